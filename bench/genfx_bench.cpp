@@ -0,0 +1,349 @@
+// genfx_bench: raster/encode microbenchmarks and end-to-end render throughput.
+//
+//   genfx_bench [--quick] [--filter TEXT] [--isa NAME] [--out results.json]
+//               [--compare baseline.json [--input results.json] [--threshold PCT]]
+//
+// Every result is a median over several timed batches. With --compare the run (or
+// the file given with --input, without running anything) is checked against a
+// baseline; results slower by more than the threshold (default 5%) are flagged and
+// the exit code is 2. --isa forces one pixel kernel variant (see PixelKernels.h).
+#include "ColorConvert.h"
+#include "EffectScript.h"
+#include "Exporter.h"
+#include "PixelKernels.h"
+#include "PngEncoder.h"
+#include "Raster.h"
+#include "Renderer.h"
+#include <wx/init.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __has_include("BuildId.h")
+#include "BuildId.h" // GENFX_BUILD_ID, regenerated on every build (cmake/BuildId.cmake)
+#endif
+#ifndef GENFX_BUILD_ID
+#define GENFX_BUILD_ID "dev"
+#endif
+#ifndef GENFX_EFFECTS_DIR
+#define GENFX_EFFECTS_DIR "effects"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double value{0.0}; // median
+    double min{0.0};
+};
+
+struct Options {
+    bool quick{false};
+    std::string filter;
+    std::string out;
+    std::string compare;
+    std::string input;
+    std::string isa;
+    double threshold{5.0};
+};
+
+double Seconds(Clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+double Median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    return n == 0 ? 0.0 : (n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]));
+}
+
+class Bench {
+public:
+    explicit Bench(const Options& opts) : m_opts(opts) {}
+
+    bool Selected(const std::string& name) const {
+        return m_opts.filter.empty() || name.find(m_opts.filter) != std::string::npos;
+    }
+
+    // fn(n) performs n operations. Batches are sized to ~20 ms; reports ns/op, or
+    // ms/frame for whole-frame kernels.
+    void Micro(const std::string& name, const std::function<void(int)>& fn, bool wholeFrames = false) {
+        if (!Selected(name)) return;
+        int n = 1;
+        for (;;) {
+            const auto t0 = Clock::now();
+            fn(n);
+            if (Seconds(Clock::now() - t0) > 0.02 || n >= (1 << 28)) break;
+            n *= 2;
+        }
+        std::vector<double> samples;
+        for (int s = 0; s < (m_opts.quick ? 3 : 7); ++s) {
+            const auto t0 = Clock::now();
+            fn(n);
+            samples.push_back(Seconds(Clock::now() - t0) * (wholeFrames ? 1e3 : 1e9) / n);
+        }
+        Add({name, wholeFrames ? "ms/frame" : "ns/op", Median(samples), *std::min_element(samples.begin(), samples.end())});
+    }
+
+    // Per-frame timings of RenderNextFrame() after a short warm-up; reports ms/frame.
+    void Render(const std::string& name, Renderer& r, int frames) {
+        if (!Selected(name)) return;
+        for (int i = 0; i < 5; ++i) r.RenderNextFrame();
+        std::vector<double> samples;
+        for (int i = 0; i < frames; ++i) {
+            const auto t0 = Clock::now();
+            r.RenderNextFrame();
+            samples.push_back(Seconds(Clock::now() - t0) * 1e3);
+        }
+        Add({name, "ms/frame", Median(samples), *std::min_element(samples.begin(), samples.end())});
+    }
+
+    const std::vector<Result>& Results() const { return m_results; }
+
+private:
+    void Add(const Result& r) {
+        std::printf("%-48s %12.3f %-8s (min %.3f)\n", r.name.c_str(), r.value, r.unit.c_str(), r.min);
+        std::fflush(stdout);
+        m_results.push_back(r);
+    }
+
+    Options m_opts;
+    std::vector<Result> m_results;
+};
+
+volatile uint32_t g_sink; // keeps results observable
+
+void RunMicro(Bench& b) {
+    const int w = 1920, h = 1080;
+    std::vector<uint8_t> buf(size_t(w) * h * 4, 0);
+    Canvas cv;
+    cv.bgra = &buf;
+    cv.width = w;
+    cv.height = h;
+    std::mt19937 rng(1234);
+    std::vector<float> rnd(1 << 16);
+    for (auto& v : rnd) v = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+    size_t k = 0;
+    auto next = [&]() { k = (k + 1) & (rnd.size() - 1); return rnd[k]; };
+
+    b.Micro("raster/putPixelBGRA", [&](int n) {
+        for (int i = 0; i < n; ++i) putPixelBGRA(cv, int(next() * w), int(next() * h), 200, 180, 40, 128);
+    });
+    for (float radius : {2.0f, 8.0f, 32.0f}) {
+        b.Micro("raster/fillCircleBGRA/r" + std::to_string(int(radius)), [&](int n) {
+            for (int i = 0; i < n; ++i) fillCircleBGRA(cv, next() * w, next() * h, radius, 255, 220, 120, 160);
+        });
+    }
+    b.Micro("raster/drawLineBGRA/64px", [&](int n) {
+        for (int i = 0; i < n; ++i) {
+            const float x = next() * w, y = next() * h, a = next() * 6.2831853f;
+            drawLineBGRA(cv, x, y, x + 64.0f * std::cos(a), y + 64.0f * std::sin(a), 180, 200, 255, 200);
+        }
+    });
+    std::vector<uint16_t> accum(buf.size(), 0);
+    Canvas acv = cv;
+    acv.accum = accum.data();
+    acv.blend = BlendMode::Additive;
+    b.Micro("raster/fillCircleBGRA/r8/accum16", [&](int n) {
+        for (int i = 0; i < n; ++i) fillCircleBGRA(acv, next() * w, next() * h, 8.0f, 255, 220, 120, 160);
+    });
+
+    // Whole-frame kernels on a rendered frame, so the data looks like real output
+    Renderer r(w, h);
+    r.SetEffect("golden-lights");
+    r.Setup();
+    for (int i = 0; i < 10; ++i) r.RenderNextFrame();
+    const std::vector<uint8_t> frameA = r.GetFrameBuffer();
+    r.RenderNextFrame();
+    const std::vector<uint8_t> frameB = r.GetFrameBuffer();
+    std::vector<uint8_t> out(frameA.size());
+    std::vector<uint16_t> frameAccum(frameA.size());
+    for (size_t i = 0; i < frameA.size(); i += 4) {
+        for (int c = 0; c < 4; ++c) frameAccum[i + c] = (uint16_t)((frameA[i + c] * frameA[i + 3] * 257u + 127u) / 255u);
+        frameAccum[i + 3] = (uint16_t)(frameA[i + 3] * 257u);
+    }
+    b.Micro("frame/ResolveAccum16ToBGRA/1920x1080", [&](int n) {
+        for (int i = 0; i < n; ++i) ResolveAccum16ToBGRA(frameAccum.data(), out.data(), out.size() / 4);
+        g_sink = out[4321];
+    }, true);
+    b.Micro("frame/crossfade/1920x1080", [&](int n) {
+        for (int i = 0; i < n; ++i) CrossfadeBGRA(frameA.data(), frameB.data(), out.data(), out.size(), 0.37f);
+        g_sink = out[12345];
+    }, true);
+    std::vector<uint8_t> y(size_t(w) * h), u(size_t(w / 2) * (h / 2)), v(u.size());
+    b.Micro("frame/ConvertBGRAToI420/1920x1080", [&](int n) {
+        for (int i = 0; i < n; ++i) ConvertBGRAToI420(frameA.data(), w, h, y.data(), w, u.data(), w / 2, v.data(), w / 2);
+        g_sink = y[777];
+    }, true);
+    b.Micro("frame/ConvertBGRAToAlphaI420/1920x1080", [&](int n) {
+        for (int i = 0; i < n; ++i) ConvertBGRAToAlphaI420(frameA.data(), w, h, y.data(), w, u.data(), w / 2, v.data(), w / 2);
+        g_sink = y[777];
+    }, true);
+    std::vector<uint8_t> png;
+    b.Micro("frame/EncodePNGFromBGRA/1920x1080", [&](int n) {
+        for (int i = 0; i < n; ++i) EncodePNGFromBGRA(frameA.data(), w, h, png);
+        g_sink = (uint32_t)png.size();
+    }, true);
+}
+
+void RunRender(Bench& b, const Options& opts) {
+    std::vector<std::string> effects = Renderer::BuiltInEffectNames();
+    for (const auto& name : ScriptEffectNames()) effects.push_back(name);
+    const SizeI sizes[] = {{1280, 720}, {720, 1280}, {1920, 1080}, {1080, 1920}};
+    const std::vector<int> densities = opts.quick ? std::vector<int>{50} : std::vector<int>{10, 50, 100};
+    const int frames = opts.quick ? 15 : 60;
+    for (const auto& effect : effects) {
+        for (const SizeI s : sizes) {
+            for (int density : densities) {
+                const std::string name = "render/" + effect + "/" + std::to_string(s.w) + "x" + std::to_string(s.h) +
+                                         "/d" + std::to_string(density);
+                if (!b.Selected(name)) continue;
+                Renderer r(s.w, s.h);
+                r.SetEffect(effect);
+                r.SetDensity(density);
+                r.Setup();
+                b.Render(name, r, frames);
+            }
+        }
+        // Primitives drawn as issued instead of binned into bands, for comparison
+        const std::string name = "render/" + effect + "/1920x1080/d50/immediate";
+        if (!b.Selected(name)) continue;
+        Renderer r(1920, 1080);
+        r.SetEffect(effect);
+        r.SetDensity(50);
+        r.SetBinnedRaster(false);
+        r.Setup();
+        b.Render(name, r, frames);
+    }
+}
+
+bool WriteJson(const std::string& path, const std::vector<Result>& results, std::string& err) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) { err = "Failed to create " + path; return false; }
+    out << "{\n  \"genfx_bench\": 1,\n  \"build\": \"" << GENFX_BUILD_ID << "\",\n  \"isa\": \""
+        << CpuIsaName(Kernels().isa) << "\",\n  \"threads\": "
+        << std::max(1u, std::thread::hardware_concurrency()) << ",\n  \"results\": [\n";
+    char line[512];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        // One result per line; ReadJson() relies on it
+        std::snprintf(line, sizeof(line), "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.6g, \"min\": %.6g}%s\n",
+                      r.name.c_str(), r.unit.c_str(), r.value, r.min, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    if (!out.good()) { err = "Failed to write " + path; return false; }
+    return true;
+}
+
+// Reads the files WriteJson() produces
+bool ReadJson(const std::string& path, std::vector<Result>& results, std::string& err) {
+    std::ifstream in(path);
+    if (!in) { err = "Failed to open " + path; return false; }
+    auto field = [](const std::string& line, const char* key) -> std::string {
+        const std::string k = std::string("\"") + key + "\": ";
+        const size_t p = line.find(k);
+        if (p == std::string::npos) return std::string();
+        size_t b = p + k.size(), e;
+        if (line[b] == '"') { ++b; e = line.find('"', b); }
+        else e = line.find_first_of(",}", b);
+        return e == std::string::npos ? std::string() : line.substr(b, e - b);
+    };
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string name = field(line, "name");
+        if (name.empty()) continue;
+        results.push_back({name, field(line, "unit"), std::atof(field(line, "value").c_str()),
+                           std::atof(field(line, "min").c_str())});
+    }
+    if (results.empty()) { err = path + " has no genfx_bench results"; return false; }
+    return true;
+}
+
+// Lower is better for every unit this tool reports. Returns the number of regressions.
+int Compare(const std::vector<Result>& base, const std::vector<Result>& current, double threshold) {
+    std::map<std::string, const Result*> byName;
+    for (const auto& r : base) byName[r.name] = &r;
+    int regressions = 0, improvements = 0, compared = 0;
+    std::printf("\n%-48s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    for (const auto& r : current) {
+        auto it = byName.find(r.name);
+        if (it == byName.end() || it->second->value <= 0.0 || it->second->unit != r.unit) continue;
+        ++compared;
+        const double pct = (r.value / it->second->value - 1.0) * 100.0;
+        const char* flag = "";
+        if (pct > threshold) { flag = "  REGRESSION"; ++regressions; }
+        else if (pct < -threshold) { flag = "  faster"; ++improvements; }
+        std::printf("%-48s %12.3f %12.3f %+8.1f%%%s\n", r.name.c_str(), it->second->value, r.value, pct, flag);
+    }
+    std::printf("\n%d compared, %d faster, %d regressions beyond %.1f%%\n", compared, improvements, regressions, threshold);
+    return regressions;
+}
+
+int Usage() {
+    std::cerr << "usage: genfx_bench [--quick] [--filter TEXT] [--isa NAME] [--out results.json]\n"
+                 "                   [--compare baseline.json [--input results.json] [--threshold PCT]]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (a == "--quick") opts.quick = true;
+        else if (a == "--filter" && (v = value())) opts.filter = v;
+        else if (a == "--out" && (v = value())) opts.out = v;
+        else if (a == "--compare" && (v = value())) opts.compare = v;
+        else if (a == "--input" && (v = value())) opts.input = v;
+        else if (a == "--isa" && (v = value())) opts.isa = v;
+        else if (a == "--threshold" && (v = value())) opts.threshold = std::atof(v);
+        else return Usage();
+    }
+    if (!opts.input.empty() && opts.compare.empty()) return Usage();
+
+    std::string err;
+    std::vector<Result> results;
+    if (!opts.input.empty()) {
+        if (!ReadJson(opts.input, results, err)) { std::cerr << err << std::endl; return 1; }
+    } else {
+        if (!opts.isa.empty()) {
+            CpuIsa isa;
+            if (!ParseCpuIsa(opts.isa, isa)) return Usage();
+            if (!SelectCpuIsa(isa, err)) { std::cerr << err << std::endl; return 1; }
+        }
+        std::cout << "genfx_bench: " << CpuIsaReport() << std::endl;
+        wxInitializer wx; // wxImage backs the PNG encoder
+        std::vector<std::string> errors;
+        LoadEffectScripts(GENFX_EFFECTS_DIR, errors);
+        for (const auto& e : errors) std::cerr << "Effect script " << e << std::endl;
+        Bench bench(opts);
+        RunMicro(bench);
+        RunRender(bench, opts);
+        results = bench.Results();
+        if (!opts.out.empty()) {
+            if (!WriteJson(opts.out, results, err)) { std::cerr << err << std::endl; return 1; }
+            std::cout << "Results written to " << opts.out << std::endl;
+        }
+    }
+    if (opts.compare.empty()) return 0;
+    std::vector<Result> base;
+    if (!ReadJson(opts.compare, base, err)) { std::cerr << err << std::endl; return 1; }
+    return Compare(base, results, opts.threshold) > 0 ? 2 : 0;
+}
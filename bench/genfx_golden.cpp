@@ -0,0 +1,363 @@
+// genfx_golden: holds the optimized render paths to the scalar reference renderer.
+//
+//   genfx_golden [--frames N] [--filter TEXT] [--isa NAME] [--write golden.txt | --check golden.txt]
+//
+// First every pixel kernel variant the CPU supports is run on random data against the
+// scalar one. Then every case (each effect at each export size, plus high-precision
+// and overlay variants) is rendered from its fixed seeds by the reference renderer and
+// by the optimized renderer at several thread counts and with every kernel variant.
+// Checks:
+//   - kernel variants and the optimized frames are bit-identical, whatever the
+//     thread count or instruction set, and so are frames rendered in strips;
+//   - they differ from the reference by no more than the case's tolerance (below);
+//   - with --check, the reference frames hash to the values in the golden file.
+// --write records the reference hashes of a known-good build. Exit code 2 = mismatch.
+#include "EffectScript.h"
+#include "PixelKernels.h"
+#include "Renderer.h"
+#include <wx/init.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef GENFX_EFFECTS_DIR
+#define GENFX_EFFECTS_DIR "effects"
+#endif
+
+namespace {
+
+struct Case {
+    std::string name;
+    int w{0}, h{0};
+    std::function<void(Renderer&)> configure;
+};
+
+// Max |optimized - reference| per 8-bit channel, where the optimized path is allowed
+// to differ. Everything else must be bit-exact.
+//  - Accumulation resolve: the SSE2 unpremultiply (float reciprocal, round-half-even)
+//    may land one step away from the integer division, and glow on top of it can
+//    carry that step into a second one.
+int ToleranceFor(const Renderer& r) {
+    if (!r.UsesAccumulation()) return 0;
+    return r.GetGlow().enabled() ? 2 : 1;
+}
+
+uint64_t HashFrame(const std::vector<uint8_t>& bgra) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (uint8_t b : bgra) { h ^= b; h *= 1099511628211ull; }
+    return h;
+}
+
+int MaxError(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, size_t& where) {
+    int worst = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const int d = std::abs(int(a[i]) - int(b[i]));
+        if (d > worst) { worst = d; where = i; }
+    }
+    return worst;
+}
+
+std::vector<Case> BuildCases() {
+    std::vector<std::string> effects = Renderer::BuiltInEffectNames();
+    for (const auto& name : ScriptEffectNames()) effects.push_back(name);
+    const SizeI sizes[] = {{1280, 720}, {720, 1280}, {1920, 1080}, {1080, 1920}};
+    std::vector<Case> cases;
+    for (const auto& effect : effects) {
+        for (const SizeI s : sizes) {
+            cases.push_back({effect + "/" + std::to_string(s.w) + "x" + std::to_string(s.h), s.w, s.h,
+                             [effect](Renderer& r) { r.SetEffect(effect); }});
+        }
+        // 16-bit accumulation (Over and Additive particles) and motion blur, all opt-in
+        cases.push_back({effect + "/1280x720/high-precision", 1280, 720, [effect](Renderer& r) {
+                             r.SetEffect(effect);
+                             r.SetHighPrecision(true);
+                         }});
+        cases.push_back({effect + "/1280x720/additive", 1280, 720, [effect](Renderer& r) {
+                             r.SetEffect(effect);
+                             r.SetBlendMode(BlendMode::Additive);
+                         }});
+        cases.push_back({effect + "/1280x720/motion-blur", 1280, 720, [effect](Renderer& r) {
+                             r.SetEffect(effect);
+                             r.SetMotionBlur(true);
+                         }});
+    }
+    // Layer stack: concurrent layers plus Over and Additive composites
+    cases.push_back({"overlay/golden-lights+snow+fireflies/1280x720", 1280, 720, [](Renderer& r) {
+                         r.SetEffect("golden-lights");
+                         LayerDesc snow = Renderer::DefaultLayerForEffect("snow");
+                         snow.opacity = 0.7f;
+                         r.AddLayer(snow);
+                         LayerDesc flies = Renderer::DefaultLayerForEffect("fireflies");
+                         flies.composite = BlendMode::Additive;
+                         r.AddLayer(flies);
+                     }});
+    return cases;
+}
+
+// Every supported kernel variant against the scalar one on random rows, including
+// odd widths and lengths that exercise the vector tails. Returns the failures.
+int CheckKernels() {
+    std::mt19937 rng(4242);
+    auto bytes = [&](size_t n) {
+        std::vector<uint8_t> v(n);
+        for (auto& b : v) b = (uint8_t)(rng() & 0xFF);
+        // Runs of transparent and opaque pixels, as in real frames
+        for (size_t i = 0; i + 64 <= n; i += 256) std::fill(v.begin() + i, v.begin() + i + 64, uint8_t(i % 512 ? 255 : 0));
+        return v;
+    };
+    const int w = 1283; // odd, and not a multiple of any vector width
+    const size_t px = size_t(w);
+    const std::vector<uint8_t> a = bytes(px * 4), b = bytes(px * 4), c = bytes(px * 4);
+    std::vector<uint16_t> accum(px * 4);
+    for (size_t i = 0; i < px; ++i) {
+        const uint16_t al = (i % 7 == 0) ? 0 : (uint16_t)(rng() & 0xFFFF);
+        for (int k = 0; k < 3; ++k) accum[i * 4 + k] = (uint16_t)(i % 5 == 0 ? rng() & 0xFFFF : al ? rng() % (al + 1u) : 0);
+        accum[i * 4 + 3] = al;
+    }
+    // Upsampled glow as GlowPass hands it to glowComposite: premultiplied, 0..16320
+    std::vector<uint16_t> glow(px * 4);
+    for (size_t i = 0; i < px; ++i) {
+        const uint16_t ga = (i % 6 == 0) ? 0 : (uint16_t)(rng() % 16321);
+        for (int k = 0; k < 3; ++k) glow[i * 4 + k] = (uint16_t)(ga ? rng() % (ga + 1u) : 0);
+        glow[i * 4 + 3] = ga;
+    }
+
+    const PixelKernels& s = *KernelsFor(CpuIsa::Scalar);
+    int failures = 0;
+    for (CpuIsa isa : {CpuIsa::SSE2, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        const PixelKernels* k = KernelsFor(isa);
+        if (!k) continue;
+        auto check = [&](const char* kernel, const auto& run) {
+            std::vector<uint8_t> expect, got;
+            run(s, expect);
+            run(*k, got);
+            const bool ok = expect == got;
+            const std::string name = std::string("kernels/") + CpuIsaName(isa) + "/" + kernel;
+            std::printf("%-52s %s\n", name.c_str(), ok ? "ok" : "FAIL  differs from scalar");
+            if (!ok) ++failures;
+        };
+        check("resolveAccum16", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            out.assign(px * 4, 0);
+            kt.resolveAccum16(accum.data(), out.data(), px);
+        });
+        check("crossfade", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            out.assign(px * 4, 0);
+            for (float t : {0.0f, 0.13f, 0.5f, 0.77f, 1.0f}) kt.crossfade(a.data(), b.data(), out.data(), out.size() - 3, t);
+        });
+        check("composite", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            out = c;
+            for (float op : {1.0f, 0.6f}) {
+                kt.composite(out.data(), a.data(), px, op, BlendMode::Over);
+                kt.composite(out.data(), b.data(), px, op, BlendMode::Additive);
+            }
+        });
+        check("lumaRow+chromaRow+alphaRow", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            out.assign(px * 2 + 2 * ((px + 1) / 2), 0);
+            kt.lumaRow(a.data(), out.data(), w);
+            kt.alphaRow(a.data(), out.data() + px, w);
+            kt.chromaRow(a.data(), b.data(), out.data() + px * 2, out.data() + px * 2 + (px + 1) / 2, w);
+        });
+        check("downscale2x2Premul", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            std::vector<uint16_t> half((px + 1) / 2 * 4);
+            kt.downscale2x2Premul(a.data(), b.data(), half.data(), w);
+            out.assign(reinterpret_cast<const uint8_t*>(half.data()), reinterpret_cast<const uint8_t*>(half.data() + half.size()));
+        });
+        check("glowComposite", [&](const PixelKernels& kt, std::vector<uint8_t>& out) {
+            out = c;
+            for (uint32_t gain : {816u, 4080u}) kt.glowComposite(out.data(), glow.data(), px, gain);
+        });
+    }
+    return failures;
+}
+
+std::string Key(const std::string& name, int frame) { return name + "#" + std::to_string(frame); }
+
+bool ReadGolden(const std::string& path, std::map<std::string, uint64_t>& golden, std::string& err) {
+    std::ifstream in(path);
+    if (!in) { err = "Failed to open " + path; return false; }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        std::string name, hash;
+        int frame = 0;
+        if (!(ls >> name >> frame >> hash)) { err = path + ": bad line: " + line; return false; }
+        golden[Key(name, frame)] = std::strtoull(hash.c_str(), nullptr, 16);
+    }
+    return true;
+}
+
+int Usage() {
+    std::cerr << "usage: genfx_golden [--frames N] [--filter TEXT] [--isa NAME] [--write golden.txt | --check golden.txt]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int frames = 6;
+    std::string filter, writePath, checkPath, isaName;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) return Usage();
+        ++i;
+        if (a == "--frames") frames = std::max(1, std::atoi(v));
+        else if (a == "--filter") filter = v;
+        else if (a == "--write") writePath = v;
+        else if (a == "--check") checkPath = v;
+        else if (a == "--isa") isaName = v;
+        else return Usage();
+    }
+    if (!writePath.empty() && !checkPath.empty()) return Usage();
+
+    std::string err;
+    if (!isaName.empty()) {
+        CpuIsa isa;
+        if (!ParseCpuIsa(isaName, isa)) return Usage();
+        if (!SelectCpuIsa(isa, err)) { std::cerr << err << std::endl; return 1; }
+    }
+    std::printf("genfx_golden: %s\n", CpuIsaReport().c_str());
+
+    wxInitializer wx;
+    std::vector<std::string> errors;
+    LoadEffectScripts(GENFX_EFFECTS_DIR, errors);
+    for (const auto& e : errors) std::cerr << "Effect script " << e << std::endl;
+
+    std::map<std::string, uint64_t> golden;
+    if (!checkPath.empty() && !ReadGolden(checkPath, golden, err)) { std::cerr << err << std::endl; return 1; }
+    std::ofstream out;
+    if (!writePath.empty()) {
+        out.open(writePath, std::ios::trunc);
+        if (!out) { std::cerr << "Failed to create " << writePath << std::endl; return 1; }
+        out << "# genfx_golden reference hashes: case frame fnv1a64\n";
+    }
+
+    // 1 and odd counts change the row-band split; more threads than cores is fine.
+    // The other kernel variants run once each.
+    struct Variant {
+        int threads;
+        CpuIsa isa;
+        std::string label;
+    };
+    const int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+    const CpuIsa active = Kernels().isa;
+    std::vector<Variant> variants;
+    for (int threads : {1, 2, 3, 7, std::max(8, hw)}) {
+        variants.push_back({threads, active, std::string(CpuIsaName(active)) + "/" + std::to_string(threads) + " threads"});
+    }
+    for (CpuIsa isa : {CpuIsa::Scalar, CpuIsa::SSE2, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        if (isa != active && CpuIsaSupported(isa)) variants.push_back({hw, isa, CpuIsaName(isa)});
+    }
+
+    int failures = filter.empty() || filter.find("kernels") != std::string::npos ? CheckKernels() : 0;
+    int checked = 0, missing = 0;
+    for (const Case& c : BuildCases()) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+        Renderer ref(c.w, c.h);
+        c.configure(ref);
+        ref.SetReference(true);
+        ref.Setup();
+        const int tolerance = ToleranceFor(ref);
+        std::vector<std::vector<uint8_t>> refFrames;
+        bool ok = true;
+        for (int f = 0; f < frames; ++f) {
+            ref.RenderNextFrame();
+            refFrames.push_back(ref.GetFrameBuffer());
+            const uint64_t h = HashFrame(refFrames.back());
+            if (out.is_open()) {
+                char line[32];
+                std::snprintf(line, sizeof(line), "%016" PRIx64, h);
+                out << c.name << ' ' << f << ' ' << line << '\n';
+            }
+            if (checkPath.empty()) continue;
+            auto it = golden.find(Key(c.name, f));
+            if (it == golden.end()) { ++missing; continue; }
+            ++checked;
+            if (it->second != h) {
+                std::printf("  %s frame %d: reference hash %016" PRIx64 ", golden %016" PRIx64 "\n",
+                            c.name.c_str(), f, h, it->second);
+                ok = false;
+            }
+        }
+
+        std::vector<uint64_t> firstHashes;
+        int worst = 0;
+        for (const Variant& variant : variants) {
+            SelectCpuIsa(variant.isa, err);
+            ParallelForLimit limit(variant.threads);
+            Renderer opt(c.w, c.h);
+            c.configure(opt);
+            opt.Setup();
+            for (int f = 0; f < frames; ++f) {
+                opt.RenderNextFrame();
+                const std::vector<uint8_t>& frame = opt.GetFrameBuffer();
+                const uint64_t h = HashFrame(frame);
+                if (firstHashes.size() < size_t(frames)) {
+                    firstHashes.push_back(h);
+                } else if (h != firstHashes[f]) {
+                    std::printf("  %s frame %d: %s differs from %s\n", c.name.c_str(), f, variant.label.c_str(),
+                                variants[0].label.c_str());
+                    ok = false;
+                }
+                size_t where = 0;
+                const int e = MaxError(frame, refFrames[f], where);
+                worst = std::max(worst, e);
+                if (e > tolerance) {
+                    const size_t px = where / 4;
+                    std::printf("  %s frame %d (%s): error %d at (%zu, %zu) channel %zu, tolerance %d\n",
+                                c.name.c_str(), f, variant.label.c_str(), e, px % (size_t)c.w, px / (size_t)c.w, where % 4, tolerance);
+                    ok = false;
+                }
+            }
+        }
+        SelectCpuIsa(active, err);
+        {
+            // Strips (with a short last one) reassemble into the whole frame
+            Renderer strips(c.w, c.h);
+            c.configure(strips);
+            strips.SetStripRows(c.h / 7);
+            strips.Setup();
+            std::vector<uint8_t> frame;
+            for (int f = 0; f < frames; ++f) {
+                strips.RenderNextFrame();
+                frame.clear();
+                for (int i = 0; i < strips.GetStripCount(); ++i) {
+                    strips.RenderStrip(i);
+                    frame.insert(frame.end(), strips.GetFrameBuffer().begin(), strips.GetFrameBuffer().end());
+                }
+                if (HashFrame(frame) != firstHashes[f]) {
+                    std::printf("  %s frame %d: strips of %d rows differ from whole frames\n", c.name.c_str(), f,
+                                strips.GetStripRows());
+                    ok = false;
+                }
+            }
+        }
+        std::printf("%-52s %s  max error %d (tolerance %d)\n", c.name.c_str(), ok ? "ok  " : "FAIL", worst, tolerance);
+        std::fflush(stdout);
+        if (!ok) ++failures;
+    }
+
+    if (out.is_open()) {
+        out.close();
+        if (!out) { std::cerr << "Failed to write " << writePath << std::endl; return 1; }
+        std::cout << "Reference hashes written to " << writePath << std::endl;
+    }
+    if (!checkPath.empty()) {
+        std::printf("%d frames checked against %s", checked, checkPath.c_str());
+        if (missing) std::printf(", %d without golden data", missing);
+        std::printf("\n");
+    }
+    std::printf("%d check(s) failed\n", failures);
+    return failures ? 2 : 0;
+}
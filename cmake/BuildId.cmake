@@ -0,0 +1,38 @@
+# Writes BuildId.h (GENFX_BUILD_ID) at build time; run with
+#   cmake -DSOURCE_DIR=<repo> -DOUTPUT=<header> -P BuildId.cmake
+# The id is 'git describe --always --dirty'. A dirty tree gets a hash of its changes
+# as well, so every edit to the sources gives a new id. The header is only rewritten
+# when the id changes, so unchanged builds recompile nothing.
+execute_process(COMMAND git describe --always --dirty
+    WORKING_DIRECTORY ${SOURCE_DIR}
+    OUTPUT_VARIABLE id OUTPUT_STRIP_TRAILING_WHITESPACE ERROR_QUIET)
+if (NOT id)
+    set(id "dev")
+elseif (id MATCHES "-dirty$")
+    execute_process(COMMAND git diff HEAD
+        WORKING_DIRECTORY ${SOURCE_DIR}
+        OUTPUT_VARIABLE changes ERROR_QUIET)
+    execute_process(COMMAND git ls-files --others --exclude-standard
+        WORKING_DIRECTORY ${SOURCE_DIR}
+        OUTPUT_VARIABLE untracked OUTPUT_STRIP_TRAILING_WHITESPACE ERROR_QUIET)
+    if (untracked)
+        string(REPLACE "\n" ";" untracked "${untracked}")
+        foreach (f IN LISTS untracked)
+            if (EXISTS "${SOURCE_DIR}/${f}" AND NOT IS_DIRECTORY "${SOURCE_DIR}/${f}")
+                file(SHA1 "${SOURCE_DIR}/${f}" h)
+                string(APPEND changes "${f} ${h}\n")
+            endif()
+        endforeach()
+    endif()
+    string(SHA1 hash "${changes}")
+    string(SUBSTRING "${hash}" 0 12 hash)
+    set(id "${id}-${hash}")
+endif()
+
+set(content "// Generated by cmake/BuildId.cmake on every build; do not edit\n#pragma once\n#define GENFX_BUILD_ID \"${id}\"\n")
+if (EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" old)
+endif()
+if (NOT old STREQUAL content)
+    file(WRITE "${OUTPUT}" "${content}")
+endif()
@@ -0,0 +1,289 @@
+#include "AnimatedWebP.h"
+#include "Utils.h"
+#include <webp/encode.h>
+#include <webp/mux.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct WebPFrame {
+    int x{0}, y{0}, w{0}, h{0};
+    int durationMs{0};
+    std::vector<uint8_t> data;
+};
+
+struct Rect { int x0, y0, x1, y1; bool empty() const { return x1 <= x0 || y1 <= y0; } };
+
+// Bounding box of the pixels that differ between two BGRA frames
+Rect DiffRect(const uint8_t* a, const uint8_t* b, int w, int h) {
+    const int chunks = std::clamp(h / 32, 1, JobWorkerCount());
+    std::vector<Rect> parts(size_t(chunks), Rect{w, h, 0, 0});
+    ParallelFor(chunks, 1, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            Rect& r = parts[size_t(c)];
+            const int y0 = int((long long)h * c / chunks), y1 = int((long long)h * (c + 1) / chunks);
+            for (int y = y0; y < y1; ++y) {
+                const uint32_t* ra = reinterpret_cast<const uint32_t*>(a) + size_t(y) * w;
+                const uint32_t* rb = reinterpret_cast<const uint32_t*>(b) + size_t(y) * w;
+                if (std::memcmp(ra, rb, size_t(w) * 4) == 0) continue;
+                int l = 0, rr = w - 1;
+                while (ra[l] == rb[l]) ++l;
+                while (ra[rr] == rb[rr]) --rr;
+                r.x0 = std::min(r.x0, l);
+                r.x1 = std::max(r.x1, rr + 1);
+                r.y0 = std::min(r.y0, y);
+                r.y1 = std::max(r.y1, y + 1);
+            }
+        }
+    });
+    Rect out{w, h, 0, 0};
+    for (const Rect& r : parts) {
+        if (r.empty()) continue;
+        out.x0 = std::min(out.x0, r.x0); out.y0 = std::min(out.y0, r.y0);
+        out.x1 = std::max(out.x1, r.x1); out.y1 = std::max(out.y1, r.y1);
+    }
+    return out;
+}
+
+bool EncodeWebP(const uint8_t* bgra, int w, int h, const EncoderSettings& s, std::vector<uint8_t>& out) {
+    WebPConfig config;
+    if (!WebPConfigInit(&config)) return false;
+    // crf 0..63 maps onto WebP quality 100..0; crf 0 selects lossless
+    config.lossless = s.crf <= 0;
+    config.quality = config.lossless ? 75.0f : std::clamp(100.0f - s.crf * (100.0f / 63.0f), 0.0f, 100.0f);
+    config.method = std::clamp(6 - s.cpuUsed, 0, 6);
+    config.alpha_quality = 100;
+    config.thread_level = 0; // parallelism comes from encoding many frames at once
+    if (!WebPValidateConfig(&config)) return false;
+    WebPPicture pic;
+    if (!WebPPictureInit(&pic)) return false;
+    pic.use_argb = config.lossless;
+    pic.width = w;
+    pic.height = h;
+    if (!WebPPictureImportBGRA(&pic, bgra, w * 4)) return false;
+    WebPMemoryWriter writer;
+    WebPMemoryWriterInit(&writer);
+    pic.writer = WebPMemoryWrite;
+    pic.custom_ptr = &writer;
+    const bool ok = WebPEncode(&config, &pic) != 0;
+    WebPPictureFree(&pic);
+    if (ok) out.assign(writer.mem, writer.mem + writer.size);
+    WebPMemoryWriterClear(&writer);
+    return ok;
+}
+
+bool AssembleWebP(const std::vector<WebPFrame>& frames, int w, int h, const std::string& path,
+                  uint64_t& bytes, std::string& err) {
+    WebPMux* mux = WebPMuxNew();
+    if (!mux) { err = "WebPMuxNew failed"; return false; }
+    WebPMuxAnimParams anim;
+    anim.bgcolor = 0x00000000; // transparent
+    anim.loop_count = 0;       // forever
+    bool ok = WebPMuxSetCanvasSize(mux, w, h) == WEBP_MUX_OK &&
+              WebPMuxSetAnimationParams(mux, &anim) == WEBP_MUX_OK;
+    for (size_t i = 0; ok && i < frames.size(); ++i) {
+        const WebPFrame& f = frames[i];
+        WebPMuxFrameInfo info;
+        std::memset(&info, 0, sizeof(info));
+        info.bitstream.bytes = f.data.data();
+        info.bitstream.size = f.data.size();
+        info.x_offset = f.x;
+        info.y_offset = f.y;
+        info.duration = f.durationMs;
+        info.id = WEBP_CHUNK_ANMF;
+        // Each frame replaces its rectangle (alpha included); the rest of the canvas
+        // already holds the previous frame
+        info.dispose_method = WEBP_MUX_DISPOSE_NONE;
+        info.blend_method = WEBP_MUX_NO_BLEND;
+        ok = WebPMuxPushFrame(mux, &info, 0) == WEBP_MUX_OK;
+    }
+    WebPData data;
+    WebPDataInit(&data);
+    ok = ok && WebPMuxAssemble(mux, &data) == WEBP_MUX_OK;
+    WebPMuxDelete(mux);
+    if (!ok) { err = "Failed to assemble animated WebP"; WebPDataClear(&data); return false; }
+    std::ofstream ofs(path, std::ios::binary);
+    if (ofs) ofs.write(reinterpret_cast<const char*>(data.bytes), (std::streamsize)data.size);
+    bytes = data.size;
+    WebPDataClear(&data);
+    if (!ofs.good()) { err = "Failed to write " + path; return false; }
+    return true;
+}
+
+class AnimatedWebPEncoder : public VideoEncoder {
+public:
+    // 'collect' keeps the encoded frames for a SegmentedOutput instead of writing a file
+    explicit AnimatedWebPEncoder(bool collect = false) : m_collect(collect) {}
+
+    bool Open(const std::string& outPath, const EncoderSettings& settings, std::string&) override {
+        m_path = outPath;
+        m_settings = settings;
+        m_index = settings.firstFrame;
+        m_stats = EncoderStats{};
+        m_prev.clear();
+        m_jobs.clear();
+        m_maxInFlight = JobWorkerCount();
+        return true;
+    }
+
+    bool WriteFrame(const uint8_t* bgra, std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        const int w = m_settings.width, h = m_settings.height;
+        const size_t bytes = size_t(w) * h * 4;
+        // Integer ms durations that add up exactly over the loop
+        const int fps = std::max(1, m_settings.fps);
+        const int duration = int((int64_t(m_index + 1) * 1000 + fps / 2) / fps - (int64_t(m_index) * 1000 + fps / 2) / fps);
+        ++m_index;
+
+        Rect r = m_prev.empty() ? Rect{0, 0, w, h} : DiffRect(m_prev.data(), bgra, w, h);
+        if (r.empty() && !m_jobs.empty()) {
+            m_jobs.back().frame.durationMs += duration; // identical frame: show the last one longer
+        } else {
+            if (r.empty()) r = Rect{0, 0, std::min(w, 2), std::min(h, 2)};
+            // Frame offsets are stored halved, so they must be even
+            r.x0 &= ~1;
+            r.y0 &= ~1;
+            Job job;
+            job.frame.x = r.x0;
+            job.frame.y = r.y0;
+            job.frame.w = r.x1 - r.x0;
+            job.frame.h = r.y1 - r.y0;
+            job.frame.durationMs = duration;
+            auto crop = std::make_shared<std::vector<uint8_t>>(size_t(job.frame.w) * job.frame.h * 4);
+            for (int y = 0; y < job.frame.h; ++y) {
+                std::memcpy(crop->data() + size_t(y) * job.frame.w * 4,
+                            bgra + (size_t(r.y0 + y) * w + r.x0) * 4, size_t(job.frame.w) * 4);
+            }
+            const EncoderSettings s = m_settings;
+            const int cw = job.frame.w, ch = job.frame.h;
+            auto encoded = std::make_shared<std::vector<uint8_t>>();
+            job.encoded = encoded;
+            job.encode = std::make_unique<JobGroup>(JobPriority::Background);
+            job.encode->Run([crop, cw, ch, s, encoded]() {
+                if (!EncodeWebP(crop->data(), cw, ch, s, *encoded)) encoded->clear();
+            });
+            m_jobs.push_back(std::move(job));
+            // Bound the frames in flight (and their crops) to the core count
+            if (!Collect((int)m_jobs.size() - m_maxInFlight, err)) return false;
+        }
+        m_prev.assign(bgra, bgra + bytes);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_stats.frames++;
+        m_stats.frameMs += ms;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, ms);
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!Collect((int)m_jobs.size(), err)) return false;
+        m_prev.clear();
+        m_stats.bytes = 0;
+        for (const Job& j : m_jobs) m_stats.bytes += j.frame.data.size();
+        if (!m_collect && !AssembleWebP(TakeFrames(), m_settings.width, m_settings.height, m_path, m_stats.bytes, err))
+            return false;
+        m_stats.finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    const char* Name() const override { return "libwebp"; }
+
+    std::vector<WebPFrame> TakeFrames() {
+        std::vector<WebPFrame> out;
+        out.reserve(m_jobs.size());
+        for (Job& j : m_jobs) out.push_back(std::move(j.frame));
+        m_jobs.clear();
+        return out;
+    }
+
+private:
+    struct Job {
+        WebPFrame frame;
+        std::unique_ptr<JobGroup> encode; // WebPEncode on the job pool
+        std::shared_ptr<std::vector<uint8_t>> encoded;
+    };
+
+    // Wait for the encodes of the first 'upTo' jobs
+    bool Collect(int upTo, std::string& err) {
+        for (int i = m_collected; i < upTo; ++i, ++m_collected) {
+            Job& j = m_jobs[size_t(i)];
+            j.encode->Wait();
+            j.frame.data = std::move(*j.encoded);
+            if (j.frame.data.empty()) { err = "WebPEncode failed"; return false; }
+        }
+        return true;
+    }
+
+    bool m_collect{false};
+    std::string m_path;
+    EncoderSettings m_settings;
+    int m_index{0};
+    int m_maxInFlight{1};
+    int m_collected{0};
+    std::vector<uint8_t> m_prev;
+    std::vector<Job> m_jobs;
+};
+
+class AnimatedWebPOutput : public SegmentedOutput {
+public:
+    bool Open(const std::string& outPath, const EncoderSettings& settings, int segments, std::string&) override {
+        m_path = outPath;
+        m_settings = settings;
+        m_segments.assign(size_t(std::max(1, segments)), {});
+        m_done.assign(m_segments.size(), false);
+        m_bytes = 0;
+        return true;
+    }
+
+    std::unique_ptr<VideoEncoder> BeginSegment(int, int firstFrame, std::string& err) override {
+        auto enc = std::make_unique<AnimatedWebPEncoder>(true);
+        EncoderSettings s = m_settings;
+        s.firstFrame = firstFrame;
+        if (!enc->Open(std::string(), s, err)) return nullptr;
+        return enc;
+    }
+
+    bool EndSegment(int index, std::unique_ptr<VideoEncoder> encoder, std::string& err) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int)m_segments.size() || m_done[size_t(index)]) {
+            err = "Invalid segment index";
+            return false;
+        }
+        m_segments[size_t(index)] = static_cast<AnimatedWebPEncoder&>(*encoder).TakeFrames();
+        m_done[size_t(index)] = true;
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        std::vector<WebPFrame> all;
+        for (size_t i = 0; i < m_segments.size(); ++i) {
+            if (!m_done[i]) { err = "Export ended with unfinished segments"; return false; }
+            for (auto& f : m_segments[i]) all.push_back(std::move(f));
+        }
+        m_segments.clear();
+        return AssembleWebP(all, m_settings.width, m_settings.height, m_path, m_bytes, err);
+    }
+
+    const char* Name() const override { return "libwebp"; }
+    uint64_t Bytes() const override { return m_bytes; }
+
+private:
+    std::string m_path;
+    EncoderSettings m_settings;
+    std::mutex m_mutex;
+    std::vector<std::vector<WebPFrame>> m_segments;
+    std::vector<bool> m_done;
+    uint64_t m_bytes{0};
+};
+
+} // namespace
+
+std::unique_ptr<VideoEncoder> CreateAnimatedWebPEncoder() { return std::make_unique<AnimatedWebPEncoder>(); }
+std::unique_ptr<SegmentedOutput> CreateAnimatedWebPOutput() { return std::make_unique<AnimatedWebPOutput>(); }
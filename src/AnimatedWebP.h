@@ -0,0 +1,10 @@
+#pragma once
+#include "VideoEncoder.h"
+
+// Animated WebP with alpha (libwebp + libwebpmux). Each frame is reduced to the
+// even-aligned rectangle that changed since the previous frame (unchanged frames just
+// extend the previous frame's duration) and encoded with WebPEncode on its own
+// thread; WebPMux assembles the frames in order into a looping animation.
+std::unique_ptr<VideoEncoder> CreateAnimatedWebPEncoder();
+// Segments start with a full frame; their frames are concatenated at Finish()
+std::unique_ptr<SegmentedOutput> CreateAnimatedWebPOutput();
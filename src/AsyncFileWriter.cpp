@@ -0,0 +1,118 @@
+#include "AsyncFileWriter.h"
+#include "Trace.h"
+#include <chrono>
+#include <fstream>
+#ifdef __linux__
+  #include <cerrno>
+  #include <cstring>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace {
+
+bool WriteWholeFile(const std::string& path, const std::vector<uint8_t>& data, std::string& err) {
+#ifdef __linux__
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { err = "Failed to create " + path + ": " + std::strerror(errno); return false; }
+    // Reserve the extent up front: one allocation instead of growing block by block.
+    // Filesystems without fallocate just skip it.
+    if (!data.empty()) (void)::posix_fallocate(fd, 0, off_t(data.size()));
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            err = "Failed to write " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        done += size_t(n);
+    }
+    if (::close(fd) != 0) { err = "Failed to write " + path + ": " + std::strerror(errno); return false; }
+    return true;
+#else
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (ofs) ofs.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    ofs.close();
+    if (!ofs) { err = "Failed to write " + path; return false; }
+    return true;
+#endif
+}
+
+} // namespace
+
+AsyncFileWriter::AsyncFileWriter(size_t maxQueuedBytes)
+    : m_maxQueued(maxQueuedBytes), m_thread(&AsyncFileWriter::Run, this) {}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+bool AsyncFileWriter::Submit(std::string path, std::vector<uint8_t> data, std::string& err) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // One file larger than the whole queue still goes through, alone
+    auto t0 = std::chrono::steady_clock::now();
+    m_cv.wait(lock, [&] { return !m_error.empty() || m_queuedBytes == 0 || m_queuedBytes + data.size() <= m_maxQueued; });
+    m_stats.stalledSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (!m_error.empty()) { err = m_error; return false; }
+    m_queuedBytes += data.size();
+    ++m_submitted;
+    m_queue.push_back({std::move(path), std::move(data)});
+    lock.unlock();
+    m_cv.notify_all();
+    return true;
+}
+
+bool AsyncFileWriter::Flush(std::string& err) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const uint64_t target = m_submitted;
+    m_cv.wait(lock, [&] { return !m_error.empty() || m_written >= target; });
+    if (!m_error.empty()) { err = m_error; return false; }
+    return true;
+}
+
+FileWriterStats AsyncFileWriter::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void AsyncFileWriter::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty()) return; // stopping, nothing left
+        // The whole backlog in one batch, written without holding the lock
+        std::deque<Item> batch;
+        batch.swap(m_queue);
+        bool failed = !m_error.empty(); // after a failure the rest is dropped
+        lock.unlock();
+        GENFX_TRACE_SCOPE_ARG("write files", (int)batch.size());
+        for (const Item& item : batch) {
+            std::string error;
+            const auto t0 = std::chrono::steady_clock::now();
+            const bool ok = !failed && WriteWholeFile(item.path, item.data, error);
+            const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            // Each file frees its queue space as soon as it is written
+            lock.lock();
+            m_queuedBytes -= item.data.size();
+            ++m_written;
+            m_stats.writeSec += sec;
+            if (ok) {
+                ++m_stats.files;
+                m_stats.bytes += item.data.size();
+            } else if (m_error.empty()) {
+                m_error = error;
+            }
+            failed = !m_error.empty();
+            m_cv.notify_all();
+            lock.unlock();
+        }
+        lock.lock();
+    }
+}
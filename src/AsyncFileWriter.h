@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FileWriterStats {
+    uint64_t files{0};
+    uint64_t bytes{0};
+    double writeSec{0.0};   // I/O thread busy writing
+    double stalledSec{0.0}; // Submit() callers blocked on a full queue, summed
+    double MBps() const { return writeSec > 0.0 ? bytes / writeSec / (1024.0 * 1024.0) : 0.0; }
+    double FilesPerSec() const { return writeSec > 0.0 ? files / writeSec : 0.0; }
+};
+
+// Whole files written by a dedicated I/O thread, so encode jobs hand over a finished
+// PNG and move on instead of waiting for the disk. The queue is bounded in bytes:
+// Submit() only blocks while it is full, which holds producers to the disk's pace.
+// The thread drains everything queued in one batch per wake-up and preallocates each
+// file to its final size before writing it (Linux). Thread-safe.
+class AsyncFileWriter {
+public:
+    explicit AsyncFileWriter(size_t maxQueuedBytes = 64u << 20);
+    ~AsyncFileWriter(); // finishes the queue
+
+    // Takes 'data'; false once any earlier write has failed ('err' = the first failure)
+    bool Submit(std::string path, std::vector<uint8_t> data, std::string& err);
+    // Waits until every file submitted so far is on disk; the first failure, if any
+    bool Flush(std::string& err);
+    FileWriterStats Stats() const;
+
+private:
+    struct Item {
+        std::string path;
+        std::vector<uint8_t> data;
+    };
+    void Run();
+
+    const size_t m_maxQueued;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Item> m_queue;
+    size_t m_queuedBytes{0};
+    uint64_t m_submitted{0}, m_written{0};
+    std::string m_error;
+    FileWriterStats m_stats;
+    bool m_stop{false};
+    std::thread m_thread;
+};
@@ -0,0 +1,37 @@
+#include "ColorConvert.h"
+#include "PixelKernels.h"
+#include "Utils.h"
+#include <cstring>
+
+void ConvertBGRAToI420(const uint8_t* bgra, int width, int height,
+                       uint8_t* y, int strideY, uint8_t* u, int strideU, uint8_t* v, int strideV) {
+    const int ch = (height + 1) / 2;
+    const size_t stride = size_t(width) * 4;
+    const PixelKernels& k = Kernels();
+    // One chroma row (two luma rows) per iteration, so bands never share output rows
+    ParallelFor(ch, 16, [&](int c0, int c1) {
+        for (int cy = c0; cy < c1; ++cy) {
+            const int y0 = 2 * cy;
+            const int y1 = std::min(y0 + 1, height - 1);
+            const uint8_t* r0 = bgra + size_t(y0) * stride;
+            const uint8_t* r1 = bgra + size_t(y1) * stride;
+            k.lumaRow(r0, y + size_t(y0) * strideY, width);
+            if (y1 != y0) k.lumaRow(r1, y + size_t(y1) * strideY, width);
+            k.chromaRow(r0, r1, u + size_t(cy) * strideU, v + size_t(cy) * strideV, width);
+        }
+    });
+}
+
+void ConvertBGRAToAlphaI420(const uint8_t* bgra, int width, int height,
+                            uint8_t* y, int strideY, uint8_t* u, int strideU, uint8_t* v, int strideV) {
+    const int cw = (width + 1) / 2;
+    const int ch = (height + 1) / 2;
+    const PixelKernels& k = Kernels();
+    ParallelFor(height, 32, [&](int r0, int r1) {
+        for (int row = r0; row < r1; ++row) k.alphaRow(bgra + size_t(row) * width * 4, y + size_t(row) * strideY, width);
+    });
+    for (int cy = 0; cy < ch; ++cy) {
+        std::memset(u + size_t(cy) * strideU, 128, size_t(cw));
+        std::memset(v + size_t(cy) * strideV, 128, size_t(cw));
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+// BGRA (straight alpha) -> planar YUV 4:2:0, BT.601 limited range, matching what
+// ffmpeg's default swscale conversion to yuv420p produces. Chroma is the rounded
+// average of each 2x2 block; odd edges repeat the last row/column.
+void ConvertBGRAToI420(const uint8_t* bgra, int width, int height,
+                       uint8_t* y, int strideY, uint8_t* u, int strideU, uint8_t* v, int strideV);
+
+// Alpha channel as a full-range luma plane with neutral chroma, the layout WebM
+// alpha streams (BlockAdditional) are encoded in.
+void ConvertBGRAToAlphaI420(const uint8_t* bgra, int width, int height,
+                            uint8_t* y, int strideY, uint8_t* u, int strideU, uint8_t* v, int strideV);
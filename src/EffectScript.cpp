@@ -0,0 +1,938 @@
+#include "EffectScript.h"
+#include "Renderer.h"
+#include <array>
+#include <map>
+#include <mutex>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+namespace {
+
+constexpr int kBatch = 256;    // particles per SoA batch
+constexpr int kMaxStack = 16;  // batch-wide stack slots per program
+
+enum class Prim { Circle, Streak, Rect };
+
+struct Node {
+    enum Kind { Num, Var, Call, Bin, Neg } kind{Num};
+    float value{0.0f};
+    std::string name; // Var / Call
+    char op{0};       // Bin: + - * / % ^
+    std::vector<std::unique_ptr<Node>> kids;
+};
+
+struct Stmt {
+    std::string name;
+    std::unique_ptr<Node> expr;
+    int line{0};
+};
+
+// ---------------------- Expression parser ----------------------
+
+class ExprParser {
+public:
+    explicit ExprParser(const std::string& s) : m_s(s) {}
+
+    std::unique_ptr<Node> Parse(std::string& err) {
+        auto n = Expr();
+        SkipWs();
+        if (n && m_pos != m_s.size()) Fail(std::string("unexpected '") + m_s[m_pos] + "'");
+        if (!m_err.empty()) { err = m_err; return nullptr; }
+        return n;
+    }
+
+private:
+    void Fail(const std::string& msg) { if (m_err.empty()) m_err = msg; }
+    void SkipWs() { while (m_pos < m_s.size() && std::isspace((unsigned char)m_s[m_pos])) ++m_pos; }
+    bool Eat(char c) {
+        SkipWs();
+        if (m_pos < m_s.size() && m_s[m_pos] == c) { ++m_pos; return true; }
+        return false;
+    }
+    static std::unique_ptr<Node> MakeBin(char op, std::unique_ptr<Node> a, std::unique_ptr<Node> b) {
+        auto n = std::make_unique<Node>();
+        n->kind = Node::Bin; n->op = op;
+        n->kids.push_back(std::move(a)); n->kids.push_back(std::move(b));
+        return n;
+    }
+
+    std::unique_ptr<Node> Expr() {
+        auto n = Term();
+        while (n) {
+            if (Eat('+')) n = MakeBin('+', std::move(n), Term());
+            else if (Eat('-')) n = MakeBin('-', std::move(n), Term());
+            else break;
+            if (!n->kids[1]) return nullptr;
+        }
+        return n;
+    }
+    std::unique_ptr<Node> Term() {
+        auto n = Unary();
+        while (n) {
+            if (Eat('*')) n = MakeBin('*', std::move(n), Unary());
+            else if (Eat('/')) n = MakeBin('/', std::move(n), Unary());
+            else if (Eat('%')) n = MakeBin('%', std::move(n), Unary());
+            else break;
+            if (!n->kids[1]) return nullptr;
+        }
+        return n;
+    }
+    std::unique_ptr<Node> Unary() {
+        if (Eat('-')) {
+            auto c = Unary();
+            if (!c) return nullptr;
+            auto n = std::make_unique<Node>();
+            n->kind = Node::Neg;
+            n->kids.push_back(std::move(c));
+            return n;
+        }
+        if (Eat('+')) return Unary();
+        auto n = Primary();
+        if (n && Eat('^')) {
+            auto e = Unary();
+            if (!e) return nullptr;
+            n = MakeBin('^', std::move(n), std::move(e));
+        }
+        return n;
+    }
+    std::unique_ptr<Node> Primary() {
+        SkipWs();
+        if (m_pos >= m_s.size()) { Fail("unexpected end of expression"); return nullptr; }
+        char c = m_s[m_pos];
+        if (c == '(') {
+            ++m_pos;
+            auto n = Expr();
+            if (n && !Eat(')')) { Fail("missing ')'"); return nullptr; }
+            return n;
+        }
+        if (std::isdigit((unsigned char)c) || c == '.') {
+            const char* begin = m_s.c_str() + m_pos;
+            char* end = nullptr;
+            float v = std::strtof(begin, &end);
+            if (end == begin) { Fail("bad number"); return nullptr; }
+            m_pos += size_t(end - begin);
+            auto n = std::make_unique<Node>();
+            n->kind = Node::Num; n->value = v;
+            return n;
+        }
+        if (std::isalpha((unsigned char)c) || c == '_') {
+            size_t b = m_pos;
+            while (m_pos < m_s.size() && (std::isalnum((unsigned char)m_s[m_pos]) || m_s[m_pos] == '_')) ++m_pos;
+            auto n = std::make_unique<Node>();
+            n->name = m_s.substr(b, m_pos - b);
+            n->kind = Node::Var;
+            if (Eat('(')) {
+                n->kind = Node::Call;
+                if (!Eat(')')) {
+                    do {
+                        auto a = Expr();
+                        if (!a) return nullptr;
+                        n->kids.push_back(std::move(a));
+                    } while (Eat(','));
+                    if (!Eat(')')) { Fail("missing ')' after arguments of " + n->name); return nullptr; }
+                }
+            }
+            return n;
+        }
+        Fail(std::string("unexpected '") + c + "'");
+        return nullptr;
+    }
+
+    const std::string& m_s;
+    size_t m_pos{0};
+    std::string m_err;
+};
+
+// ---------------------- Bytecode ----------------------
+
+enum Op : uint8_t {
+    PUSHK, LOADA, LOADL, LOADT, LOADF, LOADS, LOADI, RAND,
+    ADD, SUB, MUL, DIV, POW, MIN, MAX, WRAP,
+    ADDK, SUBK, MULK, DIVK, RSUBK, RDIVK, POWK, MINK, MAXK, WRAPK,
+    NEG, SIN, COS, ABS, FLOOR, FRACT, SQRT, EXP, CLAMP, MIX,
+    STOREA, STOREL
+};
+
+struct Instr {
+    Op op;
+    uint16_t a; // attribute / local index
+    float k;    // immediate
+};
+
+struct Program {
+    std::vector<Instr> code;
+    int maxStack{0};
+};
+
+struct FnInfo { const char* name; int arity; Op op; };
+static const FnInfo kFns[] = {
+    {"sin", 1, SIN}, {"cos", 1, COS}, {"abs", 1, ABS}, {"floor", 1, FLOOR}, {"fract", 1, FRACT},
+    {"sqrt", 1, SQRT}, {"exp", 1, EXP}, {"min", 2, MIN}, {"max", 2, MAX}, {"pow", 2, POW},
+    {"wrap", 2, WRAP}, {"clamp", 3, CLAMP}, {"mix", 3, MIX},
+};
+
+static const FnInfo* FindFn(const std::string& name) {
+    for (const auto& f : kFns) if (name == f.name) return &f;
+    return nullptr;
+}
+
+static inline float Wrap(float x, float m) { return m != 0.0f ? x - std::floor(x / m) * m : x; }
+
+static float ApplyScalar(Op op, float a, float b, float c) {
+    switch (op) {
+        case ADD: return a + b;
+        case SUB: return a - b;
+        case MUL: return a * b;
+        case DIV: return a / b;
+        case POW: return std::pow(a, b);
+        case MIN: return std::min(a, b);
+        case MAX: return std::max(a, b);
+        case WRAP: return Wrap(a, b);
+        case NEG: return -a;
+        case SIN: return std::sin(a);
+        case COS: return std::cos(a);
+        case ABS: return std::fabs(a);
+        case FLOOR: return std::floor(a);
+        case FRACT: return a - std::floor(a);
+        case SQRT: return std::sqrt(a);
+        case EXP: return std::exp(a);
+        case CLAMP: return std::clamp(a, b, c);
+        case MIX: return a + (b - a) * c;
+        default: return 0.0f;
+    }
+}
+
+static Op BinOp(char op) {
+    switch (op) {
+        case '+': return ADD; case '-': return SUB; case '*': return MUL;
+        case '/': return DIV; case '%': return WRAP; default: return POW;
+    }
+}
+
+// Map "a OP b" to the immediate form when one side is a constant.
+// 'rightConst' selects "x OP k"; otherwise "k OP x". Returns false when no form exists.
+static bool ImmediateOp(Op op, bool rightConst, Op& out) {
+    switch (op) {
+        case ADD: out = ADDK; return true;
+        case MUL: out = MULK; return true;
+        case MIN: out = MINK; return true;
+        case MAX: out = MAXK; return true;
+        case SUB: out = rightConst ? SUBK : RSUBK; return true;
+        case DIV: out = rightConst ? DIVK : RDIVK; return true;
+        case POW: out = POWK; return rightConst;
+        case WRAP: out = WRAPK; return rightConst;
+        default: return false;
+    }
+}
+
+// Names resolved at compile time for the current stage.
+struct Scope {
+    const EffectContext* ctx{nullptr};
+    const std::vector<std::string>* attrs{nullptr}; // visible attributes
+    std::vector<std::string>* locals{nullptr};      // frame locals (frame stage only)
+    bool init{false};
+};
+
+static bool ContextConstant(const EffectContext& ctx, const std::string& n, float& v) {
+    if (n == "width") v = (float)ctx.width;
+    else if (n == "height") v = (float)ctx.height;
+    else if (n == "duration") v = (float)ctx.duration;
+    else if (n == "fps") v = (float)ctx.fps;
+    else if (n == "frames") v = (float)ctx.totalFrames();
+    else if (n == "density") v = (float)ctx.density;
+    else if (n == "sizemin") v = std::min(ctx.sizeMin, ctx.sizeMax);
+    else if (n == "sizemax") v = std::max(ctx.sizeMin, ctx.sizeMax);
+    else if (n == "pi") v = 3.14159265358979323846f;
+    else if (n == "tau") v = 6.28318530717958647692f;
+    else return false;
+    return true;
+}
+
+static bool IsReserved(const std::string& n) {
+    static const char* kNames[] = {"width", "height", "duration", "fps", "frames", "density", "sizemin",
+                                   "sizemax", "speed", "pi", "tau", "t", "frame", "i", "rand"};
+    for (const char* r : kNames) if (n == r) return true;
+    return FindFn(n) != nullptr;
+}
+
+class Compiler {
+public:
+    Compiler(Program& p, const Scope& s) : m_p(p), m_s(s) {}
+
+    // Emit code leaving the value of 'n' on the stack (constants are folded first).
+    bool EmitValue(const Node& n) {
+        float k;
+        if (Fold(n, k)) { Push({PUSHK, 0, k}); return true; }
+        return Emit(n);
+    }
+    void Store(Op op, int index) { m_p.code.push_back({op, (uint16_t)index, 0.0f}); --m_depth; }
+    const std::string& Error() const { return m_err; }
+    bool Fold(const Node& n, float& v) const {
+        switch (n.kind) {
+            case Node::Num: v = n.value; return true;
+            case Node::Var: return ContextConstant(*m_s.ctx, n.name, v);
+            case Node::Neg: if (!Fold(*n.kids[0], v)) return false; v = -v; return true;
+            case Node::Bin: {
+                float a, b;
+                if (!Fold(*n.kids[0], a) || !Fold(*n.kids[1], b)) return false;
+                v = ApplyScalar(BinOp(n.op), a, b, 0.0f);
+                return true;
+            }
+            case Node::Call: {
+                const FnInfo* f = FindFn(n.name);
+                if (!f || (int)n.kids.size() != f->arity) return false;
+                float a[3] = {0, 0, 0};
+                for (size_t i = 0; i < n.kids.size(); ++i) if (!Fold(*n.kids[i], a[i])) return false;
+                v = ApplyScalar(f->op, a[0], a[1], a[2]);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    void Push(Instr in) {
+        m_p.code.push_back(in);
+        if (++m_depth > m_p.maxStack) m_p.maxStack = m_depth;
+    }
+    void Pop(Instr in, int popped) { m_p.code.push_back(in); m_depth -= popped; }
+    bool Fail(const std::string& msg) { if (m_err.empty()) m_err = msg; return false; }
+
+    bool Emit(const Node& n) {
+        switch (n.kind) {
+            case Node::Num: Push({PUSHK, 0, n.value}); return true;
+            case Node::Var: return EmitVar(n.name);
+            case Node::Neg:
+                if (!EmitValue(*n.kids[0])) return false;
+                Pop({NEG, 0, 0.0f}, 0);
+                return true;
+            case Node::Bin: {
+                Op op = BinOp(n.op);
+                float lk, rk;
+                bool lc = Fold(*n.kids[0], lk), rc = Fold(*n.kids[1], rk);
+                Op imm;
+                if (rc && ImmediateOp(op, true, imm)) {
+                    if (!EmitValue(*n.kids[0])) return false;
+                    Pop({imm, 0, rk}, 0);
+                    return true;
+                }
+                if (lc && ImmediateOp(op, false, imm)) {
+                    if (!EmitValue(*n.kids[1])) return false;
+                    Pop({imm, 0, lk}, 0);
+                    return true;
+                }
+                if (!EmitValue(*n.kids[0]) || !EmitValue(*n.kids[1])) return false;
+                Pop({op, 0, 0.0f}, 1);
+                return true;
+            }
+            case Node::Call: {
+                const FnInfo* f = FindFn(n.name);
+                if (!f) return Fail("unknown function '" + n.name + "'");
+                if ((int)n.kids.size() != f->arity)
+                    return Fail(n.name + "() takes " + std::to_string(f->arity) + " argument(s)");
+                if (f->arity == 2) {
+                    // Reuse the binary-operator path (immediate forms for min/max/pow/wrap)
+                    float rk;
+                    Op imm;
+                    if (Fold(*n.kids[1], rk) && ImmediateOp(f->op, true, imm)) {
+                        if (!EmitValue(*n.kids[0])) return false;
+                        Pop({imm, 0, rk}, 0);
+                        return true;
+                    }
+                }
+                for (const auto& k : n.kids) if (!EmitValue(*k)) return false;
+                Pop({f->op, 0, 0.0f}, f->arity - 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool EmitVar(const std::string& name) {
+        if (name == "i") { Push({LOADI, 0, 0.0f}); return true; }
+        if (name == "rand") {
+            if (!m_s.init) return Fail("'rand' is only allowed in attr lines");
+            Push({RAND, 0, 0.0f});
+            return true;
+        }
+        // Per frame, so a speed change after setup reaches the next frame
+        if (name == "t" || name == "frame" || name == "speed") {
+            if (m_s.init) return Fail("'" + name + "' is not available in attr lines");
+            Push({name == "t" ? LOADT : name == "frame" ? LOADF : LOADS, 0, 0.0f});
+            return true;
+        }
+        if (m_s.locals) {
+            for (size_t i = m_s.locals->size(); i-- > 0;) {
+                if ((*m_s.locals)[i] == name) { Push({LOADL, (uint16_t)i, 0.0f}); return true; }
+            }
+        }
+        for (size_t i = 0; i < m_s.attrs->size(); ++i) {
+            if ((*m_s.attrs)[i] == name) { Push({LOADA, (uint16_t)i, 0.0f}); return true; }
+        }
+        return Fail("unknown name '" + name + "'");
+    }
+
+    Program& m_p;
+    const Scope& m_s;
+    int m_depth{0};
+    std::string m_err;
+};
+
+} // namespace
+
+struct ScriptEffectDef {
+    std::string name;
+    std::string source;
+    uint32_t seed{1};
+    std::unique_ptr<Node> count;
+    int countLine{0};
+    Prim prim{Prim::Circle};
+    std::vector<std::array<uint8_t, 3>> palette;
+    std::vector<Stmt> attrs;
+    std::vector<Stmt> frame;
+};
+
+namespace {
+
+// Programs compiled for one EffectContext.
+struct CompiledScript {
+    Program init, frame;
+    int count{0};
+    std::vector<std::string> attrNames;
+    std::vector<std::string> localNames;
+    int outX{-1}, outY{-1}, outSize{-1}, outAlpha{-1}, outDx{-1}, outDy{-1};
+};
+
+static bool CompileScript(const ScriptEffectDef& def, const EffectContext& ctx, CompiledScript& out, std::string& err) {
+    auto lineErr = [&](int line, const std::string& msg) {
+        err = "line " + std::to_string(line) + ": " + msg;
+        return false;
+    };
+    Scope scope;
+    scope.ctx = &ctx;
+
+    {
+        Program dummy;
+        std::vector<std::string> none;
+        scope.attrs = &none;
+        Compiler c(dummy, scope);
+        float n = 0.0f;
+        if (!def.count) return lineErr(0, "missing 'count'");
+        if (!c.Fold(*def.count, n)) return lineErr(def.countLine, "'count' must only use constants");
+        out.count = std::clamp((int)n, 0, 2000000);
+    }
+
+    // Attributes: each line may use the attributes declared above it
+    scope.init = true;
+    scope.attrs = &out.attrNames;
+    for (const auto& st : def.attrs) {
+        Compiler c(out.init, scope);
+        if (!c.EmitValue(*st.expr)) return lineErr(st.line, c.Error());
+        out.attrNames.push_back(st.name);
+        c.Store(STOREA, (int)out.attrNames.size() - 1);
+    }
+
+    // Per-frame locals; reassigning a name overwrites its slot
+    scope.init = false;
+    scope.locals = &out.localNames;
+    for (const auto& st : def.frame) {
+        Compiler c(out.frame, scope);
+        if (!c.EmitValue(*st.expr)) return lineErr(st.line, c.Error());
+        auto it = std::find(out.localNames.begin(), out.localNames.end(), st.name);
+        int idx = (int)(it - out.localNames.begin());
+        if (it == out.localNames.end()) out.localNames.push_back(st.name);
+        c.Store(STOREL, idx);
+    }
+    if (out.init.maxStack > kMaxStack || out.frame.maxStack > kMaxStack) {
+        err = "expression too deeply nested";
+        return false;
+    }
+    auto find = [&](const char* n) {
+        auto it = std::find(out.localNames.begin(), out.localNames.end(), n);
+        return it == out.localNames.end() ? -1 : (int)(it - out.localNames.begin());
+    };
+    out.outX = find("x"); out.outY = find("y");
+    out.outSize = find("size"); out.outAlpha = find("alpha");
+    out.outDx = find("dx"); out.outDy = find("dy");
+    if (out.outX < 0 || out.outY < 0) { err = "the frame section must assign 'x' and 'y'"; return false; }
+    return true;
+}
+
+static bool ParseColor(const std::string& tok, std::array<uint8_t, 3>& c) {
+    std::string h = tok;
+    if (!h.empty() && h[0] == '#') h.erase(0, 1);
+    if (h.size() != 6) return false;
+    for (char ch : h) if (!std::isxdigit((unsigned char)ch)) return false;
+    unsigned long v = std::strtoul(h.c_str(), nullptr, 16);
+    c = {(uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+    return true;
+}
+
+static std::string Trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return {};
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+// '#' starts a comment at the beginning of a line or when followed by whitespace,
+// so palette colors like #ffc400 survive.
+static std::string StripComment(const std::string& s) {
+    size_t first = s.find_first_not_of(" \t");
+    for (size_t p = s.find('#'); p != std::string::npos; p = s.find('#', p + 1)) {
+        if (p == first || p + 1 == s.size() || std::isspace((unsigned char)s[p + 1])) return s.substr(0, p);
+    }
+    return s;
+}
+
+static bool ValidName(const std::string& n) {
+    if (n.empty() || !(std::isalpha((unsigned char)n[0]) || n[0] == '_')) return false;
+    for (char c : n) if (!(std::isalnum((unsigned char)c) || c == '_')) return false;
+    return true;
+}
+
+// ---------------------- Script effect ----------------------
+
+class ScriptEffect : public Effect {
+public:
+    explicit ScriptEffect(std::shared_ptr<const ScriptEffectDef> def) : m_def(std::move(def)) {}
+
+    void setup(const EffectContext& ctx) override {
+        m_ok = false;
+        m_prog = CompiledScript{};
+        std::string err;
+        if (!CompileScript(*m_def, ctx, m_prog, err)) return; // validated at load; nothing to draw
+        m_rng.reseed(m_def->seed);
+        m_attrs.assign(m_prog.attrNames.size(), std::vector<float>(size_t(m_prog.count)));
+        m_locals.assign(m_prog.localNames.size() * kBatch, 0.0f);
+        m_stack.assign(size_t(kMaxStack) * kBatch, 0.0f);
+        for (int base = 0; base < m_prog.count; base += kBatch) {
+            Run(m_prog.init, base, std::min(kBatch, m_prog.count - base), 0.0f, 0.0f, 0.0f);
+        }
+        // Palette entry per particle, drawn after the attributes so they stay stable
+        m_pal.assign(size_t(m_prog.count), 0);
+        int palN = (int)m_def->palette.size();
+        if (palN > 1) for (auto& p : m_pal) p = (uint8_t)m_rng.randint(0, palN - 1);
+        m_ok = true;
+    }
+
+    void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) override {
+        if (!m_ok) return;
+        const float t = frame * ctx.speed;
+        const auto white = std::array<uint8_t, 3>{255, 255, 255};
+        for (int base = 0; base < m_prog.count; base += kBatch) {
+            const int n = std::min(kBatch, m_prog.count - base);
+            Run(m_prog.frame, base, n, t, (float)frame, ctx.speed);
+            const float* xs = Local(m_prog.outX);
+            const float* ys = Local(m_prog.outY);
+            const float* ss = m_prog.outSize >= 0 ? Local(m_prog.outSize) : nullptr;
+            const float* as = m_prog.outAlpha >= 0 ? Local(m_prog.outAlpha) : nullptr;
+            const float* dxs = m_prog.outDx >= 0 ? Local(m_prog.outDx) : nullptr;
+            const float* dys = m_prog.outDy >= 0 ? Local(m_prog.outDy) : nullptr;
+            for (int j = 0; j < n; ++j) {
+                const auto& c = m_def->palette.empty() ? white : m_def->palette[m_pal[size_t(base + j)]];
+                const float size = ss ? ss[j] : 1.0f;
+                const uint8_t a = (uint8_t)std::clamp(int((as ? as[j] : 1.0f) * 255.0f + 0.5f), 0, 255);
+                if (!a) continue;
+                const float dx = dxs ? dxs[j] : 0.0f, dy = dys ? dys[j] : 0.0f;
+                switch (m_def->prim) {
+                    case Prim::Circle:
+                        if (ctx.motionBlur && (dx != 0.0f || dy != 0.0f))
+                            fillCapsuleBGRA(cv, xs[j] - dx, ys[j] - dy, xs[j], ys[j], size, c[0], c[1], c[2], a);
+                        else
+                            fillCircleBGRA(cv, xs[j], ys[j], size, c[0], c[1], c[2], a);
+                        break;
+                    case Prim::Streak:
+                        drawStreakVBGRA(cv, (int)std::round(xs[j]), ys[j], size, ctx.motionBlur ? dy : 0.0f,
+                                        c[0], c[1], c[2], a);
+                        break;
+                    case Prim::Rect: {
+                        int side = std::max(1, (int)size);
+                        fillRectBGRA(cv, (int)xs[j], (int)ys[j], side, side, c[0], c[1], c[2], a);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    float* Local(int idx) { return m_locals.data() + size_t(idx) * kBatch; }
+
+    // Execute 'p' for particles [base, base+n). Every instruction loops over the batch.
+    void Run(const Program& p, int base, int n, float t, float frame, float speed) {
+        float* S = m_stack.data();
+        int sp = 0; // number of live slots
+        auto slot = [&](int i) { return S + size_t(i) * kBatch; };
+        for (const Instr& in : p.code) {
+            switch (in.op) {
+                case PUSHK: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = in.k;
+                    break;
+                }
+                case LOADA: {
+                    float* d = slot(sp++);
+                    const float* s = m_attrs[in.a].data() + base;
+                    for (int i = 0; i < n; ++i) d[i] = s[i];
+                    break;
+                }
+                case LOADL: {
+                    float* d = slot(sp++);
+                    const float* s = Local(in.a);
+                    for (int i = 0; i < n; ++i) d[i] = s[i];
+                    break;
+                }
+                case LOADT: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = t;
+                    break;
+                }
+                case LOADF: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = frame;
+                    break;
+                }
+                case LOADS: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = speed;
+                    break;
+                }
+                case LOADI: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = float(base + i);
+                    break;
+                }
+                case RAND: {
+                    float* d = slot(sp++);
+                    for (int i = 0; i < n; ++i) d[i] = (float)m_rng.uniform01();
+                    break;
+                }
+                case ADD: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] += b[i];
+                    --sp;
+                    break;
+                }
+                case SUB: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] -= b[i];
+                    --sp;
+                    break;
+                }
+                case MUL: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] *= b[i];
+                    --sp;
+                    break;
+                }
+                case DIV: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] /= b[i];
+                    --sp;
+                    break;
+                }
+                case MIN: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::min(a[i], b[i]);
+                    --sp;
+                    break;
+                }
+                case MAX: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::max(a[i], b[i]);
+                    --sp;
+                    break;
+                }
+                case POW: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::pow(a[i], b[i]);
+                    --sp;
+                    break;
+                }
+                case WRAP: {
+                    float* a = slot(sp-2);
+                    const float* b = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = Wrap(a[i], b[i]);
+                    --sp;
+                    break;
+                }
+                case ADDK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] += in.k;
+                    break;
+                }
+                case SUBK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] -= in.k;
+                    break;
+                }
+                case MULK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] *= in.k;
+                    break;
+                }
+                case DIVK: {
+                    float* a = slot(sp-1);
+                    const float r = 1.0f / in.k;
+                    for (int i = 0; i < n; ++i) a[i] *= r;
+                    break;
+                }
+                case RSUBK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = in.k - a[i];
+                    break;
+                }
+                case RDIVK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = in.k / a[i];
+                    break;
+                }
+                case POWK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::pow(a[i], in.k);
+                    break;
+                }
+                case MINK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::min(a[i], in.k);
+                    break;
+                }
+                case MAXK: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::max(a[i], in.k);
+                    break;
+                }
+                case WRAPK: {
+                    float* a = slot(sp-1);
+                    const float m = in.k, r = m != 0.0f ? 1.0f / m : 0.0f;
+                    for (int i = 0; i < n; ++i) a[i] -= std::floor(a[i] * r) * m;
+                    break;
+                }
+                case NEG: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = -a[i];
+                    break;
+                }
+                case SIN: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::sin(a[i]);
+                    break;
+                }
+                case COS: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::cos(a[i]);
+                    break;
+                }
+                case ABS: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::fabs(a[i]);
+                    break;
+                }
+                case FLOOR: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::floor(a[i]);
+                    break;
+                }
+                case FRACT: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] -= std::floor(a[i]);
+                    break;
+                }
+                case SQRT: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::sqrt(a[i]);
+                    break;
+                }
+                case EXP: {
+                    float* a = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::exp(a[i]);
+                    break;
+                }
+                case CLAMP: {
+                    float* a = slot(sp-3);
+                    const float* lo = slot(sp-2);
+                    const float* hi = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] = std::clamp(a[i], lo[i], hi[i]);
+                    sp -= 2;
+                    break;
+                }
+                case MIX: {
+                    float* a = slot(sp-3);
+                    const float* b = slot(sp-2);
+                    const float* w = slot(sp-1);
+                    for (int i = 0; i < n; ++i) a[i] += (b[i] - a[i]) * w[i];
+                    sp -= 2;
+                    break;
+                }
+                case STOREA: {
+                    const float* s = slot(--sp);
+                    float* d = m_attrs[in.a].data() + base;
+                    for (int i = 0; i < n; ++i) d[i] = s[i];
+                    break;
+                }
+                case STOREL: {
+                    const float* s = slot(--sp);
+                    float* d = Local(in.a);
+                    for (int i = 0; i < n; ++i) d[i] = s[i];
+                    break;
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<const ScriptEffectDef> m_def;
+    CompiledScript m_prog;
+    bool m_ok{false};
+    RNG m_rng;
+    std::vector<std::vector<float>> m_attrs; // SoA: one array per attribute
+    std::vector<uint8_t> m_pal;              // palette index per particle
+    std::vector<float> m_locals;             // [local][kBatch]
+    std::vector<float> m_stack;              // [kMaxStack][kBatch]
+};
+
+std::mutex g_registryMutex;
+std::map<std::string, std::shared_ptr<const ScriptEffectDef>>& Registry() {
+    static std::map<std::string, std::shared_ptr<const ScriptEffectDef>> s;
+    return s;
+}
+
+} // namespace
+
+bool ParseEffectScript(const std::string& source, std::shared_ptr<const ScriptEffectDef>& out, std::string& err) {
+    auto def = std::make_shared<ScriptEffectDef>();
+    def->source = source;
+    std::istringstream in(source);
+    std::string raw;
+    int line = 0;
+    auto fail = [&](const std::string& msg) {
+        err = "line " + std::to_string(line) + ": " + msg;
+        return false;
+    };
+    auto parseExpr = [&](const std::string& text, std::unique_ptr<Node>& node) {
+        std::string e;
+        ExprParser p(text);
+        node = p.Parse(e);
+        if (!node) return fail(e.empty() ? "empty expression" : e);
+        return true;
+    };
+    while (std::getline(in, raw)) {
+        ++line;
+        std::string s = Trim(StripComment(raw));
+        if (s.empty()) continue;
+        size_t sp = s.find_first_of(" \t");
+        std::string head = s.substr(0, sp);
+        std::string rest = sp == std::string::npos ? std::string() : Trim(s.substr(sp));
+        if (head == "effect") {
+            if (rest.empty()) return fail("missing effect name");
+            def->name = rest;
+        } else if (head == "seed") {
+            def->seed = (uint32_t)std::strtoul(rest.c_str(), nullptr, 10);
+        } else if (head == "count") {
+            def->countLine = line;
+            if (!parseExpr(rest, def->count)) return false;
+        } else if (head == "primitive") {
+            if (rest == "circle") def->prim = Prim::Circle;
+            else if (rest == "streak") def->prim = Prim::Streak;
+            else if (rest == "rect") def->prim = Prim::Rect;
+            else return fail("unknown primitive '" + rest + "' (circle, streak, rect)");
+        } else if (head == "palette") {
+            std::istringstream ps(rest);
+            std::string tok;
+            while (ps >> tok) {
+                std::array<uint8_t, 3> c;
+                if (!ParseColor(tok, c)) return fail("bad color '" + tok + "' (expected #rrggbb)");
+                def->palette.push_back(c);
+            }
+            if (def->palette.size() > 256) return fail("at most 256 palette entries");
+        } else {
+            // "attr NAME = EXPR" or "NAME = EXPR"
+            bool isAttr = head == "attr";
+            std::string assign = isAttr ? rest : s;
+            size_t eq = assign.find('=');
+            if (eq == std::string::npos) return fail("expected 'NAME = expression'");
+            Stmt st;
+            st.line = line;
+            st.name = Trim(assign.substr(0, eq));
+            if (!ValidName(st.name)) return fail("bad name '" + st.name + "'");
+            if (IsReserved(st.name)) return fail("'" + st.name + "' is a reserved name");
+            if (!parseExpr(assign.substr(eq + 1), st.expr)) return false;
+            (isAttr ? def->attrs : def->frame).push_back(std::move(st));
+        }
+    }
+    line = 0;
+    if (def->name.empty()) return fail("missing 'effect NAME'");
+    // Catch unknown names and the like now rather than at Setup()
+    CompiledScript probe;
+    EffectContext ctx;
+    ctx.width = 1280; ctx.height = 720;
+    if (!CompileScript(*def, ctx, probe, err)) return false;
+    out = std::move(def);
+    return true;
+}
+
+void RegisterScriptEffect(std::shared_ptr<const ScriptEffectDef> def) {
+    if (!def) return;
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    Registry()[def->name] = std::move(def);
+}
+
+int LoadEffectScripts(const std::string& dir, std::vector<std::string>& errors) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) return 0;
+    std::vector<fs::path> files;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        if (e.is_regular_file(ec) && e.path().extension() == ".gfx") files.push_back(e.path());
+    }
+    std::sort(files.begin(), files.end());
+    int loaded = 0;
+    for (const auto& f : files) {
+        std::ifstream ifs(f, std::ios::binary);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        std::shared_ptr<const ScriptEffectDef> def;
+        std::string err;
+        if (!ParseEffectScript(ss.str(), def, err)) {
+            errors.push_back(f.filename().string() + ": " + err);
+            continue;
+        }
+        RegisterScriptEffect(std::move(def));
+        ++loaded;
+    }
+    return loaded;
+}
+
+std::vector<std::string> ScriptEffectNames() {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    std::vector<std::string> names;
+    for (const auto& kv : Registry()) names.push_back(kv.first);
+    return names;
+}
+
+std::string ScriptEffectSource(const std::string& name) {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    auto it = Registry().find(name);
+    return it == Registry().end() ? std::string() : it->second->source;
+}
+
+std::unique_ptr<Effect> CreateScriptEffect(const std::string& name) {
+    std::shared_ptr<const ScriptEffectDef> def;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        auto it = Registry().find(name);
+        if (it == Registry().end()) return nullptr;
+        def = it->second;
+    }
+    return std::make_unique<ScriptEffect>(std::move(def));
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+
+class Effect;
+
+// Data-driven effects (.gfx files). A definition declares an emitter (particle count,
+// seed, palette, primitive), per-particle attributes initialised once at setup, and
+// per-frame expressions for the drawn outputs. Expressions are compiled at Setup()
+// into a small stack bytecode whose every instruction processes a whole SoA batch of
+// particles, so the interpreter cost is paid once per batch, not once per particle.
+//
+//   effect snow-script            # name shown in the effect list
+//   seed 13579
+//   count max(50, width*height/2400*density/50)
+//   primitive circle              # circle | streak | rect
+//   palette #ffffff
+//   attr x0 = rand*width          # per particle, 'rand' is uniform [0,1)
+//   attr y0 = rand*height
+//   attr vy = (1 + floor(rand*2))*height/duration/fps
+//   y = wrap(y0 + vy*t, height)   # per frame; t = frame*speed
+//   x = x0
+//   size = 3                      # radius (circle), length (streak) or side (rect)
+//   alpha = 0.8
+//   dy = vy*speed                 # per-frame motion, used for motion blur
+//
+// '#' followed by a space starts a comment.
+// Constants: width height duration fps frames density sizemin sizemax pi tau.
+// Per frame: t, frame, speed. Per particle: i and the declared attributes.
+// Functions: sin cos abs floor fract sqrt exp min max pow wrap clamp mix.
+struct ScriptEffectDef;
+
+// Parse a definition. Returns false and fills 'err' ("line N: ...") on failure.
+bool ParseEffectScript(const std::string& source, std::shared_ptr<const ScriptEffectDef>& out, std::string& err);
+
+// Load every *.gfx file in 'dir' into the global registry. Returns the number of
+// effects registered; per-file problems are appended to 'errors'.
+int LoadEffectScripts(const std::string& dir, std::vector<std::string>& errors);
+
+void RegisterScriptEffect(std::shared_ptr<const ScriptEffectDef> def);
+std::vector<std::string> ScriptEffectNames();
+// Definition text of a registered script effect, empty for built-in effects
+std::string ScriptEffectSource(const std::string& name);
+
+// Instance of a registered script effect, or nullptr when 'name' is not registered.
+std::unique_ptr<Effect> CreateScriptEffect(const std::string& name);
@@ -0,0 +1,218 @@
+#include "ExportCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kUsedStamp = ".used";
+
+// Hardlink when source and destination share a volume, else copy
+bool LinkOrCopy(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::remove(to, ec);
+    fs::create_hard_link(from, to, ec);
+    if (!ec) return true;
+    ec.clear();
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    return !ec;
+}
+
+uint64_t DirBytes(const fs::path& dir) {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        if (e.is_regular_file(ec)) total += e.file_size(ec);
+    }
+    return total;
+}
+
+bool IsEntryName(const std::string& name) {
+    return name.size() == 32 && name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+} // namespace
+
+bool ExportCache::Open(const std::string& dir, uint64_t maxBytes, std::string& err) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) { err = "Failed to create export cache " + dir; return false; }
+    // Staging directories left behind by a crashed export (live ones are minutes old)
+    const auto stale = fs::file_time_type::clock::now() - std::chrono::hours(24);
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        if (e.path().filename().string().rfind("staging-", 0) == 0 && fs::last_write_time(e.path(), ec) < stale) {
+            fs::remove_all(e.path(), ec);
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dir = dir;
+    m_maxBytes = maxBytes;
+    m_session = ExportCacheStats{};
+    m_pinned.clear();
+    return true;
+}
+
+std::string ExportCache::HashKey(const std::string& description) {
+    // Two independent 64-bit hashes (FNV-1a and a multiply-rotate mix)
+    uint64_t a = 1469598103934665603ull, b = 0x9E3779B97F4A7C15ull;
+    for (unsigned char c : description) {
+        a ^= c;
+        a *= 1099511628211ull;
+        b = (b ^ c) * 0xff51afd7ed558ccdull;
+        b = (b << 29) | (b >> 35);
+    }
+    b ^= b >> 33; b *= 0xc4ceb9fe1a85ec53ull; b ^= b >> 33;
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)a, (unsigned long long)b);
+    return hex;
+}
+
+void ExportCache::Touch(const std::string& entryDir) {
+    const fs::path stamp = fs::path(entryDir) / kUsedStamp;
+    { std::ofstream(stamp, std::ios::trunc); }
+    std::error_code ec;
+    fs::last_write_time(stamp, fs::file_time_type::clock::now(), ec);
+}
+
+bool ExportCache::Fetch(const std::string& key, const std::string& outDir) {
+    if (!IsOpen()) return false;
+    const fs::path entry = fs::path(m_dir) / key;
+    std::error_code ec;
+    if (!fs::is_directory(entry, ec)) return false;
+    std::vector<fs::path> files;
+    for (const auto& e : fs::directory_iterator(entry, ec)) {
+        if (e.is_regular_file(ec) && e.path().filename() != kUsedStamp) files.push_back(e.path());
+    }
+    if (files.empty()) return false;
+    for (const auto& f : files) {
+        if (!LinkOrCopy(f, fs::path(outDir) / f.filename())) return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pinned.insert(key);
+    Touch(entry.string());
+    return true;
+}
+
+std::string ExportCache::Find(const std::string& key, const std::string& extension) {
+    if (!IsOpen()) return std::string();
+    const fs::path entry = fs::path(m_dir) / key;
+    std::error_code ec;
+    fs::path found;
+    for (const auto& e : fs::directory_iterator(entry, ec)) {
+        if (e.is_regular_file(ec) && e.path().extension() == extension) { found = e.path(); break; }
+    }
+    if (found.empty()) return std::string();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pinned.insert(key);
+    Touch(entry.string());
+    return found.string();
+}
+
+std::string ExportCache::BeginEntry(const std::string& key) {
+    static std::atomic<unsigned> s_counter{0};
+    std::ostringstream name;
+    name << "staging-" << key << "-" << std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000 << "-"
+         << s_counter++ << "-" << std::chrono::steady_clock::now().time_since_epoch().count() % 1000000;
+    const fs::path dir = fs::path(m_dir) / name.str();
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return ec ? std::string() : dir.string();
+}
+
+bool ExportCache::Commit(const std::string& key, const std::string& staging, std::string& err) {
+    const fs::path entry = fs::path(m_dir) / key;
+    std::error_code ec;
+    Touch(staging);
+    fs::rename(staging, entry, ec);
+    if (ec) {
+        // Another export published the same entry first; theirs is identical
+        fs::remove_all(staging, ec);
+        if (!fs::is_directory(entry, ec)) { err = "Failed to add " + entry.string() + " to the export cache"; return false; }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pinned.insert(key);
+    }
+    Evict();
+    return true;
+}
+
+void ExportCache::Abandon(const std::string& staging) {
+    std::error_code ec;
+    if (!staging.empty()) fs::remove_all(staging, ec);
+}
+
+bool ExportCache::Store(const std::string& key, const std::vector<std::string>& files, std::string& err) {
+    if (!IsOpen()) return true;
+    const std::string staging = BeginEntry(key);
+    if (staging.empty()) { err = "Failed to create an export cache entry in " + m_dir; return false; }
+    for (const auto& f : files) {
+        if (!LinkOrCopy(f, fs::path(staging) / fs::path(f).filename())) {
+            Abandon(staging);
+            err = "Failed to copy " + f + " into the export cache";
+            return false;
+        }
+    }
+    return Commit(key, staging, err);
+}
+
+void ExportCache::Evict() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    struct Entry { fs::path dir; fs::file_time_type used; uint64_t bytes; };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(m_dir, ec)) {
+        const std::string name = e.path().filename().string();
+        if (!e.is_directory(ec) || !IsEntryName(name)) continue;
+        Entry en{e.path(), fs::last_write_time(e.path() / kUsedStamp, ec), DirBytes(e.path())};
+        if (ec) { en.used = fs::file_time_type::min(); ec.clear(); }
+        total += en.bytes;
+        if (!m_pinned.count(name)) entries.push_back(en);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const auto& en : entries) {
+        if (total <= m_maxBytes) break;
+        fs::remove_all(en.dir, ec);
+        if (ec) { ec.clear(); continue; }
+        total -= std::min(total, en.bytes);
+        m_session.evictions++;
+    }
+}
+
+void ExportCache::CountHit() { std::lock_guard<std::mutex> lock(m_mutex); m_session.hits++; }
+void ExportCache::CountFrameHit() { std::lock_guard<std::mutex> lock(m_mutex); m_session.frameHits++; }
+void ExportCache::CountMiss() { std::lock_guard<std::mutex> lock(m_mutex); m_session.misses++; }
+
+ExportCacheStats ExportCache::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_session;
+}
+
+void ExportCache::SaveStats() {
+    if (!IsOpen()) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const fs::path path = fs::path(m_dir) / "stats.txt";
+    std::map<std::string, uint64_t> totals;
+    {
+        std::ifstream in(path);
+        std::string k;
+        uint64_t v;
+        while (in >> k >> v) totals[k] = v;
+    }
+    totals["hits"] += m_session.hits;
+    totals["frame_hits"] += m_session.frameHits;
+    totals["misses"] += m_session.misses;
+    totals["evictions"] += m_session.evictions;
+    std::ofstream out(path, std::ios::trunc);
+    for (const auto& kv : totals) out << kv.first << ' ' << kv.second << '\n';
+    m_session = ExportCacheStats{};
+}
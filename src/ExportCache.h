@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+struct ExportCacheStats {
+    uint64_t hits{0};       // finished outputs reused
+    uint64_t frameHits{0};  // outputs re-encoded from cached frames
+    uint64_t misses{0};     // outputs rendered
+    uint64_t evictions{0};
+};
+
+// On-disk cache of finished outputs and rendered frame stores, addressed by a hash of
+// everything that determines their bytes. Each entry is a directory named after its
+// key holding the files under their export names; its ".used" stamp orders entries
+// for LRU eviction once the cache grows past the size cap. Entries are staged in a
+// temporary directory and renamed into place, so concurrent exports never see a
+// partial entry. Stats accumulate in "stats.txt". Thread-safe.
+class ExportCache {
+public:
+    bool Open(const std::string& dir, uint64_t maxBytes, std::string& err);
+    bool IsOpen() const { return !m_dir.empty(); }
+
+    // 32 hex digits identifying 'description' (the canonical parameter text)
+    static std::string HashKey(const std::string& description);
+
+    // Hardlinks (or copies) every file of entry 'key' into 'outDir'; false on a miss
+    bool Fetch(const std::string& key, const std::string& outDir);
+    // Path of the first file with 'extension' (e.g. ".gfxraw") in entry 'key', or empty on a miss
+    std::string Find(const std::string& key, const std::string& extension);
+    // Adds 'files' as entry 'key', then evicts least recently used entries over the cap
+    bool Store(const std::string& key, const std::vector<std::string>& files, std::string& err);
+    // Fresh staging directory to write an entry in place; Commit() publishes it
+    std::string BeginEntry(const std::string& key);
+    bool Commit(const std::string& key, const std::string& staging, std::string& err);
+    void Abandon(const std::string& staging);
+
+    void CountHit();
+    void CountFrameHit();
+    void CountMiss();
+    ExportCacheStats Stats() const;
+    // Adds this session's counters to stats.txt
+    void SaveStats();
+
+private:
+    void Touch(const std::string& entryDir);
+    void Evict();
+
+    std::string m_dir;
+    uint64_t m_maxBytes{0};
+    mutable std::mutex m_mutex;
+    ExportCacheStats m_session;
+    std::set<std::string> m_pinned; // entries used by this session are never evicted
+};
@@ -0,0 +1,195 @@
+#include "ExportCheckpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kManifest = "manifest.txt";
+
+struct FileEntry {
+    uint64_t bytes{0};
+    std::string hash;
+    std::string path;
+};
+
+// "<bytes> <hash> <path>", the path being the rest of the line
+bool ParseFileEntry(std::istream& in, FileEntry& f) {
+    if (!(in >> f.bytes >> f.hash)) return false;
+    std::getline(in >> std::ws, f.path);
+    return !f.path.empty();
+}
+
+bool Verify(const FileEntry& f) {
+    uint64_t bytes = 0;
+    return ExportCheckpoint::HashFile(f.path, bytes) == f.hash && bytes == f.bytes;
+}
+
+std::string FileLine(const std::string& path) {
+    uint64_t bytes = 0;
+    const std::string hash = ExportCheckpoint::HashFile(path, bytes);
+    if (hash.empty()) return std::string();
+    std::ostringstream line;
+    line << bytes << " " << hash << " " << fs::absolute(path).string();
+    return line.str();
+}
+
+} // namespace
+
+std::string ExportCheckpoint::HashFile(const std::string& path, uint64_t& bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return std::string();
+    // Two independent 64-bit mixes over 8-byte words, plus the length
+    uint64_t a = 1469598103934665603ull, b = 0x9E3779B97F4A7C15ull;
+    std::vector<char> buf(1 << 20);
+    bytes = 0;
+    for (;;) {
+        in.read(buf.data(), (std::streamsize)buf.size());
+        const size_t n = (size_t)in.gcount();
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i += 8) {
+            uint64_t w = 0;
+            std::memcpy(&w, buf.data() + i, std::min<size_t>(8, n - i));
+            a = (a ^ w) * 1099511628211ull;
+            a ^= a >> 32;
+            b = (b ^ w) * 0xff51afd7ed558ccdull;
+            b = (b << 29) | (b >> 35);
+        }
+        bytes += n;
+        if (n < buf.size()) break;
+    }
+    if (in.bad()) return std::string();
+    a ^= bytes; a *= 0xc4ceb9fe1a85ec53ull; a ^= a >> 33;
+    b ^= b >> 33; b *= 0xc4ceb9fe1a85ec53ull; b ^= b >> 33;
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)a, (unsigned long long)b);
+    return hex;
+}
+
+bool ExportCheckpoint::Open(const std::string& dir, const std::set<std::string>& keys, std::string& err) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) { err = "Failed to create checkpoint directory " + dir; return false; }
+    const fs::path manifest = fs::path(dir) / kManifest;
+
+    std::map<std::string, std::map<int, std::string>> segments;
+    std::map<std::string, std::vector<std::pair<FileEntry, std::string>>> outputs; // files since the last "finished"
+    std::set<std::string> finished;
+    std::vector<std::string> kept; // verified lines, rewritten below
+    std::ifstream in(manifest);
+    std::string line;
+    bool header = false;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string type, key;
+        ls >> type;
+        if (type == "genfx-resume") { int v = 0; ls >> v; header = v == 1; continue; }
+        if (!header || !(ls >> key) || !keys.count(key)) continue;
+        if (type == "segment") {
+            int index = -1;
+            FileEntry f;
+            if (!(ls >> index) || !ParseFileEntry(ls, f) || !Verify(f)) continue;
+            segments[key][index] = f.path;
+            kept.push_back(line);
+        } else if (type == "output") {
+            FileEntry f;
+            if (ParseFileEntry(ls, f)) outputs[key].emplace_back(f, line);
+        } else if (type == "finished") {
+            // A later run of the same output replaces what an earlier one recorded
+            auto& files = outputs[key];
+            const bool ok = !files.empty() && std::all_of(files.begin(), files.end(),
+                                                          [](const auto& f) { return Verify(f.first); });
+            finished.erase(key);
+            if (ok) {
+                kept.erase(std::remove_if(kept.begin(), kept.end(), [&](const std::string& l) {
+                               return l.rfind("output " + key + " ", 0) == 0 || l == "finished " + key;
+                           }), kept.end());
+                for (const auto& f : files) kept.push_back(f.second);
+                kept.push_back(line);
+                finished.insert(key);
+            }
+            files.clear();
+        }
+    }
+    in.close();
+
+    // The manifest now holds exactly what survived; files nobody refers to are leftovers
+    std::set<fs::path> owned{manifest};
+    for (const auto& [key, segs] : segments) {
+        for (const auto& [index, path] : segs) owned.insert(fs::absolute(path));
+    }
+    std::vector<fs::path> stale;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        if (!owned.count(fs::absolute(e.path()))) stale.push_back(e.path());
+    }
+    for (const fs::path& p : stale) fs::remove_all(p, ec);
+    {
+        const fs::path part = manifest.string() + ".part";
+        std::ofstream out(part, std::ios::trunc);
+        out << "genfx-resume 1\n";
+        for (const auto& l : kept) out << l << "\n";
+        out.close();
+        if (!out) { err = "Failed to write " + part.string(); return false; }
+        fs::rename(part, manifest, ec);
+        if (ec) { err = "Failed to write " + manifest.string(); return false; }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dir = dir;
+    m_segments = std::move(segments);
+    m_finished = std::move(finished);
+    return true;
+}
+
+std::string ExportCheckpoint::Segment(const std::string& key, int index) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_segments.find(key);
+    if (it == m_segments.end()) return std::string();
+    auto s = it->second.find(index);
+    return s == it->second.end() ? std::string() : s->second;
+}
+
+bool ExportCheckpoint::Finished(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_finished.count(key) > 0;
+}
+
+void ExportCheckpoint::AddSegment(const std::string& key, int index, const std::string& path) {
+    if (!IsOpen()) return;
+    const std::string entry = FileLine(path);
+    if (entry.empty()) return; // not kept: the segment is encoded again next time
+    Append("segment " + key + " " + std::to_string(index) + " " + entry);
+}
+
+void ExportCheckpoint::AddOutput(const std::string& key, const std::vector<std::string>& files) {
+    if (!IsOpen()) return;
+    for (const auto& f : files) {
+        const std::string entry = FileLine(f);
+        if (entry.empty()) return;
+        Append("output " + key + " " + entry);
+    }
+    Append("finished " + key);
+}
+
+void ExportCheckpoint::Remove() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_dir.empty()) return;
+    std::error_code ec;
+    fs::remove_all(m_dir, ec);
+    m_dir.clear();
+    m_segments.clear();
+    m_finished.clear();
+}
+
+void ExportCheckpoint::Append(const std::string& line) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_dir.empty()) return;
+    std::ofstream out(fs::path(m_dir) / kManifest, std::ios::app);
+    out << line << "\n";
+    out.flush();
+}
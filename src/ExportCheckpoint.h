@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Manifest of the finished work of one export, so a run that died (ffmpeg failure, crash,
+// power loss) can be repeated and pick up where it stopped. It lives in
+// "<outDir>/<name>.resume/manifest.txt" and records, per output key (the export cache
+// key: every parameter that determines the output's bytes):
+//
+//   segment <key> <index> <bytes> <hash> <path>   an encoded segment kept as a file
+//   output <key> <bytes> <hash> <path>            a file of a finished output
+//   finished <key>                                all of the output's files are listed
+//
+// Lines are appended (and flushed) only after the files they name are complete, and on
+// Open() every entry is checked against its file's size and content hash, so a torn
+// last line or a file cut short by a crash just means that piece is done again. The
+// directory is removed once the export succeeds. Thread-safe.
+class ExportCheckpoint {
+public:
+    // Loads the manifest in 'dir' (created if needed), keeping the entries of 'keys'
+    // that verify; everything else in the manifest, and the files it owns in 'dir', goes.
+    bool Open(const std::string& dir, const std::set<std::string>& keys, std::string& err);
+    bool IsOpen() const { return !m_dir.empty(); }
+    const std::string& Dir() const { return m_dir; }
+
+    // Path of segment 'index' of output 'key' if a verified copy exists, else empty
+    std::string Segment(const std::string& key, int index) const;
+    // Output 'key' finished in an earlier run and its files are unchanged
+    bool Finished(const std::string& key) const;
+
+    void AddSegment(const std::string& key, int index, const std::string& path);
+    void AddOutput(const std::string& key, const std::vector<std::string>& files);
+
+    // The export succeeded: the manifest and the files in its directory go
+    void Remove();
+
+    // 32 hex digits of a file's contents; empty when it cannot be read
+    static std::string HashFile(const std::string& path, uint64_t& bytes);
+
+private:
+    void Append(const std::string& line);
+
+    std::string m_dir;
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::map<int, std::string>> m_segments; // key -> index -> path
+    std::set<std::string> m_finished;
+};
@@ -0,0 +1,654 @@
+#include "Exporter.h"
+#include "EffectScript.h"
+#include "ExportCache.h"
+#include "ExportCheckpoint.h"
+#include "FrameStore.h"
+#include "JobSystem.h"
+#include "PixelKernels.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#if __has_include("BuildId.h")
+#include "BuildId.h" // GENFX_BUILD_ID, regenerated on every build (cmake/BuildId.cmake)
+#endif
+#ifndef GENFX_BUILD_ID
+#define GENFX_BUILD_ID "dev"
+#endif
+
+std::string BuildFileName(const std::string& effectName, int w, int h, const char* ext) {
+    std::string kebab = ToKebabCase(effectName);
+    std::ostringstream oss;
+    oss << kebab << "-" << w << "x" << h << ext;
+    return oss.str();
+}
+
+bool ParseSizes(const std::string& s, std::vector<SizeI>& sizes) {
+    sizes.clear();
+    std::istringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        SizeI sz;
+        if (std::sscanf(item.c_str(), "%dx%d", &sz.w, &sz.h) != 2) return false;
+        if (sz.w <= 0 || sz.h <= 0 || sz.w > 16384 || sz.h > 16384) return false;
+        sizes.push_back(sz);
+    }
+    return !sizes.empty();
+}
+
+void ConfigureRenderer(Renderer& r, const ExportJob& job) {
+    r.SetEffect(job.effect);
+    r.SetDuration(job.duration);
+    r.SetFPS(job.fps);
+    r.SetDensity(job.density);
+    r.SetSpeed(job.speed);
+    r.SetSizeMin(job.sizeMin);
+    r.SetSizeMax(job.sizeMax);
+    r.SetGlow(job.glow);
+    r.SetBlendMode(job.blend);
+    r.SetHighPrecision(job.highPrecision);
+    r.SetMotionBlur(job.motionBlur);
+    if (!job.overlay.effect.empty()) r.AddLayer(job.overlay);
+    r.Setup();
+}
+
+int ExportStripRows(const ExportJob& job, SizeI s) {
+    if (job.stripRows <= 0 || uint64_t(s.w) * uint64_t(s.h) < 3840ull * 2160ull) return 0;
+    return std::min(job.stripRows, s.h);
+}
+
+void CrossfadeBGRA(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t bytes, float t) {
+    const PixelKernels& k = Kernels();
+    ParallelFor((int)(bytes / 4096) + 1, 16, [&](int c0, int c1) {
+        const size_t begin = std::min(bytes, size_t(c0) * 4096);
+        const size_t end = std::min(bytes, size_t(c1) * 4096);
+        k.crossfade(a + begin, b + begin, out + begin, end - begin, t);
+    });
+}
+
+namespace {
+
+// One GOP-aligned range of one output
+struct SegmentTask {
+    int output;
+    int segment;
+    int first;
+    int count;
+};
+
+// Renderer owned by one lane, reused while it walks forward through an output
+struct WorkerRenderer {
+    std::unique_ptr<Renderer> r;
+    int output{-1};
+    int pos{0}; // index of the next frame RenderNextFrame() would produce
+    std::vector<std::vector<uint8_t>> firstFrames; // loop head, for the crossfade tail
+    std::unique_ptr<Renderer> head;                 // or the loop head rendered again beside the tail
+    int headPos{0};
+    std::vector<uint8_t> slots[2];                  // frames between render and encode
+};
+
+// Buffers a renderer configured for 'job' holds at size 's': the BGRA frame, 16-bit
+// accumulation and glow scratch where used, and an overlay layer's own frame. In strips
+// every layer has its own buffer of one strip plus the rows its glow reaches.
+uint64_t RendererBytes(const ExportJob& job, SizeI s) {
+    const int strip = ExportStripRows(job, s);
+    auto px = [&](const GlowParams& glow) {
+        return uint64_t(s.w) * uint64_t(strip ? std::min(s.h, strip + 2 * GlowPass::HaloRows(glow)) : s.h);
+    };
+    auto layer = [&](bool accumulate, const GlowParams& glow, bool ownFrame) {
+        return (ownFrame ? 4 * px(glow) : 0) + (accumulate ? 8 * px(glow) : 0) + (glow.enabled() ? 16 * px(glow) : 0);
+    };
+    uint64_t bytes = 4 * uint64_t(s.w) * uint64_t(strip ? strip : s.h);
+    bytes += layer(job.highPrecision || job.blend == BlendMode::Additive, job.glow, strip > 0);
+    if (!job.overlay.effect.empty()) bytes += layer(job.overlay.UsesAccumulation(), job.overlay.glow, true);
+    return bytes;
+}
+
+// Feeds every frame to two encoders (the export and a frame store for the cache)
+class TeeEncoder : public VideoEncoder {
+public:
+    TeeEncoder(std::unique_ptr<VideoEncoder> a, std::unique_ptr<VideoEncoder> b) : m_a(std::move(a)), m_b(std::move(b)) {}
+    bool Open(const std::string&, const EncoderSettings&, std::string&) override { return true; }
+    bool WriteFrame(const uint8_t* bgra, std::string& err) override {
+        return m_a->WriteFrame(bgra, err) && m_b->WriteFrame(bgra, err);
+    }
+    bool WriteRows(const uint8_t* bgra, int y, int rows, int width, int height, std::string& err) override {
+        return m_a->WriteRows(bgra, y, rows, width, height, err) && m_b->WriteRows(bgra, y, rows, width, height, err);
+    }
+    bool Finish(std::string& err) override {
+        if (!m_a->Finish(err) || !m_b->Finish(err)) return false;
+        m_stats = m_a->Stats();
+        return true;
+    }
+    const char* Name() const override { return m_a->Name(); }
+
+    std::unique_ptr<VideoEncoder> m_a, m_b;
+};
+
+class TeeOutput : public SegmentedOutput {
+public:
+    TeeOutput(std::unique_ptr<SegmentedOutput> a, std::unique_ptr<SegmentedOutput> b) : m_a(std::move(a)), m_b(std::move(b)) {}
+    bool Open(const std::string&, const EncoderSettings&, int, std::string&) override { return true; }
+    std::unique_ptr<VideoEncoder> BeginSegment(int index, int firstFrame, std::string& err) override {
+        auto a = m_a->BeginSegment(index, firstFrame, err);
+        auto b = a ? m_b->BeginSegment(index, firstFrame, err) : nullptr;
+        if (!b) return nullptr;
+        return std::make_unique<TeeEncoder>(std::move(a), std::move(b));
+    }
+    bool EndSegment(int index, std::unique_ptr<VideoEncoder> encoder, std::string& err) override {
+        auto& tee = static_cast<TeeEncoder&>(*encoder);
+        return m_a->EndSegment(index, std::move(tee.m_a), err) && m_b->EndSegment(index, std::move(tee.m_b), err);
+    }
+    bool Finish(std::string& err) override { return m_a->Finish(err) && m_b->Finish(err); }
+    const char* Name() const override { return m_a->Name(); }
+    uint64_t Bytes() const override { return m_a->Bytes(); }
+    std::vector<std::string> SideFiles() const override { return m_a->SideFiles(); }
+    // Only the export's segments are kept: a resumed output is never teed
+    bool EnableCheckpoints(const std::string& dir) override { return m_a->EnableCheckpoints(dir); }
+    std::string CheckpointFile(int index) const override { return m_a->CheckpointFile(index); }
+
+private:
+    std::unique_ptr<SegmentedOutput> m_a, m_b;
+};
+
+// Everything that determines the rendered frames of one size (and, with
+// 'withEncoder', the encoded output) as canonical text, hashed into a cache key.
+// Built-in effects are covered by the build id; scripts by their source.
+std::string CacheKey(const ExportJob& job, SizeI s, bool withEncoder) {
+    std::ostringstream d;
+    d << std::hexfloat;
+    d << "genfx-cache 1\nbuild " << GENFX_BUILD_ID << "\n";
+    d << "size " << s.w << "x" << s.h << "\nduration " << job.duration << "\nfps " << job.fps
+      << "\ndensity " << job.density << "\nspeed " << job.speed << "\nsize-range " << job.sizeMin << " " << job.sizeMax
+      << "\nmotion-blur " << job.motionBlur << "\n";
+    d << "effect " << job.effect << "\nglow " << job.glow.intensity << " " << job.glow.radius
+      << "\nblend " << int(job.blend) << " " << job.highPrecision << "\nscript " << ScriptEffectSource(job.effect) << "\n";
+    if (!job.overlay.effect.empty()) {
+        const LayerDesc& l = job.overlay;
+        d << "overlay " << l.effect << " " << l.opacity << " " << int(l.composite) << " " << int(l.particles) << " "
+          << l.highPrecision << " " << l.glow.intensity << " " << l.glow.radius << "\nscript " << ScriptEffectSource(l.effect) << "\n";
+    }
+    if (withEncoder) {
+        const EncoderSettings& e = job.encoder;
+        d << "name " << job.outName << "\ncodec " << int(e.codec) << " crf " << e.crf << " gop " << e.gop << " cpu " << e.cpuUsed
+          << "\natlas " << e.atlasFrameStep << " " << e.atlasMaxPage << " " << e.atlasIndexed << "\nraw-lz4 " << e.rawLz4
+          << "\nbackend " << int(job.backend) << " segments " << job.parallelSegments << "\n";
+    }
+    return ExportCache::HashKey(d.str());
+}
+
+} // namespace
+
+// Encodes one raw frame store into 'outPath' with the job's encoder settings
+static bool ReencodeStore(const ExportJob& job, const std::string& storePath, const std::string& outPath,
+                          std::vector<std::string>& files, std::string& err) {
+    FrameStoreReader reader;
+    if (!reader.Open(storePath, err)) return false;
+    const int hw = job.limits.maxThreads > 0 ? std::min(job.limits.maxThreads, JobWorkerCount()) : JobWorkerCount();
+    EncoderSettings es = job.encoder;
+    es.width = reader.Width();
+    es.height = reader.Height();
+    es.fps = reader.Fps();
+    es.frameCount = reader.FrameCount();
+    es.cancel = job.cancel.get();
+    es.niceness = job.limits.niceness;
+    const int totalFrames = reader.FrameCount();
+    files.assign(1, outPath);
+    std::error_code ec;
+    std::filesystem::remove(outPath, ec); // never write through a hardlink into the export cache
+
+    // ffmpeg reads uncompressed stores itself: no PNGs, no copies
+    if (job.backend == EncoderBackend::FFmpegCLI && !reader.Compressed() &&
+        (es.codec == VideoCodec::VP8_DualStream || es.codec == VideoCodec::VP9_Alpha || es.codec == VideoCodec::UTVideo_RGBA)) {
+        const uint64_t offset = reader.Header().dataOffset;
+        reader.Close();
+        if (!EncodeRawVideoFile(storePath, offset, outPath, es, err)) return false;
+        std::cout << "Re-encoded " << storePath << " -> " << outPath << " via ffmpeg (raw input)" << std::endl;
+        return true;
+    }
+
+    const int segLen = job.parallelSegments ? std::max(1, es.gop) : totalFrames;
+    const int segments = (totalFrames + segLen - 1) / segLen;
+    const int workers = std::clamp(segments, 1, hw);
+    if (es.threads <= 0) es.threads = std::max(1, hw / workers);
+    auto output = CreateSegmentedOutput(es.codec, job.backend);
+    if (!output->Open(outPath, es, segments, err)) return false;
+
+    std::mutex mutex;
+    std::string firstError;
+    int nextSegment = 0;
+    auto lane = [&]() {
+        std::vector<uint8_t> scratch;
+        for (;;) {
+            int k;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!firstError.empty() || nextSegment >= segments) return;
+                k = nextSegment++;
+            }
+            std::string e;
+            const int first = k * segLen, count = std::min(segLen, totalFrames - first);
+            auto encoder = output->BeginSegment(k, first, e);
+            bool ok = encoder != nullptr;
+            for (int i = first; ok && i < first + count; ++i) {
+                if (job.cancel && *job.cancel) { e = "Re-encode cancelled"; ok = false; break; }
+                const uint8_t* frame = reader.Frame(i, scratch, e);
+                ok = frame && encoder->WriteFrame(frame, e);
+            }
+            ok = ok && encoder->Finish(e) && output->EndSegment(k, std::move(encoder), e);
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (firstError.empty()) firstError = e;
+                return;
+            }
+        }
+    };
+    JobGroup lanes(JobPriority::Background);
+    for (int i = 0; i < workers; ++i) lanes.Run(lane);
+    lanes.Wait();
+    if (!firstError.empty()) { err = firstError; return false; }
+    if (!output->Finish(err)) return false;
+    for (const auto& f : output->SideFiles()) files.push_back(f);
+    std::cout << "Re-encoded " << storePath << " -> " << outPath << " via " << output->Name() << " ("
+              << output->Bytes() << " bytes)" << std::endl;
+    return true;
+}
+
+static std::string RunExportPipeline(const ExportJob& job) {
+    std::cout << "Export: " << CpuIsaReport() << std::endl;
+    const char* ext = VideoCodecExtension(job.encoder.codec);
+    const int totalFrames = job.duration * job.fps;
+    const int cross = std::clamp(job.fps, 1, totalFrames/2); // up to 1s of crossfade
+    const int segLen = job.parallelSegments ? std::max(1, job.encoder.gop) : totalFrames;
+    const int segments = (totalFrames + segLen - 1) / segLen;
+
+    const size_t count = job.sizes.size();
+    ExportCache cache;
+    if (!job.cacheDir.empty()) {
+        std::string err;
+        if (!cache.Open(job.cacheDir, job.cacheMaxBytes, err)) return err;
+    }
+    std::vector<std::string> outKeys(count), frameKeys(count), frameStaging(count), cachedFrames(count);
+    for (size_t o = 0; o < count; ++o) {
+        outKeys[o] = CacheKey(job, job.sizes[o], true);
+        frameKeys[o] = CacheKey(job, job.sizes[o], false);
+    }
+    // A checkpoint problem never fails the export, it only makes it start over
+    ExportCheckpoint checkpoint;
+    if (job.resume) {
+        const std::string dir = (std::filesystem::path(job.outDir) / (ToKebabCase(job.outName) + ".resume")).string();
+        std::string err;
+        if (!checkpoint.Open(dir, std::set<std::string>(outKeys.begin(), outKeys.end()), err)) {
+            std::cout << "Export checkpoint: " << err << std::endl;
+        }
+    }
+
+    std::vector<std::string> paths;
+    std::vector<std::unique_ptr<SegmentedOutput>> outputs(count);
+    std::vector<bool> render(count, false);
+    for (size_t o = 0; o < count; ++o) {
+        const SizeI s = job.sizes[o];
+        paths.push_back((std::filesystem::path(job.outDir) / BuildFileName(job.outName, s.w, s.h, ext)).string());
+        if (checkpoint.Finished(outKeys[o])) {
+            std::cout << "Export resumed: " << paths[o] << " is already finished" << std::endl;
+            continue;
+        }
+        if (cache.IsOpen()) {
+            // Finished output: link it back. Cached frames: re-encode them below.
+            if (cache.Fetch(outKeys[o], job.outDir)) {
+                cache.CountHit();
+                std::cout << "Export cache hit: " << paths[o] << std::endl;
+                continue;
+            }
+            if (job.encoder.codec != VideoCodec::RawFrameStore) {
+                cachedFrames[o] = cache.Find(frameKeys[o], ".gfxraw");
+                if (!cachedFrames[o].empty()) {
+                    cache.CountFrameHit();
+                    std::cout << "Export cache frame hit: " << paths[o] << std::endl;
+                    continue;
+                }
+            }
+            cache.CountMiss();
+        }
+        render[o] = true;
+    }
+    auto abandonStaging = [&]() {
+        for (const auto& st : frameStaging) cache.Abandon(st);
+    };
+    // Outputs (and cached frames) go into the cache as soon as they are finished;
+    // a cache problem never fails the export
+    auto storeOutput = [&](size_t o, const std::vector<std::string>& files) {
+        checkpoint.AddOutput(outKeys[o], files);
+        if (!cache.IsOpen()) return;
+        std::string err;
+        if (!cache.Store(outKeys[o], files, err)) std::cout << "Export cache: " << err << std::endl;
+        if (job.encoder.codec == VideoCodec::RawFrameStore && !cache.Store(frameKeys[o], files, err)) {
+            std::cout << "Export cache: " << err << std::endl;
+        }
+        if (!frameStaging[o].empty() && !cache.Commit(frameKeys[o], frameStaging[o], err)) {
+            std::cout << "Export cache: " << err << std::endl;
+        }
+        frameStaging[o].clear();
+    };
+
+    // Every (size, segment) pair still to encode is a task. Lanes, frame slots and
+    // threads are sized to the job's limits (PlanExport), encoder threads shared out.
+    const int segmentTasks = (int)std::count(render.begin(), render.end(), true) * segments;
+    ExportLaneCost laneCost;
+    laneCost.loopHeadFrames = cross;
+    for (size_t o = 0; o < count; ++o) {
+        if (!render[o]) continue;
+        const SizeI s = job.sizes[o];
+        const int strip = ExportStripRows(job, s);
+        laneCost.frameBytes = std::max(laneCost.frameBytes, uint64_t(s.w) * uint64_t(strip ? strip : s.h) * 4);
+        laneCost.rendererBytes = std::max(laneCost.rendererBytes, RendererBytes(job, s));
+    }
+    const ExportPlan plan = PlanExport(job.limits, laneCost, segmentTasks, JobWorkerCount());
+    if (job.limits.memoryBytes || job.limits.maxThreads) {
+        std::cout << "Export plan: " << DescribeExportPlan(plan) << std::endl;
+    }
+    EncoderSettings base = job.encoder;
+    base.fps = job.fps;
+    base.frameCount = totalFrames;
+    base.cancel = job.cancel.get();
+    base.niceness = job.limits.niceness;
+    if (base.threads <= 0) base.threads = plan.encoderThreads;
+    else if (job.limits.maxThreads > 0) base.threads = std::min(base.threads, plan.encoderThreads);
+
+    std::vector<SegmentTask> tasks;
+    std::vector<int> remaining(count, segments);
+    for (size_t o = 0; o < count; ++o) {
+        if (!render[o]) continue;
+        EncoderSettings es = base;
+        es.width = job.sizes[o].w;
+        es.height = job.sizes[o].h;
+        outputs[o] = CreateSegmentedOutput(es.codec, job.backend);
+        std::string err;
+        std::error_code ec;
+        std::filesystem::remove(paths[o], ec); // never write through a hardlink into the export cache
+        if (!outputs[o]->Open(paths[o], es, segments, err)) { abandonStaging(); return err; }
+        // Segments a failed run already encoded
+        std::vector<std::string> restore((size_t)segments);
+        if (checkpoint.IsOpen() && outputs[o]->EnableCheckpoints(checkpoint.Dir())) {
+            for (int k = 0; k < segments; ++k) restore[size_t(k)] = checkpoint.Segment(outKeys[o], k);
+        }
+        const bool resumed = std::any_of(restore.begin(), restore.end(), [](const std::string& f) { return !f.empty(); });
+        if (!resumed && cache.IsOpen() && job.cacheFrames && es.codec != VideoCodec::RawFrameStore) {
+            // Keep the rendered frames too, so another codec can skip rendering
+            frameStaging[o] = cache.BeginEntry(frameKeys[o]);
+            EncoderSettings fs = es;
+            fs.codec = VideoCodec::RawFrameStore;
+            fs.rawLz4 = FrameStoreHasLZ4();
+            auto store = CreateFrameStoreOutput();
+            const std::string storePath = (std::filesystem::path(frameStaging[o]) /
+                                           std::filesystem::path(paths[o]).stem()).string() + ".gfxraw";
+            if (frameStaging[o].empty()) err = "Failed to create an export cache entry in " + job.cacheDir;
+            if (err.size() || !store->Open(storePath, fs, segments, err)) { abandonStaging(); return err; }
+            outputs[o] = std::make_unique<TeeOutput>(std::move(outputs[o]), std::move(store));
+        }
+        int restored = 0;
+        for (int k = 0; k < segments; ++k) {
+            const std::string& file = restore[size_t(k)];
+            if (!file.empty() && outputs[o]->RestoreSegment(k, file, err)) {
+                ++restored;
+                continue;
+            }
+            if (!file.empty()) std::cout << "Export checkpoint: " << err << std::endl;
+            tasks.push_back({(int)o, k, k * segLen, std::min(segLen, totalFrames - k * segLen)});
+        }
+        remaining[o] -= restored;
+        if (restored) std::cout << "Export resumed: " << paths[o] << ", " << restored << "/" << segments
+                                << " segments from the checkpoint" << std::endl;
+    }
+
+    std::mutex mutex;
+    std::string firstError;
+    size_t nextTask = 0;
+    auto fail = [&](const std::string& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (firstError.empty()) firstError = e;
+    };
+
+    // Joins the segments of an output once they have all ended
+    auto finishOutput = [&](size_t o) -> bool {
+        GENFX_TRACE_SCOPE("finish output");
+        std::string err;
+        if (!outputs[o]->Finish(err)) { fail(err); return false; }
+        std::cout << "Finished " << paths[o] << " (" << outputs[o]->Bytes() << " bytes)" << std::endl;
+        std::vector<std::string> files{paths[o]};
+        for (const auto& f : outputs[o]->SideFiles()) files.push_back(f);
+        storeOutput(o, files);
+        return true;
+    };
+
+    auto cancelled = [&]() {
+        if (!job.cancel || !*job.cancel) return false;
+        fail("Export cancelled");
+        return true;
+    };
+
+    auto runTask = [&](const SegmentTask& t, WorkerRenderer& wr) -> bool {
+        const SizeI s = job.sizes[t.output];
+        const int stripRows = ExportStripRows(job, s);
+        if (wr.output != t.output) {
+            GENFX_TRACE_SCOPE("setup renderer");
+            wr.r = std::make_unique<Renderer>(s.w, s.h);
+            wr.r->SetStripRows(stripRows);
+            ConfigureRenderer(*wr.r, job);
+            wr.output = t.output;
+            wr.pos = 0;
+            wr.firstFrames.clear();
+            wr.head.reset();
+        }
+        Renderer& r = *wr.r;
+        auto& firstFrames = wr.firstFrames;
+        // The crossfade tail needs the loop's first frames: kept from the start, or (tight
+        // memory budget, strips) rendered again by a second renderer in step with the tail
+        const bool hasTail = t.first + t.count > totalFrames - cross;
+        const bool keepLoopHead = plan.keepLoopHead && !stripRows;
+        if (hasTail && keepLoopHead && (int)firstFrames.size() < cross) {
+            if (wr.pos != 0) { r.Setup(); wr.pos = 0; }
+            firstFrames.clear();
+            for (; wr.pos < cross; ++wr.pos) {
+                if (cancelled()) return false;
+                GENFX_TRACE_SCOPE_ARG("render loop head", wr.pos);
+                r.RenderNextFrame();
+                firstFrames.emplace_back(r.GetFrameBuffer().begin(), r.GetFrameBuffer().end());
+            }
+        }
+        if (hasTail && !keepLoopHead && !wr.head) {
+            GENFX_TRACE_SCOPE("setup renderer");
+            wr.head = std::make_unique<Renderer>(s.w, s.h);
+            wr.head->SetStripRows(stripRows);
+            ConfigureRenderer(*wr.head, job);
+            wr.headPos = 0;
+        }
+        if (wr.pos > t.first) { r.Setup(); wr.pos = 0; }
+        {
+            GENFX_TRACE_SCOPE("skip to segment");
+            for (; wr.pos < t.first; ++wr.pos) {
+                if (wr.pos % 64 == 0 && cancelled()) return false;
+                r.SkipFrame();
+            }
+        }
+
+        std::string err;
+        auto encoder = outputs[t.output]->BeginSegment(t.segment, t.first, err);
+        if (!encoder) { fail(err); return false; }
+
+        // Frame pipeline: render i (plus crossfade) -> encode i. Renders and encodes each
+        // run in order; with two frame slots, frame i+1 renders while frame i encodes and
+        // render i+2 waits for encode i (one slot, under a memory budget: no overlap).
+        // Encoding is Background work, so other lanes' rendering and the preview go first.
+        // In strip mode the items are strips (frame i, strip j) instead of frames.
+        const int kSlots = plan.frameSlots;
+        const int strips = r.GetStripCount();
+        std::atomic<bool> stop{false};
+        JobGraph graph;
+        std::vector<JobGraph::Node> renders, encodes;
+        for (int k = 0; k < t.count * strips; ++k) {
+            const int i = t.first + k / strips, j = k % strips;
+            std::vector<uint8_t>* slot = &wr.slots[k % kSlots];
+            const JobGraph::Node render = graph.Add(JobPriority::Render, [&, i, j, slot]() {
+                if (stop) return;
+                if (cancelled()) { stop = true; return; }
+                const bool tail = i >= totalFrames - cross;
+                const int f = i - (totalFrames - cross);
+                if (j == 0) {
+                    {
+                        GENFX_TRACE_SCOPE_ARG("render", i);
+                        r.RenderNextFrame();
+                    }
+                    ++wr.pos;
+                    if (tail && !keepLoopHead) {
+                        GENFX_TRACE_SCOPE_ARG("render loop head", f);
+                        if (wr.headPos > f) { wr.head->Setup(); wr.headPos = 0; }
+                        for (; wr.headPos < f; ++wr.headPos) wr.head->SkipFrame();
+                        wr.head->RenderNextFrame();
+                        ++wr.headPos;
+                    }
+                }
+                if (stripRows) {
+                    GENFX_TRACE_SCOPE_ARG("render strip", j);
+                    r.RenderStrip(j);
+                    if (tail) wr.head->RenderStrip(j);
+                }
+                if (tail) {
+                    GENFX_TRACE_SCOPE_ARG("crossfade", i);
+                    const auto& buf = r.GetFrameBuffer();
+                    float tt = float(f + 1) / float(cross);
+                    const uint8_t* head = keepLoopHead ? firstFrames[f].data() : wr.head->GetFrameBuffer().data();
+                    slot->resize(buf.size());
+                    CrossfadeBGRA(buf.data(), head, slot->data(), buf.size(), tt);
+                } else {
+                    r.TakeFrameBuffer(*slot);
+                }
+            });
+            const JobGraph::Node encode = graph.Add(JobPriority::Background, [&, i, j, slot]() {
+                if (stop) return;
+                // Conversions inside the encoder stay within its share of the thread limit
+                ParallelForLimit threads(job.limits.maxThreads > 0 ? plan.encoderThreads : t_parallelForThreads);
+                GENFX_TRACE_SCOPE_ARG("encode frame", i);
+                std::string e;
+                const int rows = (int)(slot->size() / (size_t(s.w) * 4));
+                const bool ok = stripRows ? encoder->WriteRows(slot->data(), j * r.GetStripRows(), rows, s.w, s.h, e)
+                                          : encoder->WriteFrame(slot->data(), e);
+                if (!ok) { fail(e); stop = true; }
+            });
+            graph.Precede(render, encode);
+            if (k > 0) {
+                graph.Precede(renders.back(), render);
+                graph.Precede(encodes.back(), encode);
+            }
+            if (k >= kSlots) graph.Precede(encodes[size_t(k - kSlots)], render);
+            renders.push_back(render);
+            encodes.push_back(encode);
+        }
+        graph.Run();
+        if (hasTail) wr.head.reset(); // the tail is the last segment of the output
+        if (stop) return false;
+        {
+            GENFX_TRACE_SCOPE("encoder finish");
+            if (!encoder->Finish(err)) { fail(err); return false; }
+        }
+        const EncoderStats st = encoder->Stats();
+        {
+            GENFX_TRACE_SCOPE("segment join");
+            if (!outputs[t.output]->EndSegment(t.segment, std::move(encoder), err)) { fail(err); return false; }
+        }
+        if (checkpoint.IsOpen()) {
+            const std::string file = outputs[t.output]->CheckpointFile(t.segment);
+            if (!file.empty()) checkpoint.AddSegment(outKeys[t.output], t.segment, file);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << "Encoded " << paths[t.output] << " segment " << t.segment + 1 << "/" << segments
+                      << " via " << outputs[t.output]->Name() << ": " << st.frames << " frames, "
+                      << (st.frames ? st.frameMs / st.frames : 0.0) << " ms/frame avg, " << st.maxFrameMs
+                      << " ms max, " << st.finishMs << " ms finish" << std::endl;
+            if (--remaining[t.output] > 0) return true;
+        }
+        // Last segment of this output: join the parts
+        return finishOutput(size_t(t.output));
+    };
+
+    // Lanes (one per worker, at most one per task) take the tasks in order, so each lane
+    // mostly moves forward within one output and the outputs complete roughly one after
+    // another. A lane waiting on its frame graph runs other queued jobs meanwhile.
+    auto lane = [&]() {
+        ParallelForLimit threads(plan.threadsPerLane > 0 ? plan.threadsPerLane : t_parallelForThreads);
+        WorkerRenderer wr;
+        for (;;) {
+            SegmentTask t;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!firstError.empty() || nextTask >= tasks.size()) return;
+                t = tasks[nextTask++];
+            }
+            if (!runTask(t, wr)) return;
+        }
+    };
+    JobGroup lanes(JobPriority::Render);
+    for (int i = 0; i < plan.lanes; ++i) lanes.Run(lane);
+    lanes.Wait();
+    // Outputs whose every segment came from the checkpoint
+    for (size_t o = 0; o < count && firstError.empty(); ++o) {
+        if (render[o] && remaining[o] == 0 && std::none_of(tasks.begin(), tasks.end(),
+                                                           [&](const SegmentTask& t) { return t.output == (int)o; })) {
+            finishOutput(o);
+        }
+    }
+    if (!firstError.empty()) {
+        abandonStaging();
+        if (checkpoint.IsOpen()) std::cout << "Export checkpoint kept in " << checkpoint.Dir() << " for a retry" << std::endl;
+        return firstError;
+    }
+
+    for (size_t o = 0; o < count; ++o) {
+        if (cachedFrames[o].empty()) continue;
+        GENFX_TRACE_SCOPE("re-encode cached frames");
+        std::vector<std::string> files;
+        std::string err;
+        if (!ReencodeStore(job, cachedFrames[o], paths[o], files, err)) return err;
+        storeOutput(o, files);
+    }
+    checkpoint.Remove();
+    if (cache.IsOpen()) {
+        const ExportCacheStats st = cache.Stats();
+        std::cout << "Export cache " << job.cacheDir << ": " << st.hits << " hits, " << st.frameHits << " frame hits, "
+                  << st.misses << " misses, " << st.evictions << " evicted" << std::endl;
+        cache.SaveStats();
+    }
+    return std::string();
+}
+
+std::string RunExport(const ExportJob& job) {
+    if (!job.trace) return RunExportPipeline(job);
+    TraceBegin();
+    const std::string result = RunExportPipeline(job);
+    const std::string path = (std::filesystem::path(job.outDir) / (job.outName + "-trace.json")).string();
+    std::string err;
+    if (TraceWriteChrome(path, err)) std::cout << "Trace written to " << path << std::endl;
+    else std::cout << err << std::endl;
+    return result;
+}
+
+std::string RunReencode(const ExportJob& job, const std::vector<std::string>& stores) {
+    if (job.encoder.codec == VideoCodec::RawFrameStore) return "Choose a codec other than the raw frame store to re-encode";
+    for (const auto& storePath : stores) {
+        const std::filesystem::path sp(storePath);
+        const std::filesystem::path dir = job.outDir.empty() ? sp.parent_path() : std::filesystem::path(job.outDir);
+        const std::string outPath = (dir / (sp.stem().string() + VideoCodecExtension(job.encoder.codec))).string();
+        std::vector<std::string> files;
+        std::string err;
+        if (!ReencodeStore(job, storePath, outPath, files, err)) return err;
+    }
+    return std::string();
+}
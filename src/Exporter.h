@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Renderer.h"
+#include "ResourceGovernor.h"
+#include "VideoEncoder.h"
+
+// Everything an export needs, snapshotted on the UI thread so the worker never
+// touches controls.
+struct ExportJob {
+    std::string outDir;
+    std::string outName;        // file name base, e.g. "rain" or "rain-snow"
+    std::vector<SizeI> sizes;
+    std::string effect;
+    int duration{12};
+    int fps{30};
+    int density{50};
+    float speed{1.0f};
+    float sizeMin{1.0f};
+    float sizeMax{8.0f};
+    GlowParams glow;
+    BlendMode blend{BlendMode::Over};
+    bool highPrecision{false};
+    bool motionBlur{false};
+    LayerDesc overlay;           // empty effect = no overlay
+    EncoderSettings encoder;     // width/height are filled per size
+    EncoderBackend backend{EncoderBackend::Auto};
+    // Split each output into GOP-aligned segments (encoder.gop frames) encoded
+    // concurrently, across all sizes, and joined without re-encoding
+    bool parallelSegments{true};
+    // Content-addressed cache of finished outputs (and, with cacheFrames, rendered
+    // frame stores) keyed by every parameter above; empty dir = no cache
+    std::string cacheDir;
+    uint64_t cacheMaxBytes{20ull << 30};
+    bool cacheFrames{false};
+    // Keep a manifest of finished segments and outputs in "<outDir>/<outName>.resume"
+    // (ExportCheckpoint.h) until the export succeeds; a run with the same settings after a
+    // failure or crash reuses what verifies instead of rendering it again
+    bool resume{true};
+    // Memory budget, thread cap and ffmpeg priority, for exporting next to other work;
+    // the pipeline shrinks to fit (PlanExport) instead of failing
+    ExportLimits limits;
+    // Outputs of 3840x2160 pixels and up render in strips of this many rows
+    // (Renderer::SetStripRows), so 4K/8K fit in memory; same pixels. 0 = whole frames.
+    int stripRows{256};
+    // Record per-stage timings and write "<outName>-trace.json" (Chrome trace) to outDir
+    bool trace{false};
+    // Set from any thread to stop the export (running ffmpeg processes included)
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+// Render and encode every size of 'job'. The last second crossfades into the first
+// so the output loops. Returns an empty string on success, else the error message.
+std::string RunExport(const ExportJob& job);
+
+// Encode existing raw frame stores (.gfxraw) with job.encoder/backend instead of
+// rendering; only the encoder fields, backend, parallelSegments and outDir (empty =
+// next to each store) are used. Output names follow the store's file name.
+std::string RunReencode(const ExportJob& job, const std::vector<std::string>& stores);
+
+// Renderer set up with the job's effect, timing and look, at frame 0
+void ConfigureRenderer(Renderer& r, const ExportJob& job);
+
+// Strip height the export renders size 's' with, 0 = whole frames
+int ExportStripRows(const ExportJob& job, SizeI s);
+
+// out = (1-t)*a + t*b per channel (straight alpha), the loop's closing crossfade
+void CrossfadeBGRA(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t bytes, float t);
+
+// "WxH, WxH, ..." into 'sizes' (1..16384 per side); false if any entry is malformed or
+// the list is empty
+bool ParseSizes(const std::string& s, std::vector<SizeI>& sizes);
+
+// "name-in-kebab-case-WxH" + extension
+std::string BuildFileName(const std::string& effectName, int w, int h, const char* ext);
@@ -2,6 +2,7 @@
 #include <string>
 #include <cstdio>
 #include <vector>
+#include "FFmpegProcess.h"
 
 enum class FFCodec { VP8_DualStream, VP9_SingleStream };
 
@@ -13,16 +14,12 @@ public:
     // Open ffmpeg for writing raw BGRA frames. Returns false on failure.
     bool Open(const std::string& outPath, int w, int h, int fps, FFCodec codec);
     bool WriteFrame(const void* data, size_t bytes);
-    void Close();
+    // Waits for ffmpeg to finish; false (with LastError()) if it failed
+    bool Close();
+    const std::string& LastError() const { return m_error; }
 
 private:
-    std::string m_cmd;
-    std::FILE* m_pipe{nullptr};
-#ifdef _WIN32
-    // Windows-specific: keep process info to ensure clean shutdown
-    void* m_hProcess{nullptr}; // HANDLE
-    void* m_hThread{nullptr};  // HANDLE
-    void* m_childStdinWr{nullptr}; // HANDLE we write to (wrapped by m_pipe)
-    void* m_childStdinRd{nullptr}; // HANDLE passed to child as STDIN
-#endif
+    FFmpegProcess m_process;
+    bool m_open{false};
+    std::string m_error;
 };
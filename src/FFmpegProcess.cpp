@@ -0,0 +1,433 @@
+#include "FFmpegProcess.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <cerrno>
+  #include <csignal>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <spawn.h>
+  #include <sys/resource.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+  extern char** environ;
+  #ifdef __linux__
+    #include <sys/syscall.h>
+  #endif
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kInputPipeBytes = 1 << 20; // a whole 720p PNG frame fits without blocking
+constexpr double kTermGraceSec = 3.0;       // after the polite stop, before the forced kill
+
+double Seconds(Clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+#ifndef _WIN32
+// Best effort, like nice(1) and ionice(1) on the running child: CPU niceness, and on
+// Linux the matching best-effort I/O level (idle class at 19)
+void LowerPriority(pid_t pid, int niceness) {
+    if (niceness <= 0) return;
+    setpriority(PRIO_PROCESS, (id_t)pid, std::min(niceness, 19));
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    const int kWhoProcess = 1, kClassBestEffort = 2, kClassIdle = 3, kClassShift = 13;
+    const int prio = niceness >= 19 ? kClassIdle << kClassShift
+                                    : (kClassBestEffort << kClassShift) | std::min(7, 4 + niceness / 5);
+    syscall(SYS_ioprio_set, kWhoProcess, (int)pid, prio);
+#endif
+}
+#endif
+
+// "123.4kbits/s", "1.5x", "N/A"
+double LeadingNumber(const std::string& v) {
+    char* end = nullptr;
+    const double d = std::strtod(v.c_str(), &end);
+    return end == v.c_str() ? 0.0 : d;
+}
+
+} // namespace
+
+FFmpegProcess::~FFmpegProcess() {
+    if (!m_running) return;
+    Kill();
+    std::string ignored;
+    Wait(ignored);
+}
+
+void FFmpegProcess::Touch() {
+    m_lastActivity = Clock::now().time_since_epoch().count();
+}
+
+void FFmpegProcess::Kill() { m_killRequested = true; }
+
+std::string FFmpegProcess::LogTail() const {
+    // Last few non-empty lines, enough to show ffmpeg's actual complaint
+    std::vector<std::string> lines;
+    size_t end = m_log.size();
+    while (end > 0 && lines.size() < 4) {
+        const size_t nl = m_log.rfind('\n', end - 1);
+        const size_t begin = nl == std::string::npos ? 0 : nl + 1;
+        std::string line = m_log.substr(begin, end - begin);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        if (!line.empty()) lines.push_back(line);
+        if (nl == std::string::npos) break;
+        end = nl;
+    }
+    std::string tail;
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) tail += "\n" + *it;
+    return tail;
+}
+
+// Blocking read from stdout or stderr; 0 at EOF. On POSIX a pipe that a leftover
+// grandchild keeps open must not outlive the child, so reading stops once the child
+// is gone and the pipe is drained.
+size_t FFmpegProcess::ReadSome(bool fromLog, char* buf, size_t size) {
+#ifdef _WIN32
+    DWORD n = 0;
+    if (!ReadFile((HANDLE)(fromLog ? m_stderr : m_stdout), buf, (DWORD)size, &n, nullptr)) return 0;
+    return n;
+#else
+    const int fd = fromLog ? m_stderr : m_stdout;
+    for (;;) {
+        pollfd pfd{fd, POLLIN, 0};
+        const bool exited = m_exited;
+        const int r = poll(&pfd, 1, 50);
+        if (r < 0 && errno != EINTR) return 0;
+        if (r <= 0) {
+            if (exited) return 0;
+            continue;
+        }
+        const ssize_t n = read(fd, buf, size);
+        if (n < 0 && errno == EINTR) continue;
+        return n > 0 ? size_t(n) : 0;
+    }
+#endif
+}
+
+void FFmpegProcess::ReadProgress() {
+    FFmpegProgress p;
+    p.totalFrames = m_opts.expectedFrames;
+    std::string pending;
+    char buf[4096];
+    for (;;) {
+        const size_t n = ReadSome(false, buf, sizeof(buf));
+        if (n == 0) break;
+        pending.append(buf, size_t(n));
+        size_t nl;
+        while ((nl = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, nl);
+            pending.erase(0, nl + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            const size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            const std::string key = line.substr(0, eq), value = line.substr(eq + 1);
+            if (key == "frame") p.frame = (int)LeadingNumber(value);
+            else if (key == "fps") p.fps = LeadingNumber(value);
+            else if (key == "bitrate") p.kbps = LeadingNumber(value);
+            else if (key == "out_time_us") p.outSeconds = LeadingNumber(value) / 1e6;
+            else if (key == "speed") p.speed = LeadingNumber(value);
+            else if (key == "progress") {
+                // Each block ends with progress=continue|end
+                p.done = value == "end";
+                p.etaSec = (p.totalFrames > 0 && p.fps > 0.0) ? std::max(0, p.totalFrames - p.frame) / p.fps : -1.0;
+                Touch();
+                if (m_opts.onProgress) m_opts.onProgress(p);
+            }
+        }
+    }
+}
+
+void FFmpegProcess::ReadLog() {
+    const size_t cap = std::max<size_t>(m_opts.logCapacity, 4096);
+    char buf[4096];
+    for (;;) {
+        const size_t n = ReadSome(true, buf, sizeof(buf));
+        if (n == 0) break;
+        m_log.append(buf, size_t(n));
+        // Trim in batches so the ring costs O(1) amortized per byte
+        if (m_log.size() > cap + cap / 4) m_log.erase(0, m_log.size() - cap);
+    }
+    if (m_log.size() > cap) m_log.erase(0, m_log.size() - cap);
+}
+
+void FFmpegProcess::Terminate(const char* reason) {
+    if (!m_killReason) {
+        m_killReason = reason;
+        m_termSent = Clock::now();
+#ifdef _WIN32
+        // No polite stop for a console-less child; there is nothing to flush anyway
+        TerminateProcess((HANDLE)m_process, 1);
+#else
+        kill(m_pid, SIGTERM); // ffmpeg finishes the current packet and closes its outputs
+#endif
+        return;
+    }
+#ifndef _WIN32
+    if (Seconds(Clock::now() - m_termSent) > kTermGraceSec) kill(m_pid, SIGKILL);
+#endif
+}
+
+// Sole owner of the child's exit status: polls it, enforces cancellation and the
+// timeouts, and returns once the child is gone
+void FFmpegProcess::Watch() {
+    for (;;) {
+#ifdef _WIN32
+        if (WaitForSingleObject((HANDLE)m_process, 20) == WAIT_OBJECT_0) {
+            DWORD code = 1;
+            GetExitCodeProcess((HANDLE)m_process, &code);
+            m_exitCode = (int)code;
+            m_exited = true;
+            return;
+        }
+#else
+        int status = 0;
+        const pid_t r = waitpid(m_pid, &status, WNOHANG);
+        if (r == m_pid) {
+            m_exited = true;
+            if (WIFEXITED(status)) m_exitCode = WEXITSTATUS(status);
+            else if (WIFSIGNALED(status)) m_signal = WTERMSIG(status);
+            return;
+        }
+        if (r < 0 && errno != EINTR) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+#endif
+        const auto now = Clock::now();
+        const double idle = Seconds(now - Clock::time_point(Clock::duration(m_lastActivity.load())));
+        if (m_killRequested || (m_opts.cancel && m_opts.cancel->load())) Terminate("cancelled");
+        else if (m_opts.timeoutSec > 0.0 && Seconds(now - m_start) > m_opts.timeoutSec) Terminate("timed out");
+        else if (m_opts.stallSec > 0.0 && idle > m_opts.stallSec) Terminate("stalled");
+        else if (m_killReason) Terminate(m_killReason);
+    }
+}
+
+bool FFmpegProcess::Start(const FFmpegRunOptions& options, std::string& err) {
+    if (m_running) { err = "ffmpeg is already running"; return false; }
+    m_opts = options;
+    m_log.clear();
+    m_killRequested = false;
+    m_killReason = nullptr;
+    m_exited = false;
+    m_exitCode = -1;
+
+    std::vector<std::string> args = {"ffmpeg", "-progress", "pipe:1", "-nostats"};
+    if (!m_opts.pipeInput) args.push_back("-nostdin");
+    args.insert(args.end(), m_opts.args.begin(), m_opts.args.end());
+
+#ifdef _WIN32
+    // Windows command line quoting (CommandLineToArgvW rules)
+    std::string cmdline;
+    for (const auto& a : args) {
+        if (!cmdline.empty()) cmdline += ' ';
+        if (!a.empty() && a.find_first_of(" \t\"") == std::string::npos) { cmdline += a; continue; }
+        cmdline += '"';
+        size_t slashes = 0;
+        for (char c : a) {
+            if (c == '\\') { ++slashes; continue; }
+            cmdline.append(c == '"' ? slashes * 2 + 1 : slashes, '\\');
+            slashes = 0;
+            cmdline += c;
+        }
+        cmdline.append(slashes * 2, '\\');
+        cmdline += '"';
+    }
+
+    SECURITY_ATTRIBUTES sa{}; sa.nLength = sizeof(sa); sa.bInheritHandle = TRUE;
+    HANDLE inRd = nullptr, inWr = nullptr, outRd = nullptr, outWr = nullptr, errRd = nullptr, errWr = nullptr;
+    auto closeAll = [&]() {
+        for (HANDLE h : {inRd, inWr, outRd, outWr, errRd, errWr}) if (h) CloseHandle(h);
+    };
+    bool ok = CreatePipe(&outRd, &outWr, &sa, 0) && CreatePipe(&errRd, &errWr, &sa, 0);
+    if (ok && m_opts.pipeInput) ok = CreatePipe(&inRd, &inWr, &sa, (DWORD)kInputPipeBytes);
+    if (ok && !m_opts.pipeInput) {
+        inRd = CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, &sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (inRd == INVALID_HANDLE_VALUE) { inRd = nullptr; ok = false; }
+    }
+    // The parent's ends must not leak into the child
+    for (HANDLE h : {inWr, outRd, errRd}) if (ok && h) ok = SetHandleInformation(h, HANDLE_FLAG_INHERIT, 0);
+    if (!ok) { closeAll(); err = "Failed to create pipes for ffmpeg"; return false; }
+
+    STARTUPINFOA si{}; si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    si.wShowWindow = SW_HIDE;
+    si.hStdInput = inRd;
+    si.hStdOutput = outWr;
+    si.hStdError = errWr;
+    PROCESS_INFORMATION pi{};
+    std::vector<char> cl(cmdline.begin(), cmdline.end());
+    cl.push_back('\0');
+    DWORD flags = CREATE_NO_WINDOW;
+    if (m_opts.niceness > 0) flags |= m_opts.niceness >= 10 ? IDLE_PRIORITY_CLASS : BELOW_NORMAL_PRIORITY_CLASS;
+    if (!CreateProcessA(nullptr, cl.data(), nullptr, nullptr, TRUE, flags, nullptr, nullptr, &si, &pi)) {
+        closeAll();
+        err = "Failed to start ffmpeg (is it on PATH?)";
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    CloseHandle(inRd);
+    CloseHandle(outWr);
+    CloseHandle(errWr);
+    m_process = pi.hProcess;
+    m_stdin = inWr;
+    m_stdout = outRd;
+    m_stderr = errRd;
+#else
+    // Writes to a dead child must fail with EPIPE instead of killing the app
+    static std::once_flag s_sigpipe;
+    std::call_once(s_sigpipe, []() {
+        struct sigaction old{};
+        if (sigaction(SIGPIPE, nullptr, &old) == 0 && old.sa_handler == SIG_DFL) std::signal(SIGPIPE, SIG_IGN);
+    });
+
+    int in[2] = {-1, -1}, out[2] = {-1, -1}, errp[2] = {-1, -1};
+    auto closeAll = [&]() {
+        for (int fd : {in[0], in[1], out[0], out[1], errp[0], errp[1]}) if (fd >= 0) close(fd);
+    };
+    bool ok = pipe(out) == 0 && pipe(errp) == 0 && (!m_opts.pipeInput || pipe(in) == 0);
+    if (!ok) { closeAll(); err = "Failed to create pipes for ffmpeg"; return false; }
+    // Only the dup2'ed copies may survive exec
+    for (int fd : {in[0], in[1], out[0], out[1], errp[0], errp[1]}) if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+    // Default pipes hold 64 KB; a larger one lets a whole frame go in one write
+    if (in[1] >= 0) fcntl(in[1], F_SETPIPE_SZ, (int)kInputPipeBytes);
+#endif
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (m_opts.pipeInput) posix_spawn_file_actions_adddup2(&fa, in[0], 0);
+    else posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, out[1], 1);
+    posix_spawn_file_actions_adddup2(&fa, errp[1], 2);
+    // The ignored SIGPIPE is inherited through exec; ffmpeg expects the default
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid = -1;
+    const int rc = posix_spawnp(&pid, "ffmpeg", &fa, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    if (rc != 0) {
+        closeAll();
+        err = std::string("Failed to start ffmpeg (is it on PATH?): ") + std::strerror(rc);
+        return false;
+    }
+    LowerPriority(pid, m_opts.niceness);
+    close(out[1]);
+    close(errp[1]);
+    if (in[0] >= 0) close(in[0]);
+    m_pid = pid;
+    m_signal = 0;
+    m_stdin = in[1];
+    m_stdout = out[0];
+    m_stderr = errp[0];
+#endif
+
+    m_running = true;
+    m_start = Clock::now();
+    Touch();
+    m_progressThread = std::thread(&FFmpegProcess::ReadProgress, this);
+    m_logThread = std::thread(&FFmpegProcess::ReadLog, this);
+    m_watchThread = std::thread(&FFmpegProcess::Watch, this);
+    return true;
+}
+
+bool FFmpegProcess::Write(const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+#ifdef _WIN32
+    if (!m_stdin) return false;
+    while (bytes > 0) {
+        DWORD n = 0;
+        if (!WriteFile((HANDLE)m_stdin, p, (DWORD)std::min<size_t>(bytes, 1u << 30), &n, nullptr)) return false;
+        p += n;
+        bytes -= n;
+        Touch();
+    }
+#else
+    if (m_stdin < 0) return false;
+    while (bytes > 0) {
+        const ssize_t n = write(m_stdin, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= size_t(n);
+        Touch();
+    }
+#endif
+    return true;
+}
+
+bool FFmpegProcess::Wait(std::string& err) {
+    if (!m_running) { err = "ffmpeg is not running"; return false; }
+    // EOF on stdin is ffmpeg's signal to finish
+#ifdef _WIN32
+    if (m_stdin) { CloseHandle((HANDLE)m_stdin); m_stdin = nullptr; }
+#else
+    if (m_stdin >= 0) { close(m_stdin); m_stdin = -1; }
+#endif
+    m_watchThread.join();
+    m_progressThread.join();
+    m_logThread.join();
+#ifdef _WIN32
+    CloseHandle((HANDLE)m_stdout);
+    CloseHandle((HANDLE)m_stderr);
+    CloseHandle((HANDLE)m_process);
+    m_stdout = m_stderr = m_process = nullptr;
+    const bool ok = m_exited && m_exitCode == 0 && !m_killReason;
+#else
+    close(m_stdout);
+    close(m_stderr);
+    m_stdout = m_stderr = -1;
+    m_pid = -1;
+    const bool ok = m_exited && m_signal == 0 && m_exitCode == 0 && !m_killReason;
+#endif
+    m_running = false;
+
+    const bool writeLog = !m_opts.logPath.empty() && (!ok || m_opts.keepLog);
+    if (writeLog) {
+        std::ofstream log(m_opts.logPath, std::ios::binary | std::ios::trunc);
+        log.write(m_log.data(), (std::streamsize)m_log.size());
+    }
+    if (ok) return true;
+
+    if (m_killReason) {
+        err = std::string("ffmpeg ") + m_killReason;
+        if (m_opts.timeoutSec > 0.0 && std::strcmp(m_killReason, "timed out") == 0) {
+            char secs[32];
+            std::snprintf(secs, sizeof(secs), " after %g s", m_opts.timeoutSec);
+            err += secs;
+        }
+    } else {
+#ifndef _WIN32
+        if (m_signal != 0) err = "ffmpeg was killed by signal " + std::to_string(m_signal);
+        else
+#endif
+        err = "ffmpeg failed with code " + std::to_string(m_exitCode);
+    }
+    err += LogTail();
+    if (writeLog) err += "\n(full log: " + m_opts.logPath + ")";
+    return false;
+}
+
+bool RunFFmpeg(const FFmpegRunOptions& options, std::string& err) {
+    GENFX_TRACE_SCOPE("ffmpeg");
+    FFmpegProcess process;
+    FFmpegRunOptions opts = options;
+    opts.pipeInput = false;
+    return process.Start(opts, err) && process.Wait(err);
+}
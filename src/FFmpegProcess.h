@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One "-progress" block reported by ffmpeg
+struct FFmpegProgress {
+    int frame{0};
+    int totalFrames{0};     // FFmpegRunOptions::expectedFrames, 0 = unknown
+    double fps{0.0};
+    double kbps{0.0};       // output bitrate so far
+    double outSeconds{0.0}; // encoded media time
+    double speed{0.0};      // media seconds per wall-clock second
+    double etaSec{-1.0};    // -1 = unknown
+    bool done{false};
+};
+
+struct FFmpegRunOptions {
+    std::vector<std::string> args; // everything after "ffmpeg"; -progress/-nostats are added
+    bool pipeInput{false};         // the caller streams stdin with Write()
+    int expectedFrames{0};         // for the ETA
+    double timeoutSec{0.0};        // whole run, 0 = none
+    double stallSec{0.0};          // no progress and no input for this long, 0 = none
+    const std::atomic<bool>* cancel{nullptr};
+    std::function<void(const FFmpegProgress&)> onProgress; // called on a reader thread
+    std::string logPath;           // stderr goes here on failure (and on success with keepLog)
+    bool keepLog{false};
+    size_t logCapacity{256 << 10}; // only the last bytes of stderr are kept
+    int niceness{0};               // 1..19 lowers the child's CPU (and on Linux I/O) priority
+};
+
+// Runs ffmpeg as a child process without a shell. stdout carries "-progress" key=value
+// blocks that are parsed live; stderr is kept in a bounded in-memory ring and only
+// written to disk when the run fails. A watchdog terminates the child on cancellation,
+// timeout or stall (politely first, then forcibly), which also unblocks Write().
+class FFmpegProcess {
+public:
+    FFmpegProcess() = default;
+    ~FFmpegProcess();
+    FFmpegProcess(const FFmpegProcess&) = delete;
+    FFmpegProcess& operator=(const FFmpegProcess&) = delete;
+
+    bool Start(const FFmpegRunOptions& options, std::string& err);
+    // Blocking write to ffmpeg's stdin (pipeInput only); false once the child is gone
+    bool Write(const void* data, size_t bytes);
+    // Closes stdin and waits for the child; on failure 'err' explains why and ends
+    // with the tail of ffmpeg's log
+    bool Wait(std::string& err);
+    // Ask the watchdog to terminate the child; Wait() then reports the run as cancelled
+    void Kill();
+
+private:
+    void ReadProgress();
+    void ReadLog();
+    void Watch();
+    void Terminate(const char* reason);
+    void Touch();
+    size_t ReadSome(bool fromLog, char* buf, size_t size);
+    std::string LogTail() const;
+
+    FFmpegRunOptions m_opts;
+    bool m_running{false};
+    std::thread m_progressThread, m_logThread, m_watchThread;
+    std::string m_log; // stderr ring (only touched by the log thread until Wait() joins it)
+    std::atomic<bool> m_killRequested{false};
+    std::atomic<int64_t> m_lastActivity{0}; // steady_clock ticks of the last progress/input
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_termSent;
+    const char* m_killReason{nullptr};
+    std::atomic<bool> m_exited{false};
+    int m_exitCode{-1};
+#ifdef _WIN32
+    void* m_process{nullptr}; // HANDLE
+    void* m_stdin{nullptr};   // HANDLE, write end
+    void* m_stdout{nullptr};  // HANDLE, read end
+    void* m_stderr{nullptr};  // HANDLE, read end
+#else
+    int m_pid{-1};
+    int m_stdin{-1};
+    int m_stdout{-1};
+    int m_stderr{-1};
+    int m_signal{0}; // signal that ended the child, 0 = exited normally
+#endif
+};
+
+// Start() + Wait() for runs without piped input
+bool RunFFmpeg(const FFmpegRunOptions& options, std::string& err);
@@ -0,0 +1,378 @@
+#include "FrameStore.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#ifdef GENFX_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(FrameStoreHeader) == 56, "FrameStoreHeader layout is part of the file format");
+
+namespace {
+
+const char kMagic[8] = {'G', 'F', 'X', 'R', 'A', 'W', '0', '1'};
+constexpr uint64_t kAlign = 4096;
+constexpr uint32_t kTileRows = 64;
+
+uint64_t AlignUp(uint64_t v) { return (v + kAlign - 1) / kAlign * kAlign; }
+
+} // namespace
+
+bool FrameStoreHasLZ4() {
+#ifdef GENFX_HAVE_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FrameStoreWriter::Create(const std::string& path, int width, int height, int fps, int frameCount, bool lz4,
+                              std::string& err) {
+    if (width <= 0 || height <= 0 || frameCount <= 0) {
+        err = "Raw frame store needs a known size and frame count";
+        return false;
+    }
+    m_path = path;
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.magic, kMagic, sizeof(kMagic));
+    m_header.headerSize = sizeof(FrameStoreHeader);
+    m_header.width = uint32_t(width);
+    m_header.height = uint32_t(height);
+    m_header.fps = uint32_t(fps);
+    m_header.frameCount = uint32_t(frameCount);
+    m_header.format = 0;
+    m_header.compression = (lz4 && FrameStoreHasLZ4()) ? 1 : 0;
+    m_header.tileRows = kTileRows;
+    m_header.indexOffset = sizeof(FrameStoreHeader);
+    m_header.dataOffset = AlignUp(m_header.indexOffset + uint64_t(frameCount) * sizeof(IndexEntry));
+    m_index.assign(size_t(frameCount), IndexEntry{0, 0});
+    m_end = m_header.dataOffset;
+    if (!m_header.compression) m_end += uint64_t(frameCount) * width * height * 4;
+
+    m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        err = "Failed to create " + path;
+        return false;
+    }
+    // Header now; the index is rewritten at Close()
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    if (!m_file.good()) { err = "Failed to write " + path; return false; }
+    return true;
+}
+
+bool FrameStoreWriter::WriteFrame(int index, const uint8_t* bgra, std::string& err) {
+    if (index < 0 || index >= (int)m_index.size()) { err = "Raw frame store: frame index out of range"; return false; }
+    const uint64_t frameBytes = uint64_t(m_header.width) * m_header.height * 4;
+    if (!m_header.compression) {
+        // Fixed slot, so any thread can write any frame
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t offset = m_header.dataOffset + uint64_t(index) * frameBytes;
+        m_file.seekp(std::streamoff(offset));
+        m_file.write(reinterpret_cast<const char*>(bgra), std::streamsize(frameBytes));
+        if (!m_file.good()) { err = "Failed to write " + m_path; return false; }
+        m_index[size_t(index)] = IndexEntry{offset, frameBytes};
+        return true;
+    }
+#ifdef GENFX_HAVE_LZ4
+    // Bands compress independently (in parallel here, and decode in parallel later)
+    const int h = (int)m_header.height;
+    const size_t rowBytes = size_t(m_header.width) * 4;
+    const int tiles = (h + (int)kTileRows - 1) / (int)kTileRows;
+    std::vector<std::vector<char>> packed(static_cast<size_t>(tiles));
+    ParallelFor(tiles, 1, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) {
+            const int rows = std::min((int)kTileRows, h - t * (int)kTileRows);
+            const int srcSize = int(rows * rowBytes);
+            auto& out = packed[size_t(t)];
+            out.resize(size_t(LZ4_compressBound(srcSize)));
+            const int n = LZ4_compress_default(reinterpret_cast<const char*>(bgra + size_t(t) * kTileRows * rowBytes),
+                                               out.data(), srcSize, (int)out.size());
+            out.resize(size_t(std::max(0, n)));
+        }
+    });
+    std::vector<uint32_t> table(size_t(tiles) + 1);
+    table[0] = uint32_t(tiles);
+    uint64_t size = table.size() * sizeof(uint32_t);
+    for (int t = 0; t < tiles; ++t) {
+        if (packed[size_t(t)].empty()) { err = "LZ4 compression failed"; return false; }
+        table[size_t(t) + 1] = uint32_t(packed[size_t(t)].size());
+        size += packed[size_t(t)].size();
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t offset = m_end;
+    m_file.seekp(std::streamoff(offset));
+    m_file.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size() * sizeof(uint32_t)));
+    for (const auto& p : packed) m_file.write(p.data(), std::streamsize(p.size()));
+    if (!m_file.good()) { err = "Failed to write " + m_path; return false; }
+    m_index[size_t(index)] = IndexEntry{offset, size};
+    m_end += size;
+    return true;
+#else
+    err = "Built without LZ4";
+    return false;
+#endif
+}
+
+bool FrameStoreWriter::WriteRows(int index, int y, int rows, const uint8_t* bgra, std::string& err) {
+    if (index < 0 || index >= (int)m_index.size()) { err = "Raw frame store: frame index out of range"; return false; }
+    if (m_header.compression) { err = "Raw frame store: rows can only be written uncompressed"; return false; }
+    const uint64_t rowBytes = uint64_t(m_header.width) * 4;
+    const uint64_t frameBytes = rowBytes * m_header.height;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t offset = m_header.dataOffset + uint64_t(index) * frameBytes;
+    m_file.seekp(std::streamoff(offset + uint64_t(y) * rowBytes));
+    m_file.write(reinterpret_cast<const char*>(bgra), std::streamsize(uint64_t(rows) * rowBytes));
+    if (!m_file.good()) { err = "Failed to write " + m_path; return false; }
+    if (uint32_t(y + rows) >= m_header.height) m_index[size_t(index)] = IndexEntry{offset, frameBytes};
+    return true;
+}
+
+bool FrameStoreWriter::Close(std::string& err) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) return true;
+    for (const auto& e : m_index) {
+        if (e.size == 0) { err = "Raw frame store " + m_path + " is missing frames"; m_file.close(); return false; }
+    }
+    m_file.seekp(std::streamoff(m_header.indexOffset));
+    m_file.write(reinterpret_cast<const char*>(m_index.data()), std::streamsize(m_index.size() * sizeof(IndexEntry)));
+    m_file.close();
+    if (m_file.fail()) { err = "Failed to write " + m_path; return false; }
+    return true;
+}
+
+// Read-only view of the whole file
+struct FrameStoreReader::Mapping {
+    const uint8_t* data{nullptr};
+    uint64_t size{0};
+#ifdef _WIN32
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#else
+    int fd{-1};
+#endif
+
+    bool Open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileW(std::filesystem::path(path).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER li;
+        if (!GetFileSizeEx(file, &li) || li.QuadPart == 0) return false;
+        size = uint64_t(li.QuadPart);
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return data != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) return false;
+        size = uint64_t(st.st_size);
+        void* p = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        madvise(p, size_t(size), MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(p);
+        return true;
+#endif
+    }
+
+    ~Mapping() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap(const_cast<uint8_t*>(data), size_t(size));
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+};
+
+FrameStoreReader::FrameStoreReader() = default;
+FrameStoreReader::~FrameStoreReader() = default;
+
+bool FrameStoreReader::Open(const std::string& path, std::string& err) {
+    Close();
+    auto map = std::make_unique<Mapping>();
+    if (!map->Open(path)) { err = "Failed to map " + path; return false; }
+    if (map->size < sizeof(FrameStoreHeader)) { err = path + " is not a raw frame store"; return false; }
+    std::memcpy(&m_header, map->data, sizeof(m_header));
+    const uint64_t frameBytes = uint64_t(m_header.width) * m_header.height * 4;
+    const uint64_t indexEnd = m_header.indexOffset + uint64_t(m_header.frameCount) * 16;
+    if (std::memcmp(m_header.magic, kMagic, sizeof(kMagic)) != 0 || m_header.headerSize != sizeof(FrameStoreHeader) ||
+        m_header.format != 0 || m_header.compression > 1 || frameBytes == 0 || m_header.frameCount == 0 ||
+        indexEnd > map->size) {
+        err = path + " is not a supported raw frame store";
+        return false;
+    }
+    if (m_header.compression == 1 && !FrameStoreHasLZ4()) { err = path + " uses LZ4 but this build has no LZ4"; return false; }
+    // Every index entry must point inside the file
+    const uint64_t* index = reinterpret_cast<const uint64_t*>(map->data + m_header.indexOffset);
+    for (uint32_t i = 0; i < m_header.frameCount; ++i) {
+        const uint64_t offset = index[i * 2], size = index[i * 2 + 1];
+        if (size == 0 || offset < m_header.dataOffset || offset + size > map->size ||
+            (m_header.compression == 0 && size != frameBytes)) {
+            err = path + " is truncated or damaged (frame " + std::to_string(i) + ")";
+            return false;
+        }
+    }
+    m_map = std::move(map);
+    return true;
+}
+
+void FrameStoreReader::Close() {
+    m_map.reset();
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+const uint8_t* FrameStoreReader::Frame(int index, std::vector<uint8_t>& scratch, std::string& err) const {
+    if (!m_map || index < 0 || index >= (int)m_header.frameCount) { err = "Raw frame store: frame index out of range"; return nullptr; }
+    const uint64_t* entry = reinterpret_cast<const uint64_t*>(m_map->data + m_header.indexOffset) + size_t(index) * 2;
+    const uint8_t* src = m_map->data + entry[0];
+    if (m_header.compression == 0) return src;
+#ifdef GENFX_HAVE_LZ4
+    const int h = (int)m_header.height;
+    const size_t rowBytes = size_t(m_header.width) * 4;
+    const int tiles = (h + (int)m_header.tileRows - 1) / (int)m_header.tileRows;
+    uint32_t count = 0;
+    std::memcpy(&count, src, 4);
+    if ((int)count != tiles || entry[1] < (uint64_t(tiles) + 1) * 4) { err = "Raw frame store: damaged frame " + std::to_string(index); return nullptr; }
+    std::vector<uint64_t> starts(size_t(tiles) + 1);
+    starts[0] = (uint64_t(tiles) + 1) * 4;
+    for (int t = 0; t < tiles; ++t) {
+        uint32_t n = 0;
+        std::memcpy(&n, src + 4 + size_t(t) * 4, 4);
+        starts[size_t(t) + 1] = starts[size_t(t)] + n;
+    }
+    if (starts.back() > entry[1]) { err = "Raw frame store: damaged frame " + std::to_string(index); return nullptr; }
+    scratch.resize(rowBytes * h);
+    std::atomic<bool> ok{true};
+    ParallelFor(tiles, 1, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) {
+            const int rows = std::min((int)m_header.tileRows, h - t * (int)m_header.tileRows);
+            const int expect = int(rows * rowBytes);
+            const int n = LZ4_decompress_safe(reinterpret_cast<const char*>(src + starts[size_t(t)]),
+                                              reinterpret_cast<char*>(scratch.data() + size_t(t) * m_header.tileRows * rowBytes),
+                                              int(starts[size_t(t) + 1] - starts[size_t(t)]), expect);
+            if (n != expect) ok.store(false, std::memory_order_relaxed);
+        }
+    });
+    if (!ok) { err = "Raw frame store: damaged frame " + std::to_string(index); return nullptr; }
+    return scratch.data();
+#else
+    (void)scratch;
+    err = "Built without LZ4";
+    return nullptr;
+#endif
+}
+
+namespace {
+
+// Writes each frame to its slot; the store itself is shared by all segments
+class FrameStoreEncoder : public VideoEncoder {
+public:
+    explicit FrameStoreEncoder(std::shared_ptr<FrameStoreWriter> shared = nullptr) : m_writer(std::move(shared)) {}
+
+    bool Open(const std::string& outPath, const EncoderSettings& settings, std::string& err) override {
+        m_settings = settings;
+        m_index = settings.firstFrame;
+        m_stats = EncoderStats{};
+        if (m_writer) return true;
+        m_owned = true;
+        m_writer = std::make_shared<FrameStoreWriter>();
+        return m_writer->Create(outPath, settings.width, settings.height, settings.fps, settings.frameCount, settings.rawLz4, err);
+    }
+
+    bool WriteFrame(const uint8_t* bgra, std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!m_writer->WriteFrame(m_index++, bgra, err)) return false;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_stats.frames++;
+        m_stats.frameMs += ms;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, ms);
+        return true;
+    }
+
+    // Uncompressed: each strip goes to the file as it comes, no frame is assembled
+    bool WriteRows(const uint8_t* bgra, int y, int rows, int width, int height, std::string& err) override {
+        if (m_writer->Compressed()) return VideoEncoder::WriteRows(bgra, y, rows, width, height, err);
+        auto t0 = std::chrono::steady_clock::now();
+        const bool last = y + rows >= height;
+        if (!m_writer->WriteRows(m_index, y, rows, bgra, err)) return false;
+        if (last) ++m_index;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_rowMs += ms;
+        if (!last) return true;
+        m_stats.frames++;
+        m_stats.frameMs += m_rowMs;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, m_rowMs);
+        m_rowMs = 0.0;
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        if (!m_owned) return true;
+        auto t0 = std::chrono::steady_clock::now();
+        if (!m_writer->Close(err)) return false;
+        m_stats.bytes = m_writer->Bytes();
+        m_stats.finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    const char* Name() const override { return "raw store"; }
+
+private:
+    std::shared_ptr<FrameStoreWriter> m_writer;
+    bool m_owned{false};
+    EncoderSettings m_settings;
+    int m_index{0};
+    double m_rowMs{0.0}; // frame written so far by WriteRows()
+};
+
+class FrameStoreOutput : public SegmentedOutput {
+public:
+    bool Open(const std::string& outPath, const EncoderSettings& settings, int, std::string& err) override {
+        m_settings = settings;
+        m_writer = std::make_shared<FrameStoreWriter>();
+        return m_writer->Create(outPath, settings.width, settings.height, settings.fps, settings.frameCount, settings.rawLz4, err);
+    }
+
+    std::unique_ptr<VideoEncoder> BeginSegment(int, int firstFrame, std::string& err) override {
+        auto enc = std::make_unique<FrameStoreEncoder>(m_writer);
+        EncoderSettings s = m_settings;
+        s.firstFrame = firstFrame;
+        if (!enc->Open(std::string(), s, err)) return nullptr;
+        return enc;
+    }
+
+    bool EndSegment(int, std::unique_ptr<VideoEncoder>, std::string&) override { return true; }
+
+    bool Finish(std::string& err) override { return m_writer->Close(err); }
+
+    const char* Name() const override { return "raw store"; }
+    uint64_t Bytes() const override { return m_writer ? m_writer->Bytes() : 0; }
+
+private:
+    EncoderSettings m_settings;
+    std::shared_ptr<FrameStoreWriter> m_writer;
+};
+
+} // namespace
+
+std::unique_ptr<VideoEncoder> CreateFrameStoreEncoder() { return std::make_unique<FrameStoreEncoder>(); }
+std::unique_ptr<SegmentedOutput> CreateFrameStoreOutput() { return std::make_unique<FrameStoreOutput>(); }
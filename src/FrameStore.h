@@ -0,0 +1,90 @@
+#pragma once
+#include "VideoEncoder.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Raw frame store (.gfxraw): the loop's final frames (crossfade included), rendered
+// once so they can be re-encoded in any codec/CRF without rendering again.
+//
+//   FrameStoreHeader        fixed size, little endian
+//   index[frameCount]       { uint64 offset, uint64 size } per frame
+//   frames                  from dataOffset (4 KiB aligned)
+//
+// Uncompressed frames are tightly packed straight BGRA at dataOffset + i*width*height*4,
+// so readers map the file and hand out pointers into it, and ffmpeg can read the data
+// as rawvideo. With LZ4 each frame is split into bands of tileRows rows compressed
+// independently: uint32 tileCount, uint32 compressedSize[tileCount], then the tiles.
+struct FrameStoreHeader {
+    char magic[8];          // "GFXRAW01"
+    uint32_t headerSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+    uint32_t frameCount;
+    uint32_t format;        // 0 = BGRA8, straight alpha
+    uint32_t compression;   // 0 = none, 1 = LZ4 tiles
+    uint32_t tileRows;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+};
+
+// True when built with LZ4 (GENFX_HAVE_LZ4)
+bool FrameStoreHasLZ4();
+
+// Frames may be written in any order from several threads.
+class FrameStoreWriter {
+public:
+    // Without LZ4 support 'lz4' is ignored and frames are stored uncompressed
+    bool Create(const std::string& path, int width, int height, int fps, int frameCount, bool lz4, std::string& err);
+    // Thread-safe; 'index' is the loop frame index
+    bool WriteFrame(int index, const uint8_t* bgra, std::string& err);
+    // Thread-safe; rows [y, y + rows) of frame 'index' straight to their place in the
+    // file, the frame counts as written with its last row. Uncompressed stores only.
+    bool WriteRows(int index, int y, int rows, const uint8_t* bgra, std::string& err);
+    bool Compressed() const { return m_header.compression != 0; }
+    // Writes the index; fails if a frame is missing
+    bool Close(std::string& err);
+    uint64_t Bytes() const { return m_end; }
+
+private:
+    struct IndexEntry { uint64_t offset; uint64_t size; };
+    std::mutex m_mutex;
+    std::fstream m_file;
+    std::string m_path;
+    FrameStoreHeader m_header{};
+    std::vector<IndexEntry> m_index;
+    uint64_t m_end{0};
+};
+
+class FrameStoreReader {
+public:
+    FrameStoreReader();
+    ~FrameStoreReader();
+    bool Open(const std::string& path, std::string& err);
+    void Close();
+
+    const FrameStoreHeader& Header() const { return m_header; }
+    int Width() const { return (int)m_header.width; }
+    int Height() const { return (int)m_header.height; }
+    int Fps() const { return (int)m_header.fps; }
+    int FrameCount() const { return (int)m_header.frameCount; }
+    bool Compressed() const { return m_header.compression != 0; }
+
+    // BGRA of frame 'index'. Uncompressed stores return a pointer into the mapping
+    // (no copy); LZ4 stores decode into 'scratch'. Thread-safe with per-thread scratch.
+    const uint8_t* Frame(int index, std::vector<uint8_t>& scratch, std::string& err) const;
+
+private:
+    struct Mapping;
+    std::unique_ptr<Mapping> m_map;
+    FrameStoreHeader m_header{};
+};
+
+// SegmentedOutput (and VideoEncoder) that write frames into a store instead of
+// encoding them. EncoderSettings::frameCount must be set.
+std::unique_ptr<VideoEncoder> CreateFrameStoreEncoder();
+std::unique_ptr<SegmentedOutput> CreateFrameStoreOutput();
@@ -0,0 +1,305 @@
+#include "Glow.h"
+#include "PixelKernels.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+
+// Box radii whose three-fold convolution approximates a Gaussian of the given sigma
+// (W. Jarosz, "Fast Image Convolutions"; the usual "boxes for gauss" construction).
+static void BoxRadiiForGauss(float sigma, int out[3]) {
+    const int n = 3;
+    float wIdeal = std::sqrt(12.0f * sigma * sigma / n + 1.0f);
+    int wl = (int)std::floor(wIdeal);
+    if (wl % 2 == 0) --wl;
+    int wu = wl + 2;
+    float mIdeal = (12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f);
+    int m = (int)std::lround(mIdeal);
+    for (int i = 0; i < n; ++i) {
+        int size = (i < m) ? wl : wu;
+        out[i] = std::max(0, (size - 1) / 2);
+    }
+}
+
+// Running-sum box blur of one interleaved 4-channel row. Pixels outside the row count as
+// transparent black, which is what the framebuffer background is.
+static void BoxRow(const uint16_t* src, uint16_t* dst, int w, int r, uint32_t mul) {
+    uint32_t s[4] = {0, 0, 0, 0};
+    int lead = std::min(r, w - 1);
+    for (int x = 0; x <= lead; ++x) {
+        for (int c = 0; c < 4; ++c) s[c] += src[x*4 + c];
+    }
+    // Split the sweep so the hot middle section has no bounds checks:
+    // [0, a) only adds, [a, b) adds and subtracts, [b, w) only subtracts.
+    int a = std::clamp(r, 0, w);
+    int b = std::clamp(w - r - 1, a, w);
+    int x = 0;
+    for (; x < a; ++x) {
+        for (int c = 0; c < 4; ++c) dst[x*4 + c] = (uint16_t)((s[c] * mul) >> 16);
+        if (x + r + 1 < w) {
+            for (int c = 0; c < 4; ++c) s[c] += src[(x + r + 1)*4 + c];
+        }
+    }
+    for (; x < b; ++x) {
+        const uint16_t* in = src + (x + r + 1) * 4;
+        const uint16_t* outg = src + (x - r) * 4;
+        for (int c = 0; c < 4; ++c) {
+            dst[x*4 + c] = (uint16_t)((s[c] * mul) >> 16);
+            s[c] += in[c];
+            s[c] -= outg[c];
+        }
+    }
+    for (; x < w; ++x) {
+        for (int c = 0; c < 4; ++c) dst[x*4 + c] = (uint16_t)((s[c] * mul) >> 16);
+        if (x - r >= 0) {
+            for (int c = 0; c < 4; ++c) s[c] -= src[(x - r)*4 + c];
+        }
+    }
+}
+
+// Vertical running-sum box blur over the column band [x0, x1). One accumulator per
+// channel of the band; every inner loop walks contiguous memory so it vectorizes.
+static void BoxColumns(const uint16_t* src, uint16_t* dst, int w, int h, int x0, int x1,
+                       int r, uint32_t mul, std::vector<uint32_t>& acc) {
+    const size_t stride = size_t(w) * 4;
+    const size_t off = size_t(x0) * 4;
+    const int n = (x1 - x0) * 4;
+    acc.assign(n, 0);
+    int lead = std::min(r, h - 1);
+    for (int y = 0; y <= lead; ++y) {
+        const uint16_t* row = src + y * stride + off;
+        for (int i = 0; i < n; ++i) acc[i] += row[i];
+    }
+    uint32_t* a = acc.data();
+    for (int y = 0; y < h; ++y) {
+        uint16_t* out = dst + y * stride + off;
+        for (int i = 0; i < n; ++i) out[i] = (uint16_t)((a[i] * mul) >> 16);
+        int ya = y + r + 1;
+        if (ya < h) {
+            const uint16_t* row = src + ya * stride + off;
+            for (int i = 0; i < n; ++i) a[i] += row[i];
+        }
+        int ys = y - r;
+        if (ys >= 0) {
+            const uint16_t* row = src + ys * stride + off;
+            for (int i = 0; i < n; ++i) a[i] -= row[i];
+        }
+    }
+}
+
+// Non-zero alpha in pixels [x, x + n) of either BGRA row. No early exit, so it vectorizes.
+static bool AnyAlpha(const uint8_t* r0, const uint8_t* r1, int x, int n) {
+    uint32_t m = 0;
+    for (int i = x; i < x + n; ++i) m |= r0[i*4 + 3] | r1[i*4 + 3];
+    return m != 0;
+}
+
+// Next run [a, b) of set flags at or after 'a'; false when there is none
+static bool NextRun(const uint8_t* flags, int n, int& a, int& b) {
+    while (a < n && !flags[a]) ++a;
+    if (a == n) return false;
+    b = a;
+    while (b < n && flags[b]) ++b;
+    return true;
+}
+
+// Tiles within 'spread' tiles of a set one, along x or along y
+static void DilateTiles(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, int tilesX, int tilesY,
+                        int spread, bool alongX) {
+    out.assign(in.size(), 0);
+    for (int t = 0; t < tilesY; ++t) {
+        for (int i = 0; i < tilesX; ++i) {
+            if (!in[size_t(t) * tilesX + i]) continue;
+            if (alongX) {
+                for (int j = std::max(0, i - spread); j <= std::min(tilesX - 1, i + spread); ++j) out[size_t(t) * tilesX + j] = 1;
+            } else {
+                for (int u = std::max(0, t - spread); u <= std::min(tilesY - 1, t + spread); ++u) out[size_t(u) * tilesX + i] = 1;
+            }
+        }
+    }
+}
+
+// Upsamples the glow of half-res columns [lo, hi) of rows 'ga' (weight 3) and 'gb'
+// (weight 1) and composites it into the full-res pixels that take a tap from them.
+// 'col' has one spare pixel either side of a half-res row; 'up' holds a full-res row.
+static void CompositeRun(const PixelKernels& kernels, uint8_t* row, const uint16_t* ga, const uint16_t* gb,
+                         int w, int lo, int hi, uint32_t gain, uint16_t* col, uint16_t* up) {
+    const int hw = (w + 1) / 2;
+    // Full-res pixels [x0, x1) are made in pairs from half-res pixels [i0, i1), whose
+    // horizontal taps reach one further out; the spare pixels repeat the edges
+    const int x0 = std::max(0, 2 * lo - 1);
+    const int x1 = std::min(w, 2 * hi + 1);
+    const int i0 = x0 / 2;
+    const int i1 = (x1 + 1) / 2;
+    const int c0 = std::max(0, i0 - 1);
+    const int c1 = std::min(hw, i1 + 1);
+    for (size_t i = size_t(c0) * 4; i < size_t(c1) * 4; ++i) col[i] = (uint16_t)(3 * ga[i] + gb[i]);
+    for (int c = 0; c < 4; ++c) {
+        if (c0 == 0) col[c - 4] = col[c];
+        if (c1 == hw) col[hw * 4 + c] = col[(hw - 1) * 4 + c];
+    }
+    for (int i = i0; i < i1; ++i) {
+        const uint16_t* g = col + i * 4;
+        uint16_t* u = up + size_t(i - i0) * 8;
+        for (int c = 0; c < 4; ++c) {
+            u[c] = (uint16_t)(3 * g[c] + g[c - 4]);
+            u[4 + c] = (uint16_t)(3 * g[c] + g[c + 4]);
+        }
+    }
+    // Composite runs of blocks that have any glow; elsewhere the kernel would leave
+    // the pixels as they are
+    uint8_t* d = row + size_t(x0) * 4;
+    const uint16_t* g = up + size_t(x0 - 2 * i0) * 4;
+    const int n = x1 - x0;
+    const int block = 16;
+    int run = -1;
+    for (int x = 0; x < n; x += block) {
+        const int m = std::min(block, n - x);
+        uint32_t any = 0;
+        for (int i = 0; i < m; ++i) any |= g[(x + i) * 4 + 3];
+        if (any && run < 0) run = x;
+        if (!any && run >= 0) {
+            kernels.glowComposite(d + run * 4, g + run * 4, size_t(x - run), gain);
+            run = -1;
+        }
+    }
+    if (run >= 0) kernels.glowComposite(d + run * 4, g + run * 4, size_t(n - run), gain);
+}
+
+int GlowPass::HaloRows(const GlowParams& params) {
+    if (!params.enabled()) return 0;
+    // The three vertical passes reach radii[0..2] half-res rows; the upsample one more
+    int radii[3];
+    BoxRadiiForGauss(params.radius * 0.25f, radii);
+    return 2 * (radii[0] + radii[1] + radii[2] + 1);
+}
+
+void GlowPass::Apply(std::vector<uint8_t>& bgra, int w, int h, const GlowParams& params) {
+    if (!params.enabled() || w <= 0 || h <= 0) return;
+    if (bgra.size() < size_t(w) * h * 4) return;
+
+    // The halo is low frequency, so it is blurred at half resolution and upsampled
+    // bilinearly during the composite: a quarter of the blur work for the same look.
+    const int hw = (w + 1) / 2;
+    const int hh = (h + 1) / 2;
+    const int tilesX = (hw + kTile - 1) / kTile;
+    const int tilesY = (hh + kTile - 1) / kTile;
+    const size_t tiles = size_t(tilesX) * tilesY;
+    if (hw != m_hw || hh != m_hh) {
+        m_work.assign(size_t(hw) * hh * 4, 0);
+        m_temp.assign(size_t(hw) * hh * 4, 0);
+        m_glowTiles.assign(tiles, 0);
+        m_hw = hw;
+        m_hh = hh;
+    }
+
+    int radii[3];
+    BoxRadiiForGauss(params.radius * 0.25f, radii);
+    uint32_t muls[3];
+    for (int i = 0; i < 3; ++i) muls[i] = (uint32_t)((65536u + radii[i]) / (2u * radii[i] + 1u));
+    // How far the three box passes together spread a pixel along one axis, in tiles
+    const int spread = (radii[0] + radii[1] + radii[2] + kTile - 1) / kTile;
+
+    uint8_t* px = bgra.data();
+    uint16_t* work = m_work.data();
+    uint16_t* temp = m_temp.data();
+    const size_t fullStride = size_t(w) * 4;
+    const size_t halfStride = size_t(hw) * 4;
+
+    // Tiles with non-transparent pixels; the row blur then covers the tiles within its
+    // reach of them, and the column blur (and so the glow) those within its reach of those
+    m_source.assign(tiles, 0);
+    ParallelFor(tilesY, 1, [&](int t0, int t1) {
+        for (int t = t0; t < t1; ++t) {
+            uint8_t* flags = &m_source[size_t(t) * tilesX];
+            for (int y = t * kTile * 2; y < std::min(h, (t + 1) * kTile * 2); y += 2) {
+                const uint8_t* r0 = px + size_t(y) * fullStride;
+                const uint8_t* r1 = px + size_t(std::min(y + 1, h - 1)) * fullStride;
+                for (int i = 0; i < tilesX; ++i) {
+                    const int x = i * kTile * 2;
+                    if (!flags[i] && AnyAlpha(r0, r1, x, std::min(w, x + kTile * 2) - x)) flags[i] = 1;
+                }
+            }
+        }
+    });
+    std::vector<uint8_t> glow;
+    DilateTiles(m_source, m_rowTiles, tilesX, tilesY, spread, true);
+    DilateTiles(m_rowTiles, glow, tilesX, tilesY, spread, false);
+
+    const PixelKernels& kernels = Kernels();
+    // Pass 1: 2x2 premultiplied downsample (kept as the sum of four, 0..1020) into the
+    // work buffer, then blur rows (work -> temp -> work -> temp), over each run of row
+    // blur tiles. Pixels outside a run are zero, so it blurs exactly as the whole row.
+    ParallelFor(hh, 8, [&](int y0, int y1) {
+        for (int hy = y0; hy < y1; ++hy) {
+            const uint8_t* r0 = px + size_t(2 * hy) * fullStride;
+            const uint8_t* r1 = px + size_t(std::min(2 * hy + 1, h - 1)) * fullStride;
+            uint16_t* wr = work + hy * halfStride;
+            uint16_t* tr = temp + hy * halfStride;
+            const uint8_t* flags = &m_rowTiles[size_t(hy / kTile) * tilesX];
+            for (int a = 0, b; NextRun(flags, tilesX, a, b); a = b) {
+                const int c0 = a * kTile;
+                const int c1 = std::min(hw, b * kTile);
+                kernels.downscale2x2Premul(r0 + c0 * 8, r1 + c0 * 8, wr + c0 * 4, std::min(w, 2 * c1) - 2 * c0);
+                const size_t o = size_t(c0) * 4;
+                BoxRow(wr + o, tr + o, c1 - c0, radii[0], muls[0]);
+                BoxRow(tr + o, wr + o, c1 - c0, radii[1], muls[1]);
+                BoxRow(wr + o, tr + o, c1 - c0, radii[2], muls[2]);
+            }
+        }
+    });
+
+    // Pass 2: blur each tile column (temp -> work -> temp -> work) over its runs of glow
+    // tiles. Glow tiles the row pass skipped are zero input. Outside glow tiles the work
+    // buffer is kept zero from frame to frame, so only tiles that had glow on the last
+    // frame and have none now are cleared.
+    ParallelFor(tilesX, 1, [&](int i0, int i1) {
+        std::vector<uint32_t> acc;
+        std::vector<uint8_t> column(tilesY);
+        for (int i = i0; i < i1; ++i) {
+            const int x0 = i * kTile;
+            const int x1 = std::min(hw, x0 + kTile);
+            auto clear = [&](uint16_t* buf, int t) {
+                for (int y = t * kTile; y < std::min(hh, (t + 1) * kTile); ++y) {
+                    std::fill(buf + y * halfStride + x0 * 4, buf + y * halfStride + x1 * 4, uint16_t(0));
+                }
+            };
+            for (int t = 0; t < tilesY; ++t) {
+                const size_t k = size_t(t) * tilesX + i;
+                if (m_glowTiles[k] && !glow[k]) clear(work, t);
+                if (glow[k] && !m_rowTiles[k]) clear(temp, t);
+                column[t] = glow[k];
+            }
+            for (int a = 0, b; NextRun(column.data(), tilesY, a, b); a = b) {
+                const int y0 = a * kTile;
+                const size_t o = size_t(y0) * halfStride;
+                const int n = std::min(hh, b * kTile) - y0;
+                BoxColumns(temp + o, work + o, hw, n, x0, x1, radii[0], muls[0], acc);
+                BoxColumns(work + o, temp + o, hw, n, x0, x1, radii[1], muls[1], acc);
+                BoxColumns(temp + o, work + o, hw, n, x0, x1, radii[2], muls[2], acc);
+            }
+        }
+    });
+    m_glowTiles.swap(glow);
+
+    // Pass 3: 2x bilinear upsample (fixed 3:1 weights, separable) and additive composite
+    // in premultiplied space (PixelKernels::glowComposite), over the runs of glow tiles
+    // of the two half-res rows each full-res row takes its taps from. Alpha grows with
+    // the glow so the halo also shows over a transparent background.
+    const uint32_t gain = (uint32_t)std::lround(params.intensity * 1020.0f);
+    ParallelFor(h, 16, [&](int y0, int y1) {
+        std::vector<uint16_t> col(halfStride + 8);
+        std::vector<uint16_t> up(halfStride * 2);
+        std::vector<uint8_t> lit(tilesX);
+        for (int y = y0; y < y1; ++y) {
+            const int hy = y / 2;
+            const int ny = (y & 1) ? std::min(hy + 1, hh - 1) : std::max(hy - 1, 0);
+            const uint8_t* ta = &m_glowTiles[size_t(hy / kTile) * tilesX];
+            const uint8_t* tb = &m_glowTiles[size_t(ny / kTile) * tilesX];
+            for (int i = 0; i < tilesX; ++i) lit[i] = ta[i] | tb[i];
+            for (int a = 0, b; NextRun(lit.data(), tilesX, a, b); a = b) {
+                CompositeRun(kernels, px + y * fullStride, work + hy * halfStride, work + ny * halfStride,
+                             w, a * kTile, std::min(hw, b * kTile), gain, col.data() + 4, up.data());
+            }
+        }
+    });
+}
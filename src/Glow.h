@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+struct GlowParams {
+    float intensity{0.0f}; // 0 disables the pass; 1.0 adds the blurred image once
+    float radius{8.0f};    // approximate Gaussian radius in pixels (~2 sigma)
+    bool enabled() const { return intensity > 0.0f && radius >= 0.5f; }
+};
+
+// Additive bloom post-process on a straight-alpha BGRA frame.
+// The blur is three running-sum box passes per axis (a Gaussian approximation),
+// so cost per pixel does not depend on the radius. Rows and column bands are
+// split across threads, and only tiles within the blur's reach of a non-transparent
+// pixel are blurred and composited, so a sparse frame costs little more than finding
+// out it is sparse. Scratch buffers are kept between frames.
+class GlowPass {
+public:
+    void Apply(std::vector<uint8_t>& bgra, int w, int h, const GlowParams& params);
+    // Rows above and below a band of a frame that reach into it through the blur (even).
+    // Applied to the band plus this much of the frame on either side, the pass gives the
+    // band's rows exactly as on the whole frame.
+    static int HaloRows(const GlowParams& params);
+
+private:
+    static constexpr int kTile = 16; // half-res pixels per side of a tile
+
+    std::vector<uint16_t> m_work; // premultiplied BGRA at half resolution, ((w+1)/2)*((h+1)/2)*4
+    std::vector<uint16_t> m_temp; // ping-pong buffer, same size
+    // Per tile, row-major: has non-transparent pixels / is within reach of the row blur /
+    // has glow. m_work is zero outside the glow tiles, which are kept for the next frame.
+    std::vector<uint8_t> m_source;
+    std::vector<uint8_t> m_rowTiles;
+    std::vector<uint8_t> m_glowTiles;
+    int m_hw{0}, m_hh{0}; // half-res size the buffers are laid out for
+};
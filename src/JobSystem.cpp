@@ -0,0 +1,240 @@
+#include "JobSystem.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <thread>
+
+struct JobAccess {
+    static void Finish(JobGroup& g, std::exception_ptr e) { g.Finish(std::move(e)); }
+    static std::atomic<int>& Pending(JobGroup& g) { return g.m_pending; }
+    static std::atomic<int>& Lowest(JobGroup& g) { return g.m_lowest; }
+};
+
+namespace {
+
+constexpr int kPriorities = 3;
+
+struct Job {
+    std::function<void()> fn;
+    JobGroup* group{nullptr};
+    JobPriority priority{JobPriority::Render};
+    int parallelForThreads{0};
+};
+
+struct JobQueues {
+    std::mutex mutex;
+    std::deque<Job> q[kPriorities];
+};
+
+// Index of the pool worker running on this thread, -1 elsewhere
+thread_local int t_worker = -1;
+
+class Pool {
+public:
+    Pool() {
+        const int n = (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < n; ++i) m_queues.push_back(std::make_unique<JobQueues>());
+        for (int i = 0; i < n; ++i) std::thread(&Pool::WorkerMain, this, i).detach();
+    }
+
+    int Workers() const { return (int)m_queues.size(); }
+
+    void Push(Job job) {
+        const int p = (int)job.priority;
+        JobQueues& q = t_worker >= 0 ? *m_queues[size_t(t_worker)] : m_shared;
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.q[p].push_back(std::move(job));
+        }
+        m_queued[p].fetch_add(1);
+        // Sleepers register before they check m_queued, so one of the two sides sees the other
+        if (m_idle.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_workCv.notify_one();
+        }
+        if (m_waiting.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_waitCv.notify_all();
+        }
+    }
+
+    // Called by a group whose last job just finished; the group may be gone already
+    void GroupDone() {
+        if (m_waiting.load() == 0) return;
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_waitCv.notify_all();
+    }
+
+    void Wait(JobGroup& g) {
+        std::atomic<int>& pending = JobAccess::Pending(g);
+        while (pending.load(std::memory_order_acquire) > 0) {
+            const int limit = JobAccess::Lowest(g).load();
+            Job job;
+            if (TryPop(limit, job)) { Execute(job); continue; }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_waiting.fetch_add(1);
+            // The group may have added less urgent jobs meanwhile (a graph's first encode)
+            m_waitCv.wait(lock, [&] { return pending.load() == 0 || Queued(JobAccess::Lowest(g).load()); });
+            m_waiting.fetch_sub(1);
+        }
+    }
+
+private:
+    void WorkerMain(int index) {
+        t_worker = index;
+        TraceSetDefaultThreadName("job worker " + std::to_string(index));
+        for (;;) {
+            Job job;
+            if (TryPop(kPriorities - 1, job)) { Execute(job); continue; }
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_idle.fetch_add(1);
+            m_workCv.wait(lock, [&] { return Queued(kPriorities - 1); });
+            m_idle.fetch_sub(1);
+        }
+    }
+
+    bool Queued(int limit) const {
+        for (int p = 0; p <= limit; ++p) {
+            if (m_queued[p].load() > 0) return true;
+        }
+        return false;
+    }
+
+    // Most urgent job up to class 'limit': own queue (newest first), then the shared
+    // queue, then the oldest job of another worker
+    bool TryPop(int limit, Job& out) {
+        for (int p = 0; p <= limit; ++p) {
+            if (m_queued[p].load(std::memory_order_relaxed) <= 0) continue;
+            if (t_worker >= 0 && PopFrom(*m_queues[size_t(t_worker)], p, true, out)) return Took(p);
+            if (PopFrom(m_shared, p, false, out)) return Took(p);
+            const size_t n = m_queues.size();
+            const size_t start = t_worker >= 0 ? size_t(t_worker) + 1 : 0;
+            for (size_t k = 0; k < n; ++k) {
+                const size_t v = (start + k) % n;
+                if ((int)v == t_worker) continue;
+                if (PopFrom(*m_queues[v], p, false, out)) return Took(p);
+            }
+        }
+        return false;
+    }
+
+    static bool PopFrom(JobQueues& q, int p, bool back, Job& out) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        std::deque<Job>& d = q.q[p];
+        if (d.empty()) return false;
+        if (back) { out = std::move(d.back()); d.pop_back(); }
+        else { out = std::move(d.front()); d.pop_front(); }
+        return true;
+    }
+
+    bool Took(int p) {
+        m_queued[p].fetch_sub(1);
+        return true;
+    }
+
+    static void Execute(Job& job) {
+        const JobPriority savedPriority = t_jobPriority;
+        const int savedThreads = t_parallelForThreads;
+        t_jobPriority = job.priority;
+        t_parallelForThreads = job.parallelForThreads;
+        std::exception_ptr error;
+        try {
+            job.fn();
+        } catch (...) {
+            if (!job.group) throw;
+            error = std::current_exception();
+        }
+        t_jobPriority = savedPriority;
+        t_parallelForThreads = savedThreads;
+        job.fn = nullptr; // release captures before the group can see the job finished
+        if (job.group) JobAccess::Finish(*job.group, std::move(error));
+    }
+
+    std::vector<std::unique_ptr<JobQueues>> m_queues;
+    JobQueues m_shared; // jobs submitted from threads outside the pool
+    std::atomic<int> m_queued[kPriorities]{};
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_workCv; // idle workers
+    std::condition_variable m_waitCv; // threads in Wait()
+    std::atomic<int> m_idle{0};
+    std::atomic<int> m_waiting{0};
+};
+
+// Never destroyed: a detached export may still be running when the process exits
+Pool& ThePool() {
+    static Pool* pool = new Pool();
+    return *pool;
+}
+
+} // namespace
+
+int JobWorkerCount() { return ThePool().Workers(); }
+
+void SubmitJob(JobPriority priority, std::function<void()> fn) {
+    ThePool().Push(Job{std::move(fn), nullptr, priority, t_parallelForThreads});
+}
+
+JobGroup::JobGroup(JobPriority priority) : m_priority(priority), m_lowest((int)priority) {}
+
+JobGroup::~JobGroup() {
+    ThePool().Wait(*this);
+}
+
+void JobGroup::Run(JobPriority priority, std::function<void()> fn) {
+    int lowest = m_lowest.load();
+    while ((int)priority > lowest && !m_lowest.compare_exchange_weak(lowest, (int)priority)) {}
+    m_pending.fetch_add(1);
+    ThePool().Push(Job{std::move(fn), this, priority, t_parallelForThreads});
+}
+
+void JobGroup::Wait() {
+    ThePool().Wait(*this);
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        std::swap(error, m_error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void JobGroup::Finish(std::exception_ptr error) {
+    if (error) {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        if (!m_error) m_error = std::move(error);
+    }
+    // Nothing of the group may be touched after the last decrement
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ThePool().GroupDone();
+}
+
+JobGraph::Node JobGraph::Add(JobPriority priority, std::function<void()> fn) {
+    m_nodes.emplace_back();
+    m_nodes.back().fn = std::move(fn);
+    m_nodes.back().priority = priority;
+    return m_nodes.size() - 1;
+}
+
+void JobGraph::Precede(Node before, Node after) {
+    m_nodes[before].next.push_back(after);
+    ++m_nodes[after].deps;
+}
+
+void JobGraph::Start(Node n) {
+    m_group.Run(m_nodes[n].priority, [this, n]() {
+        NodeData& node = m_nodes[n];
+        node.fn();
+        for (Node s : node.next) {
+            if (m_nodes[s].waiting.fetch_sub(1) == 1) Start(s);
+        }
+    });
+}
+
+void JobGraph::Run() {
+    for (NodeData& node : m_nodes) node.waiting = node.deps;
+    for (Node n = 0; n < m_nodes.size(); ++n) {
+        if (m_nodes[n].deps == 0) Start(n);
+    }
+    m_group.Wait();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// One work-stealing thread pool for the whole process (one worker per hardware
+// thread), shared by the preview, ParallelFor(), export rendering and encoding.
+//
+// Jobs are queued in three priority classes and a worker always takes the most urgent
+// job there is, so a preview frame goes ahead of export rendering, and rendering ahead
+// of encoding and cache work. Running jobs are never interrupted, which is why export
+// work is cut into frame-sized jobs (see JobGraph). Each worker keeps its own queues:
+// it pushes and pops at the back, idle workers steal from the front of the others.
+//
+// Threads that wait for jobs (JobGroup::Wait(), ParallelFor()) run queued jobs of the
+// same or a more urgent class meanwhile, so waiting inside a job never deadlocks the
+// pool and the waiting thread is not lost to it.
+enum class JobPriority { Interactive, Render, Background };
+
+// Class of the job running on this thread; threads outside the pool count as Render.
+// Groups, graphs and ParallelFor() started from a thread use it unless told otherwise.
+inline thread_local JobPriority t_jobPriority = JobPriority::Render;
+
+// Scoped priority for the calling thread, e.g. the UI thread while it renders the preview
+class JobPriorityScope {
+public:
+    explicit JobPriorityScope(JobPriority p) : m_saved(t_jobPriority) { t_jobPriority = p; }
+    ~JobPriorityScope() { t_jobPriority = m_saved; }
+    JobPriorityScope(const JobPriorityScope&) = delete;
+    JobPriorityScope& operator=(const JobPriorityScope&) = delete;
+private:
+    JobPriority m_saved;
+};
+
+// Workers in the pool (started on first use)
+int JobWorkerCount();
+
+// Fire and forget; 'fn' must not throw. Used for work that reports back on its own,
+// like an export started from the UI.
+void SubmitJob(JobPriority priority, std::function<void()> fn);
+
+// Jobs that are waited for together. Jobs inherit the submitting thread's
+// ParallelForLimit; an exception thrown by one is rethrown by Wait().
+class JobGroup {
+public:
+    explicit JobGroup(JobPriority priority = t_jobPriority);
+    ~JobGroup(); // waits, exceptions are dropped
+    JobGroup(const JobGroup&) = delete;
+    JobGroup& operator=(const JobGroup&) = delete;
+
+    void Run(std::function<void()> fn) { Run(m_priority, std::move(fn)); }
+    void Run(JobPriority priority, std::function<void()> fn);
+    // Returns when every job run so far (and any they added) has finished
+    void Wait();
+
+private:
+    friend struct JobAccess;
+    void Finish(std::exception_ptr error);
+
+    JobPriority m_priority;
+    std::atomic<int> m_pending{0};
+    std::atomic<int> m_lowest; // least urgent class run so far; Wait() helps with up to it
+    std::mutex m_errorMutex;
+    std::exception_ptr m_error;
+};
+
+// Dependency graph of jobs, for frame pipelines: a node is submitted once all of its
+// predecessors have finished. Build it, then Run() it once.
+//
+//   JobGraph g;
+//   auto render = g.Add(JobPriority::Render, [&] { ... });
+//   auto encode = g.Add(JobPriority::Background, [&] { ... });
+//   g.Precede(render, encode);
+//   g.Run();
+class JobGraph {
+public:
+    using Node = size_t;
+    explicit JobGraph(JobPriority priority = t_jobPriority) : m_priority(priority), m_group(priority) {}
+
+    Node Add(std::function<void()> fn) { return Add(m_priority, std::move(fn)); }
+    Node Add(JobPriority priority, std::function<void()> fn);
+    // 'after' waits for 'before'
+    void Precede(Node before, Node after);
+    // Submits the nodes without predecessors and returns when everything has run. If a
+    // node throws, its successors are skipped and the exception is rethrown here.
+    void Run();
+
+private:
+    struct NodeData {
+        std::function<void()> fn;
+        JobPriority priority;
+        std::vector<Node> next;
+        int deps{0};
+        std::atomic<int> waiting{0};
+    };
+    void Start(Node n);
+
+    JobPriority m_priority;
+    std::deque<NodeData> m_nodes; // stable addresses while jobs run
+    JobGroup m_group;
+};
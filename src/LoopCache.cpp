@@ -0,0 +1,109 @@
+#include "LoopCache.h"
+#include <algorithm>
+#include <cstring>
+#ifdef GENFX_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+
+#ifndef GENFX_HAVE_LZ4
+// Runs of 32-bit pixels, each behind a 16-bit header: top bit set = one pixel repeated
+// (count - 1 in the low 15 bits), else count - 1 literal pixels follow
+constexpr uint16_t kRepeat = 0x8000;
+constexpr size_t kMaxRun = 0x8000;
+
+void PackRuns(const uint8_t* bgra, size_t pixels, std::vector<uint8_t>& out) {
+    out.clear();
+    auto px = [&](size_t i) { uint32_t v; std::memcpy(&v, bgra + i * 4, 4); return v; };
+    auto header = [&](uint16_t h) { out.push_back(uint8_t(h)); out.push_back(uint8_t(h >> 8)); };
+    size_t i = 0;
+    while (i < pixels) {
+        size_t run = 1;
+        while (i + run < pixels && run < kMaxRun && px(i + run) == px(i)) ++run;
+        if (run >= 2) {
+            header(uint16_t(kRepeat | (run - 1)));
+            out.insert(out.end(), bgra + i * 4, bgra + i * 4 + 4);
+            i += run;
+            continue;
+        }
+        // Literals up to the next pair of equal pixels
+        size_t n = 1;
+        while (i + n < pixels && n < kMaxRun && !(i + n + 1 < pixels && px(i + n) == px(i + n + 1))) ++n;
+        header(uint16_t(n - 1));
+        out.insert(out.end(), bgra + i * 4, bgra + (i + n) * 4);
+        i += n;
+    }
+}
+
+bool UnpackRuns(const std::vector<uint8_t>& in, uint8_t* bgra, size_t pixels) {
+    size_t pos = 0, i = 0;
+    while (pos + 2 <= in.size()) {
+        const uint16_t h = uint16_t(in[pos] | (in[pos + 1] << 8));
+        pos += 2;
+        const size_t n = size_t(h & ~kRepeat) + 1;
+        if (i + n > pixels) return false;
+        if (h & kRepeat) {
+            if (pos + 4 > in.size()) return false;
+            for (size_t k = 0; k < n; ++k) std::memcpy(bgra + (i + k) * 4, in.data() + pos, 4);
+            pos += 4;
+        } else {
+            if (pos + n * 4 > in.size()) return false;
+            std::memcpy(bgra + i * 4, in.data() + pos, n * 4);
+            pos += n * 4;
+        }
+        i += n;
+    }
+    return i == pixels;
+}
+#endif
+
+} // namespace
+
+LoopCache::LoopCache(size_t maxBytes) : m_maxBytes(maxBytes) {}
+
+void LoopCache::Reset(int frameCount, size_t bytesPerFrame) {
+    m_frames.clear();
+    m_frames.shrink_to_fit();
+    m_count = std::max(0, frameCount);
+    m_frameBytes = bytesPerFrame;
+    m_bytes = 0;
+    m_overflow = false;
+}
+
+bool LoopCache::Add(const std::vector<uint8_t>& bgra) {
+    if (!Filling() || bgra.size() != m_frameBytes) return false;
+    std::vector<uint8_t> packed;
+#ifdef GENFX_HAVE_LZ4
+    packed.resize(size_t(LZ4_compressBound((int)bgra.size())));
+    const int n = LZ4_compress_default(reinterpret_cast<const char*>(bgra.data()), reinterpret_cast<char*>(packed.data()),
+                                       (int)bgra.size(), (int)packed.size());
+    packed.resize(size_t(std::max(0, n)));
+    const bool failed = packed.empty() && !bgra.empty();
+#else
+    PackRuns(bgra.data(), bgra.size() / 4, packed);
+    const bool failed = false;
+#endif
+    packed.shrink_to_fit();
+    if (failed || m_bytes + packed.size() > m_maxBytes) {
+        Reset(m_count, m_frameBytes);
+        m_overflow = true;
+        return false;
+    }
+    m_bytes += packed.size();
+    m_frames.push_back(std::move(packed));
+    return true;
+}
+
+bool LoopCache::Get(int index, std::vector<uint8_t>& bgra) const {
+    if (index < 0 || index >= Frames()) return false;
+    const std::vector<uint8_t>& packed = m_frames[size_t(index)];
+    bgra.resize(m_frameBytes);
+#ifdef GENFX_HAVE_LZ4
+    const int n = LZ4_decompress_safe(reinterpret_cast<const char*>(packed.data()), reinterpret_cast<char*>(bgra.data()),
+                                      (int)packed.size(), (int)bgra.size());
+    return n == (int)bgra.size();
+#else
+    return UnpackRuns(packed, bgra.data(), bgra.size() / 4);
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One pass of the preview loop, compressed in memory, so later passes play back
+// without rendering. Frames are added in loop order during the first pass and
+// compressed one by one: LZ4 when built with it (GENFX_HAVE_LZ4), else runs of
+// identical pixels, which is what mostly transparent effect frames are made of.
+// The whole loop either fits the byte budget or is not kept: once a frame goes over
+// it, everything is dropped until the next Reset(). Not thread-safe.
+class LoopCache {
+public:
+    explicit LoopCache(size_t maxBytes = 256u << 20);
+
+    // Empties the cache; the next Add() is frame 0 of a loop of 'frameCount' frames
+    // of 'bytesPerFrame' bytes each
+    void Reset(int frameCount, size_t bytesPerFrame);
+    // Appends the next loop frame; false (and the cache empties) past the budget
+    bool Add(const std::vector<uint8_t>& bgra);
+    // Decodes loop frame 'index' (< Frames()) into 'bgra'
+    bool Get(int index, std::vector<uint8_t>& bgra) const;
+
+    bool Filling() const { return !m_overflow && Frames() < m_count; }
+    bool Complete() const { return m_count > 0 && Frames() == m_count; }
+    int FrameCount() const { return m_count; }
+    int Frames() const { return (int)m_frames.size(); }
+    size_t Bytes() const { return m_bytes; }
+    size_t MaxBytes() const { return m_maxBytes; }
+
+private:
+    const size_t m_maxBytes;
+    std::vector<std::vector<uint8_t>> m_frames; // compressed
+    int m_count{0};
+    size_t m_frameBytes{0};
+    size_t m_bytes{0};
+    bool m_overflow{false};
+};
@@ -3,16 +3,15 @@
 #include <wx/stattext.h>
 #include <wx/filename.h>
 #include <wx/filedlg.h>
-#include <thread>
-#include <future>
+#include <wx/stdpaths.h>
+#include <chrono>
 #include <sstream>
 
-#include "FFmpegPipe.h"
-// PNG encoder for frames
-#include "PngEncoder.h"
-#include <fstream>
-#include <filesystem>
-#include <cstdlib>
+#include "EffectScript.h"
+#include "Exporter.h"
+#include "FrameStore.h"
+#include "JobSystem.h"
+#include "Trace.h"
 
 wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
     EVT_TIMER(wxID_ANY, MainFrame::OnTimer)
@@ -21,6 +20,7 @@ wxEND_EVENT_TABLE()
 MainFrame::MainFrame(const wxString& title)
     : wxFrame(nullptr, wxID_ANY, title, wxDefaultPosition, wxSize(980, 640)), m_timer(this) {
     BuildUI();
+    ApplyEffectDefaults();
     RecreateRenderer();
     m_timer.Start(1000/30); // fixed 30 FPS preview
 
@@ -33,11 +33,36 @@ MainFrame::MainFrame(const wxString& title)
     if (m_speedSlider) { m_speedSlider->SetBackgroundColour(bg); m_speedSlider->SetForegroundColour(fg); }
     if (m_densitySlider) { m_densitySlider->SetBackgroundColour(bg); m_densitySlider->SetForegroundColour(fg); }
     if (m_bgRadio) { m_bgRadio->SetBackgroundColour(bg); m_bgRadio->SetForegroundColour(fg); }
+    if (m_overdrawView) { m_overdrawView->SetBackgroundColour(bg); m_overdrawView->SetForegroundColour(fg); }
+    if (m_previewStats) { m_previewStats->SetBackgroundColour(bg); m_previewStats->SetForegroundColour(fg); }
     if (m_exportBtn) { m_exportBtn->SetBackgroundColour(bg); m_exportBtn->SetForegroundColour(fg); }
     if (m_codecChoice) { m_codecChoice->SetBackgroundColour(bg); m_codecChoice->SetForegroundColour(fg); }
+    if (m_encoderChoice) { m_encoderChoice->SetBackgroundColour(bg); m_encoderChoice->SetForegroundColour(fg); }
+    if (m_parallelSegments) { m_parallelSegments->SetBackgroundColour(bg); m_parallelSegments->SetForegroundColour(fg); }
+    if (m_atlasStepChoice) { m_atlasStepChoice->SetBackgroundColour(bg); m_atlasStepChoice->SetForegroundColour(fg); }
+    if (m_atlasIndexed) { m_atlasIndexed->SetBackgroundColour(bg); m_atlasIndexed->SetForegroundColour(fg); }
+    if (m_rawLz4) { m_rawLz4->SetBackgroundColour(bg); m_rawLz4->SetForegroundColour(fg); }
+    if (m_useCache) { m_useCache->SetBackgroundColour(bg); m_useCache->SetForegroundColour(fg); }
+    if (m_cacheFrames) { m_cacheFrames->SetBackgroundColour(bg); m_cacheFrames->SetForegroundColour(fg); }
+    if (m_resume) { m_resume->SetBackgroundColour(bg); m_resume->SetForegroundColour(fg); }
+    if (m_resourceChoice) { m_resourceChoice->SetBackgroundColour(bg); m_resourceChoice->SetForegroundColour(fg); }
+    if (m_sizePresets) { m_sizePresets->SetBackgroundColour(bg); m_sizePresets->SetForegroundColour(fg); }
+    if (m_customSizes) { m_customSizes->SetBackgroundColour(bg); m_customSizes->SetForegroundColour(fg); }
+    if (m_stripRender) { m_stripRender->SetBackgroundColour(bg); m_stripRender->SetForegroundColour(fg); }
+    if (m_writeTrace) { m_writeTrace->SetBackgroundColour(bg); m_writeTrace->SetForegroundColour(fg); }
+    if (m_reencodeBtn) { m_reencodeBtn->SetBackgroundColour(bg); m_reencodeBtn->SetForegroundColour(fg); }
+    if (m_cancelBtn) { m_cancelBtn->SetBackgroundColour(bg); m_cancelBtn->SetForegroundColour(fg); }
+    if (m_exportStatus) { m_exportStatus->SetBackgroundColour(bg); m_exportStatus->SetForegroundColour(fg); }
     if (m_saveLogs) { m_saveLogs->SetBackgroundColour(bg); m_saveLogs->SetForegroundColour(fg); }
     if (m_sizeMinSlider) { m_sizeMinSlider->SetBackgroundColour(bg); m_sizeMinSlider->SetForegroundColour(fg); }
     if (m_sizeMaxSlider) { m_sizeMaxSlider->SetBackgroundColour(bg); m_sizeMaxSlider->SetForegroundColour(fg); }
+    if (m_glowIntensitySlider) { m_glowIntensitySlider->SetBackgroundColour(bg); m_glowIntensitySlider->SetForegroundColour(fg); }
+    if (m_glowRadiusSlider) { m_glowRadiusSlider->SetBackgroundColour(bg); m_glowRadiusSlider->SetForegroundColour(fg); }
+    if (m_blendChoice) { m_blendChoice->SetBackgroundColour(bg); m_blendChoice->SetForegroundColour(fg); }
+    if (m_motionBlur) { m_motionBlur->SetBackgroundColour(bg); m_motionBlur->SetForegroundColour(fg); }
+    if (m_overlayChoice) { m_overlayChoice->SetBackgroundColour(bg); m_overlayChoice->SetForegroundColour(fg); }
+    if (m_overlayOpacitySlider) { m_overlayOpacitySlider->SetBackgroundColour(bg); m_overlayOpacitySlider->SetForegroundColour(fg); }
+    if (m_overlayBlendChoice) { m_overlayBlendChoice->SetBackgroundColour(bg); m_overlayBlendChoice->SetForegroundColour(fg); }
 }
 
 void MainFrame::OnDurationChanged(wxCommandEvent&) {
@@ -49,6 +74,7 @@ void MainFrame::OnSpeedChanged(wxCommandEvent&) {
     if (!m_renderer) return;
     float speed = m_speedSlider ? (m_speedSlider->GetValue() / 100.0f) : 1.0f;
     m_renderer->SetSpeed(speed);
+    InvalidateLoopCache();
 }
 
 void MainFrame::OnDensityChanged(wxCommandEvent&) {
@@ -66,6 +92,20 @@ void MainFrame::OnBgChanged(wxCommandEvent&) {
     m_preview->SetBackgroundMode(mode);
 }
 
+void MainFrame::OnOverdrawChanged(wxCommandEvent&) {
+    ApplyOverdrawView();
+}
+
+void MainFrame::ApplyOverdrawView() {
+    const bool on = m_overdrawView && m_overdrawView->GetValue();
+    if (m_renderer) m_renderer->SetStatsEnabled(on);
+    // The stats live in the renderer, so this is redone whenever it is recreated
+    if (m_preview) m_preview->SetOverdraw(on && m_renderer ? m_renderer->GetStats() : nullptr);
+    m_statsFrames = 0;
+    m_statsMs = 0.0;
+    m_statsPrimitives = m_statsBlended = m_statsCovered = m_statsClipped = 0;
+}
+
 void MainFrame::BuildUI() {
     auto* root = new wxBoxSizer(wxHORIZONTAL);
 
@@ -73,6 +113,8 @@ void MainFrame::BuildUI() {
     auto* left = new wxBoxSizer(wxVERTICAL);
     m_preview = new PreviewPanel(this, nullptr);
     left->Add(m_preview, 1, wxEXPAND|wxALL, 8);
+    m_previewStats = new wxStaticText(this, wxID_ANY, "");
+    left->Add(m_previewStats, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
 
     // Right: controls
     auto* right = new wxBoxSizer(wxVERTICAL);
@@ -80,17 +122,34 @@ void MainFrame::BuildUI() {
     // Effect choice
     right->Add(new wxStaticText(this, wxID_ANY, "Effect"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
     m_effectChoice = new wxChoice(this, wxID_ANY);
-    m_effectChoice->Append("black-noise");
-    m_effectChoice->Append("white-noise");
-    m_effectChoice->Append("golden-lights");
-    m_effectChoice->Append("rain");
-    m_effectChoice->Append("snow");
-    m_effectChoice->Append("fireflies");
+    for (const auto& name : Renderer::BuiltInEffectNames()) m_effectChoice->Append(name);
+    for (const auto& name : ScriptEffectNames()) m_effectChoice->Append(name);
     // Keep default as "golden-lights" (now at index 2 after inserting white-noise)
     m_effectChoice->SetSelection(2);
     m_effectChoice->Bind(wxEVT_CHOICE, &MainFrame::OnEffectChanged, this);
     right->Add(m_effectChoice, 0, wxEXPAND|wxALL, 8);
 
+    // Overlay layer rendered on top of the effect in the same pass (e.g. snow over rain)
+    right->Add(new wxStaticText(this, wxID_ANY, "Overlay effect"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
+    m_overlayChoice = new wxChoice(this, wxID_ANY);
+    m_overlayChoice->Append("(none)");
+    for (unsigned i = 0; i < m_effectChoice->GetCount(); ++i) m_overlayChoice->Append(m_effectChoice->GetString(i));
+    m_overlayChoice->SetSelection(0);
+    m_overlayChoice->Bind(wxEVT_CHOICE, &MainFrame::OnOverlayChanged, this);
+    right->Add(m_overlayChoice, 0, wxEXPAND|wxALL, 8);
+
+    right->Add(new wxStaticText(this, wxID_ANY, "Overlay opacity (%)"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
+    m_overlayOpacitySlider = new wxSlider(this, wxID_ANY, 100, 0, 100, wxDefaultPosition, wxDefaultSize, wxSL_LABELS);
+    m_overlayOpacitySlider->Bind(wxEVT_SLIDER, &MainFrame::OnOverlayChanged, this);
+    right->Add(m_overlayOpacitySlider, 0, wxEXPAND|wxALL, 8);
+
+    m_overlayBlendChoice = new wxChoice(this, wxID_ANY);
+    m_overlayBlendChoice->Append("Overlay: normal");
+    m_overlayBlendChoice->Append("Overlay: additive");
+    m_overlayBlendChoice->SetSelection(0);
+    m_overlayBlendChoice->Bind(wxEVT_CHOICE, &MainFrame::OnOverlayChanged, this);
+    right->Add(m_overlayBlendChoice, 0, wxEXPAND|wxALL, 8);
+
     // Duration slider (10..20 s)
     right->Add(new wxStaticText(this, wxID_ANY, "Duration (s)"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
     m_durationSlider = new wxSlider(this, wxID_ANY, 12, 10, 20, wxDefaultPosition, wxDefaultSize, wxSL_LABELS);
@@ -120,6 +179,33 @@ void MainFrame::BuildUI() {
     m_sizeMaxSlider->Bind(wxEVT_SLIDER, &MainFrame::OnSizeRangeChanged, this);
     right->Add(m_sizeMaxSlider, 0, wxEXPAND|wxALL, 8);
 
+    // Glow post-process (intensity in %, radius in px)
+    right->Add(new wxStaticText(this, wxID_ANY, "Glow intensity (%)"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
+    m_glowIntensitySlider = new wxSlider(this, wxID_ANY, 0, 0, 200, wxDefaultPosition, wxDefaultSize, wxSL_LABELS);
+    m_glowIntensitySlider->Bind(wxEVT_SLIDER, &MainFrame::OnGlowChanged, this);
+    right->Add(m_glowIntensitySlider, 0, wxEXPAND|wxALL, 8);
+
+    right->Add(new wxStaticText(this, wxID_ANY, "Glow radius (px)"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
+    m_glowRadiusSlider = new wxSlider(this, wxID_ANY, 8, 1, 64, wxDefaultPosition, wxDefaultSize, wxSL_LABELS);
+    m_glowRadiusSlider->Bind(wxEVT_SLIDER, &MainFrame::OnGlowChanged, this);
+    right->Add(m_glowRadiusSlider, 0, wxEXPAND|wxALL, 8);
+
+    // Particle blending / framebuffer precision
+    right->Add(new wxStaticText(this, wxID_ANY, "Blending"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
+    m_blendChoice = new wxChoice(this, wxID_ANY);
+    m_blendChoice->Append("Normal (8-bit)");
+    m_blendChoice->Append("Normal (16-bit accumulation)");
+    m_blendChoice->Append("Additive (16-bit accumulation)");
+    m_blendChoice->SetSelection(0);
+    m_blendChoice->Bind(wxEVT_CHOICE, &MainFrame::OnBlendChanged, this);
+    right->Add(m_blendChoice, 0, wxEXPAND|wxALL, 8);
+
+    // Motion blur for fast particles (rain, snow)
+    m_motionBlur = new wxCheckBox(this, wxID_ANY, "Motion blur");
+    m_motionBlur->SetValue(false);
+    m_motionBlur->Bind(wxEVT_CHECKBOX, &MainFrame::OnMotionBlurChanged, this);
+    right->Add(m_motionBlur, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
     // Background radio: Black / Gray / White
     const wxString bgChoices[] = {"Black", "Gray", "White"};
     m_bgRadio = new wxRadioBox(this, wxID_ANY, "Preview background", wxDefaultPosition, wxDefaultSize,
@@ -128,16 +214,100 @@ void MainFrame::BuildUI() {
     m_bgRadio->Bind(wxEVT_RADIOBOX, &MainFrame::OnBgChanged, this);
     right->Add(m_bgRadio, 0, wxEXPAND|wxALL, 8);
 
+    // Overdraw heatmap: blends per pixel instead of the frame. Needs the raster
+    // counters, which are only compiled into Debug or GENFX_WITH_RENDER_STATS builds.
+    m_overdrawView = new wxCheckBox(this, wxID_ANY, "Overdraw heatmap");
+    m_overdrawView->Enable(Renderer::StatsAvailable());
+    if (!Renderer::StatsAvailable()) m_overdrawView->SetToolTip("Build with -DGENFX_WITH_RENDER_STATS=ON (on in Debug builds)");
+    m_overdrawView->Bind(wxEVT_CHECKBOX, &MainFrame::OnOverdrawChanged, this);
+    right->Add(m_overdrawView, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
     // Codec selection
     right->Add(new wxStaticText(this, wxID_ANY, "Codec"), 0, wxLEFT|wxRIGHT|wxTOP, 8);
     m_codecChoice = new wxChoice(this, wxID_ANY);
     m_codecChoice->Append("VP8 (dual-stream alpha)");
     m_codecChoice->Append("VP9 (single-stream alpha)");
     m_codecChoice->Append("UT Video RGBA (lossless)");
+    m_codecChoice->Append("Animated WebP (alpha)");
+    m_codecChoice->Append("Sprite atlas (PNG pages + JSON)");
+    m_codecChoice->Append("Raw frame store (.gfxraw)");
     m_codecChoice->SetSelection(0);
     m_codecChoice->Enable(true);
     right->Add(m_codecChoice, 0, wxEXPAND|wxALL, 8);
 
+    // Encoder backend: in-process libvpx when built with it, ffmpeg otherwise
+    m_encoderChoice = new wxChoice(this, wxID_ANY);
+    m_encoderChoice->Append(HasInProcessEncoder(VideoCodec::VP8_DualStream) ? "Encoder: built-in (libvpx)" : "Encoder: auto");
+    m_encoderChoice->Append("Encoder: ffmpeg command line");
+    m_encoderChoice->SetSelection(0);
+    right->Add(m_encoderChoice, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Encode keyframe-aligned segments of every size concurrently
+    m_parallelSegments = new wxCheckBox(this, wxID_ANY, "Parallel segment encoding");
+    m_parallelSegments->SetValue(true);
+    right->Add(m_parallelSegments, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Sprite atlas options: frame subset and palette pages
+    m_atlasStepChoice = new wxChoice(this, wxID_ANY);
+    m_atlasStepChoice->Append("Atlas frames: all");
+    m_atlasStepChoice->Append("Atlas frames: every 2nd");
+    m_atlasStepChoice->Append("Atlas frames: every 3rd");
+    m_atlasStepChoice->Append("Atlas frames: every 4th");
+    m_atlasStepChoice->SetSelection(1);
+    right->Add(m_atlasStepChoice, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    m_atlasIndexed = new wxCheckBox(this, wxID_ANY, "Atlas: 256-color palette pages");
+    m_atlasIndexed->SetValue(false);
+    right->Add(m_atlasIndexed, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Raw frame store: render once, re-encode later without rendering
+    m_rawLz4 = new wxCheckBox(this, wxID_ANY, "Raw store: LZ4 tiles");
+    m_rawLz4->SetValue(false);
+    m_rawLz4->Enable(FrameStoreHasLZ4());
+    right->Add(m_rawLz4, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Reuse identical earlier exports (and their rendered frames) from the user cache
+    m_useCache = new wxCheckBox(this, wxID_ANY, "Export cache");
+    m_useCache->SetValue(true);
+    right->Add(m_useCache, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    m_cacheFrames = new wxCheckBox(this, wxID_ANY, "Cache rendered frames");
+    m_cacheFrames->SetValue(false);
+    right->Add(m_cacheFrames, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    // Checkpoint finished segments so a failed or interrupted export can pick up again
+    m_resume = new wxCheckBox(this, wxID_ANY, "Resume interrupted exports");
+    m_resume->SetValue(true);
+    right->Add(m_resume, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    // Leave room for other work: the export shrinks to the budget instead of failing
+    m_resourceChoice = new wxChoice(this, wxID_ANY);
+    m_resourceChoice->Append("Export resources: unlimited");
+    m_resourceChoice->Append("Export resources: half the cores");
+    m_resourceChoice->Append("Export resources: 4 GB, 2 threads, low priority");
+    m_resourceChoice->Append("Export resources: 1 GB, 1 thread, idle priority");
+    m_resourceChoice->SetSelection(0);
+    right->Add(m_resourceChoice, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Output sizes: presets plus any "WxH, ..." list, up to 16384 per side
+    m_sizePresets = new wxCheckListBox(this, wxID_ANY, wxDefaultPosition, wxSize(-1, 90));
+    for (const char* s : {"1280x720", "720x1280", "1920x1080", "1080x1920", "3840x2160", "2160x3840", "7680x4320"}) {
+        m_sizePresets->Append(s);
+    }
+    for (unsigned i = 0; i < 4; ++i) m_sizePresets->Check(i);
+    m_sizePresets->Bind(wxEVT_CHECKLISTBOX, [this](wxCommandEvent&) { UpdateExportLabel(); });
+    right->Add(m_sizePresets, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    m_customSizes = new wxTextCtrl(this, wxID_ANY, "");
+    m_customSizes->SetHint("Custom sizes: WxH, WxH, ...");
+    m_customSizes->Bind(wxEVT_TEXT, [this](wxCommandEvent&) { UpdateExportLabel(); });
+    right->Add(m_customSizes, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    // 4K and up render a band of rows at a time (same pixels, a fraction of the memory)
+    m_stripRender = new wxCheckBox(this, wxID_ANY, "Strip rendering for 4K and up");
+    m_stripRender->SetValue(true);
+    right->Add(m_stripRender, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
+    // Per-stage timings as a Chrome trace next to the outputs
+    m_writeTrace = new wxCheckBox(this, wxID_ANY, "Write pipeline trace");
+    m_writeTrace->SetValue(false);
+    m_writeTrace->Enable(TraceAvailable());
+    right->Add(m_writeTrace, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+
     // Save logs checkbox
     m_saveLogs = new wxCheckBox(this, wxID_ANY, "Save FFmpeg logs");
     m_saveLogs->SetValue(true);
@@ -146,8 +316,19 @@ void MainFrame::BuildUI() {
     // Export button
     m_exportBtn = new wxButton(this, wxID_ANY, "Export (4 sizes)");
     m_exportBtn->Bind(wxEVT_BUTTON, &MainFrame::OnExport, this);
+    UpdateExportLabel();
     right->AddStretchSpacer(1);
     right->Add(m_exportBtn, 0, wxEXPAND|wxALL, 8);
+    m_reencodeBtn = new wxButton(this, wxID_ANY, "Re-encode raw store...");
+    m_reencodeBtn->Bind(wxEVT_BUTTON, &MainFrame::OnReencode, this);
+    right->Add(m_reencodeBtn, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    m_cancelBtn = new wxButton(this, wxID_ANY, "Cancel export");
+    m_cancelBtn->Bind(wxEVT_BUTTON, &MainFrame::OnCancelExport, this);
+    m_cancelBtn->Enable(false);
+    right->Add(m_cancelBtn, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
+    // Live ffmpeg progress (fps, bitrate, ETA) while exporting
+    m_exportStatus = new wxStaticText(this, wxID_ANY, "");
+    right->Add(m_exportStatus, 0, wxEXPAND|wxLEFT|wxRIGHT|wxBOTTOM, 8);
 
     root->Add(left, 2, wxEXPAND);
     root->Add(right, 1, wxEXPAND);
@@ -173,7 +354,138 @@ void MainFrame::RecreateRenderer() {
     m_renderer->SetSpeed(speed);
     m_renderer->SetSizeMin(sizeMin);
     m_renderer->SetSizeMax(sizeMax);
+    m_renderer->SetGlow(CurrentGlow());
+    m_renderer->SetBlendMode(CurrentBlendMode());
+    m_renderer->SetHighPrecision(CurrentHighPrecision());
+    m_renderer->SetMotionBlur(m_motionBlur && m_motionBlur->GetValue());
+    LayerDesc overlay = CurrentOverlay();
+    if (!overlay.effect.empty()) m_renderer->AddLayer(overlay);
     m_renderer->Setup();
+    ApplyOverdrawView();
+    InvalidateLoopCache();
+}
+
+void MainFrame::InvalidateLoopCache() {
+    const int frames = m_renderer ? m_renderer->GetDuration() * m_renderer->GetFPS() : 0;
+    m_loopCache.Reset(frames, size_t(m_previewW) * m_previewH * 4);
+    m_loopPos = 0;
+}
+
+GlowParams MainFrame::CurrentGlow() const {
+    GlowParams g;
+    if (m_glowIntensitySlider) g.intensity = m_glowIntensitySlider->GetValue() / 100.0f;
+    if (m_glowRadiusSlider) g.radius = (float)m_glowRadiusSlider->GetValue();
+    return g;
+}
+
+BlendMode MainFrame::CurrentBlendMode() const {
+    return (m_blendChoice && m_blendChoice->GetSelection() == 2) ? BlendMode::Additive : BlendMode::Over;
+}
+
+bool MainFrame::CurrentHighPrecision() const {
+    return m_blendChoice && m_blendChoice->GetSelection() >= 1;
+}
+
+LayerDesc MainFrame::CurrentOverlay() const {
+    if (!m_overlayChoice || m_overlayChoice->GetSelection() <= 0) return LayerDesc{};
+    LayerDesc d = Renderer::DefaultLayerForEffect(m_overlayChoice->GetStringSelection().ToStdString());
+    d.opacity = m_overlayOpacitySlider ? m_overlayOpacitySlider->GetValue() / 100.0f : 1.0f;
+    d.composite = (m_overlayBlendChoice && m_overlayBlendChoice->GetSelection() == 1) ? BlendMode::Additive : BlendMode::Over;
+    return d;
+}
+
+EncoderSettings MainFrame::CurrentEncoderSettings() const {
+    EncoderSettings es;
+    int codecSel = m_codecChoice ? m_codecChoice->GetSelection() : 0; // 0=VP8 dual, 1=VP9 single, 2=UT RGBA, 3=WebP, 4=atlas, 5=raw
+    es.codec = static_cast<VideoCodec>(std::clamp(codecSel, 0, 5));
+    es.saveLogs = m_saveLogs ? m_saveLogs->GetValue() : true;
+    es.atlasFrameStep = m_atlasStepChoice ? m_atlasStepChoice->GetSelection() + 1 : 1;
+    es.atlasIndexed = m_atlasIndexed ? m_atlasIndexed->GetValue() : false;
+    es.rawLz4 = m_rawLz4 ? m_rawLz4->GetValue() : false;
+    return es;
+}
+
+EncoderBackend MainFrame::CurrentBackend() const {
+    return (m_encoderChoice && m_encoderChoice->GetSelection() == 1) ? EncoderBackend::FFmpegCLI : EncoderBackend::Auto;
+}
+
+ExportLimits MainFrame::CurrentExportLimits() const {
+    ExportLimits limits;
+    switch (m_resourceChoice ? m_resourceChoice->GetSelection() : 0) {
+        case 1: limits.maxThreads = std::max(1, JobWorkerCount() / 2); break;
+        case 2: limits = {4ull << 30, 2, 10}; break;
+        case 3: limits = {1ull << 30, 1, 19}; break;
+        default: break;
+    }
+    return limits;
+}
+
+bool MainFrame::CurrentExportSizes(std::vector<SizeI>& sizes, std::string& err) const {
+    sizes.clear();
+    if (m_sizePresets) {
+        for (unsigned i = 0; i < m_sizePresets->GetCount(); ++i) {
+            std::vector<SizeI> preset;
+            if (m_sizePresets->IsChecked(i) && ParseSizes(m_sizePresets->GetString(i).ToStdString(), preset)) {
+                sizes.push_back(preset[0]);
+            }
+        }
+    }
+    const std::string custom = m_customSizes ? m_customSizes->GetValue().ToStdString() : std::string();
+    if (custom.find_first_not_of(" \t") != std::string::npos) {
+        std::vector<SizeI> extra;
+        if (!ParseSizes(custom, extra)) {
+            err = "Custom sizes must be a list like \"2560x1440, 1440x2560\" (at most 16384 per side)";
+            return false;
+        }
+        for (const SizeI s : extra) {
+            if (std::none_of(sizes.begin(), sizes.end(), [&](const SizeI& o) { return o.w == s.w && o.h == s.h; })) {
+                sizes.push_back(s);
+            }
+        }
+    }
+    if (sizes.empty()) { err = "Select at least one export size"; return false; }
+    return true;
+}
+
+void MainFrame::UpdateExportLabel() {
+    if (!m_exportBtn) return;
+    std::vector<SizeI> sizes;
+    std::string err;
+    if (!CurrentExportSizes(sizes, err)) { m_exportBtn->SetLabel("Export"); return; }
+    m_exportBtn->SetLabel(wxString::Format(sizes.size() == 1 ? "Export (%zu size)" : "Export (%zu sizes)", sizes.size()));
+}
+
+void MainFrame::ApplyEffectDefaults() {
+    if (!m_effectChoice || !m_glowIntensitySlider || !m_glowRadiusSlider) return;
+    std::string effect = m_effectChoice->GetStringSelection().ToStdString();
+    GlowParams g = Renderer::DefaultGlowForEffect(effect);
+    m_glowIntensitySlider->SetValue((int)std::lround(g.intensity * 100.0f));
+    m_glowRadiusSlider->SetValue(std::clamp((int)std::lround(g.radius), 1, 64));
+}
+
+void MainFrame::OnBlendChanged(wxCommandEvent&) {
+    if (!m_renderer) return;
+    m_renderer->SetBlendMode(CurrentBlendMode());
+    m_renderer->SetHighPrecision(CurrentHighPrecision());
+    InvalidateLoopCache();
+}
+
+void MainFrame::OnOverlayChanged(wxCommandEvent&) {
+    // The layer stack is fixed at Setup(); rebuild it
+    RecreateRenderer();
+}
+
+void MainFrame::OnMotionBlurChanged(wxCommandEvent&) {
+    if (!m_renderer || !m_motionBlur) return;
+    m_renderer->SetMotionBlur(m_motionBlur->GetValue());
+    InvalidateLoopCache();
+}
+
+void MainFrame::OnGlowChanged(wxCommandEvent&) {
+    // Post-process only; no need to rebuild the effect state
+    if (!m_renderer) return;
+    m_renderer->SetGlow(CurrentGlow());
+    InvalidateLoopCache();
 }
 
 void MainFrame::OnSizeRangeChanged(wxCommandEvent&) {
@@ -190,196 +502,208 @@ void MainFrame::OnSizeRangeChanged(wxCommandEvent&) {
 }
 
 void MainFrame::OnEffectChanged(wxCommandEvent&) {
+    ApplyEffectDefaults();
     RecreateRenderer();
 }
 
 void MainFrame::OnTimer(wxTimerEvent&) {
     if (!m_renderer) return;
 
-    m_renderer->RenderNextFrame();
-    m_preview->SetFrameBuffer(&m_renderer->GetFrameBuffer(), m_renderer->GetWidth(), m_renderer->GetHeight());
+    const auto t0 = std::chrono::steady_clock::now();
+    // The overdraw view needs the counters of live frames
+    const bool live = m_renderer->GetStats() != nullptr;
+    if (!live && m_loopCache.Complete()) {
+        // Later passes play the loop back from memory
+        m_loopCache.Get(m_loopPos, m_loopFrame);
+        m_loopPos = (m_loopPos + 1) % m_loopCache.FrameCount();
+        m_statsMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_preview->SetFrameBuffer(&m_loopFrame, m_renderer->GetWidth(), m_renderer->GetHeight());
+        UpdatePreviewStats();
+        return;
+    }
+    {
+        // Preview jobs go ahead of everything an export queues
+        JobPriorityScope interactive(JobPriority::Interactive);
+        m_renderer->RenderNextFrame();
+    }
+    const std::vector<uint8_t>* shown = &m_renderer->GetFrameBuffer();
+    if (live) {
+        // A partial pass is no longer contiguous; start over once the view is back
+        if (m_loopCache.Filling() && m_loopCache.Frames() > 0) InvalidateLoopCache();
+    } else if (m_loopCache.Filling()) {
+        // The pass's last second fades into its first, as an export closes the loop,
+        // so playback wraps around without a jump
+        const int n = m_loopCache.FrameCount(), k = m_loopCache.Frames();
+        const int cross = n >= 2 ? std::clamp(m_renderer->GetFPS(), 1, n / 2) : 0;
+        if (cross && k >= n - cross && m_loopCache.Get(k - (n - cross), m_loopHead)) {
+            m_loopFrame.resize(shown->size());
+            CrossfadeBGRA(shown->data(), m_loopHead.data(), m_loopFrame.data(), shown->size(),
+                          float(k - (n - cross) + 1) / float(cross));
+            shown = &m_loopFrame;
+        }
+        m_loopCache.Add(*shown);
+    }
+    m_statsMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (const RenderStats* st = m_renderer->GetStats()) {
+        m_statsPrimitives += st->primitives;
+        m_statsBlended += st->blended;
+        m_statsClipped += st->clipped;
+        for (uint16_t n : st->overdraw) m_statsCovered += n != 0;
+    }
+    m_preview->SetFrameBuffer(shown, m_renderer->GetWidth(), m_renderer->GetHeight());
+    UpdatePreviewStats();
 }
 
-static std::string BuildFileName(const std::string& effectName, int w, int h) {
-    std::string kebab = ToKebabCase(effectName);
-    std::ostringstream oss;
-    oss << kebab << "-" << w << "x" << h << ".webm";
-    return oss.str();
+void MainFrame::UpdatePreviewStats() {
+    const int kFrames = 15; // about half a second at 30 fps
+    if (!m_previewStats || ++m_statsFrames < kFrames) return;
+    std::ostringstream os;
+    os.setf(std::ios::fixed);
+    os.precision(2);
+    os << m_statsMs / m_statsFrames << " ms/frame";
+    if (const RenderStats* st = m_renderer->GetStats()) {
+        const double pixels = (double)st->overdraw.size() * m_statsFrames;
+        os.precision(1);
+        os << "  |  " << (double)m_statsPrimitives / m_statsFrames << " primitives/frame"
+           << "  |  overdraw " << (m_statsCovered ? (double)m_statsBlended / m_statsCovered : 0.0)
+           << "x on " << (pixels > 0 ? 100.0 * m_statsCovered / pixels : 0.0) << "% of pixels"
+           << "  |  " << m_statsClipped / m_statsFrames << " clipped/frame";
+    }
+    os.precision(1);
+    if (m_loopCache.Complete() && !m_renderer->GetStats()) {
+        os << "  |  playing cached loop (" << m_loopCache.Bytes() / (1024.0 * 1024.0) << " MB)";
+    } else if (m_loopCache.Filling()) {
+        os << "  |  caching loop " << m_loopCache.Frames() << "/" << m_loopCache.FrameCount();
+    } else if (m_loopCache.FrameCount() > 0) {
+        os << "  |  loop over the " << m_loopCache.MaxBytes() / (1024 * 1024) << " MB cache, rendering live";
+    }
+    m_previewStats->SetLabel(os.str());
+    m_statsFrames = 0;
+    m_statsMs = 0.0;
+    m_statsPrimitives = m_statsBlended = m_statsCovered = m_statsClipped = 0;
 }
 
 void MainFrame::OnExport(wxCommandEvent&) {
     if (!m_renderer) return;
     m_exportBtn->Enable(false);
-
-    int durationSec = m_renderer->GetDuration();
-    int fps = 30; // fixed export fps
-    std::string effect = m_renderer->GetEffectName();
-    float speed = m_renderer->GetSpeed();
-
-    std::vector<SizeI> sizes = { {1280,720}, {720,1280}, {1920,1080}, {1080,1920} };
+    m_reencodeBtn->Enable(false);
 
     // Ask folder
     wxDirDialog dlg(this, "Select output folder", wxEmptyString, wxDD_DIR_MUST_EXIST);
-    if (dlg.ShowModal() != wxID_OK) { m_exportBtn->Enable(true); return; }
-    wxString outDir = dlg.GetPath();
-
-    // Snapshot preferences before starting background work
-    bool saveLogsPref = m_saveLogs ? m_saveLogs->GetValue() : true;
-    int codecSel = m_codecChoice ? m_codecChoice->GetSelection() : 0; // 0=VP8 dual, 1=VP9 single, 2=UT RGBA
-
-    // Run export off the UI thread
-    auto fut = std::async(std::launch::async, [=]() {
-        for (auto s : sizes) {
-            // Determine output path/extension by codec
-            std::string baseName = BuildFileName(effect, s.w, s.h); // default ends with .webm
-            if (codecSel == 2) { // UT Video RGBA -> .mov
-                auto pos = baseName.rfind(".webm");
-                if (pos != std::string::npos) baseName.replace(pos, 5, ".mov");
-                else baseName += ".mov";
-            }
-            std::string outPath = (wxFileName(outDir, baseName)).GetFullPath().ToStdString();
-            Renderer r(s.w, s.h);
-            r.SetEffect(effect);
-            r.SetDuration(durationSec);
-            r.SetFPS(fps);
-            r.SetDensity(m_densitySlider->GetValue());
-            r.SetSpeed(speed);
-            // Forward particle size settings
-            float sizeMin = 1.0f, sizeMax = 8.0f;
-            if (m_sizeMinSlider) sizeMin = (float)m_sizeMinSlider->GetValue();
-            if (m_sizeMaxSlider) sizeMax = (float)m_sizeMaxSlider->GetValue();
-            r.SetSizeMin(sizeMin);
-            r.SetSizeMax(sizeMax);
-            r.Setup();
-
-            // Prepare frames directory
-            std::filesystem::path framesDir = std::filesystem::path(outDir.ToStdString()) /
-                                              (ToKebabCase(effect) + "-" + std::to_string(s.w) + "x" + std::to_string(s.h) + "_frames");
-            std::error_code ec;
-            std::filesystem::create_directories(framesDir, ec);
-            if (ec) {
-                return std::string("Failed to create frames directory: ") + framesDir.string();
+    if (dlg.ShowModal() != wxID_OK) { m_exportBtn->Enable(true); m_reencodeBtn->Enable(true); return; }
+
+    // Snapshot everything before starting background work
+    ExportJob job;
+    job.outDir = dlg.GetPath().ToStdString();
+    std::string sizeErr;
+    if (!CurrentExportSizes(job.sizes, sizeErr)) {
+        wxMessageBox(sizeErr, "Export sizes", wxOK | wxICON_WARNING, this);
+        m_exportBtn->Enable(true);
+        m_reencodeBtn->Enable(true);
+        return;
+    }
+    job.effect = m_renderer->GetEffectName();
+    job.duration = m_renderer->GetDuration();
+    job.fps = 30; // fixed export fps
+    job.density = m_densitySlider->GetValue();
+    job.speed = m_renderer->GetSpeed();
+    // Forward particle size settings
+    if (m_sizeMinSlider) job.sizeMin = (float)m_sizeMinSlider->GetValue();
+    if (m_sizeMaxSlider) job.sizeMax = (float)m_sizeMaxSlider->GetValue();
+    job.glow = CurrentGlow();
+    job.blend = CurrentBlendMode();
+    job.highPrecision = CurrentHighPrecision();
+    job.motionBlur = m_motionBlur && m_motionBlur->GetValue();
+    job.overlay = CurrentOverlay();
+    // Layered exports are named after the whole stack, e.g. rain-snow-1920x1080.webm
+    job.outName = job.overlay.effect.empty() ? job.effect : job.effect + "-" + job.overlay.effect;
+    job.encoder = CurrentEncoderSettings();
+    job.backend = CurrentBackend();
+    job.parallelSegments = m_parallelSegments ? m_parallelSegments->GetValue() : true;
+    if (m_useCache && m_useCache->GetValue()) {
+        job.cacheDir = (wxStandardPaths::Get().GetUserLocalDataDir() + wxFILE_SEP_PATH + "export-cache").ToStdString();
+        job.cacheFrames = m_cacheFrames && m_cacheFrames->GetValue();
+    }
+    job.resume = m_resume ? m_resume->GetValue() : true;
+    job.limits = CurrentExportLimits();
+    job.stripRows = (m_stripRender && !m_stripRender->GetValue()) ? 0 : job.stripRows;
+    job.trace = m_writeTrace && m_writeTrace->GetValue();
+    AttachExportMonitor(job);
+
+    // Run export on the job pool, below the preview; the result comes back to the UI thread
+    SubmitJob(JobPriority::Background, [this, job]() {
+        std::string err = RunExport(job);
+        wxTheApp->CallAfter([this, err]() {
+            EndExport();
+            if (!err.empty()) {
+                wxMessageBox(err, "Export error", wxOK | wxICON_ERROR, this);
+            } else {
+                wxMessageBox("Export finished!", "Success", wxOK | wxICON_INFORMATION, this);
             }
+        });
+    });
+}
 
-            auto write_png_file = [&](int index, const std::vector<uint8_t>& pngBytes) -> bool {
-                char name[64];
-                std::snprintf(name, sizeof(name), "frame-%06d.png", index);
-                std::filesystem::path fpath = framesDir / name;
-                std::ofstream ofs(fpath, std::ios::binary);
-                if (!ofs) return false;
-                ofs.write(reinterpret_cast<const char*>(pngBytes.data()), static_cast<std::streamsize>(pngBytes.size()));
-                return ofs.good();
-            };
-
-            int totalFrames = durationSec * fps;
-            int cross = std::clamp(fps, 1, totalFrames/2); // up to 1s of crossfade
-            std::vector<std::vector<uint8_t>> firstFrames;
-            firstFrames.reserve(cross);
-
-            for (int i = 0; i < totalFrames; ++i) {
-                r.RenderNextFrame();
-                const auto& buf = r.GetFrameBuffer();
-                if (i < cross) {
-                    firstFrames.emplace_back(buf.begin(), buf.end());
-                }
-
-                std::vector<uint8_t> png;
-                if (i >= totalFrames - cross) {
-                    int k = i - (totalFrames - cross);
-                    float t = float(k + 1) / float(cross);
-                    std::vector<uint8_t> blended(buf.size());
-                    const auto& f0 = firstFrames[k];
-                    const uint8_t* a = buf.data();
-                    const uint8_t* b = f0.data();
-                    for (size_t p = 0; p < buf.size(); p += 4) {
-                        for (int c = 0; c < 4; ++c) {
-                            float va = a[p + c] / 255.0f;
-                            float vb = b[p + c] / 255.0f;
-                            float vo = (1.0f - t) * va + t * vb;
-                            blended[p + c] = (uint8_t)std::clamp(int(vo * 255.0f + 0.5f), 0, 255);
-                        }
-                    }
-                    if (!EncodePNGFromBGRA(blended.data(), s.w, s.h, png)) {
-                        return std::string("Failed to encode PNG (blend) for ") + outPath;
-                    }
-                } else {
-                    if (!EncodePNGFromBGRA(buf.data(), s.w, s.h, png)) {
-                        return std::string("Failed to encode PNG for ") + outPath;
-                    }
-                }
-
-                if (!write_png_file(i+1, png)) {
-                    return std::string("Failed to write PNG file for frame ") + std::to_string(i+1) + " to " + framesDir.string();
-                }
-            }
+void MainFrame::AttachExportMonitor(ExportJob& job) {
+    m_exportCancel = std::make_shared<std::atomic<bool>>(false);
+    job.cancel = m_exportCancel;
+    // ffmpeg that neither reports progress nor takes input for this long is stuck
+    job.encoder.stallTimeoutSec = 120.0;
+    job.encoder.onProgress = [this](const std::string& outPath, const FFmpegProgress& p) {
+        std::ostringstream ss;
+        ss << outPath.substr(outPath.find_last_of("/\\") + 1) << ": frame " << p.frame;
+        if (p.totalFrames > 0) ss << "/" << p.totalFrames;
+        ss << ", " << int(p.fps) << " fps, " << int(p.kbps) << " kbit/s";
+        if (p.etaSec >= 0.0) ss << ", ETA " << int(p.etaSec + 0.5) << " s";
+        const std::string text = ss.str();
+        wxTheApp->CallAfter([this, text]() { if (m_exportStatus) m_exportStatus->SetLabel(text); });
+    };
+    m_cancelBtn->Enable(true);
+    m_exportStatus->SetLabel("");
+}
 
-            // Build ffmpeg command to encode sequence with selected codec
-            auto quote = [](const std::string& s){ return std::string("\"") + s + "\""; };
-            std::string cmd;
-            cmd.reserve(1024);
-            // Build ffmpeg base with selected log level
-            cmd += "ffmpeg -hide_banner ";
-            if (saveLogsPref) cmd += "-loglevel debug "; else cmd += "-loglevel warning ";
-            cmd += "-y ";
-            cmd += "-framerate "; cmd += std::to_string(fps); cmd += ' ';
-            std::string pattern = (framesDir / "frame-%06d.png").string();
-            cmd += "-i "; cmd += quote(pattern); cmd += ' ';
-            if (codecSel == 2) {
-                // UT Video RGBA (lossless), single stream with native alpha in MOV
-                cmd += "-an -vf format=rgba ";
-                cmd += "-c:v utvideo -pix_fmt rgba ";
-            } else if (codecSel == 1) {
-                // VP9 single-stream alpha (yuva420p). Note: some builds may drop alpha.
-                cmd += "-an -vf format=rgba,format=yuva420p ";
-                cmd += "-c:v libvpx-vp9 -pix_fmt yuva420p ";
-                cmd += "-b:v 0 -crf 22 -g 60 -deadline good -cpu-used 4 -auto-alt-ref 1 -lag-in-frames 25 ";
-                cmd += "-metadata:s:v:0 alpha_mode=1 ";
-            } else {
-                // VP8 dual-stream alpha: color in v:0 (yuv420p), alpha in v:1 (gray/yuv420p)
-                // This path is widely supported and guarantees transparency.
-                cmd += "-an -filter_complex \"[0:v]format=rgba,split=2[c][a];[c]format=yuv420p[color];[a]alphaextract,format=gray[alpha]\" ";
-                cmd += "-map [color] -map [alpha] ";
-                cmd += "-c:v:0 libvpx -pix_fmt yuv420p -b:v:0 0 -crf:v:0 22 -g 60 -deadline good -cpu-used 4 -auto-alt-ref 0 ";
-                cmd += "-c:v:1 libvpx -pix_fmt yuv420p -b:v:1 0 -crf:v:1 22 -g 60 -deadline good -cpu-used 4 -auto-alt-ref 0 ";
-                cmd += "-metadata:s:v:0 alpha_mode=1 -metadata:s:v:1 alpha_mode=1 ";
-            }
-            cmd += quote(outPath);
-
-            if (saveLogsPref) {
-                std::string ffstdoutPath = outPath;
-                {
-                    // Place output log next to media file
-                    auto pos = ffstdoutPath.find_last_of('.') ;
-                    if (pos != std::string::npos) ffstdoutPath.insert(pos, "-ffmpeg-output");
-                    else ffstdoutPath += ".ffmpeg-output";
-                    ffstdoutPath += ".txt";
-                }
-                // Redirect stdout/stderr to a text file
-                cmd += " 1>"; cmd += quote(ffstdoutPath); cmd += " 2>&1";
-            }
+void MainFrame::EndExport() {
+    m_exportBtn->Enable(true);
+    m_reencodeBtn->Enable(true);
+    m_cancelBtn->Enable(false);
+    m_exportStatus->SetLabel("");
+    m_exportCancel.reset();
+}
 
-            std::cout << "FFmpeg sequence command: " << cmd << std::endl;
-            int rc = std::system(cmd.c_str());
-            if (rc != 0) {
-                return std::string("ffmpeg failed with code ") + std::to_string(rc) + ". Check ffmpeg-*.log.";
-            }
+void MainFrame::OnCancelExport(wxCommandEvent&) {
+    if (m_exportCancel) *m_exportCancel = true;
+    m_cancelBtn->Enable(false);
+    m_exportStatus->SetLabel("Cancelling...");
+}
 
-            // Cleanup frames on success
-            std::filesystem::remove_all(framesDir, ec);
-        }
-        return std::string();
-    });
+void MainFrame::OnReencode(wxCommandEvent&) {
+    wxFileDialog dlg(this, "Select raw frame stores", wxEmptyString, wxEmptyString,
+                     "GenFX raw frame store (*.gfxraw)|*.gfxraw", wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
+    if (dlg.ShowModal() != wxID_OK) return;
+    wxArrayString files;
+    dlg.GetPaths(files);
+    std::vector<std::string> stores;
+    for (const auto& f : files) stores.push_back(f.ToStdString());
+
+    // Outputs go next to each store, named after it, with the current codec settings
+    ExportJob job;
+    job.encoder = CurrentEncoderSettings();
+    job.backend = CurrentBackend();
+    job.parallelSegments = m_parallelSegments ? m_parallelSegments->GetValue() : true;
+    job.limits = CurrentExportLimits();
 
-    // Poll completion on UI thread
-    std::thread([this, f = std::move(fut)]() mutable {
-        std::string err = f.get();
+    m_exportBtn->Enable(false);
+    m_reencodeBtn->Enable(false);
+    AttachExportMonitor(job);
+    SubmitJob(JobPriority::Background, [this, job, stores]() {
+        std::string err = RunReencode(job, stores);
         wxTheApp->CallAfter([this, err]() {
-            m_exportBtn->Enable(true);
+            EndExport();
             if (!err.empty()) {
-                wxMessageBox(err, "Export error", wxOK | wxICON_ERROR, this);
+                wxMessageBox(err, "Re-encode error", wxOK | wxICON_ERROR, this);
             } else {
-                wxMessageBox("Export finished!", "Success", wxOK | wxICON_INFORMATION, this);
+                wxMessageBox("Re-encode finished!", "Success", wxOK | wxICON_INFORMATION, this);
             }
         });
-    }).detach();
+    });
 }
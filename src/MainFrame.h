@@ -7,9 +7,16 @@
 #include <wx/timer.h>
 #include <wx/dcbuffer.h>
 #include <wx/checkbox.h>
+#include <wx/checklst.h>
+#include <cmath>
+#include "LoopCache.h"
 #include "Renderer.h"
+#include "ResourceGovernor.h"
+#include "VideoEncoder.h"
 #include "Utils.h"
 
+struct ExportJob;
+
 class PreviewPanel : public wxPanel {
 public:
     enum class BackgroundMode { Black=0, Gray=1, White=2 };
@@ -26,6 +33,9 @@ public:
 
     void SetBackgroundMode(BackgroundMode m) { m_bgMode = m; Refresh(false); }
 
+    // Paint the per-pixel blend counts instead of the frame; nullptr shows the frame
+    void SetOverdraw(const RenderStats* stats) { m_stats = stats; Refresh(false); }
+
 private:
     void OnPaint(wxPaintEvent&) {
         wxAutoBufferedPaintDC dc(this);
@@ -46,7 +56,12 @@ private:
         if (!img.HasAlpha()) img.InitAlpha();
         unsigned char* alpha = img.GetAlpha();
         const uint8_t* src = m_buf->data();
-        for (int i = 0; i < m_w * m_h; ++i) {
+        if (m_stats && m_stats->overdraw.size() == size_t(m_w) * m_h) {
+            for (int i = 0; i < m_w * m_h; ++i) {
+                OverdrawColor(m_stats->overdraw[i], data + i * 3);
+                alpha[i] = m_stats->overdraw[i] ? 255 : 0;
+            }
+        } else for (int i = 0; i < m_w * m_h; ++i) {
             uint8_t b = src[i*4 + 0];
             uint8_t g = src[i*4 + 1];
             uint8_t r = src[i*4 + 2];
@@ -73,10 +88,23 @@ private:
     }
     void OnSize(wxSizeEvent&) { Refresh(false); }
 
+    // Log scale so colors mean the same on every frame: 1 blend blue, 2 cyan, 4 green,
+    // 8 yellow, 16 red, 32 or more white
+    static void OverdrawColor(uint16_t n, unsigned char* rgb) {
+        static const unsigned char stops[6][3] = {
+            {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}, {255, 255, 255}};
+        if (n == 0) { rgb[0] = rgb[1] = rgb[2] = 0; return; }
+        const float t = std::min(5.0f, std::log2((float)n));
+        const int i = std::min(4, (int)t);
+        const float f = t - i;
+        for (int c = 0; c < 3; ++c) rgb[c] = (unsigned char)(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f + 0.5f);
+    }
+
     const std::vector<uint8_t>* m_buf{nullptr};
     int m_w{0}, m_h{0};
     Renderer* m_renderer{nullptr};
     BackgroundMode m_bgMode{BackgroundMode::Gray};
+    const RenderStats* m_stats{nullptr};
 };
 
 class MainFrame : public wxFrame {
@@ -87,13 +115,42 @@ private:
     void BuildUI();
     void OnTimer(wxTimerEvent&);
     void OnExport(wxCommandEvent&);
+    void OnReencode(wxCommandEvent&);
+    void OnCancelExport(wxCommandEvent&);
     void OnEffectChanged(wxCommandEvent&);
     void OnDurationChanged(wxCommandEvent&);
     void OnSpeedChanged(wxCommandEvent&);
     void OnDensityChanged(wxCommandEvent&);
     void OnSizeRangeChanged(wxCommandEvent&);
+    void OnGlowChanged(wxCommandEvent&);
+    void OnBlendChanged(wxCommandEvent&);
+    void OnMotionBlurChanged(wxCommandEvent&);
+    void OnOverlayChanged(wxCommandEvent&);
     void OnBgChanged(wxCommandEvent&);
+    void OnOverdrawChanged(wxCommandEvent&);
+    void ApplyOverdrawView();
+    void UpdatePreviewStats();
     void RecreateRenderer();
+    // Drops the cached loop after a change to what the preview shows; the next pass
+    // fills it again starting from the renderer's next frame
+    void InvalidateLoopCache();
+    void ApplyEffectDefaults();
+    GlowParams CurrentGlow() const;
+    BlendMode CurrentBlendMode() const;
+    bool CurrentHighPrecision() const;
+    // Overlay layer from the UI; empty effect name when none is selected
+    LayerDesc CurrentOverlay() const;
+    // Codec options from the UI (size and fps are filled per output)
+    EncoderSettings CurrentEncoderSettings() const;
+    EncoderBackend CurrentBackend() const;
+    ExportLimits CurrentExportLimits() const;
+    // Checked presets plus the custom sizes; false (with a message in 'err') if the
+    // custom list does not parse or nothing is selected
+    bool CurrentExportSizes(std::vector<SizeI>& sizes, std::string& err) const;
+    void UpdateExportLabel();
+    // Cancel flag and live ffmpeg progress for a background export/re-encode
+    void AttachExportMonitor(ExportJob& job);
+    void EndExport();
 
     PreviewPanel* m_preview{nullptr};
     wxChoice* m_effectChoice{nullptr};
@@ -102,14 +159,48 @@ private:
     wxSlider* m_densitySlider{nullptr};
     wxSlider* m_sizeMinSlider{nullptr};
     wxSlider* m_sizeMaxSlider{nullptr};
+    wxSlider* m_glowIntensitySlider{nullptr};
+    wxSlider* m_glowRadiusSlider{nullptr};
+    wxChoice* m_blendChoice{nullptr};
+    wxCheckBox* m_motionBlur{nullptr};
+    wxChoice* m_overlayChoice{nullptr};
+    wxSlider* m_overlayOpacitySlider{nullptr};
+    wxChoice* m_overlayBlendChoice{nullptr};
     wxRadioBox* m_bgRadio{nullptr};
+    wxCheckBox* m_overdrawView{nullptr};
+    wxStaticText* m_previewStats{nullptr};
+    // Preview readout, averaged over a few frames
+    double m_statsMs{0.0};
+    uint64_t m_statsPrimitives{0}, m_statsBlended{0}, m_statsCovered{0}, m_statsClipped{0};
+    int m_statsFrames{0};
     wxChoice* m_codecChoice{nullptr};
+    wxChoice* m_encoderChoice{nullptr};
+    wxCheckBox* m_parallelSegments{nullptr};
+    wxChoice* m_atlasStepChoice{nullptr};
+    wxCheckBox* m_atlasIndexed{nullptr};
+    wxCheckBox* m_rawLz4{nullptr};
+    wxCheckBox* m_useCache{nullptr};
+    wxCheckBox* m_cacheFrames{nullptr};
+    wxCheckBox* m_resume{nullptr};
+    wxChoice* m_resourceChoice{nullptr};
+    wxCheckListBox* m_sizePresets{nullptr};
+    wxTextCtrl* m_customSizes{nullptr};
+    wxCheckBox* m_stripRender{nullptr};
+    wxCheckBox* m_writeTrace{nullptr};
+    wxButton* m_reencodeBtn{nullptr};
     wxButton* m_exportBtn{nullptr};
+    wxButton* m_cancelBtn{nullptr};
+    wxStaticText* m_exportStatus{nullptr};
+    std::shared_ptr<std::atomic<bool>> m_exportCancel;
     wxCheckBox* m_saveLogs{nullptr};
 
     wxTimer m_timer;
     std::unique_ptr<Renderer> m_renderer;
     int m_previewW{640}, m_previewH{360};
+    // The first pass of the preview loop, played back instead of rendered afterwards
+    LoopCache m_loopCache;
+    int m_loopPos{0};
+    std::vector<uint8_t> m_loopFrame, m_loopHead;
 
     wxDECLARE_EVENT_TABLE();
 };
@@ -0,0 +1,177 @@
+#include "PixelKernels.h"
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <math.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #include <intrin.h>
+  #include <immintrin.h>
+  #define GENFX_KERNELS_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #include <cpuid.h>
+  #define GENFX_KERNELS_X86 1
+#endif
+
+// Variants in their own translation units; nullptr when not compiled for this target
+const PixelKernels* PixelKernelsSSE2();
+const PixelKernels* PixelKernelsAVX2();
+const PixelKernels* PixelKernelsAVX512();
+
+namespace scalar {
+#include "PixelKernelsGeneric.inl"
+}
+
+namespace {
+
+const PixelKernels kScalar = {
+    CpuIsa::Scalar,
+    scalar::ResolveAccum16Generic,
+    scalar::CrossfadeGeneric,
+    scalar::CompositeGeneric,
+    scalar::LumaRowGeneric,
+    scalar::ChromaRowGeneric,
+    scalar::AlphaRowGeneric,
+    scalar::Downscale2x2PremulGeneric,
+    scalar::GlowCompositeGeneric,
+};
+
+struct CpuFeatures {
+    bool sse2{false};
+    bool avx2{false};
+    bool avx512{false}; // F + BW
+};
+
+#ifdef GENFX_KERNELS_X86
+void Cpuid(int leaf, int sub, unsigned regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, sub);
+    for (int i = 0; i < 4; ++i) regs[i] = (unsigned)r[i];
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0: which register states the OS saves on context switches
+uint64_t ReadXcr0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+CpuFeatures QueryCpu() {
+    CpuFeatures f;
+#ifdef GENFX_KERNELS_X86
+    unsigned r[4];
+    Cpuid(0, 0, r);
+    const unsigned maxLeaf = r[0];
+    Cpuid(1, 0, r);
+    f.sse2 = (r[3] >> 26) & 1;
+    const bool osxsave = (r[2] >> 27) & 1;
+    const bool avx = (r[2] >> 28) & 1;
+    if (!osxsave || !avx || maxLeaf < 7) return f;
+    const uint64_t xcr0 = ReadXcr0();
+    const bool ymm = (xcr0 & 0x6) == 0x6;     // SSE + AVX state
+    const bool zmm = (xcr0 & 0xE6) == 0xE6;   // + opmask, ZMM0-15 upper halves, ZMM16-31
+    Cpuid(7, 0, r);
+    f.avx2 = ymm && ((r[1] >> 5) & 1);
+    f.avx512 = zmm && f.avx2 && ((r[1] >> 16) & 1) && ((r[1] >> 30) & 1);
+#endif
+    return f;
+}
+
+const CpuFeatures& Cpu() {
+    static const CpuFeatures f = QueryCpu();
+    return f;
+}
+
+std::atomic<const PixelKernels*> g_kernels{nullptr};
+std::atomic<bool> g_forced{false};
+
+} // namespace
+
+const char* CpuIsaName(CpuIsa isa) {
+    switch (isa) {
+        case CpuIsa::Scalar: return "scalar";
+        case CpuIsa::SSE2: return "sse2";
+        case CpuIsa::AVX2: return "avx2";
+        case CpuIsa::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+bool ParseCpuIsa(const std::string& name, CpuIsa& isa) {
+    std::string n;
+    for (char c : name) {
+        if (c != '-' && c != '_') n.push_back((char)std::tolower((unsigned char)c));
+    }
+    for (CpuIsa i : {CpuIsa::Scalar, CpuIsa::SSE2, CpuIsa::AVX2, CpuIsa::AVX512}) {
+        if (n == CpuIsaName(i)) { isa = i; return true; }
+    }
+    return false;
+}
+
+const PixelKernels* KernelsFor(CpuIsa isa) {
+    switch (isa) {
+        case CpuIsa::Scalar: return &kScalar;
+        case CpuIsa::SSE2: return Cpu().sse2 ? PixelKernelsSSE2() : nullptr;
+        case CpuIsa::AVX2: return Cpu().avx2 ? PixelKernelsAVX2() : nullptr;
+        case CpuIsa::AVX512: return Cpu().avx512 ? PixelKernelsAVX512() : nullptr;
+    }
+    return nullptr;
+}
+
+bool CpuIsaSupported(CpuIsa isa) { return KernelsFor(isa) != nullptr; }
+
+CpuIsa DetectCpuIsa() {
+    for (CpuIsa isa : {CpuIsa::AVX512, CpuIsa::AVX2, CpuIsa::SSE2}) {
+        if (CpuIsaSupported(isa)) return isa;
+    }
+    return CpuIsa::Scalar;
+}
+
+const PixelKernels& Kernels() {
+    if (t_pixelKernels) return *t_pixelKernels;
+    if (const PixelKernels* k = g_kernels.load(std::memory_order_acquire)) return *k;
+    CpuIsa isa = DetectCpuIsa();
+    bool forced = false;
+    if (const char* env = std::getenv("GENFX_ISA")) {
+        CpuIsa wanted;
+        if (!ParseCpuIsa(env, wanted)) {
+            std::cerr << "GENFX_ISA=" << env << " is not one of scalar, sse2, avx2, avx512; using " << CpuIsaName(isa) << std::endl;
+        } else if (!CpuIsaSupported(wanted)) {
+            std::cerr << "GENFX_ISA=" << env << " is not supported on this CPU or build; using " << CpuIsaName(isa) << std::endl;
+        } else {
+            isa = wanted;
+            forced = true;
+        }
+    }
+    const PixelKernels* expected = nullptr;
+    if (g_kernels.compare_exchange_strong(expected, KernelsFor(isa))) g_forced = forced;
+    return *g_kernels.load(std::memory_order_acquire);
+}
+
+bool SelectCpuIsa(CpuIsa isa, std::string& err) {
+    const PixelKernels* k = KernelsFor(isa);
+    if (!k) {
+        err = std::string("Instruction set ") + CpuIsaName(isa) + " is not supported on this CPU or build";
+        return false;
+    }
+    g_kernels.store(k, std::memory_order_release);
+    g_forced = true;
+    return true;
+}
+
+std::string CpuIsaReport() {
+    const CpuIsa active = Kernels().isa;
+    std::string s = std::string("pixel kernels ") + CpuIsaName(active) + " (best available " + CpuIsaName(DetectCpuIsa());
+    if (g_forced) s += ", forced";
+    return s + ")";
+}
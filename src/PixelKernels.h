@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Raster.h"
+
+// Frame-sized pixel kernels, built once per instruction set (PixelKernels*.cpp, each
+// compiled with its own -m/arch flags) and picked once at startup through CPUID, so
+// the binary uses AVX2/AVX-512 where available and still runs on SSE2-only machines.
+// Every variant produces the same bytes as the scalar one; genfx_golden checks it.
+//
+// The choice can be forced with GENFX_ISA=scalar|sse2|avx2|avx512 in the environment
+// (read on first use) or SelectCpuIsa() (the bench tools' --isa).
+
+enum class CpuIsa { Scalar, SSE2, AVX2, AVX512 };
+
+struct PixelKernels {
+    CpuIsa isa;
+    // Premultiplied 16-bit accumulation -> straight-alpha BGRA8 (unpremultiply)
+    void (*resolveAccum16)(const uint16_t* accum, uint8_t* bgra, size_t pixels);
+    // out = a*(1-t) + b*t per byte
+    void (*crossfade)(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t bytes, float t);
+    // See CompositeLayerBGRA()
+    void (*composite)(uint8_t* dst, const uint8_t* src, size_t pixels, float opacity, BlendMode mode);
+    // BT.601 limited-range luma of one BGRA row
+    void (*lumaRow)(const uint8_t* bgra, uint8_t* y, int width);
+    // U and V of one chroma row from the two BGRA rows it covers (width in pixels)
+    void (*chromaRow)(const uint8_t* row0, const uint8_t* row1, uint8_t* u, uint8_t* v, int width);
+    // Alpha channel of one BGRA row
+    void (*alphaRow)(const uint8_t* bgra, uint8_t* a, int width);
+    // Premultiply and 2x2 box-downscale two BGRA rows into (width+1)/2 pixels, each
+    // channel the sum of four (0..1020); odd edges repeat the last column
+    void (*downscale2x2Premul)(const uint8_t* row0, const uint8_t* row1, uint16_t* out, int width);
+    // Lays a premultiplied glow over BGRA pixels, in fixed point. Glow channels are 64x
+    // the 0..255 value (0..16320, GlowPass's 2x2 sum times its 4x4 upsample weights);
+    // gain = intensity * 1020 in 8.8 fixed point
+    void (*glowComposite)(uint8_t* bgra, const uint16_t* glow, size_t pixels, uint32_t gain);
+};
+
+const char* CpuIsaName(CpuIsa isa);
+// Accepts the names above, case-insensitive
+bool ParseCpuIsa(const std::string& name, CpuIsa& isa);
+// Compiled in and supported by this CPU and OS
+bool CpuIsaSupported(CpuIsa isa);
+// Best supported instruction set
+CpuIsa DetectCpuIsa();
+
+// Per-thread override, see ScopedKernels
+inline thread_local const PixelKernels* t_pixelKernels = nullptr;
+
+// Active kernels; the first call selects them (GENFX_ISA, else DetectCpuIsa())
+const PixelKernels& Kernels();
+// Switch the active kernels, e.g. to benchmark or verify one variant
+bool SelectCpuIsa(CpuIsa isa, std::string& err);
+// Kernels of one instruction set, nullptr when unsupported
+const PixelKernels* KernelsFor(CpuIsa isa);
+// One line for logs: active variant, what the CPU offers, and whether it was forced
+std::string CpuIsaReport();
+
+// Pins the calling thread (not the ParallelFor workers it starts) to one variant while
+// in scope; nullptr keeps the current choice. The reference renderer runs on one
+// thread with the scalar kernels.
+class ScopedKernels {
+public:
+    explicit ScopedKernels(const PixelKernels* kernels) : m_saved(t_pixelKernels) {
+        if (kernels) t_pixelKernels = kernels;
+    }
+    ~ScopedKernels() { t_pixelKernels = m_saved; }
+    ScopedKernels(const ScopedKernels&) = delete;
+    ScopedKernels& operator=(const ScopedKernels&) = delete;
+private:
+    const PixelKernels* m_saved;
+};
@@ -0,0 +1,60 @@
+// AVX2 variants (see PixelKernels.h). Built with -mavx2 or /arch:AVX2; only called
+// after CPUID confirmed AVX2.
+#include "PixelKernels.h"
+#include <math.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace avx2 {
+#include "PixelKernelsGeneric.inl"
+
+// 8 pixels per iteration, one per 128-bit lane; same float steps as the SSE2 variant
+static void ResolveAccum16(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    size_t i = 0;
+    const __m256 k255 = _mm256_set1_ps(255.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 alphaScale = _mm256_set1_ps(255.0f / 65535.0f);
+    // packs/packus interleave the lanes: pixels come out as 0,2,4,6 | 1,3,5,7
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    auto unpremul = [&](const uint16_t* p) -> __m256i {
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+        __m256 a = _mm256_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 s = _mm256_div_ps(k255, _mm256_max_ps(a, one));
+        __m256 c = _mm256_mul_ps(_mm256_min_ps(f, a), s);
+        __m256 al = _mm256_mul_ps(f, alphaScale);
+        return _mm256_cvtps_epi32(_mm256_blend_ps(c, al, 0x88));
+    };
+    for (; i + 8 <= pixels; i += 8) {
+        const uint16_t* src = accum + i * 4;
+        const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 16));
+        __m256i out;
+        if (_mm256_testz_si256(_mm256_or_si256(v0, v1), _mm256_or_si256(v0, v1))) {
+            out = _mm256_setzero_si256(); // fully transparent run
+        } else {
+            const __m256i lo = _mm256_packs_epi32(unpremul(src), unpremul(src + 8));
+            const __m256i hi = _mm256_packs_epi32(unpremul(src + 16), unpremul(src + 24));
+            out = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(bgra + i * 4), out);
+    }
+    ResolveAccum16Generic(accum + i * 4, bgra + i * 4, pixels - i);
+}
+
+static const PixelKernels kTable = {
+    CpuIsa::AVX2,
+    ResolveAccum16,
+    CrossfadeGeneric,
+    CompositeGeneric,
+    LumaRowGeneric,
+    ChromaRowGeneric,
+    AlphaRowGeneric,
+    Downscale2x2PremulGeneric,
+    GlowCompositeGeneric,
+};
+} // namespace avx2
+
+const PixelKernels* PixelKernelsAVX2() { return &avx2::kTable; }
+#else
+const PixelKernels* PixelKernelsAVX2() { return nullptr; }
+#endif
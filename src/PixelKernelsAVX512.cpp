@@ -0,0 +1,60 @@
+// AVX-512 (F + BW) variants (see PixelKernels.h). Built with -mavx512f -mavx512bw or
+// /arch:AVX512; only called after CPUID and XCR0 confirmed both.
+#include "PixelKernels.h"
+#include <math.h>
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#include <immintrin.h>
+
+namespace avx512 {
+#include "PixelKernelsGeneric.inl"
+
+// 16 pixels per iteration, one per 128-bit lane; same float steps as the SSE2 variant
+static void ResolveAccum16(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    size_t i = 0;
+    const __m512 k255 = _mm512_set1_ps(255.0f);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 alphaScale = _mm512_set1_ps(255.0f / 65535.0f);
+    // After packs/packus lane k holds pixels k, 4+k, 8+k, 12+k
+    const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    auto unpremul = [&](const uint16_t* p) -> __m512i {
+        __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))));
+        __m512 a = _mm512_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+        __m512 s = _mm512_div_ps(k255, _mm512_max_ps(a, one));
+        __m512 c = _mm512_mul_ps(_mm512_min_ps(f, a), s);
+        __m512 al = _mm512_mul_ps(f, alphaScale);
+        return _mm512_cvtps_epi32(_mm512_mask_blend_ps(0x8888, c, al));
+    };
+    for (; i + 16 <= pixels; i += 16) {
+        const uint16_t* src = accum + i * 4;
+        const __m512i v0 = _mm512_loadu_si512(src);
+        const __m512i v1 = _mm512_loadu_si512(src + 32);
+        __m512i out;
+        if (_mm512_test_epi64_mask(_mm512_or_si512(v0, v1), _mm512_or_si512(v0, v1)) == 0) {
+            out = _mm512_setzero_si512(); // fully transparent run
+        } else {
+            const __m512i lo = _mm512_packs_epi32(unpremul(src), unpremul(src + 16));
+            const __m512i hi = _mm512_packs_epi32(unpremul(src + 32), unpremul(src + 48));
+            out = _mm512_permutexvar_epi32(order, _mm512_packus_epi16(lo, hi));
+        }
+        _mm512_storeu_si512(bgra + i * 4, out);
+    }
+    ResolveAccum16Generic(accum + i * 4, bgra + i * 4, pixels - i);
+}
+
+static const PixelKernels kTable = {
+    CpuIsa::AVX512,
+    ResolveAccum16,
+    CrossfadeGeneric,
+    CompositeGeneric,
+    LumaRowGeneric,
+    ChromaRowGeneric,
+    AlphaRowGeneric,
+    Downscale2x2PremulGeneric,
+    GlowCompositeGeneric,
+};
+} // namespace avx512
+
+const PixelKernels* PixelKernelsAVX512() { return &avx512::kTable; }
+#else
+const PixelKernels* PixelKernelsAVX512() { return nullptr; }
+#endif
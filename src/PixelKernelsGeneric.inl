@@ -0,0 +1,146 @@
+// Portable pixel kernels, included into one namespace per instruction set by
+// PixelKernels*.cpp, so the compiler vectorizes the same loops for SSE2, AVX2 and
+// AVX-512. All variants must produce identical bytes, so:
+//   - keep the arithmetic and its order exactly as written (those files are built
+//     with -ffp-contract=off: no FMA contraction);
+//   - use the K* helpers instead of std:: templates. Template instances are merged
+//     across translation units by the linker, which could hand AVX-512 code to
+//     every caller.
+
+static inline int KMin(int a, int b) { return a < b ? a : b; }
+static inline int KMax(int a, int b) { return a < b ? b : a; }
+static inline uint32_t KMinU(uint32_t a, uint32_t b) { return a < b ? a : b; }
+static inline int KClamp(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+static inline float KMinF(float a, float b) { return b < a ? b : a; }
+static inline float KMaxF(float a, float b) { return a < b ? b : a; }
+
+// Same math as the SSE2 unpremultiply: 255/A as a float reciprocal, rounded to
+// nearest-even like cvtps2dq. Vector variants use this for their tails.
+static void ResolveAccum16Generic(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i, accum += 4, bgra += 4) {
+        const float a = accum[3];
+        const float s = 255.0f / KMaxF(a, 1.0f);
+        for (int c = 0; c < 3; ++c) bgra[c] = (uint8_t)nearbyintf(KMinF((float)accum[c], a) * s);
+        bgra[3] = (uint8_t)nearbyintf(a * (255.0f / 65535.0f));
+    }
+}
+
+static void CrossfadeGeneric(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t bytes, float t) {
+    const float ka = 1.0f - t;
+    for (size_t p = 0; p < bytes; ++p) {
+        const float vo = ka * (a[p] / 255.0f) + t * (b[p] / 255.0f);
+        out[p] = (uint8_t)KClamp(int(vo * 255.0f + 0.5f), 0, 255);
+    }
+}
+
+static void CompositeGeneric(uint8_t* dst, const uint8_t* src, size_t pixels, float opacity, BlendMode mode) {
+    const int op = KClamp((int)lroundf(opacity * 255.0f), 0, 255);
+    if (op == 0) return;
+    for (size_t i = 0; i < pixels; ++i, src += 4, dst += 4) {
+        if (src[3] == 0) continue; // transparent overlay pixels leave the base untouched
+        const int sa8 = (src[3] * op + 127) / 255;
+        if (sa8 == 0) continue;
+        const float sa = sa8 / 255.0f;
+        const float da = dst[3] / 255.0f;
+        float outA, c[3];
+        if (mode == BlendMode::Additive) {
+            outA = sa + da - sa * da;
+            for (int k = 0; k < 3; ++k) c[k] = KMinF(src[k] * sa + dst[k] * da, outA * 255.0f);
+        } else {
+            if (dst[3] == 0 || sa8 == 255) {
+                dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = (uint8_t)sa8;
+                continue;
+            }
+            outA = sa + da * (1.0f - sa);
+            for (int k = 0; k < 3; ++k) c[k] = src[k] * sa + dst[k] * da * (1.0f - sa);
+        }
+        const float inv = 1.0f / outA;
+        for (int k = 0; k < 3; ++k) dst[k] = (uint8_t)KClamp(int(c[k] * inv + 0.5f), 0, 255);
+        dst[3] = (uint8_t)KClamp(int(outA * 255.0f + 0.5f), 0, 255);
+    }
+}
+
+static void LumaRowGeneric(const uint8_t* bgra, uint8_t* y, int width) {
+    for (int x = 0; x < width; ++x) {
+        const uint8_t* p = bgra + x * 4;
+        y[x] = (uint8_t)(((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16);
+    }
+}
+
+static inline void ChromaPixel(const uint8_t* r0, const uint8_t* r1, int xa, int xb, uint8_t* u, uint8_t* v) {
+    const int b = r0[xa] + r0[xb] + r1[xa] + r1[xb];
+    const int g = r0[xa+1] + r0[xb+1] + r1[xa+1] + r1[xb+1];
+    const int r = r0[xa+2] + r0[xb+2] + r1[xa+2] + r1[xb+2];
+    // Sums of four: fold the /4 into the final shift
+    *u = (uint8_t)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+    *v = (uint8_t)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+}
+
+static void ChromaRowGeneric(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v, int width) {
+    const int pairs = width / 2;
+    for (int cx = 0; cx < pairs; ++cx) ChromaPixel(r0, r1, cx * 8, cx * 8 + 4, u + cx, v + cx);
+    if (width & 1) ChromaPixel(r0, r1, pairs * 8, pairs * 8, u + pairs, v + pairs);
+}
+
+static void AlphaRowGeneric(const uint8_t* bgra, uint8_t* a, int width) {
+    for (int x = 0; x < width; ++x) a[x] = bgra[x * 4 + 3];
+}
+
+// (x + 127) / 255 for x <= 255*255, without the divide (checked exhaustively)
+static inline uint32_t KDiv255(uint32_t x) {
+    const uint32_t t = x + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline void Downscale2x2Pixel(const uint8_t* a, const uint8_t* b, const uint8_t* c, const uint8_t* d, uint16_t* out) {
+    const uint32_t aa = a[3], ba = b[3], ca = c[3], da = d[3];
+    for (int k = 0; k < 3; ++k) {
+        out[k] = (uint16_t)(KDiv255(a[k] * aa) + KDiv255(b[k] * ba) + KDiv255(c[k] * ca) + KDiv255(d[k] * da));
+    }
+    out[3] = (uint16_t)(aa + ba + ca + da);
+}
+
+static void Downscale2x2PremulGeneric(const uint8_t* r0, const uint8_t* r1, uint16_t* out, int width) {
+    const int pairs = width / 2;
+    for (int hx = 0; hx < pairs; ++hx) {
+        Downscale2x2Pixel(r0 + hx * 8, r0 + hx * 8 + 4, r1 + hx * 8, r1 + hx * 8 + 4, out + hx * 4);
+    }
+    if (width & 1) {
+        const int x = (width - 1) * 4;
+        Downscale2x2Pixel(r0 + x, r0 + x, r1 + x, r1 + x, out + pairs * 4);
+    }
+}
+
+// round(2^24 / a): the glow composite unpremultiplies with a multiply instead of a divide
+struct KRecipTable {
+    uint32_t v[256];
+    constexpr KRecipTable() : v() {
+        for (uint32_t a = 1; a < 256; ++a) v[a] = ((1u << 24) + a / 2) / a;
+    }
+};
+static constexpr KRecipTable kRecip{};
+
+// Integer "over" of the upsampled glow: colors in premultiplied units of 255*255 = 1.0,
+// glow alpha in units of 65536 = 1.0 so blending it needs a shift rather than a divide.
+// Branch-free so it vectorizes; where the glow is zero it returns the pixel as it was
+// (a transparent pixel is left alone, an opaque one unpremultiplies to itself).
+// Overflow-free in 32 bits: colors are capped at the output alpha before the
+// reciprocal multiply, so (a*255) * round(2^24/a) + 2^23 stays below 2^32.
+static void GlowCompositeGeneric(uint8_t* bgra, const uint16_t* glow, size_t pixels, uint32_t gain) {
+    const uint32_t gainA = (gain * 66051u + 32768) >> 16; // gain * 65536/65025
+    for (size_t i = 0; i < pixels; ++i, bgra += 4, glow += 4) {
+        const uint32_t sa8 = bgra[3];
+        const uint32_t gA = KMinU((glow[3] * gainA + 128) >> 8, 65536u);
+        const uint32_t a8 = sa8 + (((255u - sa8) * gA + 32768) >> 16);
+        const uint32_t cap = a8 * 255, r = kRecip.v[a8];
+        const uint32_t keep = a8 == 0 ? 0xFFu : 0u; // all ones where the pixel stays as it was
+        const uint32_t c0 = bgra[0], c1 = bgra[1], c2 = bgra[2];
+        const uint32_t v0 = (KMinU(c0 * sa8 + ((glow[0] * gain + 128) >> 8), cap) * r + (1u << 23)) >> 24;
+        const uint32_t v1 = (KMinU(c1 * sa8 + ((glow[1] * gain + 128) >> 8), cap) * r + (1u << 23)) >> 24;
+        const uint32_t v2 = (KMinU(c2 * sa8 + ((glow[2] * gain + 128) >> 8), cap) * r + (1u << 23)) >> 24;
+        bgra[0] = (uint8_t)((v0 & ~keep) | (c0 & keep));
+        bgra[1] = (uint8_t)((v1 & ~keep) | (c1 & keep));
+        bgra[2] = (uint8_t)((v2 & ~keep) | (c2 & keep));
+        bgra[3] = (uint8_t)a8;
+    }
+}
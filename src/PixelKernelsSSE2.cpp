@@ -0,0 +1,62 @@
+// SSE2 variants (see PixelKernels.h). Built with -msse2 where the compiler needs it.
+#include "PixelKernels.h"
+#include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace sse2 {
+#include "PixelKernelsGeneric.inl"
+
+// 4 pixels per iteration, one per float vector
+static void ResolveAccum16(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    size_t i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k255 = _mm_set1_ps(255.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 alphaScale = _mm_set_ps(255.0f / 65535.0f, 0.0f, 0.0f, 0.0f);
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    auto unpremul = [&](__m128i p) -> __m128i {
+        __m128 f = _mm_cvtepi32_ps(p);
+        __m128 a = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 s = _mm_div_ps(k255, _mm_max_ps(a, one));
+        __m128 c = _mm_mul_ps(_mm_min_ps(f, a), s);
+        __m128 al = _mm_mul_ps(f, alphaScale);
+        __m128 v = _mm_or_ps(_mm_and_ps(alphaLane, al), _mm_andnot_ps(alphaLane, c));
+        return _mm_cvtps_epi32(v);
+    };
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accum + i * 4));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accum + i * 4 + 8));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_or_si128(v0, v1), zero)) == 0xFFFF) {
+            // Fully transparent run (the common case for particle effects)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bgra + i * 4), zero);
+            continue;
+        }
+        __m128i p0 = unpremul(_mm_unpacklo_epi16(v0, zero));
+        __m128i p1 = unpremul(_mm_unpackhi_epi16(v0, zero));
+        __m128i p2 = unpremul(_mm_unpacklo_epi16(v1, zero));
+        __m128i p3 = unpremul(_mm_unpackhi_epi16(v1, zero));
+        __m128i lo = _mm_packs_epi32(p0, p1);
+        __m128i hi = _mm_packs_epi32(p2, p3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bgra + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    ResolveAccum16Generic(accum + i * 4, bgra + i * 4, pixels - i);
+}
+
+static const PixelKernels kTable = {
+    CpuIsa::SSE2,
+    ResolveAccum16,
+    CrossfadeGeneric,
+    CompositeGeneric,
+    LumaRowGeneric,
+    ChromaRowGeneric,
+    AlphaRowGeneric,
+    Downscale2x2PremulGeneric,
+    GlowCompositeGeneric,
+};
+} // namespace sse2
+
+const PixelKernels* PixelKernelsSSE2() { return &sse2::kTable; }
+#else
+const PixelKernels* PixelKernelsSSE2() { return nullptr; }
+#endif
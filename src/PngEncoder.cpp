@@ -1,16 +1,15 @@
 #include "PngEncoder.h"
 #include <wx/image.h>
 #include <wx/mstream.h>
+#include <png.h>
 #include <algorithm>
 
 bool EncodePNGFromBGRA(const uint8_t* bgra, int width, int height, std::vector<uint8_t>& outPng) {
     if (!bgra || width <= 0 || height <= 0) return false;
 
-    static bool s_inited = false;
-    if (!s_inited) {
-        wxInitAllImageHandlers();
-        s_inited = true;
-    }
+    // Exports call this from several worker threads; a function-local static initialises once
+    static const bool s_inited = (wxInitAllImageHandlers(), true);
+    (void)s_inited;
 
     // wxImage expects RGB data (3 bytes) and an optional separate alpha array
     wxImage img(width, height, /*clear=*/false);
@@ -48,3 +47,40 @@ bool EncodePNGFromBGRA(const uint8_t* bgra, int width, int height, std::vector<u
     memOut.CopyTo(outPng.data(), sz);
     return true;
 }
+
+bool EncodeIndexedPNG(const uint8_t* indices, int width, int height, const uint8_t* paletteRGBA, int paletteSize,
+                      std::vector<uint8_t>& outPng) {
+    if (!indices || width <= 0 || height <= 0 || paletteSize < 1 || paletteSize > 256) return false;
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!png) return false;
+    png_infop info = png_create_info_struct(png);
+    if (!info) { png_destroy_write_struct(&png, nullptr); return false; }
+    outPng.clear();
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+    png_set_write_fn(png, &outPng, [](png_structp p, png_bytep data, png_size_t len) {
+        auto* out = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(p));
+        out->insert(out->end(), data, data + len);
+    }, nullptr);
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_color plte[256];
+    png_byte trns[256];
+    for (int i = 0; i < paletteSize; ++i) {
+        plte[i].red = paletteRGBA[i * 4 + 0];
+        plte[i].green = paletteRGBA[i * 4 + 1];
+        plte[i].blue = paletteRGBA[i * 4 + 2];
+        trns[i] = paletteRGBA[i * 4 + 3];
+    }
+    png_set_PLTE(png, info, plte, paletteSize);
+    png_set_tRNS(png, info, trns, paletteSize, nullptr);
+    png_write_info(png, info);
+    for (int y = 0; y < height; ++y) {
+        png_write_row(png, const_cast<png_bytep>(indices + size_t(y) * width));
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+    return true;
+}
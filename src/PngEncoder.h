@@ -5,3 +5,8 @@
 // Encode a BGRA buffer (width*height*4) into a PNG byte vector.
 // Returns true on success. On success, 'outPng' is filled with the PNG file bytes.
 bool EncodePNGFromBGRA(const uint8_t* bgra, int width, int height, std::vector<uint8_t>& outPng);
+
+// Encode 8-bit palette indices (width*height) into a PNG byte vector. 'paletteRGBA'
+// holds 'paletteSize' (1..256) RGBA entries; alpha goes into a tRNS chunk.
+bool EncodeIndexedPNG(const uint8_t* indices, int width, int height, const uint8_t* paletteRGBA, int paletteSize,
+                      std::vector<uint8_t>& outPng);
@@ -0,0 +1,341 @@
+#include "Raster.h"
+#include "PixelKernels.h"
+#include <cmath>
+#include <initializer_list>
+
+// Counts the part of an inclusive bounding box that falls outside the canvas
+static inline void clipStats(Canvas& cv, int x0, int y0, int x1, int y1) {
+#ifdef GENFX_RENDER_STATS
+    if (!cv.stats || x1 < x0 || y1 < y0) return;
+    const long long all = (long long)(x1 - x0 + 1) * (y1 - y0 + 1);
+    const long long vw = std::max(0, std::min(x1, cv.width - 1) - std::max(x0, 0) + 1);
+    const long long vh = std::max(0, std::min(y1, cv.height - 1) - std::max(y0, 0) + 1);
+    statsClipped(cv, all - vw * vh);
+#else
+    (void)cv; (void)x0; (void)y0; (void)x1; (void)y1;
+#endif
+}
+
+// Past the limit, what was recorded is drawn and the frame goes on drawing immediately
+static void checkRecordLimit(Canvas& cv) {
+    if (!cv.recordLimit || ++cv.recorded < cv.recordLimit) return;
+    DrawList* list = cv.record;
+    cv.record = nullptr;
+    ReplayDrawList(*list, cv);
+    list->clear();
+}
+
+static void recordCommand(Canvas& cv, DrawCommand::Type type, uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+                          std::initializer_list<float> p, int thickness = 1, int segments = 0) {
+    DrawCommand c{};
+    c.type = type;
+    c.r = r; c.g = g; c.b = b; c.a = a;
+    c.thickness = (uint8_t)std::clamp(thickness, 0, 255);
+    c.segments = (uint16_t)std::clamp(segments, 0, 65535);
+    std::copy(p.begin(), p.end(), c.p);
+    cv.record->push_back(c);
+    checkRecordLimit(cv);
+}
+
+void recordPixel(Canvas& cv, int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    // Runs along a row in one color (vignettes, fills done pixel by pixel) share a command
+    DrawList& list = *cv.record;
+    if (!list.empty()) {
+        DrawCommand& last = list.back();
+        if (last.type == DrawCommand::Pixels && last.p[1] == (float)y && last.p[0] + last.p[2] == (float)x &&
+            last.r == r && last.g == g && last.b == b && last.a == a) {
+            last.p[2] += 1.0f;
+            checkRecordLimit(cv);
+            return;
+        }
+    }
+    DrawCommand c{};
+    c.type = DrawCommand::Pixels;
+    c.r = r; c.g = g; c.b = b; c.a = a;
+    c.p[0] = (float)x; c.p[1] = (float)y; c.p[2] = 1.0f;
+    list.push_back(c);
+    checkRecordLimit(cv);
+}
+
+static void circle(Canvas& cv, float cx, float cy, float radius,
+                   uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    clipStats(cv, (int)std::floor(cx - radius), (int)std::floor(cy - radius), (int)std::ceil(cx + radius), (int)std::ceil(cy + radius));
+    int minx = std::max(0, (int)std::floor(cx - radius));
+    int maxx = std::min(cv.width-1, (int)std::ceil(cx + radius));
+    int miny = std::max(cv.top, (int)std::floor(cy - radius));
+    int maxy = std::min(cv.rowEnd()-1, (int)std::ceil(cy + radius));
+    float r2 = radius*radius;
+    for (int y=miny; y<=maxy; ++y) {
+        for (int x=minx; x<=maxx; ++x) {
+            float dx = x + 0.5f - cx;
+            float dy = y + 0.5f - cy;
+            if (dx*dx + dy*dy <= r2) {
+                blendPixelBGRA(cv, x, y, r, g, b, a);
+            }
+        }
+    }
+}
+
+void fillCircleBGRA(Canvas& cv, float cx, float cy, float radius,
+                    uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (cv.record) { recordCommand(cv, DrawCommand::Circle, r, g, b, a, {cx, cy, radius}); return; }
+    statsPrimitive(cv);
+    circle(cv, cx, cy, radius, r, g, b, a);
+}
+
+void fillRectBGRA(Canvas& cv, int x, int y, int rw, int rh,
+                  uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (cv.record) { recordCommand(cv, DrawCommand::Rect, r, g, b, a, {(float)x, (float)y, (float)rw, (float)rh}); return; }
+    statsPrimitive(cv);
+    clipStats(cv, x, y, x + rw - 1, y + rh - 1);
+    int x0 = std::max(0, x);
+    int y0 = std::max(cv.top, y);
+    int x1 = std::min(cv.width, x + rw);
+    int y1 = std::min(cv.rowEnd(), y + rh);
+    for (int yy = y0; yy < y1; ++yy) {
+        for (int xx = x0; xx < x1; ++xx) {
+            blendPixelBGRA(cv, xx, yy, r, g, b, a);
+        }
+    }
+}
+
+static void line(Canvas& cv, float x0, float y0, float x1, float y1,
+                 uint8_t r, uint8_t g, uint8_t b, uint8_t a, int thickness) {
+    float dx = x1 - x0, dy = y1 - y0;
+    float len = std::sqrt(dx*dx + dy*dy);
+    int steps = (int)std::max(1.0f, len);
+    for (int i = 0; i <= steps; ++i) {
+        float t = (steps==0)?0.0f: (float)i / (float)steps;
+        float x = x0 + dx * t;
+        float y = y0 + dy * t;
+        int ix = (int)std::round(x);
+        int iy = (int)std::round(y);
+        for (int oy = -thickness/2; oy <= thickness/2; ++oy) {
+            for (int ox = -thickness/2; ox <= thickness/2; ++ox) {
+                blendPixelBGRA(cv, ix + ox, iy + oy, r, g, b, a);
+            }
+        }
+    }
+}
+
+void drawLineBGRA(Canvas& cv, float x0, float y0, float x1, float y1,
+                  uint8_t r, uint8_t g, uint8_t b, uint8_t a, int thickness) {
+    if (cv.record) { recordCommand(cv, DrawCommand::Line, r, g, b, a, {x0, y0, x1, y1}, thickness); return; }
+    statsPrimitive(cv);
+    line(cv, x0, y0, x1, y1, r, g, b, a, thickness);
+}
+
+void drawQuadBezierBGRA(Canvas& cv, float x0, float y0, float cx, float cy, float x1, float y1,
+                        uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+                        int thickness, int segments) {
+    if (cv.record) { recordCommand(cv, DrawCommand::QuadBezier, r, g, b, a, {x0, y0, cx, cy, x1, y1}, thickness, segments); return; }
+    statsPrimitive(cv);
+    float px = x0, py = y0;
+    for (int i=1; i<=segments; ++i) {
+        float t = (float)i / (float)segments;
+        float it = 1.0f - t;
+        float x = it*it*x0 + 2*it*t*cx + t*t*x1;
+        float y = it*it*y0 + 2*it*t*cy + t*t*y1;
+        line(cv, px, py, x, y, r, g, b, a, thickness);
+        px = x; py = y;
+    }
+}
+
+void fillCapsuleBGRA(Canvas& cv, float x0, float y0, float x1, float y1, float radius,
+                     uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (cv.record) { recordCommand(cv, DrawCommand::Capsule, r, g, b, a, {x0, y0, x1, y1, radius}); return; }
+    statsPrimitive(cv);
+    const float dx = x1 - x0, dy = y1 - y0;
+    const float dd = dx*dx + dy*dy;
+    if (dd < 0.0625f) { // under a quarter pixel of motion: plain disc
+        circle(cv, x1, y1, radius, r, g, b, a);
+        return;
+    }
+    clipStats(cv, (int)std::floor(std::min(x0, x1) - radius), (int)std::floor(std::min(y0, y1) - radius),
+              (int)std::ceil(std::max(x0, x1) + radius), (int)std::ceil(std::max(y0, y1) + radius));
+    int minx = std::max(0, (int)std::floor(std::min(x0, x1) - radius));
+    int maxx = std::min(cv.width-1, (int)std::ceil(std::max(x0, x1) + radius));
+    int miny = std::max(cv.top, (int)std::floor(std::min(y0, y1) - radius));
+    int maxy = std::min(cv.rowEnd()-1, (int)std::ceil(std::max(y0, y1) + radius));
+    const float r2 = radius*radius;
+    const float invDD = 1.0f / dd;
+    const float halfWidth = radius * std::sqrt(dd); // strip |dy*qx - dx*qy| < r*|d|
+    for (int y=miny; y<=maxy; ++y) {
+        const float qy = y + 0.5f - y0;
+        // Narrow the row to the swept strip so diagonal motion does not walk the whole bbox
+        int xa = minx, xb = maxx;
+        if (std::fabs(dy) > 1e-3f) {
+            float ea = (dx*qy - halfWidth) / dy, eb = (dx*qy + halfWidth) / dy;
+            if (ea > eb) std::swap(ea, eb);
+            xa = std::max(minx, (int)std::floor(x0 + ea - 0.5f));
+            xb = std::min(maxx, (int)std::ceil(x0 + eb - 0.5f));
+        }
+        for (int x=xa; x<=xb; ++x) {
+            const float qx = x + 0.5f - x0;
+            // Inside both end discs: covered for the whole interval, no root needed
+            const float ex = qx - dx, ey = qy - dy;
+            if (qx*qx + qy*qy <= r2 && ex*ex + ey*ey <= r2) {
+                blendPixelBGRA(cv, x, y, r, g, b, a);
+                continue;
+            }
+            // |q - t*d|^2 <= r^2  ->  t in [(qd - sqrt(D))/dd, (qd + sqrt(D))/dd]
+            const float qd = qx*dx + qy*dy;
+            const float D = qd*qd - dd*(qx*qx + qy*qy - r2);
+            if (D <= 0.0f) continue;
+            const float sq = std::sqrt(D);
+            const float t0 = std::max(0.0f, (qd - sq) * invDD);
+            const float t1 = std::min(1.0f, (qd + sq) * invDD);
+            if (t1 <= t0) continue;
+            const int pa = (int)(a * (t1 - t0) + 0.5f);
+            if (pa > 0) blendPixelBGRA(cv, x, y, r, g, b, (uint8_t)pa);
+        }
+    }
+}
+
+void drawStreakVBGRA(Canvas& cv, int x, float y, float length, float motion,
+                     uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (cv.record) { recordCommand(cv, DrawCommand::StreakV, r, g, b, a, {(float)x, y, length, motion}); return; }
+    statsPrimitive(cv);
+    if ((unsigned)x >= (unsigned)cv.width || cv.height <= 0) {
+        statsClipped(cv, (long long)std::ceil(length + std::max(motion, 1.0f)) + 1);
+        return;
+    }
+    const float m = std::max(motion, 1.0f); // below 1 px the ramps collapse into the old hard segment
+    const float top = y - m;                  // segment top at the start of the frame
+    int y0 = (int)std::floor(top);
+    int y1 = (int)std::ceil(y + length);
+    if (y0 >= 0 && y1 < cv.height) {
+        // No wrap: only the rows drawn (a band or strip) need visiting
+        y0 = std::max(y0, cv.top);
+        y1 = std::min(y1, cv.rowEnd() - 1);
+    }
+    for (int yy = y0; yy <= y1; ++yy) {
+        // Exposure of the pixel center: clamp(u/m) - clamp((u-len)/m), u measured from 'top'
+        const float u = yy + 0.5f - top;
+        const float e = std::clamp(u / m, 0.0f, 1.0f) - std::clamp((u - length) / m, 0.0f, 1.0f);
+        const int pa = (int)(a * e + 0.5f);
+        if (pa <= 0) continue;
+        int wy = yy % cv.height;
+        if (wy < 0) wy += cv.height;
+        blendPixelBGRA(cv, x, wy, r, g, b, (uint8_t)pa);
+    }
+}
+
+static void replayCommand(const DrawCommand& c, Canvas& cv) {
+    const float* p = c.p;
+    switch (c.type) {
+    case DrawCommand::Pixels:
+        for (int i = 0, n = (int)p[2]; i < n; ++i) putPixelBGRA(cv, (int)p[0] + i, (int)p[1], c.r, c.g, c.b, c.a);
+        break;
+    case DrawCommand::Circle: fillCircleBGRA(cv, p[0], p[1], p[2], c.r, c.g, c.b, c.a); break;
+    case DrawCommand::Rect: fillRectBGRA(cv, (int)p[0], (int)p[1], (int)p[2], (int)p[3], c.r, c.g, c.b, c.a); break;
+    case DrawCommand::Line: drawLineBGRA(cv, p[0], p[1], p[2], p[3], c.r, c.g, c.b, c.a, c.thickness); break;
+    case DrawCommand::QuadBezier:
+        drawQuadBezierBGRA(cv, p[0], p[1], p[2], p[3], p[4], p[5], c.r, c.g, c.b, c.a, c.thickness, c.segments);
+        break;
+    case DrawCommand::Capsule: fillCapsuleBGRA(cv, p[0], p[1], p[2], p[3], p[4], c.r, c.g, c.b, c.a); break;
+    case DrawCommand::StreakV: drawStreakVBGRA(cv, (int)p[0], p[1], p[2], p[3], c.r, c.g, c.b, c.a); break;
+    }
+}
+
+void ReplayDrawList(const DrawList& list, Canvas& cv) {
+    for (const DrawCommand& c : list) replayCommand(c, cv);
+}
+
+// Frame rows a command may touch, as up to two inclusive, conservative ranges (a streak
+// wrapping around the frame has one at the bottom and one at the top); returns how many
+static int commandRows(const DrawCommand& c, int height, int rows[2][2]) {
+    const float* p = c.p;
+    float lo = 0.0f, hi = 0.0f;
+    const float pad = c.thickness / 2 + 1.0f; // line pen plus rounding
+    switch (c.type) {
+    case DrawCommand::Pixels: lo = hi = p[1]; break;
+    case DrawCommand::Circle: lo = p[1] - p[2]; hi = p[1] + p[2]; break;
+    case DrawCommand::Rect: lo = p[1]; hi = p[1] + p[3] - 1.0f; break;
+    case DrawCommand::Line: lo = std::min(p[1], p[3]) - pad; hi = std::max(p[1], p[3]) + pad; break;
+    case DrawCommand::QuadBezier: // inside the control points' hull
+        lo = std::min({p[1], p[3], p[5]}) - pad;
+        hi = std::max({p[1], p[3], p[5]}) + pad;
+        break;
+    case DrawCommand::Capsule: lo = std::min(p[1], p[3]) - p[4]; hi = std::max(p[1], p[3]) + p[4]; break;
+    case DrawCommand::StreakV: {
+        // Same rows as drawStreakVBGRA(), taken modulo the height
+        lo = p[1] - std::max(p[3], 1.0f);
+        hi = p[1] + p[2];
+        if (!(hi >= lo) || !std::isfinite(lo) || !std::isfinite(hi) || hi - lo >= (float)height - 2.0f) {
+            rows[0][0] = 0; rows[0][1] = height - 1;
+            return height > 0 ? 1 : 0;
+        }
+        const int y0 = (int)std::floor(lo), span = (int)std::ceil(hi) - y0;
+        const int w0 = ((y0 % height) + height) % height;
+        rows[0][0] = w0;
+        rows[0][1] = std::min(w0 + span, height - 1);
+        if (w0 + span < height) return 1;
+        rows[1][0] = 0;
+        rows[1][1] = w0 + span - height;
+        return 2;
+    }
+    }
+    if (!(hi >= lo)) return 0; // NaN too
+    rows[0][0] = std::max((int)std::floor(std::clamp(lo, -1.0f, (float)height)), 0);
+    rows[0][1] = std::min((int)std::ceil(std::clamp(hi, -1.0f, (float)height)), height - 1);
+    return rows[0][0] <= rows[0][1] ? 1 : 0;
+}
+
+void DrawBins::Build(const DrawList& list, int height, int rows) {
+    bandRows = std::max(1, rows);
+    const int bands = std::max(1, (height + bandRows - 1) / bandRows);
+    start.assign(size_t(bands) + 1, 0);
+    // Bands [b[i][0], b[i][1]] of a command, each listed once
+    auto commandBands = [&](const DrawCommand& c, int b[2][2]) {
+        const int n = commandRows(c, height, b);
+        for (int i = 0; i < n; ++i) { b[i][0] /= bandRows; b[i][1] /= bandRows; }
+        if (n == 2 && b[1][1] >= b[0][0]) { b[0][0] = 0; return 1; } // both ends in one band
+        return n;
+    };
+    // Count per band, prefix sum, then fill in paint order
+    for (const DrawCommand& c : list) {
+        int b[2][2];
+        for (int i = 0, n = commandBands(c, b); i < n; ++i)
+            for (int band = b[i][0]; band <= b[i][1]; ++band) ++start[size_t(band) + 1];
+    }
+    for (int b = 0; b < bands; ++b) start[size_t(b) + 1] += start[size_t(b)];
+    items.resize(start.back());
+    std::vector<uint32_t> next(start.begin(), start.end() - 1);
+    for (size_t k = 0; k < list.size(); ++k) {
+        int b[2][2];
+        for (int i = 0, n = commandBands(list[k], b); i < n; ++i)
+            for (int band = b[i][0]; band <= b[i][1]; ++band) items[next[size_t(band)]++] = (uint32_t)k;
+    }
+}
+
+void ReplayDrawBand(const DrawList& list, const DrawBins& bins, int band, const Canvas& cv, int y0, int y1) {
+    Canvas c = cv;
+    c.record = nullptr;
+    c.top = std::max(y0, band * bins.bandRows);
+    c.rows = std::min(y1, (band + 1) * bins.bandRows) - c.top;
+    if (c.rows <= 0) return;
+    for (uint32_t i = bins.start[size_t(band)]; i < bins.start[size_t(band) + 1]; ++i) replayCommand(list[bins.items[i]], c);
+}
+
+void CompositeLayerBGRA(uint8_t* dst, const uint8_t* src, size_t pixels, float opacity, BlendMode mode) {
+    Kernels().composite(dst, src, pixels, opacity, mode);
+}
+
+static inline void resolvePixel(const uint16_t* s, uint8_t* d) {
+    uint32_t A = s[3];
+    if (!A) { d[0] = d[1] = d[2] = d[3] = 0; return; }
+    for (int c = 0; c < 3; ++c) {
+        uint32_t C = std::min<uint32_t>(s[c], A); // additive blending may overshoot alpha
+        d[c] = (uint8_t)((C * 255u + A / 2) / A);
+    }
+    d[3] = (uint8_t)((A + 128u) / 257u);
+}
+
+void ResolveAccum16ToBGRA(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    Kernels().resolveAccum16(accum, bgra, pixels);
+}
+
+void ResolveAccum16ToBGRAReference(const uint16_t* accum, uint8_t* bgra, size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) resolvePixel(accum + i * 4, bgra + i * 4);
+}
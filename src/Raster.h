@@ -0,0 +1,219 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+enum class BlendMode { Over, Additive };
+
+// Per-frame raster counters for the preview's overdraw view, filled while
+// Canvas::stats is set. The hooks only exist when GENFX_RENDER_STATS is defined
+// (Debug builds, or -DGENFX_WITH_RENDER_STATS=ON); otherwise they compile to nothing.
+struct RenderStats {
+    std::vector<uint16_t> overdraw; // blends per destination pixel, saturating
+    uint64_t primitives{0};         // primitive calls, putPixelBGRA() from effects included
+    uint64_t blended{0};            // pixel blends
+    uint64_t clipped{0};            // pixels rejected by clipping (bounding-box area for fills)
+    void Reset(int w, int h) {
+        overdraw.assign(size_t(w) * h, 0);
+        primitives = blended = clipped = 0;
+    }
+    void Merge(const RenderStats& o) {
+        for (size_t i = 0; i < overdraw.size() && i < o.overdraw.size(); ++i) {
+            overdraw[i] = (uint16_t)std::min<uint32_t>(65535u, overdraw[i] + o.overdraw[i]);
+        }
+        primitives += o.primitives;
+        blended += o.blended;
+        clipped += o.clipped;
+    }
+};
+
+// One primitive call, as recorded by a Canvas with 'record' set. Integer arguments
+// are stored as floats (exact below 2^24).
+struct DrawCommand {
+    enum Type : uint8_t { Pixels, Circle, Rect, Line, QuadBezier, Capsule, StreakV };
+    Type type;
+    uint8_t r, g, b, a;
+    uint8_t thickness;
+    uint16_t segments;
+    float p[6]; // Pixels: x, y, run length
+};
+// The primitives of one frame in paint order
+using DrawList = std::vector<DrawCommand>;
+
+// Drawing target handed to effects. Primitives blend into the 8-bit straight-alpha
+// BGRA buffer, or, when 'accum' is set, into a 16-bit premultiplied accumulation
+// buffer (0..65535 = 0..1) that the Renderer resolves to BGRA once per frame.
+// Additive blending is only supported on the accumulation buffer.
+//
+// Coordinates are always frame coordinates (width x height). Only the rows [top, top +
+// rows) are drawn (a strip or a band); the buffers start at frame row 'origin'. With
+// 'record' set the primitives are appended to it instead of drawn (see ReplayDrawList()),
+// until 'recordLimit' primitives (single pixels counted one by one) have been recorded:
+// then it is replayed here and cleared, 'record' is reset, and the rest of the frame
+// draws immediately.
+struct Canvas {
+    std::vector<uint8_t>* bgra{nullptr};
+    uint16_t* accum{nullptr}; // same layout as bgra, 4 channels per pixel
+    int width{0};
+    int height{0};
+    int origin{0}; // frame row of the buffers' first row
+    int top{0};    // first frame row drawn
+    int rows{0};   // rows drawn, 0 = all of them
+    BlendMode blend{BlendMode::Over};
+    RenderStats* stats{nullptr}; // only read with GENFX_RENDER_STATS
+    DrawList* record{nullptr};
+    size_t recordLimit{0}; // 0 = none
+    size_t recorded{0};
+    int rowCount() const { return rows ? rows : height; }
+    int rowEnd() const { return top + rowCount(); }
+};
+
+#ifdef GENFX_RENDER_STATS
+inline void statsPrimitive(Canvas& cv) { if (cv.stats) ++cv.stats->primitives; }
+inline void statsClipped(Canvas& cv, long long pixels) { if (cv.stats && pixels > 0) cv.stats->clipped += (uint64_t)pixels; }
+inline void statsBlend(Canvas& cv, size_t pixel) {
+    if (!cv.stats) return;
+    ++cv.stats->blended;
+    uint16_t& n = cv.stats->overdraw[pixel];
+    if (n != 65535) ++n;
+}
+#else
+inline void statsPrimitive(Canvas&) {}
+inline void statsClipped(Canvas&, long long) {}
+inline void statsBlend(Canvas&, size_t) {}
+#endif
+
+// Blend one straight-alpha source color into a premultiplied 16-bit pixel.
+inline void blendAccum16(uint16_t* px, uint8_t r, uint8_t g, uint8_t b, uint8_t a, BlendMode mode) {
+    if (!a) return;
+    const uint32_t sa = a * 257u;
+    const uint32_t sb = (b * a * 257u + 127u) / 255u;
+    const uint32_t sg = (g * a * 257u + 127u) / 255u;
+    const uint32_t sr = (r * a * 257u + 127u) / 255u;
+    if (mode == BlendMode::Additive) {
+        // Colors add; alpha is combined like 'screen' so it never exceeds 1.
+        // Colors may exceed alpha here; the resolve clamps them.
+        px[0] = (uint16_t)std::min(65535u, px[0] + sb);
+        px[1] = (uint16_t)std::min(65535u, px[1] + sg);
+        px[2] = (uint16_t)std::min(65535u, px[2] + sr);
+        px[3] = (uint16_t)(px[3] + sa - (px[3] * sa + 32767u) / 65535u);
+        return;
+    }
+    const uint32_t inv = 65535u - sa;
+    px[0] = (uint16_t)(sb + (px[0] * inv + 32767u) / 65535u);
+    px[1] = (uint16_t)(sg + (px[1] * inv + 32767u) / 65535u);
+    px[2] = (uint16_t)(sr + (px[2] * inv + 32767u) / 65535u);
+    px[3] = (uint16_t)(sa + (px[3] * inv + 32767u) / 65535u);
+}
+
+// Pixel write shared by all primitives; effects call putPixelBGRA() below
+inline void blendPixelBGRA(Canvas& cv, int x, int y,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if ((unsigned)x >= (unsigned)cv.width || (unsigned)(y - cv.top) >= (unsigned)cv.rowCount()) { statsClipped(cv, 1); return; }
+    y -= cv.origin;
+    statsBlend(cv, size_t(y) * cv.width + x);
+    size_t idx = (size_t(y) * cv.width + x) * 4;
+    if (cv.accum) { blendAccum16(cv.accum + idx, r, g, b, a, cv.blend); return; }
+    std::vector<uint8_t>& buf = *cv.bgra;
+    // Alpha blend over existing (premultiplied not assumed). Simple src-over.
+    uint8_t dstB = buf[idx+0];
+    uint8_t dstG = buf[idx+1];
+    uint8_t dstR = buf[idx+2];
+    uint8_t dstA = buf[idx+3];
+    // Exact shortcuts of the formula below for the common cases
+    if (a == 0) {
+        if (dstA == 0) { buf[idx+0]=buf[idx+1]=buf[idx+2]=0; }
+        return;
+    }
+    if (dstA == 0 || a == 255) {
+        buf[idx+0] = b; buf[idx+1] = g; buf[idx+2] = r; buf[idx+3] = a;
+        return;
+    }
+
+    float sa = a / 255.0f;
+    float da = dstA / 255.0f;
+    float outA = sa + da * (1.0f - sa);
+    if (outA <= 0.0001f) {
+        buf[idx+0]=buf[idx+1]=buf[idx+2]=0; buf[idx+3]=0; return;
+    }
+    auto blend = [&](uint8_t sc, uint8_t dc) -> uint8_t {
+        float sr = sc / 255.0f;
+        float dr = dc / 255.0f;
+        float orv = (sr*sa + dr*da*(1.0f-sa)) / outA;
+        return (uint8_t)std::clamp(int(orv*255.0f + 0.5f), 0, 255);
+    };
+    buf[idx+0] = blend(b, dstB);
+    buf[idx+1] = blend(g, dstG);
+    buf[idx+2] = blend(r, dstR);
+    buf[idx+3] = (uint8_t)std::clamp(int(outA*255.0f + 0.5f), 0, 255);
+}
+
+void recordPixel(Canvas& cv, int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+inline void putPixelBGRA(Canvas& cv, int x, int y,
+                         uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (cv.record) { recordPixel(cv, x, y, r, g, b, a); return; }
+    statsPrimitive(cv);
+    blendPixelBGRA(cv, x, y, r, g, b, a);
+}
+
+void fillCircleBGRA(Canvas& cv, float cx, float cy, float radius,
+                    uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+// Simple filled rectangle helper (axis-aligned)
+void fillRectBGRA(Canvas& cv, int x, int y, int rw, int rh,
+                  uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+// Draw a thin line by sampling t along the segment. thickness in pixels (1 or 2 recommended)
+void drawLineBGRA(Canvas& cv, float x0, float y0, float x1, float y1,
+                  uint8_t r, uint8_t g, uint8_t b, uint8_t a, int thickness = 1);
+
+// Quadratic Bezier curve drawing using line segments
+void drawQuadBezierBGRA(Canvas& cv, float x0, float y0, float cx, float cy, float x1, float y1,
+                        uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+                        int thickness = 1, int segments = 32);
+
+// Motion-blurred disc: the disc swept from (x0,y0) to (x1,y1) over one frame interval.
+// Each pixel gets alpha scaled by the fraction of the interval the disc covers it,
+// solved analytically, so no sub-frame accumulation is needed.
+void fillCapsuleBGRA(Canvas& cv, float x0, float y0, float x1, float y1, float radius,
+                     uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+// Motion-blurred 1-px vertical segment [y, y+length] that moved down by 'motion' px
+// during the frame (from y-motion to y). Coverage ramps over 'motion' px at both ends.
+// Rows wrap modulo the canvas height.
+void drawStreakVBGRA(Canvas& cv, int x, float y, float length, float motion,
+                     uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+// Draws 'list' onto 'cv' in order, exactly as the recorded calls would have. Replaying
+// into each row window of a frame in turn gives the same pixels as drawing the frame.
+void ReplayDrawList(const DrawList& list, Canvas& cv);
+
+// A DrawList sorted into bands of 'bandRows' full-width rows: per band, the indices of the
+// commands that reach it, in paint order. Rasterizing band by band keeps the pixels being
+// blended within a cache-sized window, and bands can be drawn concurrently.
+struct DrawBins {
+    int bandRows{0};
+    std::vector<uint32_t> start; // band b: items[start[b] .. start[b+1])
+    std::vector<uint32_t> items;
+    void Build(const DrawList& list, int height, int rows);
+    int Bands() const { return start.empty() ? 0 : (int)start.size() - 1; }
+};
+
+// Replays band 'band' of 'bins', drawing only the frame rows [y0, y1) within it. Every
+// pixel lies in one band, so drawing all bands gives the pixels of ReplayDrawList().
+void ReplayDrawBand(const DrawList& list, const DrawBins& bins, int band, const Canvas& cv, int y0, int y1);
+
+// Composite a straight-alpha BGRA layer onto another with an extra opacity factor.
+// Over is Porter-Duff src-over (same math as putPixelBGRA); Additive adds
+// premultiplied colors and combines alpha like 'screen'.
+void CompositeLayerBGRA(uint8_t* dst, const uint8_t* src, size_t pixels, float opacity, BlendMode mode);
+
+// Convert premultiplied 16-bit accumulation pixels to straight-alpha BGRA8, with the
+// best kernel for the CPU (PixelKernels.h).
+void ResolveAccum16ToBGRA(const uint16_t* accum, uint8_t* bgra, size_t pixels);
+// Scalar integer version of the above, used by the reference renderer. The kernels
+// (float reciprocal, round-half-even) may differ from it by one step in a color
+// channel; alpha is identical.
+void ResolveAccum16ToBGRAReference(const uint16_t* accum, uint8_t* bgra, size_t pixels);
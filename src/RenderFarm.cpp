@@ -0,0 +1,594 @@
+#include "RenderFarm.h"
+#include "EffectScript.h"
+#include "ExportCache.h"
+#include "FrameStore.h"
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+  #include <Windows.h>
+  #include <process.h>
+#else
+  #include <unistd.h>
+#endif
+
+#if __has_include("BuildId.h")
+#include "BuildId.h" // GENFX_BUILD_ID, regenerated on every build (cmake/BuildId.cmake)
+#endif
+#ifndef GENFX_BUILD_ID
+#define GENFX_BUILD_ID "dev"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* kUnitExt = ".unit";
+constexpr const char* kPartExt = ".part";
+
+// A job as stored in the spool
+struct FarmJob {
+    ExportJob job;
+    std::string build;
+    std::string script, overlayScript; // hashes of the effects' script source, "-" = built in
+    int unitFrames{0};
+};
+
+struct Unit {
+    std::string name; // file name without extension
+    std::string job;
+    int output{0}, first{0}, count{0};
+};
+
+fs::path SpoolDir(const std::string& spool, const char* sub) { return fs::path(spool) / sub; }
+
+std::string DefaultWorkerName() {
+    char host[256] = {};
+#ifdef _WIN32
+    DWORD n = sizeof(host);
+    if (!GetComputerNameA(host, &n)) host[0] = 0;
+    const int pid = _getpid();
+#else
+    if (gethostname(host, sizeof(host) - 1) != 0) host[0] = 0;
+    const int pid = (int)getpid();
+#endif
+    const std::string h = ToKebabCase(host);
+    return (h.empty() ? std::string("host") : h) + "-" + std::to_string(pid);
+}
+
+std::string ScriptHash(const std::string& effect) {
+    const std::string src = ScriptEffectSource(effect);
+    return src.empty() ? std::string("-") : ExportCache::HashKey(src);
+}
+
+std::string UnitName(const std::string& job, int output, int first) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), ".%d.%06d", output, first); // sorts in frame order
+    return job + buf;
+}
+
+// The job a unit or claim file belongs to: job names are kebab case, without dots
+std::string JobOfFile(const std::string& fileName) { return fileName.substr(0, fileName.find('.')); }
+
+bool ReadFile(const fs::path& p, std::string& out) {
+    std::ifstream in(p, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+// Written under a temporary name and renamed, so readers never see half a file
+bool WriteFileAtomic(const fs::path& p, const std::string& text, std::string& err) {
+    const fs::path part = p.string() + kPartExt;
+    {
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        out << text;
+        if (!out.good()) { err = "Failed to write " + part.string(); return false; }
+    }
+    std::error_code ec;
+    fs::rename(part, p, ec);
+    if (ec) { err = "Failed to rename " + part.string() + ": " + ec.message(); return false; }
+    return true;
+}
+
+std::string JobText(const ExportJob& job, int unitFrames) {
+    std::ostringstream d;
+    d << std::hexfloat;
+    d << "genfx-farm 1\nbuild " << GENFX_BUILD_ID << "\nname " << job.outName << "\nunit-frames " << unitFrames << "\n";
+    d << "effect " << job.effect << "\nscript " << ScriptHash(job.effect) << "\nsizes";
+    for (const SizeI& s : job.sizes) d << " " << s.w << "x" << s.h;
+    d << "\nduration " << job.duration << "\nfps " << job.fps << "\ndensity " << job.density << "\nspeed " << job.speed
+      << "\nsize-range " << job.sizeMin << " " << job.sizeMax << "\nmotion-blur " << job.motionBlur
+      << "\nglow " << job.glow.intensity << " " << job.glow.radius << "\nblend " << int(job.blend) << " " << job.highPrecision << "\n";
+    if (!job.overlay.effect.empty()) {
+        const LayerDesc& l = job.overlay;
+        d << "overlay " << l.effect << " " << l.opacity << " " << int(l.composite) << " " << int(l.particles) << " "
+          << l.highPrecision << " " << l.glow.intensity << " " << l.glow.radius << "\noverlay-script " << ScriptHash(l.effect) << "\n";
+    }
+    const EncoderSettings& e = job.encoder;
+    d << "codec " << int(e.codec) << " " << e.crf << " " << e.gop << " " << e.cpuUsed
+      << "\natlas " << e.atlasFrameStep << " " << e.atlasMaxPage << " " << e.atlasIndexed << "\nraw-lz4 " << e.rawLz4
+      << "\nbackend " << int(job.backend) << " " << job.parallelSegments << "\n";
+    return d.str();
+}
+
+// Floats are written as hexfloat, which operator>> does not read back
+float ReadFloat(std::istream& in) {
+    std::string s;
+    in >> s;
+    return std::strtof(s.c_str(), nullptr);
+}
+
+bool ParseJob(const std::string& text, FarmJob& fj, std::string& err) {
+    std::istringstream in(text);
+    std::string line;
+    ExportJob& job = fj.job;
+    job.overlay = LayerDesc{};
+    bool header = false;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string key;
+        ls >> key;
+        int a = 0, b = 0;
+        if (key == "genfx-farm") { ls >> a; header = a == 1; }
+        else if (key == "build") ls >> fj.build;
+        else if (key == "name") { std::getline(ls >> std::ws, job.outName); }
+        else if (key == "unit-frames") ls >> fj.unitFrames;
+        else if (key == "effect") ls >> job.effect;
+        else if (key == "script") ls >> fj.script;
+        else if (key == "sizes") {
+            std::string s;
+            while (ls >> s) {
+                SizeI sz;
+                if (std::sscanf(s.c_str(), "%dx%d", &sz.w, &sz.h) == 2 && sz.w > 0 && sz.h > 0) job.sizes.push_back(sz);
+            }
+        }
+        else if (key == "duration") ls >> job.duration;
+        else if (key == "fps") ls >> job.fps;
+        else if (key == "density") ls >> job.density;
+        else if (key == "speed") job.speed = ReadFloat(ls);
+        else if (key == "size-range") { job.sizeMin = ReadFloat(ls); job.sizeMax = ReadFloat(ls); }
+        else if (key == "motion-blur") ls >> job.motionBlur;
+        else if (key == "glow") { job.glow.intensity = ReadFloat(ls); job.glow.radius = ReadFloat(ls); }
+        else if (key == "blend") { ls >> a >> job.highPrecision; job.blend = BlendMode(a); }
+        else if (key == "overlay") {
+            LayerDesc& l = job.overlay;
+            ls >> l.effect;
+            l.opacity = ReadFloat(ls);
+            ls >> a >> b >> l.highPrecision;
+            l.composite = BlendMode(a);
+            l.particles = BlendMode(b);
+            l.glow.intensity = ReadFloat(ls);
+            l.glow.radius = ReadFloat(ls);
+        }
+        else if (key == "overlay-script") ls >> fj.overlayScript;
+        else if (key == "codec") { ls >> a >> job.encoder.crf >> job.encoder.gop >> job.encoder.cpuUsed; job.encoder.codec = VideoCodec(a); }
+        else if (key == "atlas") ls >> job.encoder.atlasFrameStep >> job.encoder.atlasMaxPage >> job.encoder.atlasIndexed;
+        else if (key == "raw-lz4") ls >> job.encoder.rawLz4;
+        else if (key == "backend") { ls >> a >> job.parallelSegments; job.backend = EncoderBackend(a); }
+    }
+    if (!header || job.effect.empty() || job.sizes.empty() || fj.unitFrames <= 0 || job.duration <= 0 || job.fps <= 0) {
+        err = "Not a valid farm job";
+        return false;
+    }
+    return true;
+}
+
+bool LoadJob(const std::string& spool, const std::string& name, FarmJob& fj, std::string& err) {
+    const fs::path p = SpoolDir(spool, "jobs") / (name + ".txt");
+    std::string text;
+    if (!ReadFile(p, text)) { err = "Missing job file " + p.string(); return false; }
+    if (!ParseJob(text, fj, err)) { err += " in " + p.string(); return false; }
+    return true;
+}
+
+// Frames rendered here would differ from the rest of the job's: another renderer build,
+// or a scripted effect with other source (or missing)
+bool CanRender(const FarmJob& fj, std::string& why) {
+    if (fj.build != GENFX_BUILD_ID) {
+        why = "job was submitted by build " + fj.build + ", this is " + GENFX_BUILD_ID;
+        return false;
+    }
+    if (ScriptHash(fj.job.effect) != fj.script ||
+        (!fj.job.overlay.effect.empty() && ScriptHash(fj.job.overlay.effect) != fj.overlayScript)) {
+        why = "effect scripts differ from the ones the job was submitted with";
+        return false;
+    }
+    return true;
+}
+
+bool ParseUnit(const std::string& name, const std::string& text, Unit& u) {
+    std::istringstream in(text);
+    std::string key;
+    u.name = name;
+    u.job.clear();
+    u.count = 0;
+    while (in >> key) {
+        if (key == "job") in >> u.job;
+        else if (key == "output") in >> u.output;
+        else if (key == "first") in >> u.first;
+        else if (key == "count") in >> u.count;
+    }
+    return !u.job.empty() && u.count > 0;
+}
+
+// Now, by the spool's file server: the mtime of a file just written. Claims are
+// compared against it, so clocks of the worker machines do not matter.
+fs::file_time_type SpoolNow(const std::string& spool, const std::string& worker) {
+    const fs::path p = fs::path(spool) / (".clock-" + worker);
+    { std::ofstream(p, std::ios::trunc) << "now"; }
+    std::error_code ec;
+    const auto t = fs::last_write_time(p, ec);
+    return ec ? fs::file_time_type::clock::now() : t;
+}
+
+fs::file_time_type::duration Seconds(double s) {
+    return std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::duration<double>(s));
+}
+
+// Claims of dead workers back to todo/, and their half-written segments removed
+void RequeueExpired(const std::string& spool, const std::string& worker, double leaseSec) {
+    const auto now = SpoolNow(spool, worker);
+    const auto lease = Seconds(leaseSec);
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(SpoolDir(spool, "claimed"), ec)) {
+        const std::string name = e.path().filename().string();
+        const size_t at = name.rfind('@');
+        std::error_code tec;
+        const auto t = fs::last_write_time(e.path(), tec);
+        if (at == std::string::npos || tec || now - t < lease) continue;
+        std::error_code rec;
+        fs::rename(e.path(), SpoolDir(spool, "todo") / (name.substr(0, at) + kUnitExt), rec);
+        if (!rec) std::cout << "Farm: claim " << name << " expired, unit returned to the queue" << std::endl;
+    }
+    for (const auto& e : fs::directory_iterator(SpoolDir(spool, "done"), ec)) {
+        if (e.path().extension() != kPartExt) continue;
+        std::error_code tec;
+        const auto t = fs::last_write_time(e.path(), tec);
+        if (!tec && now - t >= lease) fs::remove(e.path(), tec);
+    }
+}
+
+// Renews a claim's lease by rewriting its first byte; opened for update, never created,
+// so a claim that was taken back stays gone (false)
+bool TouchClaim(const fs::path& claim) {
+    std::fstream f(claim, std::ios::in | std::ios::out | std::ios::binary);
+    char c = 0;
+    if (!f || !f.get(c)) return false;
+    f.seekp(0);
+    f.put(c);
+    f.flush();
+    return f.good();
+}
+
+// Keeps a claim alive while a unit renders; notices when it was taken back
+class ClaimLease {
+public:
+    ClaimLease(fs::path path, double leaseSec) : m_path(std::move(path)) {
+        const auto interval = std::chrono::duration<double>(std::clamp(leaseSec / 5.0, 0.2, 60.0));
+        m_thread = std::thread([this, interval]() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_cv.wait_for(lock, interval, [this] { return m_stop; })) {
+                if (!TouchClaim(m_path)) { m_lost = true; return; }
+            }
+        });
+    }
+    ~ClaimLease() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+    bool Lost() const { return m_lost; }
+
+private:
+    fs::path m_path;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop{false};
+    std::atomic<bool> m_lost{false};
+    std::thread m_thread;
+};
+
+// Renderer reused while a worker's units walk forward through one output
+struct WorkerState {
+    std::map<std::string, FarmJob> jobs;
+    std::set<std::string> refused;
+    std::string job;
+    int output{-1};
+    std::unique_ptr<Renderer> r;
+    int pos{0};
+};
+
+// Oldest unit first; false when todo/ has nothing this worker may render
+bool ClaimNext(const std::string& spool, const std::string& worker, const std::set<std::string>& refused,
+               Unit& unit, fs::path& claim) {
+    std::vector<fs::path> units;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(SpoolDir(spool, "todo"), ec)) {
+        if (e.path().extension() == kUnitExt) units.push_back(e.path());
+    }
+    std::sort(units.begin(), units.end());
+    for (const fs::path& p : units) {
+        const std::string name = p.stem().string();
+        if (refused.count(JobOfFile(name))) continue;
+        claim = SpoolDir(spool, "claimed") / (name + "@" + worker);
+        std::error_code rec;
+        fs::rename(p, claim, rec); // another worker got it first
+        if (rec) continue;
+        // A rename keeps the unit's mtime from when it was queued; the lease starts now.
+        // Failing means a worker took it back in between, as if it had been too late.
+        if (!TouchClaim(claim)) continue;
+        std::string text;
+        if (ReadFile(claim, text) && ParseUnit(name, text, unit)) return true;
+        std::cout << "Farm: dropping malformed unit " << name << std::endl;
+        fs::remove(claim, rec);
+    }
+    return false;
+}
+
+// Renders one claimed unit into done/. 'lost' = the claim expired meanwhile and the
+// unit went back to the queue (not an error).
+bool RenderUnit(const std::string& spool, const std::string& worker, const FarmWorkerOptions& options,
+                const Unit& u, const fs::path& claim, WorkerState& st, bool& lost, std::string& err) {
+    const FarmJob& fj = st.jobs[u.job];
+    const ExportJob& job = fj.job;
+    if (u.output < 0 || u.output >= (int)job.sizes.size()) { err = "Unit " + u.name + " has no such output"; return false; }
+    const SizeI s = job.sizes[size_t(u.output)];
+    if (!st.r || st.job != u.job || st.output != u.output) {
+        st.r = std::make_unique<Renderer>(s.w, s.h);
+        ConfigureRenderer(*st.r, job);
+        st.job = u.job;
+        st.output = u.output;
+        st.pos = 0;
+    }
+    Renderer& r = *st.r;
+    if (st.pos > u.first) { r.Setup(); st.pos = 0; }
+    for (; st.pos < u.first; ++st.pos) r.SkipFrame();
+
+    const fs::path part = SpoolDir(spool, "done") / (u.name + "@" + worker + kPartExt);
+    FrameStoreWriter writer;
+    if (!writer.Create(part.string(), s.w, s.h, job.fps, u.count, FrameStoreHasLZ4(), err)) return false;
+    {
+        ClaimLease lease(claim, options.leaseSec);
+        for (int k = 0; k < u.count; ++k, ++st.pos) {
+            if (lease.Lost()) { lost = true; break; }
+            r.RenderNextFrame();
+            if (!writer.WriteFrame(k, r.GetFrameBuffer().data(), err)) return false;
+        }
+    }
+    std::error_code ec;
+    if (lost) {
+        fs::remove(part, ec);
+        return true;
+    }
+    if (!writer.Close(err)) return false;
+    fs::rename(part, SpoolDir(spool, "done") / (u.name + ".gfxraw"), ec);
+    if (ec) { err = "Failed to publish " + u.name + ": " + ec.message(); return false; }
+    fs::remove(claim, ec);
+    return true;
+}
+
+// Units a job was split into, in frame order per output
+std::vector<Unit> JobUnits(const std::string& name, const FarmJob& fj) {
+    std::vector<Unit> units;
+    const int total = fj.job.duration * fj.job.fps;
+    for (int o = 0; o < (int)fj.job.sizes.size(); ++o) {
+        for (int first = 0; first < total; first += fj.unitFrames) {
+            units.push_back({UnitName(name, o, first), name, o, first, std::min(fj.unitFrames, total - first)});
+        }
+    }
+    return units;
+}
+
+// Concatenates one output's units with the loop crossfade into a frame store at 'path'
+bool MergeOutput(const std::string& spool, const FarmJob& fj, const std::vector<Unit>& units, int output,
+                 const std::string& path, bool lz4, std::string& err) {
+    const ExportJob& job = fj.job;
+    const SizeI s = job.sizes[size_t(output)];
+    const int total = job.duration * job.fps;
+    const int cross = std::clamp(job.fps, 1, total / 2); // as in RunExport
+    std::vector<std::unique_ptr<FrameStoreReader>> parts;
+    for (const Unit& u : units) {
+        if (u.output != output) continue;
+        auto reader = std::make_unique<FrameStoreReader>();
+        const std::string p = (SpoolDir(spool, "done") / (u.name + ".gfxraw")).string();
+        if (!reader->Open(p, err)) return false;
+        if (reader->Width() != s.w || reader->Height() != s.h || reader->FrameCount() != u.count) {
+            err = "Segment " + p + " does not match its unit";
+            return false;
+        }
+        parts.push_back(std::move(reader));
+    }
+    auto frame = [&](int i, std::vector<uint8_t>& scratch) {
+        return parts[size_t(i / fj.unitFrames)]->Frame(i % fj.unitFrames, scratch, err);
+    };
+    FrameStoreWriter writer;
+    if (!writer.Create(path, s.w, s.h, job.fps, total, lz4, err)) return false;
+    std::vector<uint8_t> scratchA, scratchB, blended;
+    const size_t bytes = size_t(s.w) * s.h * 4;
+    for (int i = 0; i < total; ++i) {
+        const uint8_t* f = frame(i, scratchA);
+        if (!f) return false;
+        if (i >= total - cross) {
+            const int k = i - (total - cross);
+            const uint8_t* head = frame(k, scratchB);
+            if (!head) return false;
+            blended.resize(bytes);
+            CrossfadeBGRA(f, head, blended.data(), bytes, float(k + 1) / float(cross));
+            f = blended.data();
+        }
+        if (!writer.WriteFrame(i, f, err)) return false;
+    }
+    return writer.Close(err);
+}
+
+bool MergeJob(const std::string& spool, const std::string& name, const FarmJob& fj, const std::string& outDir,
+              std::string& err) {
+    const ExportJob& job = fj.job;
+    const std::vector<Unit> units = JobUnits(name, fj);
+    const bool raw = job.encoder.codec == VideoCodec::RawFrameStore;
+    std::error_code ec;
+    fs::create_directories(outDir, ec);
+    for (int o = 0; o < (int)job.sizes.size(); ++o) {
+        const SizeI s = job.sizes[size_t(o)];
+        // Non-raw codecs re-encode an uncompressed store, which ffmpeg can read directly
+        const std::string store = (fs::path(outDir) / BuildFileName(job.outName, s.w, s.h, ".gfxraw")).string();
+        fs::remove(store, ec); // never write through a hardlink into the export cache
+        if (!MergeOutput(spool, fj, units, o, store, raw && job.encoder.rawLz4, err)) return false;
+        if (!raw) {
+            ExportJob rj = job;
+            rj.outDir = outDir;
+            err = RunReencode(rj, {store});
+            fs::remove(store, ec);
+            if (!err.empty()) return false;
+        }
+        std::cout << "Farm: merged " << name << " " << s.w << "x" << s.h << " into " << outDir << std::endl;
+    }
+    return true;
+}
+
+int CountFiles(const fs::path& dir, const char* ext) {
+    int n = 0;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        const std::string name = e.path().filename().string();
+        if (name.empty() || name[0] == '.' || e.path().extension() == kPartExt) continue;
+        if (!ext || e.path().extension() == ext) ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+bool FarmSubmit(const std::string& spool, const ExportJob& job, int unitFrames, std::string& err) {
+    const std::string name = ToKebabCase(job.outName);
+    const int total = job.duration * job.fps;
+    if (name.empty() || job.sizes.empty() || total <= 0 || unitFrames <= 0) {
+        err = "Nothing to submit: the job needs a name, sizes and a duration";
+        return false;
+    }
+    std::error_code ec;
+    for (const char* sub : {"jobs", "todo", "claimed", "done"}) {
+        fs::create_directories(SpoolDir(spool, sub), ec);
+        if (ec) { err = "Failed to create " + SpoolDir(spool, sub).string() + ": " + ec.message(); return false; }
+    }
+    const fs::path jobPath = SpoolDir(spool, "jobs") / (name + ".txt");
+    if (fs::exists(jobPath, ec)) { err = "A job named " + name + " is already in " + spool; return false; }
+    // The job file goes first: a worker that claims a unit must find it
+    FarmJob fj;
+    if (!ParseJob(JobText(job, unitFrames), fj, err)) return false;
+    if (!WriteFileAtomic(jobPath, JobText(job, unitFrames), err)) return false;
+    for (const Unit& u : JobUnits(name, fj)) {
+        std::ostringstream text;
+        text << "job " << u.job << "\noutput " << u.output << "\nfirst " << u.first << "\ncount " << u.count << "\n";
+        if (!WriteFileAtomic(SpoolDir(spool, "todo") / (u.name + kUnitExt), text.str(), err)) return false;
+    }
+    return true;
+}
+
+bool FarmWork(const std::string& spool, const FarmWorkerOptions& options, int& rendered, std::string& err) {
+    const std::string worker = options.name.empty() ? DefaultWorkerName() : ToKebabCase(options.name);
+    rendered = 0;
+    WorkerState st;
+    for (;;) {
+        RequeueExpired(spool, worker, options.leaseSec);
+        Unit u;
+        fs::path claim;
+        if (!ClaimNext(spool, worker, st.refused, u, claim)) {
+            if (!options.waitForClaimed || CountFiles(SpoolDir(spool, "claimed"), nullptr) == 0) break;
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::clamp(options.leaseSec / 10.0, 0.1, 5.0)));
+            continue;
+        }
+        std::error_code ec;
+        const fs::path todo = SpoolDir(spool, "todo") / (u.name + kUnitExt);
+        if (!st.jobs.count(u.job)) {
+            FarmJob fj;
+            std::string why;
+            if (!LoadJob(spool, u.job, fj, why) || !CanRender(fj, why)) {
+                // Leave the job to workers that can render it
+                std::cout << "Farm: skipping job " << u.job << ": " << why << std::endl;
+                st.refused.insert(u.job);
+                fs::rename(claim, todo, ec);
+                continue;
+            }
+            st.jobs[u.job] = fj;
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        bool lost = false;
+        if (!RenderUnit(spool, worker, options, u, claim, st, lost, err)) {
+            fs::rename(claim, todo, ec); // someone else can try
+            return false;
+        }
+        if (lost) {
+            std::cout << "Farm: lost the claim on " << u.name << ", left to the worker that took it" << std::endl;
+            continue;
+        }
+        ++rendered;
+        std::cout << "Farm: rendered " << u.name << " (" << u.count << " frames, "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() << " s)" << std::endl;
+    }
+    std::error_code ec;
+    fs::remove(fs::path(spool) / (".clock-" + worker), ec);
+    return true;
+}
+
+bool FarmMerge(const std::string& spool, const std::string& outDir, std::vector<std::string>& merged,
+               std::vector<std::string>& pending, std::string& err) {
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(SpoolDir(spool, "jobs"), ec)) {
+        if (e.path().extension() == ".txt") names.push_back(e.path().stem().string());
+    }
+    if (ec) { err = "No farm spool at " + spool; return false; }
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+        FarmJob fj;
+        if (!LoadJob(spool, name, fj, err)) return false;
+        const std::vector<Unit> units = JobUnits(name, fj);
+        const bool complete = std::all_of(units.begin(), units.end(), [&](const Unit& u) {
+            std::error_code xec;
+            return fs::exists(SpoolDir(spool, "done") / (u.name + ".gfxraw"), xec);
+        });
+        if (!complete) { pending.push_back(name); continue; }
+        if (!MergeJob(spool, name, fj, outDir, err)) return false;
+        // Everything of the job goes, including units a slow worker is still redoing
+        std::vector<fs::path> files;
+        for (const char* sub : {"todo", "claimed", "done"}) {
+            for (const auto& e : fs::directory_iterator(SpoolDir(spool, sub), ec)) {
+                if (JobOfFile(e.path().filename().string()) == name) files.push_back(e.path());
+            }
+        }
+        for (const fs::path& f : files) fs::remove(f, ec);
+        fs::remove(SpoolDir(spool, "jobs") / (name + ".txt"), ec);
+        merged.push_back(name);
+    }
+    return true;
+}
+
+FarmStatus FarmGetStatus(const std::string& spool) {
+    FarmStatus st;
+    st.jobs = CountFiles(SpoolDir(spool, "jobs"), ".txt");
+    st.todo = CountFiles(SpoolDir(spool, "todo"), kUnitExt);
+    st.claimed = CountFiles(SpoolDir(spool, "claimed"), nullptr);
+    st.done = CountFiles(SpoolDir(spool, "done"), ".gfxraw");
+    return st;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Exporter.h"
+#include <string>
+#include <vector>
+
+// Render farm: exports split into work units in a spool directory that any number of
+// worker processes (local, or on other machines with the spool on NFS) take from.
+//
+//   spool/jobs/<job>.txt                    export parameters, canonical text
+//   spool/todo/<job>.<output>.<first>.unit  units nobody works on
+//   spool/claimed/<unit>@<worker>           claimed units; the file's mtime is the lease
+//   spool/done/<unit>.gfxraw                rendered frames of finished units
+//
+// A unit is one frame range of one size of one export. Workers claim a unit by renaming
+// it from todo/ into claimed/ (atomic, so exactly one wins), render the range from the
+// seeded Setup() state, the same way a segment of a local export does, write a raw frame
+// store under a temporary name and rename it into done/. While rendering they touch the
+// claim; a claim not touched for the lease time belongs to a dead worker and is moved
+// back to todo/ by the next process that looks, so a crash loses only that unit.
+// Merging concatenates the units of each size in order, applies the loop crossfade and
+// encodes the result with the job's codec (RunReencode()).
+//
+// Frames only match across machines built from the same source: the build id and the
+// script source of scripted effects are part of the job, and workers refuse jobs that
+// do not match their own.
+
+struct FarmWorkerOptions {
+    double leaseSec{300.0};      // claims not touched for this long are taken back
+    bool waitForClaimed{false};  // when todo/ is empty, keep polling while others hold claims
+    std::string name;            // worker id in claim names; empty = host-pid
+};
+
+// Files in the spool, in units
+struct FarmStatus {
+    int jobs{0};
+    int todo{0};
+    int claimed{0};
+    int done{0};
+};
+
+// Adds 'job' to the spool (created if needed) as units of 'unitFrames' frames per size.
+// job.outName names the job and must be unique in the spool; outDir, cache and trace
+// settings are ignored (the merge step decides where outputs go).
+bool FarmSubmit(const std::string& spool, const ExportJob& job, int unitFrames, std::string& err);
+
+// Claims and renders units until none are left ('rendered' counts them). Claims of
+// dead workers are returned to todo/ first.
+bool FarmWork(const std::string& spool, const FarmWorkerOptions& options, int& rendered, std::string& err);
+
+// Merges every job whose units are all done into outDir (named like a local export),
+// then removes the job and its units from the spool; jobs still in progress are listed
+// in 'pending' and left alone.
+bool FarmMerge(const std::string& spool, const std::string& outDir, std::vector<std::string>& merged,
+               std::vector<std::string>& pending, std::string& err);
+
+FarmStatus FarmGetStatus(const std::string& spool);
@@ -1,4 +1,7 @@
 #include "Renderer.h"
+#include "PixelKernels.h"
+#include "EffectScript.h"
+#include "Trace.h"
 #include <cstring>
 #include <algorithm>
 #include <random>
@@ -9,104 +12,6 @@ static constexpr float PI = 3.14159265358979323846f;
 
 // ---------------------- Effects Implementations ----------------------
 
-static inline void putPixelBGRA(std::vector<uint8_t>& buf, int w, int h, int x, int y,
-                                uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if ((unsigned)x >= (unsigned)w || (unsigned)y >= (unsigned)h) return;
-    size_t idx = (size_t(y) * w + x) * 4;
-    // Alpha blend over existing (premultiplied not assumed). Simple src-over.
-    uint8_t dstB = buf[idx+0];
-    uint8_t dstG = buf[idx+1];
-    uint8_t dstR = buf[idx+2];
-    uint8_t dstA = buf[idx+3];
-
-    float sa = a / 255.0f;
-    float da = dstA / 255.0f;
-    float outA = sa + da * (1.0f - sa);
-    if (outA <= 0.0001f) {
-        buf[idx+0]=buf[idx+1]=buf[idx+2]=0; buf[idx+3]=0; return;
-    }
-    auto blend = [&](uint8_t sc, uint8_t dc) -> uint8_t {
-        float sr = sc / 255.0f;
-        float dr = dc / 255.0f;
-        float orv = (sr*sa + dr*da*(1.0f-sa)) / outA;
-        return (uint8_t)std::clamp(int(orv*255.0f + 0.5f), 0, 255);
-    };
-    buf[idx+0] = blend(b, dstB);
-    buf[idx+1] = blend(g, dstG);
-    buf[idx+2] = blend(r, dstR);
-    buf[idx+3] = (uint8_t)std::clamp(int(outA*255.0f + 0.5f), 0, 255);
-}
-
-static inline void fillCircleBGRA(std::vector<uint8_t>& buf, int w, int h, float cx, float cy, float radius,
-                                  uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    int minx = std::max(0, (int)std::floor(cx - radius));
-    int maxx = std::min(w-1, (int)std::ceil(cx + radius));
-    int miny = std::max(0, (int)std::floor(cy - radius));
-    int maxy = std::min(h-1, (int)std::ceil(cy + radius));
-    float r2 = radius*radius;
-    for (int y=miny; y<=maxy; ++y) {
-        for (int x=minx; x<=maxx; ++x) {
-            float dx = x + 0.5f - cx;
-            float dy = y + 0.5f - cy;
-            if (dx*dx + dy*dy <= r2) {
-                putPixelBGRA(buf, w, h, x, y, r, g, b, a);
-            }
-        }
-    }
-}
-
-// Simple filled rectangle helper (axis-aligned)
-static inline void fillRectBGRA(std::vector<uint8_t>& buf, int w, int h, int x, int y, int rw, int rh,
-                                uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    int x0 = std::max(0, x);
-    int y0 = std::max(0, y);
-    int x1 = std::min(w, x + rw);
-    int y1 = std::min(h, y + rh);
-    for (int yy = y0; yy < y1; ++yy) {
-        for (int xx = x0; xx < x1; ++xx) {
-            putPixelBGRA(buf, w, h, xx, yy, r, g, b, a);
-        }
-    }
-}
-
-// Draw a thin line by sampling t along the segment. thickness in pixels (1 or 2 recommended)
-static inline void drawLineBGRA(std::vector<uint8_t>& buf, int w, int h,
-                                float x0, float y0, float x1, float y1,
-                                uint8_t r, uint8_t g, uint8_t b, uint8_t a,
-                                int thickness = 1) {
-    float dx = x1 - x0, dy = y1 - y0;
-    float len = std::sqrt(dx*dx + dy*dy);
-    int steps = (int)std::max(1.0f, len);
-    for (int i = 0; i <= steps; ++i) {
-        float t = (steps==0)?0.0f: (float)i / (float)steps;
-        float x = x0 + dx * t;
-        float y = y0 + dy * t;
-        int ix = (int)std::round(x);
-        int iy = (int)std::round(y);
-        for (int oy = -thickness/2; oy <= thickness/2; ++oy) {
-            for (int ox = -thickness/2; ox <= thickness/2; ++ox) {
-                putPixelBGRA(buf, w, h, ix + ox, iy + oy, r, g, b, a);
-            }
-        }
-    }
-}
-
-// Quadratic Bezier curve drawing using line segments
-static inline void drawQuadBezierBGRA(std::vector<uint8_t>& buf, int w, int h,
-                                      float x0, float y0, float cx, float cy, float x1, float y1,
-                                      uint8_t r, uint8_t g, uint8_t b, uint8_t a,
-                                      int thickness = 1, int segments = 32) {
-    float px = x0, py = y0;
-    for (int i=1; i<=segments; ++i) {
-        float t = (float)i / (float)segments;
-        float it = 1.0f - t;
-        float x = it*it*x0 + 2*it*t*cx + t*t*x1;
-        float y = it*it*y0 + 2*it*t*cy + t*t*y1;
-        drawLineBGRA(buf, w, h, px, py, x, y, r, g, b, a, thickness);
-        px = x; py = y;
-    }
-}
-
 // Base Effect class helpers
 // Film Dust and Scratches effect (replaces former Black Noise)
 class EffectBlackNoise : public Effect {
@@ -135,7 +40,7 @@ public:
         m_seedBase = 77771u; // deterministic base
     }
 
-    void drawBGRA(std::vector<uint8_t>& buf, int frame, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) override {
         int tf = std::max(1, ctx.totalFrames());
         int f = int(frame * ctx.speed) % tf;
         RNG rng(m_seedBase + (uint32_t)f);
@@ -155,7 +60,7 @@ public:
                 if (a) {
                     // further attenuate vignette alpha for subtlety
                     uint8_t a2 = (uint8_t)std::clamp(int(a * 0.6f), 0, 255);
-                    putPixelBGRA(buf, ctx.width, ctx.height, x, y, 0,0,0, a2);
+                    putPixelBGRA(cv, x, y, 0,0,0, a2);
                 }
             }
         }
@@ -175,7 +80,7 @@ public:
             uint8_t v = randGray(0, 40); // black to dark gray
             uint8_t a = (uint8_t)rng.randint(178, 255); // 70%-100%
             // prefer small irregular rectangle
-            fillRectBGRA(buf, ctx.width, ctx.height, px, py, rw, rh, v, v, v, a);
+            fillRectBGRA(cv, px, py, rw, rh, v, v, v, a);
         }
 
         // 3) Scratches (thin lines/curves)
@@ -192,12 +97,12 @@ public:
             uint8_t a = (uint8_t)rng.randint(130, 220);
             if (rng.uniform01() < 0.5) {
                 // straight line
-                drawLineBGRA(buf, ctx.width, ctx.height, x0 + jx, y0 + jy, x1 + jx, y1 + jy, v, v, v, a, thick);
+                drawLineBGRA(cv, x0 + jx, y0 + jy, x1 + jx, y1 + jy, v, v, v, a, thick);
             } else {
                 // curved line via a control point near the middle
                 float cxp = (x0 + x1) * 0.5f + (float)rng.randint(-10, 10);
                 float cyp = (y0 + y1) * 0.5f + (float)rng.randint(-10, 10);
-                drawQuadBezierBGRA(buf, ctx.width, ctx.height, x0 + jx, y0 + jy, cxp + jx, cyp + jy, x1 + jx, y1 + jy,
+                drawQuadBezierBGRA(cv, x0 + jx, y0 + jy, cxp + jx, cyp + jy, x1 + jx, y1 + jy,
                                    v, v, v, a, thick, 24);
             }
         }
@@ -215,7 +120,7 @@ public:
             float cyp = ((y0 + y1) * 0.5f) + (float)rng.randint(-30, 30);
             uint8_t v = randGray(0, 25);
             uint8_t a = (uint8_t)rng.randint(110, 180);
-            drawQuadBezierBGRA(buf, ctx.width, ctx.height, x0 + jx, y0 + jy, cxp + jx, cyp + jy, x1 + jx, y1 + jy,
+            drawQuadBezierBGRA(cv, x0 + jx, y0 + jy, cxp + jx, cyp + jy, x1 + jx, y1 + jy,
                                v, v, v, a, 1, 40);
         } else if (rare < 0.08) {
             // Smudge: big faint circle
@@ -224,7 +129,7 @@ public:
             float rad = (float)rng.randint(std::max(20, ctx.width/20), std::max(30, ctx.width/10));
             uint8_t v = randGray(20, 60);
             uint8_t a = (uint8_t)rng.randint(25, 50); // 10%-20%
-            fillCircleBGRA(buf, ctx.width, ctx.height, cxp, cyp, rad, v, v, v, a);
+            fillCircleBGRA(cv, cxp, cyp, rad, v, v, v, a);
         }
 
         // No internal state to keep for seamless loop
@@ -244,7 +149,7 @@ public:
         m_w = ctx.width; m_h = ctx.height;
         m_seedBase = 99123u;
     }
-    void drawBGRA(std::vector<uint8_t>& buf, int frame, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) override {
         int tf = std::max(1, ctx.totalFrames());
         int f = int(frame * ctx.speed) % tf;
         RNG rng(m_seedBase + (uint32_t)f);
@@ -266,7 +171,7 @@ public:
             float rad = rmin + (float)rng.uniform01() * std::max(0.0f, rmax - rmin);
             uint8_t v = (uint8_t)rng.randint(200, 255); // light
             uint8_t a = (uint8_t)rng.randint(150, 230);  // 60%..90%
-            fillCircleBGRA(buf, ctx.width, ctx.height, cx, cy, rad, v, v, v, a);
+            fillCircleBGRA(cv, cx, cy, rad, v, v, v, a);
         }
 
         // Very few scratches: thinner and lighter
@@ -284,11 +189,11 @@ public:
             if (rng.uniform01() < 0.35) {
                 float cxp = (x0 + x1) * 0.5f + (float)rng.randint(-8, 8);
                 float cyp = (y0 + y1) * 0.5f + (float)rng.randint(-8, 8);
-                drawQuadBezierBGRA(buf, ctx.width, ctx.height,
+                drawQuadBezierBGRA(cv,
                                    x0 + jx, y0 + jy, cxp + jx, cyp + jy, x1 + jx, y1 + jy,
                                    v, v, v, a, thick, 20);
             } else {
-                drawLineBGRA(buf, ctx.width, ctx.height, x0 + jx, y0 + jy, x1 + jx, y1 + jy, v, v, v, a, thick);
+                drawLineBGRA(cv, x0 + jx, y0 + jy, x1 + jx, y1 + jy, v, v, v, a, thick);
             }
         }
     }
@@ -332,7 +237,7 @@ public:
         }
         m_frame = 0;
     }
-    void drawBGRA(std::vector<uint8_t>& buf, int frame, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) override {
         float ff = frame * ctx.speed;
         for (auto& p : m_particles) {
             p.baseX += p.vx; p.baseY += p.vy;
@@ -342,7 +247,7 @@ public:
             float y = std::fmod(p.baseY + oy, (float)ctx.height);
             if (x < 0) x += ctx.width; if (y < 0) y += ctx.height;
             uint8_t a = (uint8_t)std::clamp(int(p.opacity * 255), 0, 255);
-            fillCircleBGRA(buf, ctx.width, ctx.height, x, y, p.radius, p.r, p.g, p.b, a);
+            fillCircleBGRA(cv, x, y, p.radius, p.r, p.g, p.b, a);
         }
         m_frame = (m_frame+1) % ctx.totalFrames();
     }
@@ -372,17 +277,21 @@ public:
             m_drops.push_back(d);
         }
     }
-    void drawBGRA(std::vector<uint8_t>& buf, int, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int, const EffectContext& ctx) override {
         // Simple line drawing using vertical segments
         for (auto& d : m_drops) {
             d.y += d.vy * ctx.speed;
             float y = std::fmod(d.y, (float)ctx.height);
             if (y < 0) y += ctx.height;
             int x = (int)std::round(d.x);
+            if (ctx.motionBlur) {
+                drawStreakVBGRA(cv, x, y, d.length, d.vy * ctx.speed, 174,194,224,128);
+                continue;
+            }
             int y0 = (int)std::round(y);
             int y1 = (int)std::round(y + d.length);
             for (int yy=y0; yy<=y1; ++yy) {
-                putPixelBGRA(buf, ctx.width, ctx.height, x, yy % ctx.height, 174,194,224,128);
+                putPixelBGRA(cv, x, yy % ctx.height, 174,194,224,128);
             }
         }
     }
@@ -412,13 +321,18 @@ public:
             m_particles.push_back(p);
         }
     }
-    void drawBGRA(std::vector<uint8_t>& buf, int, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int, const EffectContext& ctx) override {
         for (auto& p : m_particles) {
             p.x += p.vx * ctx.speed; p.y += p.vy * ctx.speed;
             float x = std::fmod(p.x, (float)ctx.width); if (x<0) x+=ctx.width;
             float y = std::fmod(p.y, (float)ctx.height); if (y<0) y+=ctx.height;
             uint8_t a = (uint8_t)std::clamp(int(p.opacity * 255), 0, 255);
-            fillCircleBGRA(buf, ctx.width, ctx.height, x, y, p.radius, 255,255,255, a);
+            if (ctx.motionBlur) {
+                // Swept from where the flake was at the previous frame
+                fillCapsuleBGRA(cv, x - p.vx * ctx.speed, y - p.vy * ctx.speed, x, y, p.radius, 255,255,255, a);
+            } else {
+                fillCircleBGRA(cv, x, y, p.radius, 255,255,255, a);
+            }
         }
     }
 private:
@@ -450,7 +364,7 @@ public:
         }
         m_frame = 0;
     }
-    void drawBGRA(std::vector<uint8_t>& buf, int frame, const EffectContext& ctx) override {
+    void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) override {
         float ff = frame * ctx.speed;
         for (auto& p : m_particles) {
             p.x += p.vx * ctx.speed; p.y += p.vy * ctx.speed;
@@ -458,7 +372,7 @@ public:
             float y = std::fmod(p.y, (float)ctx.height); if (y<0) y+=ctx.height;
             float opacity = 0.5f + std::sin(p.blinkOffset + ff * p.blinkSpeed) * 0.5f;
             uint8_t a = (uint8_t)std::clamp(int(opacity * 255), 0, 255);
-            fillCircleBGRA(buf, ctx.width, ctx.height, x, y, p.radius, 223,255,100, a);
+            fillCircleBGRA(cv, x, y, p.radius, 223,255,100, a);
         }
         m_frame = (m_frame+1) % ctx.totalFrames();
     }
@@ -470,12 +384,40 @@ private:
 
 // ---------------------- Renderer ----------------------
 
+static std::unique_ptr<Effect> CreateEffect(const std::string& name) {
+    if (name == "black-noise") return std::make_unique<EffectBlackNoise>();
+    if (name == "white-noise") return std::make_unique<EffectWhiteNoise>();
+    if (name == "golden-lights") return std::make_unique<EffectGoldenLights>();
+    if (name == "rain") return std::make_unique<EffectRain>();
+    if (name == "snow") return std::make_unique<EffectSnow>();
+    if (name == "fireflies") return std::make_unique<EffectFireflies>();
+    if (auto scripted = CreateScriptEffect(name)) return scripted;
+    return std::make_unique<EffectGoldenLights>();
+}
+
+std::vector<std::string> Renderer::BuiltInEffectNames() {
+    return {"black-noise", "white-noise", "golden-lights", "rain", "snow", "fireflies"};
+}
+
 Renderer::Renderer(int w, int h) {
     m_ctx.width = w; m_ctx.height = h; m_ctx.duration = 12; m_ctx.fps = 30; m_ctx.density = 50;
     m_bgra.resize(size_t(w*h*4), 0);
+    m_layers.resize(1);
+    m_layers[0].desc = DefaultLayerForEffect("golden-lights");
 }
 
-void Renderer::SetEffect(const std::string& name) { m_effectName = name; }
+void Renderer::SetEffect(const std::string& name) {
+    LayerDesc& d = m_layers[0].desc;
+    d.effect = name;
+    d.glow = DefaultGlowForEffect(name);
+}
+void Renderer::AddLayer(const LayerDesc& layer) {
+    Layer l;
+    l.desc = layer;
+    l.desc.opacity = std::clamp(layer.opacity, 0.0f, 1.0f);
+    m_layers.push_back(std::move(l));
+}
+void Renderer::ClearLayers() { m_layers.resize(1); }
 void Renderer::SetDuration(int sec) { m_ctx.duration = std::clamp(sec, 10, 20); }
 void Renderer::SetFPS(int fps) { m_ctx.fps = std::clamp(fps, 1, 120); }
 void Renderer::SetDensity(int density) { m_ctx.density = std::clamp(density, 1, 100); }
@@ -489,28 +431,239 @@ void Renderer::SetSizeMax(float px) {
     if (m_ctx.sizeMax < m_ctx.sizeMin) m_ctx.sizeMin = m_ctx.sizeMax;
 }
 
+void Renderer::SetGlow(const GlowParams& glow) {
+    GlowParams& g = m_layers[0].desc.glow;
+    g.intensity = std::clamp(glow.intensity, 0.0f, 4.0f);
+    g.radius = std::clamp(glow.radius, 0.0f, 128.0f);
+}
+
+void Renderer::SetMotionBlur(bool on) { m_ctx.motionBlur = on; }
+
+void Renderer::SetStripRows(int rows) {
+    // Even, so strips and the glow's 2x2 downsample line up
+    m_stripRows = rows > 0 ? std::min(m_ctx.height, rows + (rows & 1)) : 0;
+    m_bgra.assign(size_t(m_ctx.width) * (m_stripRows ? m_stripRows : m_ctx.height) * 4, 0);
+    m_bgra.shrink_to_fit();
+}
+
+bool Renderer::StatsAvailable() {
+#ifdef GENFX_RENDER_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Renderer::SetStatsEnabled(bool on) {
+    m_statsEnabled = on && StatsAvailable();
+    for (auto& l : m_layers) l.stats.Reset(m_statsEnabled ? m_ctx.width : 0, m_statsEnabled ? m_ctx.height : 0);
+}
+void Renderer::SetBlendMode(BlendMode mode) { m_layers[0].desc.particles = mode; }
+void Renderer::SetHighPrecision(bool on) { m_layers[0].desc.highPrecision = on; }
+
+GlowParams Renderer::DefaultGlowForEffect(const std::string& name) {
+    GlowParams g;
+    if (name == "golden-lights") { g.intensity = 0.8f; g.radius = 12.0f; }
+    else if (name == "fireflies") { g.intensity = 1.0f; g.radius = 8.0f; }
+    return g;
+}
+
+LayerDesc Renderer::DefaultLayerForEffect(const std::string& name) {
+    LayerDesc d;
+    d.effect = name;
+    d.glow = DefaultGlowForEffect(name);
+    return d;
+}
+
 void Renderer::Setup() {
-    if (m_effectName == "black-noise") m_effect = std::make_unique<EffectBlackNoise>();
-    else if (m_effectName == "white-noise") m_effect = std::make_unique<EffectWhiteNoise>();
-    else if (m_effectName == "golden-lights") m_effect = std::make_unique<EffectGoldenLights>();
-    else if (m_effectName == "rain") m_effect = std::make_unique<EffectRain>();
-    else if (m_effectName == "snow") m_effect = std::make_unique<EffectSnow>();
-    else if (m_effectName == "fireflies") m_effect = std::make_unique<EffectFireflies>();
-    else m_effect = std::make_unique<EffectGoldenLights>();
-
-    m_bgra.assign(m_bgra.size(), 0);
+    const size_t bytes = size_t(m_ctx.width) * (m_stripRows ? m_stripRows : m_ctx.height) * 4;
+    for (size_t i = 0; i < m_layers.size(); ++i) {
+        Layer& l = m_layers[i];
+        l.effect = CreateEffect(l.desc.effect);
+        l.effect->setup(m_ctx);
+        l.record.clear();
+        l.immediate = false;
+        if (m_stripRows) l.bgra.clear(); // sized per strip, glow halo included
+        else if (i > 0) l.bgra.assign(bytes, 0);
+    }
+    m_bgra.assign(bytes, 0);
     m_frame = 0;
-    m_effect->setup(m_ctx);
 }
 
-void Renderer::ClearBuffer() {
-    std::fill(m_bgra.begin(), m_bgra.end(), 0);
+void Renderer::BinLayer(Layer& layer) {
+    GENFX_TRACE_SCOPE_ARG("bin primitives", m_frame);
+    // About 256 KB of target per band, so a band's blends stay in L2
+    const size_t bytesPerRow = size_t(m_ctx.width) * (layer.desc.UsesAccumulation() ? 8 : 4);
+    const int rows = (int)std::clamp<size_t>((256u << 10) / std::max<size_t>(1, bytesPerRow), 8, 128);
+    layer.bins.Build(layer.record, m_ctx.height, rows);
+}
+
+void Renderer::RasterizeBins(Layer& layer, const Canvas& cv, int y0, int y1) {
+    if (y1 <= y0) return;
+    const int b0 = y0 / layer.bins.bandRows, b1 = (y1 - 1) / layer.bins.bandRows;
+    if (m_reference) {
+        for (int b = b0; b <= b1; ++b) ReplayDrawBand(layer.record, layer.bins, b, cv, y0, y1);
+        return;
+    }
+    ParallelFor(b1 - b0 + 1, 1, [&](int i0, int i1) {
+        for (int b = b0 + i0; b < b0 + i1; ++b) ReplayDrawBand(layer.record, layer.bins, b, cv, y0, y1);
+    });
+}
+
+// Clear, draw, resolve and glow one layer into 'target' (w*rows*4 BGRA).
+void Renderer::DrawLayer(Layer& layer, std::vector<uint8_t>& target, int top, int rows) {
+    Canvas cv;
+    cv.bgra = &target;
+    cv.width = m_ctx.width;
+    cv.height = m_ctx.height;
+    cv.origin = top;
+    cv.top = top;
+    cv.rows = rows;
+    if (layer.desc.UsesAccumulation()) {
+        // The 8-bit buffer is fully overwritten by the resolve
+        if (layer.accum.size() != target.size()) layer.accum.resize(target.size());
+        std::fill(layer.accum.begin(), layer.accum.end(), 0);
+        cv.accum = layer.accum.data();
+        cv.blend = layer.desc.particles;
+    } else {
+        std::fill(target.begin(), target.end(), 0);
+    }
+    if (m_statsEnabled && !m_stripRows) {
+        layer.stats.Reset(m_ctx.width, m_ctx.height);
+        cv.stats = &layer.stats;
+    }
+    if (m_stripRows) {
+        GENFX_TRACE_SCOPE_ARG("replay strip", top);
+        RasterizeBins(layer, cv, top, top + rows);
+    } else if (!m_binned || layer.immediate || m_reference || cv.stats) {
+        GENFX_TRACE_SCOPE_ARG("draw effect", m_frame);
+        layer.effect->drawBGRA(cv, m_frame, m_ctx);
+    } else {
+        {
+            GENFX_TRACE_SCOPE_ARG("record effect", m_frame);
+            // Per-pixel effects (vignettes, noise) would record more than they save; past
+            // the limit the canvas draws what it has and continues immediately
+            layer.record.clear();
+            cv.record = &layer.record;
+            cv.recordLimit = std::max<size_t>(1u << 16, size_t(m_ctx.width) * m_ctx.height / 16);
+            layer.effect->drawBGRA(cv, m_frame, m_ctx);
+        }
+        if (cv.record) {
+            cv.record = nullptr;
+            BinLayer(layer);
+            GENFX_TRACE_SCOPE_ARG("rasterize bands", m_frame);
+            RasterizeBins(layer, cv, 0, m_ctx.height);
+        } else {
+            layer.immediate = true;
+            layer.record = DrawList();
+        }
+    }
+    if (cv.accum) {
+        // Single quantization step per frame, split in row bands
+        GENFX_TRACE_SCOPE_ARG("resolve accumulation", m_frame);
+        const int w = m_ctx.width;
+        if (m_reference) {
+            ResolveAccum16ToBGRAReference(layer.accum.data(), target.data(), size_t(rows) * w);
+        } else {
+            ParallelFor(rows, 64, [&](int y0, int y1) {
+                size_t o = size_t(y0) * w * 4;
+                ResolveAccum16ToBGRA(layer.accum.data() + o, target.data() + o, size_t(y1 - y0) * w);
+            });
+        }
+    }
+    if (layer.desc.glow.enabled()) {
+        GENFX_TRACE_SCOPE_ARG("glow", m_frame);
+        layer.glowPass.Apply(target, m_ctx.width, rows, layer.desc.glow);
+    }
 }
 
 void Renderer::RenderNextFrame() {
-    if (!m_effect) return;
-    ClearBuffer();
-    m_effect->drawBGRA(m_bgra, m_frame, m_ctx);
+    if (!m_layers[0].effect) return;
+    ParallelForLimit limit(m_reference ? 1 : t_parallelForThreads);
+    ScopedKernels kernels(m_reference ? KernelsFor(CpuIsa::Scalar) : nullptr);
+    if (m_stripRows) {
+        // Strips: the effects run once per frame here, RenderStrip() replays them
+        ParallelFor((int)m_layers.size(), 1, [&](int l0, int l1) {
+            for (int i = l0; i < l1; ++i) {
+                Layer& l = m_layers[i];
+                GENFX_TRACE_SCOPE_ARG("record effect", m_frame);
+                Canvas cv;
+                cv.width = m_ctx.width;
+                cv.height = m_ctx.height;
+                cv.record = &l.record;
+                l.record.clear();
+                l.effect->drawBGRA(cv, m_frame, m_ctx);
+                BinLayer(l);
+            }
+        });
+    } else if (m_layers.size() == 1) {
+        DrawLayer(m_layers[0], m_bgra, 0, m_ctx.height);
+    } else {
+        // Layers are independent until the composite: draw them concurrently,
+        // then fold the overlays onto the base in order, in row bands
+        ParallelFor((int)m_layers.size(), 1, [&](int l0, int l1) {
+            for (int i = l0; i < l1; ++i) {
+                Layer& l = m_layers[i];
+                DrawLayer(l, i == 0 ? m_bgra : l.bgra, 0, m_ctx.height);
+            }
+        });
+        GENFX_TRACE_SCOPE_ARG("composite layers", m_frame);
+        const int w = m_ctx.width;
+        ParallelFor(m_ctx.height, 64, [&](int y0, int y1) {
+            size_t o = size_t(y0) * w * 4;
+            size_t pixels = size_t(y1 - y0) * w;
+            for (size_t i = 1; i < m_layers.size(); ++i) {
+                const Layer& l = m_layers[i];
+                CompositeLayerBGRA(m_bgra.data() + o, l.bgra.data() + o, pixels, l.desc.opacity, l.desc.composite);
+            }
+        });
+        if (m_statsEnabled) {
+            for (size_t i = 1; i < m_layers.size(); ++i) m_layers[0].stats.Merge(m_layers[i].stats);
+        }
+    }
     // advance time by 1 frame (frame index used with speed inside effects)
     m_frame = (m_frame + 1) % m_ctx.totalFrames();
 }
+
+void Renderer::RenderStrip(int index) {
+    if (!m_stripRows || !m_layers[0].effect) return;
+    ParallelForLimit limit(m_reference ? 1 : t_parallelForThreads);
+    ScopedKernels kernels(m_reference ? KernelsFor(CpuIsa::Scalar) : nullptr);
+    const int w = m_ctx.width, h = m_ctx.height;
+    const int top = std::clamp(index * m_stripRows, 0, h);
+    const int rows = std::min(m_stripRows, h - top);
+    const size_t rowBytes = size_t(w) * 4;
+    m_bgra.resize(size_t(rows) * rowBytes);
+    // Each layer draws the strip plus the rows its glow reaches in from the neighbours
+    std::vector<int> tops(m_layers.size());
+    ParallelFor((int)m_layers.size(), 1, [&](int l0, int l1) {
+        for (int i = l0; i < l1; ++i) {
+            Layer& l = m_layers[i];
+            const int halo = GlowPass::HaloRows(l.desc.glow);
+            const int y0 = std::max(0, top - halo), y1 = std::min(h, top + rows + halo);
+            tops[i] = y0;
+            l.bgra.resize(size_t(y1 - y0) * rowBytes);
+            DrawLayer(l, l.bgra, y0, y1 - y0);
+        }
+    });
+    GENFX_TRACE_SCOPE_ARG("composite layers", top);
+    ParallelFor(rows, 64, [&](int y0, int y1) {
+        size_t o = size_t(y0) * rowBytes;
+        size_t pixels = size_t(y1 - y0) * w;
+        auto row = [&](size_t i) { return m_layers[i].bgra.data() + size_t(top - tops[i]) * rowBytes + o; };
+        std::memcpy(m_bgra.data() + o, row(0), pixels * 4);
+        for (size_t i = 1; i < m_layers.size(); ++i) {
+            const Layer& l = m_layers[i];
+            CompositeLayerBGRA(m_bgra.data() + o, row(i), pixels, l.desc.opacity, l.desc.composite);
+        }
+    });
+}
+
+void Renderer::SkipFrame() {
+    if (!m_layers[0].effect) return;
+    // A zero-sized canvas rejects every primitive, so only the effects' updates run
+    Canvas cv;
+    cv.bgra = &m_bgra;
+    for (auto& l : m_layers) l.effect->drawBGRA(cv, m_frame, m_ctx);
+    m_frame = (m_frame + 1) % m_ctx.totalFrames();
+}
@@ -4,6 +4,8 @@
 #include <memory>
 #include <cmath>
 #include "Utils.h"
+#include "Glow.h"
+#include "Raster.h"
 
 struct EffectContext {
     int width{0};
@@ -15,43 +17,138 @@ struct EffectContext {
     int density{50}; // generic slider 1..100
     float sizeMin{1.0f}; // particle min radius (px)
     float sizeMax{8.0f}; // particle max radius (px)
+    bool motionBlur{false}; // rasterize swept shapes along the per-frame velocity (opt-in: ~2-2.7x the render cost of rain/snow)
 };
 
 class Effect {
 public:
     virtual ~Effect() = default;
     virtual void setup(const EffectContext& ctx) = 0;
-    virtual void drawBGRA(std::vector<uint8_t>& buf, int frame, const EffectContext& ctx) = 0;
+    virtual void drawBGRA(Canvas& cv, int frame, const EffectContext& ctx) = 0;
+};
+
+// One entry of the layer stack. Layer 0 is the base effect (configured through the
+// Renderer setters); further layers composite on top of it in order. An empty effect
+// means no layer, so LayerDesc{} is "no overlay".
+struct LayerDesc {
+    std::string effect;
+    float opacity{1.0f};
+    BlendMode composite{BlendMode::Over}; // how the layer lands on the layers below
+    BlendMode particles{BlendMode::Over}; // how primitives blend within the layer
+    bool highPrecision{false};
+    GlowParams glow;
+    bool UsesAccumulation() const { return highPrecision || particles == BlendMode::Additive; }
 };
 
 class Renderer {
 public:
     Renderer(int w, int h);
     void SetEffect(const std::string& name);
+    // Overlay layers, rendered concurrently into their own buffers and composited
+    // over the base effect in the order added. Takes effect on the next Setup().
+    void AddLayer(const LayerDesc& layer);
+    void ClearLayers();
     void SetDuration(int sec);
     void SetFPS(int fps);
     void SetDensity(int density);
     void SetSpeed(float s);
     void SetSizeMin(float px);
     void SetSizeMax(float px);
+    void SetGlow(const GlowParams& glow);
+    void SetMotionBlur(bool on);
+    // Additive always renders through the 16-bit accumulation buffer;
+    // Over uses it only when high precision is requested.
+    void SetBlendMode(BlendMode mode);
+    void SetHighPrecision(bool on);
+    // Scalar reference path: every pass runs on the calling thread with the scalar
+    // pixel kernels, and the accumulation resolve uses the integer code. Slower; the
+    // golden checks (bench/genfx_golden.cpp) hold the optimized paths against it.
+    void SetReference(bool on) { m_reference = on; }
+    bool GetReference() const { return m_reference; }
+    // Binned rasterization (default): each layer's primitives are recorded for the frame,
+    // sorted into cache-sized row bands (DrawBins) and drawn band by band, bands in
+    // parallel, in paint order within each band. Same pixels as drawing them as the
+    // effect issues them, which is what 'off', the reference and the stats view do.
+    void SetBinnedRaster(bool on) { m_binned = on; }
+    bool GetBinnedRaster() const { return m_binned; }
+    // Raster counters per frame (blends per pixel, primitives, clipped pixels) for
+    // the preview's overdraw view. Costs a little per pixel while enabled; without
+    // GENFX_RENDER_STATS the counting is not compiled in and this stays off.
+    static bool StatsAvailable();
+    void SetStatsEnabled(bool on);
+    // Counters of the last RenderNextFrame() over all layers, nullptr when disabled
+    const RenderStats* GetStats() const { return m_statsEnabled ? &m_layers[0].stats : nullptr; }
+
+    // Strip rendering, for frames too large to hold with their 16-bit and glow buffers
+    // (4K, 8K). With 'rows' > 0 (rounded up to even), RenderNextFrame() only runs the
+    // effects and records their primitives; RenderStrip(i) then rasterizes frame rows
+    // [i*rows, i*rows + rows) into the frame buffer, which holds one strip. Memory is
+    // bounded by the strip instead of the frame, and the pixels are exactly those of
+    // whole-frame rendering. 0 = whole frames. Takes effect on the next Setup().
+    void SetStripRows(int rows);
+    int GetStripRows() const { return m_stripRows; }
+    int GetStripCount() const { return m_stripRows ? (m_ctx.height + m_stripRows - 1) / m_stripRows : 1; }
+    void RenderStrip(int index);
 
     void Setup();
     void RenderNextFrame();
+    // Advance every effect by one frame without rasterizing or post-processing,
+    // e.g. to start rendering partway through the loop. State ends up exactly as
+    // after RenderNextFrame().
+    void SkipFrame();
+    int GetFrameIndex() const { return m_frame; }
 
     const std::vector<uint8_t>& GetFrameBuffer() const { return m_bgra; }
+    // Moves the last frame into 'out'; out's old storage becomes the next frame's
+    // buffer (every frame overwrites it completely), so a pipeline can keep frames
+    // around while the next one renders without copying them
+    void TakeFrameBuffer(std::vector<uint8_t>& out) { out.resize(m_bgra.size()); m_bgra.swap(out); }
     int GetWidth() const { return m_ctx.width; }
     int GetHeight() const { return m_ctx.height; }
     int GetFPS() const { return m_ctx.fps; }
     int GetDuration() const { return m_ctx.duration; }
-    const std::string& GetEffectName() const { return m_effectName; }
+    const std::string& GetEffectName() const { return m_layers[0].desc.effect; }
     float GetSpeed() const { return m_ctx.speed; }
+    const GlowParams& GetGlow() const { return m_layers[0].desc.glow; }
+    bool GetMotionBlur() const { return m_ctx.motionBlur; }
+    BlendMode GetBlendMode() const { return m_layers[0].desc.particles; }
+    bool GetHighPrecision() const { return m_layers[0].desc.highPrecision; }
+    bool UsesAccumulation() const { return m_layers[0].desc.UsesAccumulation(); }
+    int GetLayerCount() const { return (int)m_layers.size(); }
+
+    // Effects compiled into the renderer, in menu order (scripted ones come from ScriptEffectNames())
+    static std::vector<std::string> BuiltInEffectNames();
+    // Glow look each built-in effect is designed for (intensity 0 = off)
+    static GlowParams DefaultGlowForEffect(const std::string& name);
+    // LayerDesc with the effect's default glow (every effect blends Over by default)
+    static LayerDesc DefaultLayerForEffect(const std::string& name);
 
 private:
-    void ClearBuffer();
+    struct Layer {
+        LayerDesc desc;
+        std::unique_ptr<Effect> effect;
+        std::vector<uint8_t> bgra;    // overlays only (strips: every layer); else layer 0 draws into m_bgra
+        std::vector<uint16_t> accum;  // premultiplied 16-bit, allocated only when used
+        GlowPass glowPass;
+        RenderStats stats;
+        DrawList record; // the frame's primitives (binned and strip rendering)
+        DrawBins bins;
+        bool immediate{false}; // outgrew the record limit once: drawn as issued from then on
+    };
+
+    // Rows [top, top + rows) of the frame; 'target' holds exactly those
+    void DrawLayer(Layer& layer, std::vector<uint8_t>& target, int top, int rows);
+    // layer.record into layer.bins, bands sized for the layer's target
+    void BinLayer(Layer& layer);
+    // Draws the binned rows [y0, y1) of layer.record onto 'cv', bands in parallel
+    void RasterizeBins(Layer& layer, const Canvas& cv, int y0, int y1);
 
     EffectContext m_ctx;
-    std::string m_effectName{"golden-lights"};
-    std::unique_ptr<Effect> m_effect;
-    std::vector<uint8_t> m_bgra; // size w*h*4
+    std::vector<Layer> m_layers; // never empty
+    std::vector<uint8_t> m_bgra; // size w*h*4, final composited frame
     int m_frame{0};
+    int m_stripRows{0};
+    bool m_reference{false};
+    bool m_binned{true};
+    bool m_statsEnabled{false};
 };
@@ -0,0 +1,58 @@
+#include "ResourceGovernor.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+uint64_t LaneBytes(const ExportLaneCost& cost, int slots, bool keepHead) {
+    const uint64_t head = keepHead ? cost.frameBytes * uint64_t(cost.loopHeadFrames) : cost.rendererBytes;
+    return cost.rendererBytes + cost.frameBytes * uint64_t(slots) + head;
+}
+
+} // namespace
+
+ExportPlan PlanExport(const ExportLimits& limits, const ExportLaneCost& cost, int tasks, int poolWorkers) {
+    const int cores = limits.maxThreads > 0 ? std::min(limits.maxThreads, poolWorkers) : poolWorkers;
+    ExportPlan plan;
+    plan.lanes = std::clamp(tasks, 1, std::max(1, cores));
+    auto bytes = [&]() { return uint64_t(plan.lanes) * LaneBytes(cost, plan.frameSlots, plan.keepLoopHead); };
+    if (limits.memoryBytes > 0) {
+        // Lanes first, sized at the leanest lane; then the second frame slot (overlap of
+        // render and encode all along), then keeping the loop head (saves re-rendering it)
+        plan.frameSlots = 1;
+        plan.keepLoopHead = cost.frameBytes * uint64_t(cost.loopHeadFrames) <= cost.rendererBytes;
+        while (plan.lanes > 1 && bytes() > limits.memoryBytes) --plan.lanes;
+        plan.overBudget = bytes() > limits.memoryBytes;
+        plan.frameSlots = 2;
+        if (bytes() > limits.memoryBytes) plan.frameSlots = 1;
+        const bool lean = plan.keepLoopHead;
+        plan.keepLoopHead = true;
+        if (bytes() > limits.memoryBytes) plan.keepLoopHead = lean;
+    }
+    const int perLane = std::max(1, cores / plan.lanes);
+    plan.encoderThreads = perLane;
+    if (limits.maxThreads > 0) {
+        // Each lane's share covers its encoder too. With two frame slots the encode of
+        // frame i (a pool job plus the encoder's own threads) runs beside the render of
+        // frame i+1, so the share is split between them; that takes at least two threads,
+        // else render and encode take turns on one slot
+        if (plan.frameSlots == 2 && perLane < 2) plan.frameSlots = 1;
+        plan.encoderThreads = plan.frameSlots == 2 ? std::max(1, perLane / 3) : perLane;
+        plan.threadsPerLane = plan.frameSlots == 2 ? perLane - plan.encoderThreads : perLane;
+    }
+    plan.bytes = bytes();
+    return plan;
+}
+
+std::string DescribeExportPlan(const ExportPlan& plan) {
+    std::ostringstream d;
+    d << plan.lanes << (plan.lanes == 1 ? " lane, " : " lanes, ") << plan.frameSlots
+      << (plan.frameSlots == 1 ? " frame slot, " : " frame slots, ")
+      << (plan.keepLoopHead ? "loop head kept" : "loop head re-rendered") << ", "
+      << (plan.threadsPerLane > 0 ? std::to_string(plan.threadsPerLane) : std::string("all"))
+      << (plan.threadsPerLane == 1 ? " render thread per lane, " : " render threads per lane, ")
+      << plan.encoderThreads << (plan.encoderThreads == 1 ? " encoder thread, ~" : " encoder threads, ~")
+      << (plan.bytes + (1u << 20) - 1) / (1u << 20) << " MB";
+    if (plan.overBudget) d << " (over the memory budget: the largest output does not fit in one lane)";
+    return d.str();
+}
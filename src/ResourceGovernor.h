@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// What an export may use on a shared machine (ExportJob::limits); 0 = no limit
+struct ExportLimits {
+    uint64_t memoryBytes{0}; // renderers and frames in flight
+    int maxThreads{0};       // threads rendering and encoding at once: pool workers, encoder and ffmpeg threads
+    int niceness{0};         // 0..19 as in nice(1): CPU and I/O priority of ffmpeg child processes
+};
+
+// What one lane of the export pipeline holds for the largest output
+struct ExportLaneCost {
+    uint64_t frameBytes{0};    // one BGRA frame
+    uint64_t rendererBytes{0}; // a configured renderer, its frame buffer included
+    int loopHeadFrames{0};     // frames the closing crossfade needs from the start of the loop
+};
+
+// How the export pipeline is sized to fit the limits
+struct ExportPlan {
+    int lanes{1};            // renderers walking through the outputs concurrently
+    int frameSlots{2};       // frames between render and encode per lane; 1 = no overlap
+    bool keepLoopHead{true}; // keep the loop's first frames, else re-render them beside the tail
+    int threadsPerLane{0};   // ParallelFor() limit for a lane's rendering, 0 = none
+    int encoderThreads{1};   // per encoder, its pool job included; with a thread limit, the
+                             // lane's share not rendering (two slots) or all of it (one slot)
+    uint64_t bytes{0};       // estimated peak
+    bool overBudget{false};  // not even one lane with one slot fits; runs like that anyway
+};
+
+// Largest plan within 'limits' for 'tasks' segments on a pool of 'poolWorkers'. Memory
+// goes first to lanes (parallelism), then to the second frame slot, then to keeping the
+// loop head rather than rendering it again with a second renderer. A thread limit is
+// shared out per lane between rendering and the encoder working beside it, so
+// lanes * (threadsPerLane + encoderThreads) stays within it with two slots, and
+// lanes * max(threadsPerLane, encoderThreads) with one.
+ExportPlan PlanExport(const ExportLimits& limits, const ExportLaneCost& cost, int tasks, int poolWorkers);
+
+// One line for the console, e.g. "2 lanes, 2 frame slots, loop head re-rendered, 3 render
+// threads per lane, 1 encoder thread, ~850 MB"
+std::string DescribeExportPlan(const ExportPlan& plan);
@@ -0,0 +1,440 @@
+#include "SpriteAtlas.h"
+#include "PngEncoder.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// One kept frame, trimmed to its alpha bounding box
+struct Sprite {
+    int index{0};            // loop frame index
+    int srcX{0}, srcY{0};    // trimmed rectangle inside the frame
+    int w{0}, h{0};
+    uint64_t hash{0};
+    std::vector<uint8_t> bgra;
+    // Placement, filled by the packer
+    int page{-1}, x{0}, y{0};
+    int same{-1};            // index of an identical earlier sprite
+};
+
+uint64_t HashBytes(const uint8_t* p, size_t n) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+int NextPow2(int v) {
+    int p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+Sprite TrimFrame(const uint8_t* bgra, int w, int h, int index) {
+    Sprite s;
+    s.index = index;
+    int x0 = w, y0 = h, x1 = 0, y1 = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = bgra + size_t(y) * w * 4;
+        int l = 0;
+        while (l < w && row[l * 4 + 3] == 0) ++l;
+        if (l == w) continue;
+        int r = w - 1;
+        while (row[r * 4 + 3] == 0) --r;
+        x0 = std::min(x0, l);
+        x1 = std::max(x1, r + 1);
+        y0 = std::min(y0, y);
+        y1 = y + 1;
+    }
+    if (x1 <= x0) return s; // fully transparent
+    s.srcX = x0;
+    s.srcY = y0;
+    s.w = x1 - x0;
+    s.h = y1 - y0;
+    s.bgra.resize(size_t(s.w) * s.h * 4);
+    for (int y = 0; y < s.h; ++y) {
+        std::memcpy(s.bgra.data() + size_t(y) * s.w * 4, bgra + (size_t(y0 + y) * w + x0) * 4, size_t(s.w) * 4);
+    }
+    s.hash = HashBytes(s.bgra.data(), s.bgra.size());
+    return s;
+}
+
+struct Page { int w{0}, h{0}; };
+
+// Shelf packing, tallest first. Each sprite gets a 1px transparent border so bilinear
+// sampling never bleeds into its neighbours.
+bool PackSprites(std::vector<Sprite>& sprites, int maxPage, std::vector<Page>& pages, std::string& err) {
+    int largest = 1;
+    std::vector<int> order;
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        const Sprite& s = sprites[i];
+        if (s.w == 0 || s.same >= 0) continue;
+        largest = std::max(largest, std::max(s.w, s.h) + 2);
+        order.push_back((int)i);
+    }
+    const int side = std::max(NextPow2(std::max(1, maxPage)), NextPow2(largest));
+    if (side > 16384) { err = "Sprite atlas: frames are too large for a 16384px page"; return false; }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sprites[a].h > sprites[b].h; });
+
+    int shelfY = 0, shelfH = 0, cursorX = 0;
+    for (int i : order) {
+        Sprite& s = sprites[i];
+        const int cw = s.w + 2, ch = s.h + 2;
+        if (pages.empty()) pages.push_back({});
+        if (cursorX + cw > side) { shelfY += shelfH; shelfH = 0; cursorX = 0; }
+        if (shelfY + ch > side) { pages.push_back({}); shelfY = 0; shelfH = 0; cursorX = 0; }
+        s.page = (int)pages.size() - 1;
+        s.x = cursorX + 1;
+        s.y = shelfY + 1;
+        cursorX += cw;
+        shelfH = std::max(shelfH, ch);
+        Page& p = pages.back();
+        p.w = std::max(p.w, cursorX);
+        p.h = std::max(p.h, shelfY + shelfH);
+    }
+    // Shrink every page to the smallest power of two that holds its sprites
+    for (Page& p : pages) { p.w = NextPow2(p.w); p.h = NextPow2(p.h); }
+    for (Sprite& s : sprites) {
+        if (s.same < 0) continue;
+        const Sprite& o = sprites[size_t(s.same)];
+        s.page = o.page; s.x = o.x; s.y = o.y;
+    }
+    return true;
+}
+
+// 256-entry palette (entry 0 = transparent) by median cut over a 5:5:5:4-bit RGBA
+// histogram of every stored sprite; returns a bucket -> palette index map.
+constexpr int kBucketBits = 19;
+
+inline uint32_t BucketOf(const uint8_t* px) {
+    return (uint32_t(px[2] >> 3) << 14) | (uint32_t(px[1] >> 3) << 9) | (uint32_t(px[0] >> 3) << 4) | (px[3] >> 4);
+}
+
+inline void BucketCenter(uint32_t b, int c[4]) {
+    c[0] = int(((b >> 14) & 31) << 3) + 4; // r
+    c[1] = int(((b >> 9) & 31) << 3) + 4;  // g
+    c[2] = int(((b >> 4) & 31) << 3) + 4;  // b
+    c[3] = int((b & 15) << 4) + 8;         // a
+}
+
+void BuildPalette(const std::vector<Sprite>& sprites, std::vector<uint8_t>& paletteRGBA, std::vector<uint8_t>& lut) {
+    // Histogram, one per chunk of sprites
+    const int chunks = std::clamp((int)sprites.size(), 1, JobWorkerCount());
+    std::vector<std::vector<uint32_t>> hist{size_t(chunks)};
+    ParallelFor(chunks, 1, [&](int c0, int c1) {
+        for (int c = c0; c < c1; ++c) {
+            auto& hc = hist[size_t(c)];
+            hc.assign(size_t(1) << kBucketBits, 0);
+            const size_t s0 = sprites.size() * size_t(c) / size_t(chunks), s1 = sprites.size() * size_t(c + 1) / size_t(chunks);
+            for (size_t i = s0; i < s1; ++i) {
+                const Sprite& s = sprites[i];
+                if (s.same >= 0) continue;
+                for (size_t p = 0; p < s.bgra.size(); p += 4) {
+                    if (s.bgra[p + 3]) hc[BucketOf(&s.bgra[p])]++;
+                }
+            }
+        }
+    });
+    struct Color { int c[4]; uint32_t bucket; uint64_t n; };
+    std::vector<Color> colors;
+    for (uint32_t b = 0; b < (1u << kBucketBits); ++b) {
+        uint64_t n = 0;
+        for (const auto& hc : hist) n += hc[b];
+        if (!n) continue;
+        Color col{};
+        BucketCenter(b, col.c);
+        col.bucket = b;
+        col.n = n;
+        colors.push_back(col);
+    }
+
+    // Median cut into up to 255 boxes; a box's score is its widest channel range
+    // weighted by sqrt(pixel count)
+    struct Box { size_t begin, end; int axis; double score; };
+    auto makeBox = [&](size_t begin, size_t end) {
+        Box bx{begin, end, 0, 0.0};
+        if (end - begin < 2) return bx;
+        int best = -1;
+        for (int a = 0; a < 4; ++a) {
+            int lo = 255, hi = 0;
+            for (size_t i = begin; i < end; ++i) { lo = std::min(lo, colors[i].c[a]); hi = std::max(hi, colors[i].c[a]); }
+            if (hi - lo > best) { best = hi - lo; bx.axis = a; }
+        }
+        uint64_t n = 0;
+        for (size_t i = begin; i < end; ++i) n += colors[i].n;
+        bx.score = double(best) * std::sqrt(double(n));
+        return bx;
+    };
+    std::vector<Box> boxes;
+    if (!colors.empty()) boxes.push_back(makeBox(0, colors.size()));
+    while (boxes.size() < 255) {
+        auto it = std::max_element(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) { return a.score < b.score; });
+        if (it == boxes.end() || it->score <= 0.0) break;
+        const Box bx = *it;
+        const int axis = bx.axis;
+        std::sort(colors.begin() + bx.begin, colors.begin() + bx.end,
+                  [axis](const Color& a, const Color& b) { return a.c[axis] < b.c[axis]; });
+        uint64_t total = 0, acc = 0;
+        for (size_t k = bx.begin; k < bx.end; ++k) total += colors[k].n;
+        size_t mid = bx.begin + 1;
+        for (size_t k = bx.begin; k < bx.end - 1; ++k) {
+            acc += colors[k].n;
+            mid = k + 1;
+            if (acc * 2 >= total) break;
+        }
+        *it = makeBox(bx.begin, mid);
+        boxes.push_back(makeBox(mid, bx.end));
+    }
+
+    paletteRGBA.assign(size_t(1 + boxes.size()) * 4, 0);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        double sum[4] = {0, 0, 0, 0};
+        uint64_t n = 0;
+        for (size_t k = boxes[i].begin; k < boxes[i].end; ++k) {
+            for (int a = 0; a < 4; ++a) sum[a] += double(colors[k].c[a]) * double(colors[k].n);
+            n += colors[k].n;
+        }
+        for (int a = 0; a < 4; ++a) paletteRGBA[(i + 1) * 4 + a] = (uint8_t)std::clamp(int(sum[a] / double(n) + 0.5), 0, 255);
+    }
+
+    // Nearest entry per used bucket, compared premultiplied so faint pixels match loosely
+    lut.assign(size_t(1) << kBucketBits, 0);
+    const int entries = (int)paletteRGBA.size() / 4;
+    ParallelFor((int)colors.size(), 256, [&](int b0, int b1) {
+        for (int i = b0; i < b1; ++i) {
+            const Color& col = colors[size_t(i)];
+            int best = 1;
+            long long bestD = -1;
+            for (int e = 1; e < entries; ++e) {
+                const uint8_t* p = &paletteRGBA[size_t(e) * 4];
+                long long d = 0;
+                for (int a = 0; a < 3; ++a) {
+                    long long v = (long long)col.c[a] * col.c[3] / 255 - (long long)p[a] * p[3] / 255;
+                    d += v * v;
+                }
+                long long da = col.c[3] - p[3];
+                d += 2 * da * da;
+                if (bestD < 0 || d < bestD) { bestD = d; best = e; }
+            }
+            lut[col.bucket] = (uint8_t)best;
+        }
+    });
+}
+
+bool WriteAtlas(std::vector<Sprite>& sprites, const EncoderSettings& es, const std::string& jsonPath,
+                uint64_t& bytes, std::vector<std::string>& pagePaths, std::string& err) {
+    std::sort(sprites.begin(), sprites.end(), [](const Sprite& a, const Sprite& b) { return a.index < b.index; });
+    // Identical frames (static stretches, exact loops) share one rectangle
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        Sprite& s = sprites[i];
+        if (s.w == 0) continue;
+        for (size_t j = 0; j < i; ++j) {
+            const Sprite& o = sprites[j];
+            if (o.same < 0 && o.w == s.w && o.h == s.h && o.hash == s.hash && o.bgra == s.bgra) {
+                s.same = (int)j;
+                s.bgra.clear();
+                s.bgra.shrink_to_fit();
+                break;
+            }
+        }
+    }
+    std::vector<Page> pages;
+    if (!PackSprites(sprites, es.atlasMaxPage, pages, err)) return false;
+
+    std::vector<uint8_t> palette, lut;
+    if (es.atlasIndexed) BuildPalette(sprites, palette, lut);
+
+    const std::filesystem::path jp(jsonPath);
+    const std::string stem = jp.stem().string();
+    std::vector<std::string> files(pages.size());
+    std::vector<uint64_t> sizes(pages.size(), 0);
+    pagePaths.assign(pages.size(), std::string());
+    std::mutex errMutex;
+    // One page per task: blit (and quantize) its sprites, then PNG-encode it
+    ParallelFor((int)pages.size(), 1, [&](int p0, int p1) {
+        for (int p = p0; p < p1; ++p) {
+            const Page& pg = pages[size_t(p)];
+            const int bpp = es.atlasIndexed ? 1 : 4;
+            std::vector<uint8_t> px(size_t(pg.w) * pg.h * bpp, 0);
+            for (const Sprite& s : sprites) {
+                if (s.page != p || s.same >= 0 || s.w == 0) continue;
+                for (int y = 0; y < s.h; ++y) {
+                    const uint8_t* src = s.bgra.data() + size_t(y) * s.w * 4;
+                    uint8_t* dst = px.data() + (size_t(s.y + y) * pg.w + s.x) * bpp;
+                    if (!es.atlasIndexed) { std::memcpy(dst, src, size_t(s.w) * 4); continue; }
+                    for (int x = 0; x < s.w; ++x, src += 4) dst[x] = src[3] ? lut[BucketOf(src)] : 0;
+                }
+            }
+            std::vector<uint8_t> png;
+            const bool ok = es.atlasIndexed
+                ? EncodeIndexedPNG(px.data(), pg.w, pg.h, palette.data(), (int)palette.size() / 4, png)
+                : EncodePNGFromBGRA(px.data(), pg.w, pg.h, png);
+            char name[32];
+            std::snprintf(name, sizeof(name), "-%d.png", p);
+            files[size_t(p)] = stem + name;
+            const std::filesystem::path path = jp.parent_path() / files[size_t(p)];
+            pagePaths[size_t(p)] = path.string();
+            std::error_code ec;
+            std::filesystem::remove(path, ec); // may be a hardlink into the export cache
+            std::ofstream ofs(path, std::ios::binary);
+            if (ok && ofs) ofs.write(reinterpret_cast<const char*>(png.data()), (std::streamsize)png.size());
+            if (!ok || !ofs.good()) {
+                std::lock_guard<std::mutex> lock(errMutex);
+                err = "Failed to write atlas page " + path.string();
+            }
+            sizes[size_t(p)] = png.size();
+        }
+    });
+    if (!err.empty()) return false;
+
+    const int step = std::max(1, es.atlasFrameStep);
+    std::ostringstream js;
+    js << "{\n  \"width\": " << es.width << ",\n  \"height\": " << es.height
+       << ",\n  \"fps\": " << double(es.fps) / step << ",\n  \"frameStep\": " << step
+       << ",\n  \"frameCount\": " << sprites.size()
+       << ",\n  \"format\": \"" << (es.atlasIndexed ? "indexed8" : "rgba8") << "\",\n";
+    if (es.atlasIndexed) {
+        js << "  \"palette\": [";
+        for (size_t i = 0; i < palette.size() / 4; ++i) {
+            char hex[16];
+            std::snprintf(hex, sizeof(hex), "\"%02x%02x%02x%02x\"", palette[i * 4], palette[i * 4 + 1], palette[i * 4 + 2], palette[i * 4 + 3]);
+            js << (i ? ", " : "") << hex;
+        }
+        js << "],\n";
+    }
+    js << "  \"pages\": [\n";
+    for (size_t p = 0; p < pages.size(); ++p) {
+        js << "    { \"file\": \"" << files[p] << "\", \"width\": " << pages[p].w << ", \"height\": " << pages[p].h << " }"
+           << (p + 1 < pages.size() ? ",\n" : "\n");
+    }
+    js << "  ],\n  \"frames\": [\n";
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        const Sprite& s = sprites[i];
+        js << "    { \"index\": " << s.index << ", \"page\": " << s.page << ", \"x\": " << s.x << ", \"y\": " << s.y
+           << ", \"w\": " << s.w << ", \"h\": " << s.h << ", \"offsetX\": " << s.srcX << ", \"offsetY\": " << s.srcY << " }"
+           << (i + 1 < sprites.size() ? ",\n" : "\n");
+    }
+    js << "  ]\n}\n";
+    const std::string json = js.str();
+    std::ofstream ofs(jsonPath, std::ios::binary);
+    if (ofs) ofs.write(json.data(), (std::streamsize)json.size());
+    if (!ofs.good()) { err = "Failed to write " + jsonPath; return false; }
+    bytes = std::accumulate(sizes.begin(), sizes.end(), uint64_t(json.size()));
+    return true;
+}
+
+class SpriteAtlasEncoder : public VideoEncoder {
+public:
+    // 'collect' keeps the trimmed frames for a SegmentedOutput instead of writing the atlas
+    explicit SpriteAtlasEncoder(bool collect = false) : m_collect(collect) {}
+
+    bool Open(const std::string& outPath, const EncoderSettings& settings, std::string&) override {
+        m_path = outPath;
+        m_settings = settings;
+        m_index = settings.firstFrame;
+        m_stats = EncoderStats{};
+        m_sprites.clear();
+        return true;
+    }
+
+    bool WriteFrame(const uint8_t* bgra, std::string&) override {
+        auto t0 = std::chrono::steady_clock::now();
+        if (m_index % std::max(1, m_settings.atlasFrameStep) == 0) {
+            m_sprites.push_back(TrimFrame(bgra, m_settings.width, m_settings.height, m_index));
+        }
+        ++m_index;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_stats.frames++;
+        m_stats.frameMs += ms;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, ms);
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        if (m_collect) return true;
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::string> pages;
+        if (!WriteAtlas(m_sprites, m_settings, m_path, m_stats.bytes, pages, err)) return false;
+        m_sprites.clear();
+        m_stats.finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    const char* Name() const override { return "sprite atlas"; }
+
+    std::vector<Sprite> TakeSprites() { return std::move(m_sprites); }
+
+private:
+    bool m_collect{false};
+    std::string m_path;
+    EncoderSettings m_settings;
+    int m_index{0};
+    std::vector<Sprite> m_sprites;
+};
+
+class SpriteAtlasOutput : public SegmentedOutput {
+public:
+    bool Open(const std::string& outPath, const EncoderSettings& settings, int segments, std::string&) override {
+        m_path = outPath;
+        m_settings = settings;
+        m_done.assign(size_t(std::max(1, segments)), false);
+        m_sprites.clear();
+        m_bytes = 0;
+        return true;
+    }
+
+    std::unique_ptr<VideoEncoder> BeginSegment(int, int firstFrame, std::string& err) override {
+        auto enc = std::make_unique<SpriteAtlasEncoder>(true);
+        EncoderSettings s = m_settings;
+        s.firstFrame = firstFrame;
+        if (!enc->Open(std::string(), s, err)) return nullptr;
+        return enc;
+    }
+
+    bool EndSegment(int index, std::unique_ptr<VideoEncoder> encoder, std::string& err) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int)m_done.size() || m_done[size_t(index)]) {
+            err = "Invalid segment index";
+            return false;
+        }
+        for (auto& s : static_cast<SpriteAtlasEncoder&>(*encoder).TakeSprites()) m_sprites.push_back(std::move(s));
+        m_done[size_t(index)] = true;
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        for (bool d : m_done) {
+            if (!d) { err = "Export ended with unfinished segments"; return false; }
+        }
+        const bool ok = WriteAtlas(m_sprites, m_settings, m_path, m_bytes, m_pages, err);
+        m_sprites.clear();
+        return ok;
+    }
+
+    const char* Name() const override { return "sprite atlas"; }
+    uint64_t Bytes() const override { return m_bytes; }
+    std::vector<std::string> SideFiles() const override { return m_pages; }
+
+private:
+    std::string m_path;
+    EncoderSettings m_settings;
+    std::mutex m_mutex;
+    std::vector<bool> m_done;
+    std::vector<Sprite> m_sprites;
+    std::vector<std::string> m_pages;
+    uint64_t m_bytes{0};
+};
+
+} // namespace
+
+std::unique_ptr<VideoEncoder> CreateSpriteAtlasEncoder() { return std::make_unique<SpriteAtlasEncoder>(); }
+std::unique_ptr<SegmentedOutput> CreateSpriteAtlasOutput() { return std::make_unique<SpriteAtlasOutput>(); }
@@ -0,0 +1,19 @@
+#pragma once
+#include "VideoEncoder.h"
+
+// Sprite-sheet export for real-time engines: frames (optionally every Nth, see
+// EncoderSettings::atlasFrameStep) are trimmed to their alpha bounding box, identical
+// frames are stored once, and everything is shelf-packed into power-of-two PNG pages
+// (at most atlasMaxPage, grown to fit the largest frame). The output path is the JSON
+// metadata; pages are written next to it as "<stem>-N.png". With atlasIndexed the
+// pages are 8-bit palette PNGs (one 256-entry RGBA palette shared by every page).
+//
+// JSON: { "width", "height", "fps", "frameStep", "frameCount", "format",
+//         "palette": ["rrggbbaa", ...]            (indexed only)
+//         "pages":  [{ "file", "width", "height" }],
+//         "frames": [{ "index", "page", "x", "y", "w", "h", "offsetX", "offsetY" }] }
+// A fully transparent frame has page -1 and w = h = 0. offsetX/Y place the trimmed
+// rectangle inside the width x height frame.
+std::unique_ptr<VideoEncoder> CreateSpriteAtlasEncoder();
+// Segments trim their frames concurrently; packing happens at Finish()
+std::unique_ptr<SegmentedOutput> CreateSpriteAtlasOutput();
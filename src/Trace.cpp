@@ -0,0 +1,190 @@
+#include "Trace.h"
+
+#ifdef GENFX_TRACING
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> g_traceEnabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durNs;
+    int64_t arg;
+};
+
+constexpr size_t kRingEvents = 1 << 15; // ~1 MB per thread; the oldest events are overwritten
+
+// One thread's events. Only the owning thread writes; 'head' is published with
+// release so the dump sees complete events.
+struct TraceRing {
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(kRingEvents);
+    std::atomic<uint64_t> head{0};
+    uint32_t generation{0}; // session the events belong to
+    std::string name;
+    int tid{0};
+};
+
+std::mutex g_mutex;                             // registry only, never taken while recording
+std::vector<std::unique_ptr<TraceRing>> g_rings; // all rings ever made; tid = index + 1
+std::vector<TraceRing*> g_free;                 // rings of exited threads, reused by new ones
+std::atomic<uint32_t> g_generation{0};
+std::atomic<int64_t> g_epochNs{0}; // steady_clock time of TraceBegin()
+
+// Threads hand their ring back on exit, so lanes are reused instead of allocating a
+// ring per thread
+struct RingHolder {
+    TraceRing* ring{nullptr};
+    std::string defaultName;
+    ~RingHolder() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_free.push_back(ring);
+    }
+};
+thread_local RingHolder t_ring;
+
+// Caller holds g_mutex. 'reusable' decides which parked rings may be taken.
+template <typename Pred>
+TraceRing* TakeRing(Pred reusable) {
+    for (size_t i = 0; i < g_free.size(); ++i) {
+        if (!reusable(*g_free[i])) continue;
+        TraceRing* ring = g_free[i];
+        g_free.erase(g_free.begin() + (std::ptrdiff_t)i);
+        return ring;
+    }
+    g_rings.push_back(std::make_unique<TraceRing>());
+    TraceRing* ring = g_rings.back().get();
+    ring->tid = (int)g_rings.size();
+    ring->name = "helper " + std::to_string(ring->tid);
+    return ring;
+}
+
+TraceRing* ThreadRing() {
+    if (t_ring.ring) return t_ring.ring;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    t_ring.ring = TakeRing([](const TraceRing&) { return true; });
+    if (!t_ring.defaultName.empty()) t_ring.ring->name = t_ring.defaultName;
+    return t_ring.ring;
+}
+
+void WriteJsonString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char)c < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+int64_t SteadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+uint64_t TraceNowNs() {
+    return (uint64_t)std::max<int64_t>(0, SteadyNs() - g_epochNs.load(std::memory_order_relaxed));
+}
+
+void TraceRecord(const char* name, uint64_t startNs, uint64_t endNs, int64_t arg) {
+    TraceRing* ring = ThreadRing();
+    const uint32_t gen = g_generation.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (ring->generation != gen) {
+        // First event of a new session on this thread: drop the old ones
+        ring->generation = gen;
+        head = 0;
+    }
+    ring->events[head % kRingEvents] = TraceEvent{name, startNs, endNs - startNs, arg};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool TraceAvailable() { return true; }
+
+void TraceBegin() {
+    g_generation.fetch_add(1);
+    g_epochNs = SteadyNs();
+    g_traceEnabled = true;
+}
+
+void TraceEnd() { g_traceEnabled = false; }
+
+void TraceSetThreadName(const std::string& name) {
+    if (!g_traceEnabled) return; // threads that never record get no ring
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // A named thread gets a lane of its own: skip rings that already hold this
+    // session's events from another thread
+    const uint32_t gen = g_generation.load();
+    auto fresh = [gen](const TraceRing& r) { return r.generation != gen || r.head.load() == 0; };
+    if (t_ring.ring && !fresh(*t_ring.ring)) g_free.push_back(t_ring.ring), t_ring.ring = nullptr;
+    if (!t_ring.ring) t_ring.ring = TakeRing(fresh);
+    t_ring.ring->name = name;
+}
+
+void TraceSetDefaultThreadName(const std::string& name) {
+    t_ring.defaultName = name;
+    if (!t_ring.ring) return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    t_ring.ring->name = name;
+}
+
+bool TraceWriteChrome(const std::string& path, std::string& err) {
+    TraceEnd();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) { err = "Failed to create trace " + path; return false; }
+    const uint32_t gen = g_generation.load();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"genfx export\"}}";
+    char num[96];
+    for (const auto& ring : g_rings) {
+        if (ring->generation != gen) continue;
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        if (head == 0) continue;
+        out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid << ",\"args\":{\"name\":";
+        WriteJsonString(out, ring->name);
+        out << "}}";
+        const uint64_t count = std::min<uint64_t>(head, kRingEvents);
+        if (count < head) {
+            out << ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"dropped " << head - count << " events\",\"pid\":1,\"tid\":"
+                << ring->tid << ",\"ts\":0}";
+        }
+        for (uint64_t i = head - count; i < head; ++i) {
+            const TraceEvent& e = ring->events[i % kRingEvents];
+            // Microseconds with nanosecond precision
+            std::snprintf(num, sizeof(num), "\"ts\":%.3f,\"dur\":%.3f", e.startNs / 1000.0, e.durNs / 1000.0);
+            out << ",\n{\"ph\":\"X\",\"cat\":\"genfx\",\"name\":";
+            WriteJsonString(out, e.name);
+            out << ",\"pid\":1,\"tid\":" << ring->tid << "," << num;
+            if (e.arg >= 0) out << ",\"args\":{\"frame\":" << e.arg << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    if (!out.good()) { err = "Failed to write trace " + path; return false; }
+    return true;
+}
+
+#else
+
+bool TraceAvailable() { return false; }
+void TraceBegin() {}
+void TraceEnd() {}
+void TraceSetThreadName(const std::string&) {}
+void TraceSetDefaultThreadName(const std::string&) {}
+bool TraceWriteChrome(const std::string& path, std::string& err) {
+    err = "Tracing is not compiled in (GENFX_WITH_TRACING=OFF); cannot write " + path;
+    return false;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timers for the export pipeline, written out as a Chrome trace (open it in
+// chrome://tracing or ui.perfetto.dev). Every thread records into its own fixed-size
+// ring without locks; a scope costs two clock reads while a session is running and
+// one relaxed load otherwise. Without GENFX_TRACING the scopes compile to nothing.
+//
+//   GENFX_TRACE_SCOPE("encode frame");
+//   GENFX_TRACE_SCOPE_ARG("render", frameIndex);
+
+// True when tracing was compiled in
+bool TraceAvailable();
+// Clears every ring and starts recording
+void TraceBegin();
+void TraceEnd();
+// Lane name for the calling thread in the trace viewer (while a session is running)
+void TraceSetThreadName(const std::string& name);
+// Lane name for every session, for long-lived threads started before TraceBegin()
+// (the job pool workers)
+void TraceSetDefaultThreadName(const std::string& name);
+// Stops recording and writes everything recorded since TraceBegin()
+bool TraceWriteChrome(const std::string& path, std::string& err);
+
+#ifdef GENFX_TRACING
+
+extern std::atomic<bool> g_traceEnabled;
+uint64_t TraceNowNs();
+void TraceRecord(const char* name, uint64_t startNs, uint64_t endNs, int64_t arg);
+
+class TraceScope {
+public:
+    // 'name' must outlive the session (a string literal); arg is usually a frame index, < 0 = none
+    explicit TraceScope(const char* name, int64_t arg = -1)
+        : m_name(g_traceEnabled.load(std::memory_order_relaxed) ? name : nullptr), m_arg(arg),
+          m_start(m_name ? TraceNowNs() : 0) {}
+    ~TraceScope() { if (m_name) TraceRecord(m_name, m_start, TraceNowNs(), m_arg); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_arg;
+    uint64_t m_start;
+};
+
+#define GENFX_TRACE_CONCAT_(a, b) a##b
+#define GENFX_TRACE_CONCAT(a, b) GENFX_TRACE_CONCAT_(a, b)
+#define GENFX_TRACE_SCOPE(name) TraceScope GENFX_TRACE_CONCAT(genfxTrace_, __LINE__)(name)
+#define GENFX_TRACE_SCOPE_ARG(name, arg) TraceScope GENFX_TRACE_CONCAT(genfxTrace_, __LINE__)(name, (int64_t)(arg))
+
+#else
+
+#define GENFX_TRACE_SCOPE(name) ((void)0)
+#define GENFX_TRACE_SCOPE_ARG(name, arg) ((void)0)
+
+#endif
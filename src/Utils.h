@@ -4,6 +4,8 @@
 #include <cctype>
 #include <random>
 #include <vector>
+#include <thread>
+#include "JobSystem.h"
 
 inline std::string ToKebabCase(const std::string& in) {
     std::string out;
@@ -37,3 +39,40 @@ private:
 };
 
 struct SizeI { int w{0}; int h{0}; };
+
+// Chunks ParallelFor() may split into when called from this thread, 0 = one per
+// pool worker. Jobs inherit it, so nested loops follow the same limit.
+inline thread_local int t_parallelForThreads = 0;
+
+// Scoped thread count for ParallelFor() on the calling thread: 1 runs everything
+// inline (the reference renderer); counts above the core count are allowed, which
+// is how the golden checks show that results do not depend on the split.
+class ParallelForLimit {
+public:
+    explicit ParallelForLimit(int threads) : m_saved(t_parallelForThreads) { t_parallelForThreads = threads; }
+    ~ParallelForLimit() { t_parallelForThreads = m_saved; }
+    ParallelForLimit(const ParallelForLimit&) = delete;
+    ParallelForLimit& operator=(const ParallelForLimit&) = delete;
+private:
+    int m_saved;
+};
+
+// Split [0, count) into contiguous chunks and run fn(begin, end) as jobs on the shared
+// pool (JobSystem.h), at the calling thread's priority. Chunks smaller than minChunk are
+// not worth a job; the calling thread takes the first one and helps with the rest.
+template <typename Fn>
+inline void ParallelFor(int count, int minChunk, Fn&& fn) {
+    if (count <= 0) return;
+    const int limit = t_parallelForThreads;
+    int hw = limit > 0 ? limit : JobWorkerCount();
+    int chunks = std::clamp(count / std::max(1, minChunk), 1, hw);
+    if (chunks <= 1) { fn(0, count); return; }
+    JobGroup group;
+    for (int c = 1; c < chunks; ++c) {
+        int b = int((long long)count * c / chunks);
+        int e = int((long long)count * (c + 1) / chunks);
+        group.Run([&fn, b, e]() { fn(b, e); });
+    }
+    fn(0, int((long long)count / chunks));
+    group.Wait();
+}
@@ -0,0 +1,336 @@
+#include "VideoEncoder.h"
+#include "AsyncFileWriter.h"
+#include "VpxEncoder.h"
+#include "AnimatedWebP.h"
+#include "SpriteAtlas.h"
+#include "FrameStore.h"
+#include "PngEncoder.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// ffmpeg arguments for 'inputArgs' (everything up to and including -i); the codec
+// options come from 'settings'
+std::vector<std::string> BuildFFmpegArgs(const EncoderSettings& settings, const std::vector<std::string>& inputArgs,
+                                         const std::string& outPath) {
+    const std::string crf = std::to_string(settings.crf);
+    const std::string gop = std::to_string(settings.gop);
+    const std::string cpu = std::to_string(settings.cpuUsed);
+    // The log only lands on disk on failure (or with saveLogs), so info costs nothing
+    std::vector<std::string> args = {"-hide_banner", "-loglevel", settings.saveLogs ? "verbose" : "info", "-y"};
+    args.insert(args.end(), inputArgs.begin(), inputArgs.end());
+    if (settings.threads > 0) args.insert(args.end(), {"-threads", std::to_string(settings.threads)});
+    if (settings.codec == VideoCodec::UTVideo_RGBA) {
+        // UT Video RGBA (lossless), single stream with native alpha in MOV
+        args.insert(args.end(), {"-an", "-vf", "format=rgba", "-c:v", "utvideo", "-pix_fmt", "rgba"});
+    } else if (settings.codec == VideoCodec::VP9_Alpha) {
+        // VP9 single-stream alpha (yuva420p). Note: some builds may drop alpha.
+        args.insert(args.end(), {"-an", "-vf", "format=rgba,format=yuva420p", "-c:v", "libvpx-vp9", "-pix_fmt", "yuva420p",
+                                 "-b:v", "0", "-crf", crf, "-g", gop, "-deadline", "good", "-cpu-used", cpu,
+                                 "-auto-alt-ref", "1", "-lag-in-frames", "25", "-metadata:s:v:0", "alpha_mode=1"});
+    } else {
+        // VP8 dual-stream alpha: color in v:0 (yuv420p), alpha in v:1 (gray/yuv420p)
+        // This path is widely supported and guarantees transparency.
+        args.insert(args.end(), {"-an", "-filter_complex",
+                                 "[0:v]format=rgba,split=2[c][a];[c]format=yuv420p[color];[a]alphaextract,format=gray[alpha]",
+                                 "-map", "[color]", "-map", "[alpha]",
+                                 "-c:v:0", "libvpx", "-pix_fmt:v:0", "yuv420p", "-b:v:0", "0", "-crf:v:0", crf, "-g", gop,
+                                 "-deadline", "good", "-cpu-used", cpu, "-auto-alt-ref", "0",
+                                 "-c:v:1", "libvpx", "-pix_fmt:v:1", "yuv420p", "-b:v:1", "0", "-crf:v:1", crf, "-g", gop,
+                                 "-deadline", "good", "-cpu-used", cpu, "-auto-alt-ref", "0",
+                                 "-metadata:s:v:0", "alpha_mode=1", "-metadata:s:v:1", "alpha_mode=1"});
+    }
+    args.push_back(outPath);
+    return args;
+}
+
+// Supervisor options for one ffmpeg run writing 'outPath'; its log goes next to it
+FFmpegRunOptions MakeRunOptions(const EncoderSettings& settings, std::vector<std::string> args,
+                                const std::string& outPath, int expectedFrames) {
+    FFmpegRunOptions opts;
+    opts.args = std::move(args);
+    opts.expectedFrames = expectedFrames;
+    opts.stallSec = settings.stallTimeoutSec;
+    opts.cancel = settings.cancel;
+    opts.keepLog = settings.saveLogs;
+    opts.niceness = settings.niceness;
+    std::string logPath = outPath;
+    auto pos = logPath.find_last_of('.');
+    if (pos != std::string::npos) logPath.insert(pos, "-ffmpeg-output");
+    else logPath += ".ffmpeg-output";
+    opts.logPath = logPath + ".txt";
+    if (settings.onProgress) {
+        auto cb = settings.onProgress;
+        opts.onProgress = [cb, outPath](const FFmpegProgress& p) { cb(outPath, p); };
+    }
+    return opts;
+}
+
+std::string JoinArgs(const std::vector<std::string>& args) {
+    std::string s = "ffmpeg";
+    for (const auto& a : args) s += a.find(' ') == std::string::npos ? " " + a : " \"" + a + "\"";
+    return s;
+}
+
+void PrintWriterStats(const std::string& outPath, const FileWriterStats& st) {
+    std::cout << "PNG frames for " << outPath << ": " << st.files << " files, " << st.bytes / (1024.0 * 1024.0)
+              << " MB at " << st.MBps() << " MB/s, " << st.FilesPerSec() << " frames/s; encoders waited "
+              << st.stalledSec * 1000.0 << " ms on the disk" << std::endl;
+}
+
+// Fallback backend: frames go to a PNG sequence next to the output, then one ffmpeg
+// command line encodes it. The PNGs are encoded on the calling thread and written by an
+// AsyncFileWriter (shared by the segments of an output), so encoding overlaps the disk.
+class FFmpegSequenceEncoder : public VideoEncoder {
+public:
+    explicit FFmpegSequenceEncoder(std::shared_ptr<AsyncFileWriter> writer = nullptr) : m_writer(std::move(writer)) {}
+
+    bool Open(const std::string& outPath, const EncoderSettings& settings, std::string& err) override {
+        if (!m_writer) {
+            m_writer = std::make_shared<AsyncFileWriter>();
+            m_ownsWriter = true;
+        }
+        m_outPath = outPath;
+        m_settings = settings;
+        m_index = 0;
+        m_stats = EncoderStats{};
+        std::filesystem::path p(outPath);
+        m_framesDir = p.parent_path() / (p.stem().string() + "_frames");
+        std::error_code ec;
+        std::filesystem::create_directories(m_framesDir, ec);
+        if (ec) {
+            err = std::string("Failed to create frames directory: ") + m_framesDir.string();
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteFrame(const uint8_t* bgra, std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            GENFX_TRACE_SCOPE_ARG("png encode", m_index);
+            if (!EncodePNGFromBGRA(bgra, m_settings.width, m_settings.height, m_png)) {
+                err = std::string("Failed to encode PNG for ") + m_outPath;
+                return false;
+            }
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "frame-%06d.png", ++m_index);
+        if (!m_writer->Submit((m_framesDir / name).string(), std::move(m_png), err)) return false;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_stats.frames++;
+        m_stats.frameMs += ms;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, ms);
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            GENFX_TRACE_SCOPE("png flush");
+            if (!m_writer->Flush(err)) return false;
+        }
+        if (m_ownsWriter) PrintWriterStats(m_outPath, m_writer->Stats());
+        const std::string pattern = (m_framesDir / "frame-%06d.png").string();
+        const auto args = BuildFFmpegArgs(m_settings, {"-framerate", std::to_string(m_settings.fps), "-i", pattern}, m_outPath);
+        std::cout << "FFmpeg sequence command: " << JoinArgs(args) << std::endl;
+        if (!RunFFmpeg(MakeRunOptions(m_settings, args, m_outPath, m_index), err)) return false;
+        m_stats.finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::error_code ec;
+        m_stats.bytes = std::filesystem::file_size(m_outPath, ec);
+        // Cleanup frames on success
+        std::filesystem::remove_all(m_framesDir, ec);
+        return true;
+    }
+
+    const char* Name() const override { return "ffmpeg"; }
+
+private:
+    std::string m_outPath;
+    EncoderSettings m_settings;
+    std::filesystem::path m_framesDir;
+    std::vector<uint8_t> m_png;
+    std::shared_ptr<AsyncFileWriter> m_writer;
+    bool m_ownsWriter{false};
+    int m_index{0};
+};
+
+// Each segment is its own PNG sequence + ffmpeg run into a part file; the parts are
+// then joined with the concat demuxer and stream copy.
+class FFmpegSegmentedOutput : public SegmentedOutput {
+public:
+    bool Open(const std::string& outPath, const EncoderSettings& settings, int segments, std::string& err) override {
+        m_outPath = outPath;
+        m_settings = settings;
+        m_parts.assign(size_t(std::max(1, segments)), std::string());
+        m_bytes = 0;
+        m_writer = std::make_shared<AsyncFileWriter>();
+        (void)err;
+        return true;
+    }
+
+    std::unique_ptr<VideoEncoder> BeginSegment(int index, int firstFrame, std::string& err) override {
+        EncoderSettings s = m_settings;
+        s.firstFrame = firstFrame;
+        auto enc = std::make_unique<FFmpegSequenceEncoder>(m_writer);
+        if (!enc->Open(PartPath(index), s, err)) return nullptr;
+        return enc;
+    }
+
+    bool EndSegment(int index, std::unique_ptr<VideoEncoder>, std::string& err) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int)m_parts.size()) { err = "Invalid segment index"; return false; }
+        m_parts[index] = PartPath(index);
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        for (const auto& p : m_parts) {
+            if (p.empty()) { err = "Export ended with unfinished segments"; return false; }
+        }
+        if (m_writer->Stats().files) PrintWriterStats(m_outPath, m_writer->Stats());
+        std::error_code ec;
+        if (m_parts.size() == 1) {
+            std::filesystem::rename(m_parts[0], m_outPath, ec);
+            if (ec) { err = "Failed to move " + m_parts[0] + " to " + m_outPath; return false; }
+        } else if (!Concat(err)) {
+            return false;
+        }
+        m_bytes = std::filesystem::file_size(m_outPath, ec);
+        return true;
+    }
+
+    const char* Name() const override { return "ffmpeg"; }
+    uint64_t Bytes() const override { return m_bytes; }
+
+    // The part files already outlive a failed run; they stay where they are
+    bool EnableCheckpoints(const std::string&) override { return true; }
+    std::string CheckpointFile(int index) const override { return PartPath(index); }
+    bool RestoreSegment(int index, const std::string& file, std::string& err) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int)m_parts.size()) { err = "Invalid segment index"; return false; }
+        m_parts[index] = file;
+        return true;
+    }
+
+private:
+    std::string PartPath(int index) const {
+        std::filesystem::path p(m_outPath);
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".part%03d", index);
+        return (p.parent_path() / (p.stem().string() + suffix + p.extension().string())).string();
+    }
+
+    bool Concat(std::string& err) {
+        const std::string listPath = m_outPath + ".parts.txt";
+        {
+            std::ofstream list(listPath);
+            for (const auto& p : m_parts) {
+                // concat demuxer syntax: single quotes, embedded quotes as '\''
+                std::string esc;
+                for (char c : std::filesystem::absolute(p).string()) {
+                    if (c == '\'') esc += "'\\''"; else esc += c;
+                }
+                list << "file '" << esc << "'\n";
+            }
+            if (!list.good()) { err = "Failed to write " + listPath; return false; }
+        }
+        std::vector<std::string> args = {"-hide_banner", "-loglevel", "warning", "-y", "-f", "concat", "-safe", "0",
+                                         "-i", listPath, "-map", "0", "-c", "copy"};
+        // Stream copy keeps the alpha planes; restate the container flag so players see them
+        if (m_settings.codec == VideoCodec::VP9_Alpha) args.insert(args.end(), {"-metadata:s:v:0", "alpha_mode=1"});
+        else if (m_settings.codec == VideoCodec::VP8_DualStream)
+            args.insert(args.end(), {"-metadata:s:v:0", "alpha_mode=1", "-metadata:s:v:1", "alpha_mode=1"});
+        args.push_back(m_outPath);
+        std::cout << "FFmpeg concat command: " << JoinArgs(args) << std::endl;
+        if (!RunFFmpeg(MakeRunOptions(m_settings, args, m_outPath, 0), err)) {
+            err = "ffmpeg concat: " + err;
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::remove(listPath, ec);
+        for (const auto& p : m_parts) std::filesystem::remove(p, ec);
+        return true;
+    }
+
+    std::string m_outPath;
+    EncoderSettings m_settings;
+    std::mutex m_mutex;
+    std::vector<std::string> m_parts;
+    std::shared_ptr<AsyncFileWriter> m_writer;
+    uint64_t m_bytes{0};
+};
+
+} // namespace
+
+bool VideoEncoder::WriteRows(const uint8_t* bgra, int y, int rows, int width, int height, std::string& err) {
+    const size_t rowBytes = size_t(width) * 4;
+    m_rows.resize(rowBytes * size_t(height));
+    std::memcpy(m_rows.data() + size_t(y) * rowBytes, bgra, size_t(rows) * rowBytes);
+    if (y + rows < height) return true;
+    return WriteFrame(m_rows.data(), err);
+}
+
+bool HasInProcessEncoder(VideoCodec codec) {
+    if (codec == VideoCodec::AnimatedWebP || codec == VideoCodec::SpriteAtlas || codec == VideoCodec::RawFrameStore)
+        return true; // libwebp/libpng are always linked, the store is plain file IO
+#ifdef GENFX_HAVE_LIBVPX
+    return codec == VideoCodec::VP8_DualStream || codec == VideoCodec::VP9_Alpha;
+#else
+    (void)codec;
+    return false;
+#endif
+}
+
+std::unique_ptr<VideoEncoder> CreateVideoEncoder(VideoCodec codec, EncoderBackend backend) {
+    if (codec == VideoCodec::AnimatedWebP) return CreateAnimatedWebPEncoder();
+    if (codec == VideoCodec::SpriteAtlas) return CreateSpriteAtlasEncoder();
+    if (codec == VideoCodec::RawFrameStore) return CreateFrameStoreEncoder();
+    if (backend == EncoderBackend::Auto && HasInProcessEncoder(codec)) {
+        if (auto enc = CreateVpxEncoder()) return enc;
+    }
+    return std::make_unique<FFmpegSequenceEncoder>();
+}
+
+std::unique_ptr<SegmentedOutput> CreateSegmentedOutput(VideoCodec codec, EncoderBackend backend) {
+    if (codec == VideoCodec::AnimatedWebP) return CreateAnimatedWebPOutput();
+    if (codec == VideoCodec::SpriteAtlas) return CreateSpriteAtlasOutput();
+    if (codec == VideoCodec::RawFrameStore) return CreateFrameStoreOutput();
+    if (backend == EncoderBackend::Auto && HasInProcessEncoder(codec)) {
+        if (auto out = CreateVpxSegmentedOutput()) return out;
+    }
+    return std::make_unique<FFmpegSegmentedOutput>();
+}
+
+bool EncodeRawVideoFile(const std::string& rawPath, uint64_t offset, const std::string& outPath,
+                        const EncoderSettings& settings, std::string& err) {
+    if (settings.codec != VideoCodec::VP8_DualStream && settings.codec != VideoCodec::VP9_Alpha &&
+        settings.codec != VideoCodec::UTVideo_RGBA) {
+        err = "ffmpeg raw input only supports the VP8, VP9 and UT Video codecs";
+        return false;
+    }
+    std::vector<std::string> input = {"-f", "rawvideo", "-pix_fmt", "bgra",
+                                      "-s", std::to_string(settings.width) + "x" + std::to_string(settings.height),
+                                      "-framerate", std::to_string(settings.fps),
+                                      "-skip_initial_bytes", std::to_string(offset), "-i", rawPath};
+    if (settings.frameCount > 0) input.insert(input.end(), {"-frames:v", std::to_string(settings.frameCount)});
+    const auto args = BuildFFmpegArgs(settings, input, outPath);
+    std::cout << "FFmpeg raw command: " << JoinArgs(args) << std::endl;
+    return RunFFmpeg(MakeRunOptions(settings, args, outPath, settings.frameCount), err);
+}
+
+const char* VideoCodecExtension(VideoCodec codec) {
+    if (codec == VideoCodec::UTVideo_RGBA) return ".mov";
+    if (codec == VideoCodec::AnimatedWebP) return ".webp";
+    if (codec == VideoCodec::SpriteAtlas) return ".json";
+    if (codec == VideoCodec::RawFrameStore) return ".gfxraw";
+    return ".webm";
+}
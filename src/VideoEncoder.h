@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "FFmpegProcess.h"
+
+// Order matches the codec choice in the UI
+enum class VideoCodec { VP8_DualStream, VP9_Alpha, UTVideo_RGBA, AnimatedWebP, SpriteAtlas, RawFrameStore };
+
+enum class EncoderBackend {
+    Auto,      // in-process libvpx when compiled in and the codec supports it, else ffmpeg
+    FFmpegCLI, // PNG sequence + ffmpeg command line
+};
+
+struct EncoderSettings {
+    int width{0};
+    int height{0};
+    int fps{30};
+    VideoCodec codec{VideoCodec::VP8_DualStream};
+    int crf{22};     // constant-quality level, 0..63 (WebP: 0 = lossless)
+    int gop{60};     // keyframe every 'gop' frames
+    int cpuUsed{4};  // libvpx speed/quality trade-off
+    int threads{0};  // encoder threads, 0 = hardware concurrency
+    bool saveLogs{true};       // ffmpeg: keep its log even when it succeeds (it is always kept on failure)
+    int firstFrame{0}; // loop index of the first frame fed; keeps timestamps and keyframes global
+    int frameCount{0}; // frames in the whole loop (0 = unknown); needed by the raw frame store
+    int atlasFrameStep{1};     // sprite atlas: keep every Nth frame (playback at fps/N)
+    int atlasMaxPage{2048};    // sprite atlas: page side limit, power of two
+    bool atlasIndexed{false};  // sprite atlas: 8-bit palette pages instead of RGBA
+    bool rawLz4{false};        // raw frame store: LZ4-compressed tiles
+    // ffmpeg processes: abort flag, live progress (called on a reader thread with the
+    // output path) and a stall timeout in seconds (0 = none)
+    const std::atomic<bool>* cancel{nullptr};
+    std::function<void(const std::string& outPath, const FFmpegProgress& progress)> onProgress;
+    double stallTimeoutSec{0.0};
+    int niceness{0}; // ffmpeg processes run at lower priority (ExportLimits::niceness)
+};
+
+struct EncoderStats {
+    int frames{0};
+    double frameMs{0.0};    // total time spent inside WriteFrame
+    double maxFrameMs{0.0};
+    double finishMs{0.0};   // flush / external encode at Finish()
+    uint64_t bytes{0};      // output size
+};
+
+// Consumes straight-alpha BGRA frames (width*height*4) in display order and produces
+// one output file.
+class VideoEncoder {
+public:
+    virtual ~VideoEncoder() = default;
+    virtual bool Open(const std::string& outPath, const EncoderSettings& settings, std::string& err) = 0;
+    // 'bgra' is only read during the call, so it can point straight at a render buffer
+    virtual bool WriteFrame(const uint8_t* bgra, std::string& err) = 0;
+    // Rows [y, y + rows) of the next frame (width x height), fed top to bottom by strip
+    // rendering (Renderer::SetStripRows). By default they are gathered into a frame for
+    // WriteFrame(); encoders that can take rows as they come override this.
+    virtual bool WriteRows(const uint8_t* bgra, int y, int rows, int width, int height, std::string& err);
+    virtual bool Finish(std::string& err) = 0;
+    virtual const char* Name() const = 0;
+    const EncoderStats& Stats() const { return m_stats; }
+
+protected:
+    EncoderStats m_stats;
+    std::vector<uint8_t> m_rows; // frame being gathered by WriteRows()
+};
+
+// One output file assembled from independently encoded, keyframe-aligned segments.
+// Segments can be encoded concurrently and finish in any order; the result is joined
+// without re-encoding.
+class SegmentedOutput {
+public:
+    virtual ~SegmentedOutput() = default;
+    virtual bool Open(const std::string& outPath, const EncoderSettings& settings, int segments, std::string& err) = 0;
+    // Thread-safe. The encoder is already open; settings.firstFrame = 'firstFrame'.
+    virtual std::unique_ptr<VideoEncoder> BeginSegment(int index, int firstFrame, std::string& err) = 0;
+    // Thread-safe. Takes the encoder after its Finish() succeeded.
+    virtual bool EndSegment(int index, std::unique_ptr<VideoEncoder> encoder, std::string& err) = 0;
+    // After every segment ended: join and finalize the file
+    virtual bool Finish(std::string& err) = 0;
+    virtual const char* Name() const = 0;
+    virtual uint64_t Bytes() const = 0;
+    // Files written by Finish() next to the output path (e.g. atlas pages)
+    virtual std::vector<std::string> SideFiles() const { return {}; }
+
+    // Resumable exports (ExportCheckpoint). After EnableCheckpoints(), every ended segment
+    // is also a complete file, CheckpointFile(index), that a later export with the same
+    // settings hands to RestoreSegment() in place of BeginSegment() ... EndSegment().
+    // Outputs that keep nothing between segments return false and are encoded in full.
+    virtual bool EnableCheckpoints(const std::string& dir) { (void)dir; return false; }
+    virtual std::string CheckpointFile(int index) const { (void)index; return std::string(); }
+    // Thread-safe
+    virtual bool RestoreSegment(int index, const std::string& file, std::string& err) {
+        (void)index; (void)file;
+        err = std::string(Name()) + " cannot resume segments";
+        return false;
+    }
+};
+
+bool HasInProcessEncoder(VideoCodec codec);
+std::unique_ptr<SegmentedOutput> CreateSegmentedOutput(VideoCodec codec, EncoderBackend backend);
+std::unique_ptr<VideoEncoder> CreateVideoEncoder(VideoCodec codec, EncoderBackend backend);
+
+// ffmpeg reading tightly packed BGRA frames (settings.frameCount of them) straight from
+// 'rawPath' at byte 'offset', e.g. an uncompressed raw frame store. VP8/VP9/UT Video.
+bool EncodeRawVideoFile(const std::string& rawPath, uint64_t offset, const std::string& outPath,
+                        const EncoderSettings& settings, std::string& err);
+
+// Output extension for a codec, including the dot
+const char* VideoCodecExtension(VideoCodec codec);
@@ -0,0 +1,397 @@
+#include "VpxEncoder.h"
+
+#ifdef GENFX_HAVE_LIBVPX
+#include "ColorConvert.h"
+#include "WebmMuxer.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <vpx/vpx_encoder.h>
+#include <vpx/vp8cx.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Packet {
+    std::vector<uint8_t> data;
+    bool key{false};
+};
+
+// Compressed color + alpha for one displayed frame
+struct EncodedFrame {
+    int64_t index{0};
+    Packet color;
+    std::vector<uint8_t> alpha;
+};
+
+// One libvpx encoder (the color planes or the alpha plane) plus its input image.
+class VpxStream {
+public:
+    ~VpxStream() { Close(); }
+
+    bool Open(const EncoderSettings& s, bool alphaPlane, std::string& err) {
+        const bool vp9 = s.codec == VideoCodec::VP9_Alpha;
+        vpx_codec_iface_t* iface = vp9 ? vpx_codec_vp9_cx() : vpx_codec_vp8_cx();
+        vpx_codec_enc_cfg_t cfg;
+        if (vpx_codec_enc_config_default(iface, &cfg, 0) != VPX_CODEC_OK) {
+            err = "libvpx: no default encoder config";
+            return false;
+        }
+        int threads = s.threads > 0 ? s.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+        // The alpha plane is a fraction of the work; give it a small share of the threads.
+        // Both streams encode side by side, so the shares add up to 'threads'
+        const int alphaThreads = std::max(1, threads / 4);
+        if (alphaPlane) threads = alphaThreads;
+        else if (threads > 1) threads -= alphaThreads;
+        cfg.g_w = (unsigned)s.width;
+        cfg.g_h = (unsigned)s.height;
+        cfg.g_timebase.num = 1;
+        cfg.g_timebase.den = std::max(1, s.fps);
+        cfg.g_threads = (unsigned)std::clamp(threads, 1, 64);
+        cfg.g_pass = VPX_RC_ONE_PASS;
+        cfg.g_lag_in_frames = vp9 ? 25 : 0;
+        cfg.rc_end_usage = VPX_Q;
+        cfg.rc_min_quantizer = 0;
+        cfg.rc_max_quantizer = 63;
+        // Keyframes are forced every 'gop' frames on both streams so color and alpha stay aligned
+        cfg.kf_mode = VPX_KF_DISABLED;
+        cfg.kf_min_dist = cfg.kf_max_dist = (unsigned)std::max(1, s.gop);
+        if (vpx_codec_enc_init(&m_ctx, iface, &cfg, 0) != VPX_CODEC_OK) {
+            err = std::string("libvpx: ") + vpx_codec_error(&m_ctx);
+            return false;
+        }
+        m_open = true;
+        vpx_codec_control(&m_ctx, VP8E_SET_CPUUSED, s.cpuUsed);
+        vpx_codec_control(&m_ctx, VP8E_SET_CQ_LEVEL, (unsigned)std::clamp(s.crf, 0, 63));
+        vpx_codec_control(&m_ctx, VP8E_SET_ENABLEAUTOALTREF, vp9 ? 1u : 0u);
+        if (vp9) {
+            int tiles = 0; // log2 of tile columns; tiles must be at least 256 px wide
+            while (tiles < 6 && (1 << (tiles + 1)) <= threads && (s.width >> (tiles + 1)) >= 256) ++tiles;
+            vpx_codec_control(&m_ctx, VP9E_SET_TILE_COLUMNS, tiles);
+            vpx_codec_control(&m_ctx, VP9E_SET_ROW_MT, 1u);
+        }
+        if (!vpx_img_alloc(&m_img, VPX_IMG_FMT_I420, (unsigned)s.width, (unsigned)s.height, 32)) {
+            err = "libvpx: cannot allocate image";
+            return false;
+        }
+        m_imgAlloc = true;
+        return true;
+    }
+
+    vpx_image_t& Image() { return m_img; }
+
+    // img == nullptr flushes delayed frames. Completed packets land in 'packets' by pts.
+    bool Encode(const vpx_image_t* img, int64_t pts, bool forceKey, bool& gotPacket, std::string& err) {
+        gotPacket = false;
+        vpx_enc_frame_flags_t flags = forceKey ? VPX_EFLAG_FORCE_KF : 0;
+        if (vpx_codec_encode(&m_ctx, img, img ? pts : -1, 1, flags, VPX_DL_GOOD_QUALITY) != VPX_CODEC_OK) {
+            err = std::string("libvpx: ") + vpx_codec_error(&m_ctx);
+            if (const char* d = vpx_codec_error_detail(&m_ctx)) err += std::string(" (") + d + ")";
+            return false;
+        }
+        vpx_codec_iter_t iter = nullptr;
+        while (const vpx_codec_cx_pkt_t* pkt = vpx_codec_get_cx_data(&m_ctx, &iter)) {
+            if (pkt->kind != VPX_CODEC_CX_FRAME_PKT) continue;
+            Packet& p = packets[(int64_t)pkt->data.frame.pts];
+            const uint8_t* b = static_cast<const uint8_t*>(pkt->data.frame.buf);
+            p.data.assign(b, b + pkt->data.frame.sz);
+            p.key = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
+            gotPacket = true;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (m_open) vpx_codec_destroy(&m_ctx);
+        if (m_imgAlloc) vpx_img_free(&m_img);
+        m_open = m_imgAlloc = false;
+    }
+
+    std::map<int64_t, Packet> packets;
+
+private:
+    vpx_codec_ctx_t m_ctx{};
+    vpx_image_t m_img{};
+    bool m_open{false};
+    bool m_imgAlloc{false};
+};
+
+class VpxEncoder : public VideoEncoder {
+public:
+    // 'collect' keeps the compressed frames in memory (see TakeFrames) instead of
+    // writing a file; used for segments
+    explicit VpxEncoder(bool collect = false) : m_collect(collect) {}
+
+    bool Open(const std::string& outPath, const EncoderSettings& settings, std::string& err) override {
+        m_settings = settings;
+        m_frame = settings.firstFrame;
+        m_stats = EncoderStats{};
+        m_frames.clear();
+        if (settings.codec != VideoCodec::VP8_DualStream && settings.codec != VideoCodec::VP9_Alpha) {
+            err = "In-process encoder supports VP8 and VP9 only";
+            return false;
+        }
+        if (!m_color.Open(settings, false, err) || !m_alpha.Open(settings, true, err)) return false;
+        WebmMuxer::Track track;
+        track.codecId = settings.codec == VideoCodec::VP9_Alpha ? "V_VP9" : "V_VP8";
+        track.width = settings.width;
+        track.height = settings.height;
+        track.fps = settings.fps;
+        track.alpha = true;
+        return m_collect || m_mux.Open(outPath, track, err);
+    }
+
+    bool WriteFrame(const uint8_t* bgra, std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        const int w = m_settings.width, h = m_settings.height;
+        vpx_image_t& ci = m_color.Image();
+        vpx_image_t& ai = m_alpha.Image();
+        {
+            GENFX_TRACE_SCOPE_ARG("bgra to i420", m_frame);
+            ConvertBGRAToI420(bgra, w, h, ci.planes[VPX_PLANE_Y], ci.stride[VPX_PLANE_Y],
+                              ci.planes[VPX_PLANE_U], ci.stride[VPX_PLANE_U], ci.planes[VPX_PLANE_V], ci.stride[VPX_PLANE_V]);
+            ConvertBGRAToAlphaI420(bgra, w, h, ai.planes[VPX_PLANE_Y], ai.stride[VPX_PLANE_Y],
+                                   ai.planes[VPX_PLANE_U], ai.stride[VPX_PLANE_U], ai.planes[VPX_PLANE_V], ai.stride[VPX_PLANE_V]);
+        }
+        const bool key = m_frame % std::max(1, m_settings.gop) == 0;
+        // Color and alpha encoders are independent; run them side by side
+        bool ok[2] = {true, true};
+        bool got[2] = {false, false};
+        std::string errs[2];
+        ParallelFor(2, 1, [&](int b, int e) {
+            for (int i = b; i < e; ++i) {
+                GENFX_TRACE_SCOPE_ARG(i == 0 ? "vpx encode color" : "vpx encode alpha", m_frame);
+                VpxStream& s = i == 0 ? m_color : m_alpha;
+                ok[i] = s.Encode(&s.Image(), m_frame, key, got[i], errs[i]);
+            }
+        });
+        if (!ok[0] || !ok[1]) { err = ok[0] ? errs[1] : errs[0]; return false; }
+        ++m_frame;
+        GENFX_TRACE_SCOPE("webm mux");
+        if (!Mux(false, err)) return false;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        m_stats.frames++;
+        m_stats.frameMs += ms;
+        m_stats.maxFrameMs = std::max(m_stats.maxFrameMs, ms);
+        return true;
+    }
+
+    bool Finish(std::string& err) override {
+        auto t0 = std::chrono::steady_clock::now();
+        for (VpxStream* s : {&m_color, &m_alpha}) {
+            bool got = true;
+            while (got) {
+                if (!s->Encode(nullptr, 0, false, got, err)) return false;
+            }
+        }
+        if (!Mux(true, err)) return false;
+        if (!m_collect && !m_mux.Close(err)) return false;
+        m_color.Close();
+        m_alpha.Close();
+        if (!m_collect) m_stats.bytes = m_mux.BytesWritten();
+        m_stats.finishMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    const char* Name() const override { return "libvpx"; }
+
+    std::vector<EncodedFrame> TakeFrames() { return std::move(m_frames); }
+
+private:
+    // Write every frame whose color and alpha packets are both available; at the end,
+    // also anything left on the color side.
+    bool Mux(bool drain, std::string& err) {
+        auto& cp = m_color.packets;
+        auto& ap = m_alpha.packets;
+        while (!cp.empty()) {
+            auto c = cp.begin();
+            auto a = ap.find(c->first);
+            if (a == ap.end() && !drain) break;
+            const bool hasAlpha = a != ap.end();
+            if (m_collect) {
+                EncodedFrame f;
+                f.index = c->first;
+                f.color = std::move(c->second);
+                if (hasAlpha) f.alpha = std::move(a->second.data);
+                m_stats.bytes += f.color.data.size() + f.alpha.size();
+                m_frames.push_back(std::move(f));
+            } else if (!m_mux.WriteFrame(c->first, c->second.key, c->second.data.data(), c->second.data.size(),
+                                         hasAlpha ? a->second.data.data() : nullptr, hasAlpha ? a->second.data.size() : 0)) {
+                err = "Failed to write WebM frame";
+                return false;
+            }
+            if (hasAlpha) ap.erase(a);
+            cp.erase(c);
+        }
+        return true;
+    }
+
+    EncoderSettings m_settings;
+    VpxStream m_color, m_alpha;
+    WebmMuxer m_mux;
+    int64_t m_frame{0};
+    bool m_collect{false};
+    std::vector<EncodedFrame> m_frames;
+};
+
+// Segment checkpoint: "GFXVPXS1", frame count, then per frame its index, key flag and
+// the color and alpha packets with their sizes. Written under a temporary name.
+bool SaveFrames(const std::string& path, const std::vector<EncodedFrame>& frames) {
+    const std::string part = path + ".part";
+    {
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        auto put = [&](const void* p, size_t n) { out.write(static_cast<const char*>(p), (std::streamsize)n); };
+        const uint32_t count = (uint32_t)frames.size();
+        put("GFXVPXS1", 8);
+        put(&count, 4);
+        for (const EncodedFrame& f : frames) {
+            const uint8_t key = f.color.key ? 1 : 0;
+            const uint32_t colorBytes = (uint32_t)f.color.data.size(), alphaBytes = (uint32_t)f.alpha.size();
+            put(&f.index, 8);
+            put(&key, 1);
+            put(&colorBytes, 4);
+            put(f.color.data.data(), colorBytes);
+            put(&alphaBytes, 4);
+            put(f.alpha.data(), alphaBytes);
+        }
+        if (!out.good()) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(part, path, ec);
+    return !ec;
+}
+
+bool LoadFrames(const std::string& path, std::vector<EncodedFrame>& frames, std::string& err) {
+    std::ifstream in(path, std::ios::binary);
+    auto get = [&](void* p, size_t n) { return (bool)in.read(static_cast<char*>(p), (std::streamsize)n); };
+    char magic[8] = {};
+    uint32_t count = 0;
+    if (!get(magic, 8) || std::string(magic, 8) != "GFXVPXS1" || !get(&count, 4)) {
+        err = "Not a segment checkpoint: " + path;
+        return false;
+    }
+    frames.assign(count, EncodedFrame{});
+    for (EncodedFrame& f : frames) {
+        uint8_t key = 0;
+        uint32_t colorBytes = 0, alphaBytes = 0;
+        bool ok = get(&f.index, 8) && get(&key, 1) && get(&colorBytes, 4);
+        f.color.key = key != 0;
+        if (ok) { f.color.data.resize(colorBytes); ok = get(f.color.data.data(), colorBytes) && get(&alphaBytes, 4); }
+        if (ok) { f.alpha.resize(alphaBytes); ok = get(f.alpha.data(), alphaBytes); }
+        if (!ok) { err = "Truncated segment checkpoint: " + path; return false; }
+    }
+    return true;
+}
+
+class VpxSegmentedOutput : public SegmentedOutput {
+public:
+    bool Open(const std::string& outPath, const EncoderSettings& settings, int segments, std::string& err) override {
+        m_settings = settings;
+        m_outPath = outPath;
+        m_segments.assign(size_t(std::max(1, segments)), {});
+        m_done.assign(m_segments.size(), false);
+        m_next = 0;
+        WebmMuxer::Track track;
+        track.codecId = settings.codec == VideoCodec::VP9_Alpha ? "V_VP9" : "V_VP8";
+        track.width = settings.width;
+        track.height = settings.height;
+        track.fps = settings.fps;
+        track.alpha = true;
+        return m_mux.Open(outPath, track, err);
+    }
+
+    std::unique_ptr<VideoEncoder> BeginSegment(int, int firstFrame, std::string& err) override {
+        auto enc = std::make_unique<VpxEncoder>(true);
+        EncoderSettings s = m_settings;
+        s.firstFrame = firstFrame;
+        if (!enc->Open(std::string(), s, err)) return nullptr;
+        return enc;
+    }
+
+    bool EndSegment(int index, std::unique_ptr<VideoEncoder> encoder, std::string& err) override {
+        std::vector<EncodedFrame> frames = static_cast<VpxEncoder&>(*encoder).TakeFrames();
+        // A checkpoint that cannot be written is only a segment to encode again next time
+        if (!m_checkpointDir.empty() && !SaveFrames(CheckpointFile(index), frames)) {
+            std::error_code ec;
+            std::filesystem::remove(CheckpointFile(index), ec);
+        }
+        return Commit(index, std::move(frames), err);
+    }
+
+    bool RestoreSegment(int index, const std::string& file, std::string& err) override {
+        std::vector<EncodedFrame> frames;
+        return LoadFrames(file, frames, err) && Commit(index, std::move(frames), err);
+    }
+
+    bool EnableCheckpoints(const std::string& dir) override {
+        m_checkpointDir = dir;
+        return true;
+    }
+
+    std::string CheckpointFile(int index) const override {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".seg%03d.vpxseg", index);
+        return (std::filesystem::path(m_checkpointDir) / (std::filesystem::path(m_outPath).stem().string() + suffix)).string();
+    }
+
+    bool Finish(std::string& err) override {
+        if (m_next != m_segments.size()) {
+            err = "Export ended with unfinished segments";
+            return false;
+        }
+        return m_mux.Close(err);
+    }
+
+    const char* Name() const override { return "libvpx"; }
+    uint64_t Bytes() const override { return m_mux.BytesWritten(); }
+
+private:
+    bool Commit(int index, std::vector<EncodedFrame> frames, std::string& err) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < 0 || index >= (int)m_segments.size() || m_done[index]) {
+            err = "Invalid segment index";
+            return false;
+        }
+        m_segments[index] = std::move(frames);
+        m_done[index] = true;
+        // Write every segment that is now contiguous with what is already in the file
+        while (m_next < m_segments.size() && m_done[m_next]) {
+            for (const EncodedFrame& f : m_segments[m_next]) {
+                if (!m_mux.WriteFrame(f.index, f.color.key, f.color.data.data(), f.color.data.size(),
+                                      f.alpha.empty() ? nullptr : f.alpha.data(), f.alpha.size())) {
+                    err = "Failed to write WebM frame";
+                    return false;
+                }
+            }
+            std::vector<EncodedFrame>().swap(m_segments[m_next]);
+            ++m_next;
+        }
+        return true;
+    }
+
+    EncoderSettings m_settings;
+    std::string m_outPath;
+    std::string m_checkpointDir;
+    WebmMuxer m_mux;
+    std::mutex m_mutex;
+    std::vector<std::vector<EncodedFrame>> m_segments;
+    std::vector<bool> m_done;
+    size_t m_next{0};
+};
+
+} // namespace
+
+std::unique_ptr<VideoEncoder> CreateVpxEncoder() { return std::make_unique<VpxEncoder>(); }
+std::unique_ptr<SegmentedOutput> CreateVpxSegmentedOutput() { return std::make_unique<VpxSegmentedOutput>(); }
+
+#else
+
+std::unique_ptr<VideoEncoder> CreateVpxEncoder() { return nullptr; }
+std::unique_ptr<SegmentedOutput> CreateVpxSegmentedOutput() { return nullptr; }
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+#include "VideoEncoder.h"
+
+// In-process VP8/VP9 encoder: libvpx for color and alpha, WebmMuxer for the container.
+// Only available when built with GENFX_HAVE_LIBVPX; returns nullptr otherwise.
+std::unique_ptr<VideoEncoder> CreateVpxEncoder();
+// Segments keep their compressed frames in memory and are muxed in order as they
+// complete, so joining them is just writing blocks.
+std::unique_ptr<SegmentedOutput> CreateVpxSegmentedOutput();
@@ -0,0 +1,299 @@
+#include "WebmMuxer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Matroska element IDs used here
+enum : uint32_t {
+    kEBML = 0x1A45DFA3, kEBMLVersion = 0x4286, kEBMLReadVersion = 0x42F7, kEBMLMaxIDLength = 0x42F2,
+    kEBMLMaxSizeLength = 0x42F3, kDocType = 0x4282, kDocTypeVersion = 0x4287, kDocTypeReadVersion = 0x4285,
+    kSegment = 0x18538067, kSeekHead = 0x114D9B74, kSeek = 0x4DBB, kSeekID = 0x53AB, kSeekPosition = 0x53AC,
+    kInfo = 0x1549A966, kTimecodeScale = 0x2AD7B1, kDuration = 0x4489, kMuxingApp = 0x4D80, kWritingApp = 0x5741,
+    kTracks = 0x1654AE6B, kTrackEntry = 0xAE, kTrackNumber = 0xD7, kTrackUID = 0x73C5, kTrackType = 0x83,
+    kFlagLacing = 0x9C, kCodecID = 0x86, kDefaultDuration = 0x23E383, kMaxBlockAdditionID = 0x55EE,
+    kVideo = 0xE0, kPixelWidth = 0xB0, kPixelHeight = 0xBA, kAlphaMode = 0x53C0,
+    kCluster = 0x1F43B675, kTimecode = 0xE7, kSimpleBlock = 0xA3, kBlockGroup = 0xA0, kBlock = 0xA1,
+    kReferenceBlock = 0xFB, kBlockAdditions = 0x75A1, kBlockMore = 0xA6, kBlockAddID = 0xEE,
+    kBlockAdditional = 0xA5, kCues = 0x1C53BB6B, kCuePoint = 0xBB, kCueTime = 0xB3,
+    kCueTrackPositions = 0xB7, kCueTrack = 0xF7, kCueClusterPosition = 0xF1, kVoid = 0xEC,
+};
+
+constexpr size_t kSeekHeadReserve = 96; // room for three Seek entries with 8-byte positions
+
+void PutID(std::vector<uint8_t>& b, uint32_t id) {
+    int n = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+    for (int i = n - 1; i >= 0; --i) b.push_back(uint8_t(id >> (8 * i)));
+}
+
+void PutSize(std::vector<uint8_t>& b, uint64_t size) {
+    int n = 1;
+    while (n < 8 && size >= (1ull << (7 * n)) - 1) ++n;
+    for (int i = n - 1; i >= 0; --i) {
+        uint8_t byte = uint8_t(size >> (8 * i));
+        if (i == n - 1) byte |= uint8_t(0x80 >> (n - 1));
+        b.push_back(byte);
+    }
+}
+
+// 8-byte size field, patched once the element is complete
+void PutSize8(std::vector<uint8_t>& b, uint64_t size) {
+    b.push_back(0x01);
+    for (int i = 6; i >= 0; --i) b.push_back(uint8_t(size >> (8 * i)));
+}
+
+void PutUInt(std::vector<uint8_t>& b, uint32_t id, uint64_t v, int minBytes = 1) {
+    int n = minBytes;
+    while (n < 8 && (v >> (8 * n))) ++n;
+    PutID(b, id);
+    PutSize(b, n);
+    for (int i = n - 1; i >= 0; --i) b.push_back(uint8_t(v >> (8 * i)));
+}
+
+void PutSInt(std::vector<uint8_t>& b, uint32_t id, int64_t v) {
+    int n = 1;
+    while (n < 8 && (v < -(1ll << (8 * n - 1)) || v >= (1ll << (8 * n - 1)))) ++n;
+    PutID(b, id);
+    PutSize(b, n);
+    for (int i = n - 1; i >= 0; --i) b.push_back(uint8_t(uint64_t(v) >> (8 * i)));
+}
+
+void PutFloat(std::vector<uint8_t>& b, uint32_t id, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, 8);
+    PutID(b, id);
+    PutSize(b, 8);
+    for (int i = 7; i >= 0; --i) b.push_back(uint8_t(bits >> (8 * i)));
+}
+
+void PutBytes(std::vector<uint8_t>& b, uint32_t id, const void* data, size_t size) {
+    PutID(b, id);
+    PutSize(b, size);
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    b.insert(b.end(), p, p + size);
+}
+
+void PutString(std::vector<uint8_t>& b, uint32_t id, const std::string& s) { PutBytes(b, id, s.data(), s.size()); }
+
+void PutMaster(std::vector<uint8_t>& b, uint32_t id, const std::vector<uint8_t>& body) {
+    PutID(b, id);
+    PutSize(b, body.size());
+    b.insert(b.end(), body.begin(), body.end());
+}
+
+// Void element covering exactly 'total' bytes (total >= 9)
+void PutVoid(std::vector<uint8_t>& b, size_t total) {
+    b.push_back(uint8_t(kVoid));
+    PutSize8(b, total - 9);
+    b.insert(b.end(), total - 9, 0);
+}
+
+} // namespace
+
+WebmMuxer::~WebmMuxer() {
+    std::string err;
+    if (m_out.is_open()) Close(err);
+}
+
+uint64_t WebmMuxer::Tell() { return (uint64_t)m_out.tellp(); }
+
+void WebmMuxer::Write(const std::vector<uint8_t>& b) {
+    m_out.write(reinterpret_cast<const char*>(b.data()), (std::streamsize)b.size());
+    m_bytes += b.size();
+}
+
+void WebmMuxer::PatchSize(uint64_t sizePos, uint64_t size) {
+    std::vector<uint8_t> b;
+    PutSize8(b, size);
+    auto end = m_out.tellp();
+    m_out.seekp((std::streamoff)sizePos);
+    m_out.write(reinterpret_cast<const char*>(b.data()), (std::streamsize)b.size());
+    m_out.seekp(end);
+}
+
+bool WebmMuxer::Open(const std::string& path, const Track& track, std::string& err) {
+    m_out.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_out) { err = "Cannot create " + path; return false; }
+    m_track = track;
+    m_bytes = 0;
+    m_cues.clear();
+    m_clusterOpen = false;
+    m_lastFrame = -1;
+
+    std::vector<uint8_t> b, body;
+    PutUInt(body, kEBMLVersion, 1);
+    PutUInt(body, kEBMLReadVersion, 1);
+    PutUInt(body, kEBMLMaxIDLength, 4);
+    PutUInt(body, kEBMLMaxSizeLength, 8);
+    PutString(body, kDocType, "webm");
+    PutUInt(body, kDocTypeVersion, 4);
+    PutUInt(body, kDocTypeReadVersion, 2);
+    PutMaster(b, kEBML, body);
+    PutID(b, kSegment);
+    Write(b);
+    m_segmentSizePos = Tell();
+    b.clear();
+    PutSize8(b, 0);
+    Write(b);
+    m_segmentStart = Tell();
+
+    // SeekHead is written at Close(); keep its space
+    m_seekHeadPos = Tell();
+    b.clear();
+    PutVoid(b, kSeekHeadReserve);
+    Write(b);
+
+    m_infoPos = Tell();
+    b.clear(); body.clear();
+    PutUInt(body, kTimecodeScale, 1000000); // 1 ms ticks
+    size_t durationOffset = body.size() + 3; // ID (2) + size (1)
+    PutFloat(body, kDuration, 0.0);
+    PutString(body, kMuxingApp, "genfx");
+    PutString(body, kWritingApp, "genfx");
+    PutMaster(b, kInfo, body);
+    m_durationPos = m_infoPos + (b.size() - body.size()) + durationOffset;
+    Write(b);
+
+    m_tracksPos = Tell();
+    std::vector<uint8_t> video, entry;
+    b.clear(); body.clear();
+    PutUInt(video, kPixelWidth, (uint64_t)track.width);
+    PutUInt(video, kPixelHeight, (uint64_t)track.height);
+    if (track.alpha) PutUInt(video, kAlphaMode, 1);
+    PutUInt(entry, kTrackNumber, 1);
+    PutUInt(entry, kTrackUID, 1);
+    PutUInt(entry, kTrackType, 1);
+    PutUInt(entry, kFlagLacing, 0);
+    PutString(entry, kCodecID, track.codecId);
+    PutUInt(entry, kDefaultDuration, (uint64_t)(1000000000.0 / std::max(1, track.fps) + 0.5));
+    if (track.alpha) PutUInt(entry, kMaxBlockAdditionID, 1);
+    PutMaster(entry, kVideo, video);
+    PutMaster(body, kTrackEntry, entry);
+    PutMaster(b, kTracks, body);
+    Write(b);
+    if (!m_out) { err = "Write failed: " + path; return false; }
+    return true;
+}
+
+void WebmMuxer::CloseCluster() {
+    if (!m_clusterOpen) return;
+    PatchSize(m_clusterSizePos, Tell() - (m_clusterSizePos + 8));
+    m_clusterOpen = false;
+}
+
+bool WebmMuxer::WriteFrame(int64_t frameIndex, bool keyframe, const uint8_t* data, size_t size,
+                           const uint8_t* alpha, size_t alphaSize) {
+    const int fps = std::max(1, m_track.fps);
+    const uint64_t timeMs = (uint64_t)((frameIndex * 1000 + fps / 2) / fps);
+    // Block timecodes are int16 relative to the cluster
+    if (!m_clusterOpen || keyframe || timeMs - m_clusterTimeMs > 30000) {
+        CloseCluster();
+        uint64_t pos = Tell();
+        if (keyframe) m_cues.push_back({timeMs, pos - m_segmentStart});
+        m_buf.clear();
+        PutID(m_buf, kCluster);
+        Write(m_buf);
+        m_clusterSizePos = Tell();
+        m_buf.clear();
+        PutSize8(m_buf, 0);
+        PutUInt(m_buf, kTimecode, timeMs);
+        Write(m_buf);
+        m_clusterOpen = true;
+        m_clusterTimeMs = timeMs;
+    }
+    const int16_t rel = (int16_t)(timeMs - m_clusterTimeMs);
+    const uint8_t header[4] = {0x81, uint8_t(uint16_t(rel) >> 8), uint8_t(rel & 0xFF), uint8_t(keyframe ? 0x80 : 0x00)};
+
+    m_buf.clear();
+    if (!m_track.alpha || !alpha || !alphaSize) {
+        PutID(m_buf, kSimpleBlock);
+        PutSize(m_buf, size + 4);
+        m_buf.insert(m_buf.end(), header, header + 4);
+        Write(m_buf);
+    } else {
+        // BlockGroup { Block, [ReferenceBlock], BlockAdditions { BlockMore { id 1, alpha } } }
+        std::vector<uint8_t> more, adds, tail;
+        PutUInt(more, kBlockAddID, 1);
+        PutBytes(more, kBlockAdditional, alpha, alphaSize);
+        PutMaster(adds, kBlockMore, more);
+        if (!keyframe && m_lastFrame >= 0) {
+            int64_t prevMs = (m_lastFrame * 1000 + fps / 2) / fps;
+            PutSInt(tail, kReferenceBlock, prevMs - (int64_t)timeMs);
+        }
+        PutMaster(tail, kBlockAdditions, adds);
+        const uint64_t blockSize = size + 4;
+        std::vector<uint8_t> blockHead;
+        PutID(blockHead, kBlock);
+        PutSize(blockHead, blockSize);
+        const uint64_t groupSize = blockHead.size() + blockSize + tail.size();
+        PutID(m_buf, kBlockGroup);
+        PutSize(m_buf, groupSize);
+        m_buf.insert(m_buf.end(), blockHead.begin(), blockHead.end());
+        m_buf.push_back(0x81);
+        m_buf.push_back(header[1]);
+        m_buf.push_back(header[2]);
+        m_buf.push_back(0x00); // Block flags carry no keyframe bit; ReferenceBlock absence does
+        Write(m_buf);
+        m_out.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+        m_bytes += size;
+        Write(tail);
+        m_lastFrame = frameIndex;
+        return (bool)m_out;
+    }
+    m_out.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+    m_bytes += size;
+    m_lastFrame = frameIndex;
+    return (bool)m_out;
+}
+
+bool WebmMuxer::Close(std::string& err) {
+    if (!m_out.is_open()) return true;
+    CloseCluster();
+
+    uint64_t cuesPos = Tell();
+    std::vector<uint8_t> b, body;
+    for (const auto& c : m_cues) {
+        std::vector<uint8_t> pos, point;
+        PutUInt(pos, kCueTrack, 1);
+        PutUInt(pos, kCueClusterPosition, c.clusterPos);
+        PutUInt(point, kCueTime, c.timeMs);
+        PutMaster(point, kCueTrackPositions, pos);
+        PutMaster(body, kCuePoint, point);
+    }
+    if (!m_cues.empty()) { PutMaster(b, kCues, body); Write(b); }
+
+    uint64_t end = Tell();
+    PatchSize(m_segmentSizePos, end - m_segmentStart);
+
+    // Duration in ms (TimecodeScale units)
+    const int fps = std::max(1, m_track.fps);
+    double durationMs = (m_lastFrame + 1) * 1000.0 / fps;
+    b.clear();
+    PutFloat(b, kDuration, durationMs);
+    m_out.seekp((std::streamoff)m_durationPos);
+    m_out.write(reinterpret_cast<const char*>(b.data() + 3), 8);
+
+    // SeekHead in the reserved space, padded with a Void
+    std::vector<uint8_t> seeks;
+    auto addSeek = [&](uint32_t id, uint64_t pos) {
+        std::vector<uint8_t> s, idBytes;
+        PutID(idBytes, id);
+        PutBytes(s, kSeekID, idBytes.data(), idBytes.size());
+        PutUInt(s, kSeekPosition, pos - m_segmentStart);
+        PutMaster(seeks, kSeek, s);
+    };
+    addSeek(kInfo, m_infoPos);
+    addSeek(kTracks, m_tracksPos);
+    if (!m_cues.empty()) addSeek(kCues, cuesPos);
+    b.clear();
+    PutMaster(b, kSeekHead, seeks);
+    if (b.size() + 9 <= kSeekHeadReserve) PutVoid(b, kSeekHeadReserve - b.size());
+    if (b.size() == kSeekHeadReserve) {
+        m_out.seekp((std::streamoff)m_seekHeadPos);
+        m_out.write(reinterpret_cast<const char*>(b.data()), (std::streamsize)b.size());
+    }
+    m_out.seekp((std::streamoff)end);
+    m_out.close();
+    if (m_out.fail()) { err = "Failed to finalize WebM file"; return false; }
+    return true;
+}
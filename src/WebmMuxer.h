@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+// Minimal single-track WebM (Matroska) writer for VP8/VP9. Alpha follows the WebM
+// convention: the track is flagged AlphaMode=1 and each frame's alpha bitstream is
+// stored as BlockAdditional id 1 next to the color frame. A cluster starts at every
+// keyframe and Cues point at them, so the output is seekable.
+class WebmMuxer {
+public:
+    struct Track {
+        std::string codecId; // "V_VP8" or "V_VP9"
+        int width{0};
+        int height{0};
+        int fps{30};
+        bool alpha{false};
+    };
+
+    ~WebmMuxer();
+    bool Open(const std::string& path, const Track& track, std::string& err);
+    // Frames must arrive in display order. 'alpha' is ignored unless the track has alpha.
+    bool WriteFrame(int64_t frameIndex, bool keyframe, const uint8_t* data, size_t size,
+                    const uint8_t* alpha = nullptr, size_t alphaSize = 0);
+    bool Close(std::string& err);
+    uint64_t BytesWritten() const { return m_bytes; }
+
+private:
+    struct CuePoint { uint64_t timeMs; uint64_t clusterPos; };
+
+    void Write(const std::vector<uint8_t>& b);
+    void CloseCluster();
+    uint64_t Tell();
+    void PatchSize(uint64_t sizePos, uint64_t size);
+
+    std::ofstream m_out;
+    Track m_track;
+    uint64_t m_bytes{0};
+    uint64_t m_segmentSizePos{0};
+    uint64_t m_segmentStart{0};
+    uint64_t m_seekHeadPos{0};
+    uint64_t m_durationPos{0};
+    uint64_t m_infoPos{0};
+    uint64_t m_tracksPos{0};
+    bool m_clusterOpen{false};
+    uint64_t m_clusterSizePos{0};
+    uint64_t m_clusterTimeMs{0};
+    int64_t m_lastFrame{-1};
+    std::vector<CuePoint> m_cues;
+    std::vector<uint8_t> m_buf; // scratch for element assembly
+};
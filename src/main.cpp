@@ -1,14 +1,33 @@
 #include <wx/wx.h>
+#include <wx/stdpaths.h>
+#include <wx/filename.h>
 #include "MainFrame.h"
+#include "EffectScript.h"
 
 class GenfxApp : public wxApp {
 public:
     bool OnInit() override {
         if (!wxApp::OnInit()) return false;
+        LoadScriptedEffects();
         MainFrame* frame = new MainFrame("GenFX - Looping Effects Exporter");
         frame->Show(true);
         return true;
     }
+
+private:
+    // *.gfx definitions next to the executable, then in the working directory
+    void LoadScriptedEffects() {
+        wxFileName exe(wxStandardPaths::Get().GetExecutablePath());
+        std::vector<std::string> dirs = {
+            (exe.GetPath() + wxFILE_SEP_PATH + "effects").ToStdString(),
+            "effects",
+        };
+        std::vector<std::string> errors;
+        for (const auto& d : dirs) {
+            if (LoadEffectScripts(d, errors) > 0) break;
+        }
+        for (const auto& e : errors) wxLogWarning("Effect script %s", e);
+    }
 };
 
 wxIMPLEMENT_APP(GenfxApp);
@@ -0,0 +1,139 @@
+// genfx_farm: renders exports on a farm of worker processes (see RenderFarm.h).
+//
+//   genfx_farm submit SPOOL --effect NAME [--overlay NAME] [--name NAME] [--sizes WxH,...]
+//                     [--duration S] [--fps N] [--density N] [--speed F]
+//                     [--codec vp8|vp9|utvideo|webp|atlas|raw] [--crf N] [--unit-frames N]
+//   genfx_farm work SPOOL [--wait] [--lease SEC] [--worker NAME]
+//   genfx_farm merge SPOOL OUTDIR
+//   genfx_farm status SPOOL
+//
+// Every command takes --effects DIR for the effect scripts. Start 'work' on as many
+// machines (or as many times on one) as there are to spare; 'merge' writes the outputs
+// of finished jobs, so it can be run at any time and again later.
+#include "EffectScript.h"
+#include "RenderFarm.h"
+#include <wx/init.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef GENFX_EFFECTS_DIR
+#define GENFX_EFFECTS_DIR "effects"
+#endif
+
+namespace {
+
+int Usage() {
+    std::cerr << "usage: genfx_farm submit SPOOL --effect NAME [--overlay NAME] [--name NAME] [--sizes WxH,...]\n"
+                 "                         [--duration S] [--fps N] [--density N] [--speed F]\n"
+                 "                         [--codec vp8|vp9|utvideo|webp|atlas|raw] [--crf N] [--unit-frames N]\n"
+                 "       genfx_farm work SPOOL [--wait] [--lease SEC] [--worker NAME]\n"
+                 "       genfx_farm merge SPOOL OUTDIR\n"
+                 "       genfx_farm status SPOOL\n"
+                 "       (all commands: [--effects DIR])\n";
+    return 1;
+}
+
+bool ParseCodec(const std::string& s, VideoCodec& c) {
+    if (s == "vp8") c = VideoCodec::VP8_DualStream;
+    else if (s == "vp9") c = VideoCodec::VP9_Alpha;
+    else if (s == "utvideo") c = VideoCodec::UTVideo_RGBA;
+    else if (s == "webp") c = VideoCodec::AnimatedWebP;
+    else if (s == "atlas") c = VideoCodec::SpriteAtlas;
+    else if (s == "raw") c = VideoCodec::RawFrameStore;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) return Usage();
+    const std::string cmd = argv[1];
+    const std::string spool = argv[2];
+    std::string outDir, effectsDir = GENFX_EFFECTS_DIR;
+    std::string effect, overlay, name, sizes, codec;
+    int duration = 12, fps = 30, density = 50, crf = -1, unitFrames = 60;
+    float speed = 1.0f;
+    FarmWorkerOptions worker;
+    int first = 3;
+    if (cmd == "merge") {
+        if (argc < 4) return Usage();
+        outDir = argv[3];
+        first = 4;
+    }
+    for (int i = first; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (a == "--effects" && (v = value())) effectsDir = v;
+        else if (a == "--effect" && (v = value())) effect = v;
+        else if (a == "--overlay" && (v = value())) overlay = v;
+        else if (a == "--name" && (v = value())) name = v;
+        else if (a == "--sizes" && (v = value())) sizes = v;
+        else if (a == "--codec" && (v = value())) codec = v;
+        else if (a == "--duration" && (v = value())) duration = std::atoi(v);
+        else if (a == "--fps" && (v = value())) fps = std::atoi(v);
+        else if (a == "--density" && (v = value())) density = std::atoi(v);
+        else if (a == "--speed" && (v = value())) speed = (float)std::atof(v);
+        else if (a == "--crf" && (v = value())) crf = std::atoi(v);
+        else if (a == "--unit-frames" && (v = value())) unitFrames = std::atoi(v);
+        else if (a == "--wait") worker.waitForClaimed = true;
+        else if (a == "--lease" && (v = value())) worker.leaseSec = std::atof(v);
+        else if (a == "--worker" && (v = value())) worker.name = v;
+        else return Usage();
+    }
+
+    std::string err;
+    if (cmd == "status") {
+        const FarmStatus st = FarmGetStatus(spool);
+        std::cout << st.jobs << " jobs, units: " << st.todo << " queued, " << st.claimed << " claimed, "
+                  << st.done << " done" << std::endl;
+        return 0;
+    }
+
+    wxInitializer wx; // wxImage backs the PNG encoder
+    std::vector<std::string> errors;
+    LoadEffectScripts(effectsDir, errors);
+    for (const auto& e : errors) std::cerr << "Effect script " << e << std::endl;
+
+    if (cmd == "submit") {
+        if (effect.empty()) return Usage();
+        // Same defaults as a fresh UI session
+        ExportJob job;
+        job.effect = effect;
+        job.sizes = { {1280,720}, {720,1280}, {1920,1080}, {1080,1920} };
+        if (!sizes.empty() && !ParseSizes(sizes, job.sizes)) return Usage();
+        job.duration = duration;
+        job.fps = fps;
+        job.density = density;
+        job.speed = speed;
+        job.glow = Renderer::DefaultGlowForEffect(effect);
+        if (!overlay.empty()) job.overlay = Renderer::DefaultLayerForEffect(overlay);
+        job.outName = !name.empty() ? name : overlay.empty() ? effect : effect + "-" + overlay;
+        if (!codec.empty() && !ParseCodec(codec, job.encoder.codec)) return Usage();
+        if (crf >= 0) job.encoder.crf = crf;
+        if (!FarmSubmit(spool, job, unitFrames, err)) { std::cerr << err << std::endl; return 1; }
+        const FarmStatus st = FarmGetStatus(spool);
+        std::cout << "Submitted " << job.outName << "; " << st.todo << " units queued" << std::endl;
+        return 0;
+    }
+    if (cmd == "work") {
+        int rendered = 0;
+        const bool ok = FarmWork(spool, worker, rendered, err);
+        std::cout << "Rendered " << rendered << " units" << std::endl;
+        if (!ok) { std::cerr << err << std::endl; return 1; }
+        return 0;
+    }
+    if (cmd == "merge") {
+        std::vector<std::string> merged, pending;
+        if (!FarmMerge(spool, outDir, merged, pending, err)) { std::cerr << err << std::endl; return 1; }
+        for (const auto& n : merged) std::cout << "Merged " << n << std::endl;
+        for (const auto& n : pending) std::cout << "Still rendering " << n << std::endl;
+        return pending.empty() ? 0 : 3;
+    }
+    return Usage();
+}